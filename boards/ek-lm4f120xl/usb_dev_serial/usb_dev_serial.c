@@ -37,6 +37,7 @@
 #include "driverlib/systick.h"
 #include "driverlib/timer.h"
 #include "driverlib/uart.h"
+#include "driverlib/udma.h"
 #include "driverlib/usb.h"
 #include "driverlib/rom.h"
 #include "usblib/usblib.h"
@@ -62,6 +63,14 @@
 //! driver information (INF) file for use with Windows XP, Windows Vista and
 //! Windows7 can be found in C:/StellarisWare/windows_drivers. For Windows
 //! 2000, the required INF file is in C:/StellarisWare/windows_drivers/win2K.
+//!
+//! If the application is built with \b UART_DMA_BRIDGE defined, data is moved
+//! between the USB endpoints and the UART by the uDMA controller in blocks of
+//! up to 1 KB rather than a character at a time.  This mode allows the
+//! virtual COM port to keep up with the UART running at up to 3 Mbaud.  A
+//! block received from the host is passed to the UART when it is full, when
+//! the host sends a short packet or once the host has sent nothing for 2
+//! milliseconds.
 //
 //*****************************************************************************
 
@@ -152,6 +161,81 @@ unsigned long g_ulUARTRxErrors = 0;
 #define RX_GPIO_PERIPH          SYSCTL_PERIPH_GPIOA
 #define RX_GPIO_PIN             GPIO_PIN_0
 
+#ifdef UART_DMA_BRIDGE
+//*****************************************************************************
+//
+// The uDMA channels used to move data to and from the redirected UART when
+// the UART DMA bridge is in use.
+//
+//*****************************************************************************
+#define USB_UART_DMA_RX         UDMA_CHANNEL_UART0RX
+#define USB_UART_DMA_TX         UDMA_CHANNEL_UART0TX
+
+//*****************************************************************************
+//
+// The size of each of the blocks used to carry data through the bridge.  Two
+// blocks are used in each direction so that one can be filled while the
+// other is emptied.  This must be a multiple of the USB packet size (64
+// bytes) and no larger than 1024 bytes, the largest uDMA transfer.
+//
+//*****************************************************************************
+#define BRIDGE_BUFFER_SIZE      1024
+
+//*****************************************************************************
+//
+// The number of USB frames (milliseconds) without data from the host after
+// which a partly filled receive block is passed to the UART.  Hosts do not
+// end a write that fills its last packet with a zero length packet, so
+// without this timeout such data would wait until the host sends more.
+//
+//*****************************************************************************
+#define BRIDGE_RX_IDLE_FRAMES   2
+
+//*****************************************************************************
+//
+// The control table used by the uDMA controller.  This table must be aligned
+// to a 1024 byte boundary.
+//
+//*****************************************************************************
+#if defined(ewarm)
+#pragma data_alignment=1024
+unsigned char g_pucDMAControlTable[1024];
+#elif defined(ccs)
+#pragma DATA_ALIGN(g_pucDMAControlTable, 1024)
+unsigned char g_pucDMAControlTable[1024];
+#else
+unsigned char g_pucDMAControlTable[1024] __attribute__ ((aligned(1024)));
+#endif
+
+//*****************************************************************************
+//
+// Blocks of data received from the USB host and waiting to be sent on the
+// UART.  g_pulHostCount holds the number of bytes in each block and is zero
+// when the block is free.  Blocks are filled and emptied in turn, starting
+// with g_ulHostFill and g_ulHostSend respectively.
+//
+//*****************************************************************************
+static unsigned long g_pulHostBuf[2][BRIDGE_BUFFER_SIZE / 4];
+static volatile unsigned long g_pulHostCount[2];
+static unsigned long g_ulHostFill;
+static unsigned long g_ulHostSend;
+static tBoolean g_bHostRxBusy;
+static tBoolean g_bUARTTxBusy;
+
+//*****************************************************************************
+//
+// Blocks of data received from the UART and waiting to be sent to the USB
+// host, managed in the same way as the blocks above.
+//
+//*****************************************************************************
+static unsigned long g_pulUARTBuf[2][BRIDGE_BUFFER_SIZE / 4];
+static volatile unsigned long g_pulUARTCount[2];
+static unsigned long g_ulUARTFill;
+static unsigned long g_ulUARTSend;
+static tBoolean g_bUARTRxBusy;
+static tBoolean g_bDevTxBusy;
+#endif
+
 //*****************************************************************************
 //
 // Flag indicating whether or not we are currently sending a Break condition.
@@ -189,7 +273,9 @@ static volatile tBoolean g_bUSBConfigured = false;
 // Internal function prototypes.
 //
 //*****************************************************************************
+#ifndef UART_DMA_BRIDGE
 static void USBUARTPrimeTransmit(unsigned long ulBase);
+#endif
 static void CheckForSerialStateChange(const tUSBDCDCDevice *psDevice, long lErrors);
 static void SetControlLineState(unsigned short usState);
 static tBoolean SetLineCoding(tLineCoding *psLineCoding);
@@ -271,6 +357,7 @@ CheckForSerialStateChange(const tUSBDCDCDevice *psDevice, long lErrors)
     }
 }
 
+#ifndef UART_DMA_BRIDGE
 //*****************************************************************************
 //
 // Read as many characters from the UART FIFO as we can and move them into
@@ -405,6 +492,147 @@ USBUARTPrimeTransmit(unsigned long ulBase)
         }
     }
 }
+#endif
+
+#ifdef UART_DMA_BRIDGE
+//*****************************************************************************
+//
+// The following functions implement the UART DMA bridge.  They are called
+// from the USB and UART interrupt handlers, which run at the same priority
+// and so never preempt each other.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+// Starts a USB receive transfer into the next block if it is free.
+//
+//*****************************************************************************
+static void
+BridgeHostReceive(void)
+{
+    if(g_bUSBConfigured && !g_bHostRxBusy && !g_pulHostCount[g_ulHostFill])
+    {
+        g_bHostRxBusy = USBDCDCTransferRead((void *)&g_sCDCDevice,
+                                   (unsigned char *)g_pulHostBuf[g_ulHostFill],
+                                   BRIDGE_BUFFER_SIZE);
+    }
+}
+
+//*****************************************************************************
+//
+// Starts sending the next block received from the USB host on the UART if
+// one is waiting and the UART is idle.
+//
+//*****************************************************************************
+static void
+BridgeUARTTransmit(void)
+{
+    if(g_bSendingBreak || g_bUARTTxBusy || !g_pulHostCount[g_ulHostSend])
+    {
+        return;
+    }
+
+    g_bUARTTxBusy = true;
+    ROM_uDMAChannelTransferSet(USB_UART_DMA_TX | UDMA_PRI_SELECT,
+                               UDMA_MODE_BASIC, g_pulHostBuf[g_ulHostSend],
+                               (void *)(USB_UART_BASE + UART_O_DR),
+                               g_pulHostCount[g_ulHostSend]);
+    ROM_uDMAChannelEnable(USB_UART_DMA_TX);
+}
+
+//*****************************************************************************
+//
+// Starts the uDMA controller receiving from the UART into the next block if
+// it is free.
+//
+//*****************************************************************************
+static void
+BridgeUARTReceive(void)
+{
+    if(g_bUARTRxBusy || g_pulUARTCount[g_ulUARTFill])
+    {
+        return;
+    }
+
+    g_bUARTRxBusy = true;
+    ROM_uDMAChannelTransferSet(USB_UART_DMA_RX | UDMA_PRI_SELECT,
+                               UDMA_MODE_BASIC,
+                               (void *)(USB_UART_BASE + UART_O_DR),
+                               g_pulUARTBuf[g_ulUARTFill], BRIDGE_BUFFER_SIZE);
+    ROM_uDMAChannelEnable(USB_UART_DMA_RX);
+}
+
+//*****************************************************************************
+//
+// Starts a USB transmit transfer of the next block received from the UART if
+// one is waiting.
+//
+//*****************************************************************************
+static void
+BridgeDeviceTransmit(void)
+{
+    if(g_bUSBConfigured && !g_bDevTxBusy && g_pulUARTCount[g_ulUARTSend])
+    {
+        g_bDevTxBusy = USBDCDCTransferWrite((void *)&g_sCDCDevice,
+                                   (unsigned char *)g_pulUARTBuf[g_ulUARTSend],
+                                   g_pulUARTCount[g_ulUARTSend]);
+    }
+}
+
+//*****************************************************************************
+//
+// Ends reception into the current UART block, either because the uDMA
+// controller has filled it or because the UART receive timeout expired, and
+// queues it for transmission to the USB host.
+//
+//*****************************************************************************
+static void
+BridgeUARTReceiveDone(tBoolean bTimeout)
+{
+    unsigned char *pucBuf;
+    unsigned long ulCount;
+
+    pucBuf = (unsigned char *)g_pulUARTBuf[g_ulUARTFill];
+
+    if(bTimeout)
+    {
+        //
+        // Stop the uDMA controller and pick up the few characters left in the
+        // FIFO, which are fewer than a uDMA burst.
+        //
+        ROM_uDMAChannelDisable(USB_UART_DMA_RX);
+        ulCount = BRIDGE_BUFFER_SIZE -
+                  ROM_uDMAChannelSizeGet(USB_UART_DMA_RX | UDMA_PRI_SELECT);
+
+        while((ulCount < BRIDGE_BUFFER_SIZE) &&
+              ROM_UARTCharsAvail(USB_UART_BASE))
+        {
+            pucBuf[ulCount++] = (unsigned char)
+                                ROM_UARTCharGetNonBlocking(USB_UART_BASE);
+        }
+    }
+    else
+    {
+        ulCount = BRIDGE_BUFFER_SIZE;
+    }
+
+    g_bUARTRxBusy = false;
+
+    //
+    // Queue the block if anything was received and move on to the next one.
+    //
+    if(ulCount)
+    {
+        g_ulUARTRxCount += ulCount;
+        g_pulUARTCount[g_ulUARTFill] = ulCount;
+        g_ulUARTFill ^= 1;
+    }
+
+    BridgeUARTReceive();
+    BridgeDeviceTransmit();
+}
+#endif
 
 //*****************************************************************************
 //
@@ -437,6 +665,56 @@ USBUARTIntHandler(void)
     ulInts = ROM_UARTIntStatus(USB_UART_BASE, true);
     ROM_UARTIntClear(USB_UART_BASE, ulInts);
 
+#ifdef UART_DMA_BRIDGE
+    //
+    // The uDMA controller signals the end of its transfers through this
+    // interrupt too.  Has the block being sent on the UART gone?
+    //
+    if(g_bUARTTxBusy && !ROM_uDMAChannelIsEnabled(USB_UART_DMA_TX))
+    {
+        g_ulUARTTxCount += g_pulHostCount[g_ulHostSend];
+        g_pulHostCount[g_ulHostSend] = 0;
+        g_ulHostSend ^= 1;
+        g_bUARTTxBusy = false;
+        BridgeUARTTransmit();
+        BridgeHostReceive();
+    }
+
+    //
+    // Has the block being received from the UART been filled, or has the
+    // line gone quiet with a few characters still in the FIFO?
+    //
+    if(g_bUARTRxBusy && !ROM_uDMAChannelIsEnabled(USB_UART_DMA_RX))
+    {
+        BridgeUARTReceiveDone(false);
+    }
+    else if((ulInts & UART_INT_RT) && g_bUARTRxBusy)
+    {
+        BridgeUARTReceiveDone(true);
+    }
+
+    //
+    // Pass any receive errors on to the host.
+    //
+    lErrors = 0;
+    if(ulInts & UART_INT_OE)
+    {
+        lErrors |= UART_DR_OE;
+    }
+    if(ulInts & UART_INT_BE)
+    {
+        lErrors |= UART_DR_BE;
+    }
+    if(ulInts & UART_INT_PE)
+    {
+        lErrors |= UART_DR_PE;
+    }
+    if(ulInts & UART_INT_FE)
+    {
+        lErrors |= UART_DR_FE;
+    }
+    CheckForSerialStateChange(&g_sCDCDevice, lErrors);
+#else
     //
     // Are we being interrupted because the TX FIFO has space available?
     //
@@ -472,6 +750,7 @@ USBUARTIntHandler(void)
         //
         CheckForSerialStateChange(&g_sCDCDevice, lErrors);
     }
+#endif
 }
 
 //*****************************************************************************
@@ -764,6 +1043,13 @@ SendBreak(tBoolean bSend)
         //
         ROM_UARTBreakCtl(USB_UART_BASE, false);
         g_bSendingBreak = false;
+#ifdef UART_DMA_BRIDGE
+
+        //
+        // Resume sending any data that was held back during the break.
+        //
+        BridgeUARTTransmit();
+#endif
     }
     else
     {
@@ -809,11 +1095,20 @@ ControlHandler(void *pvCBData, unsigned long ulEvent,
         case USB_EVENT_CONNECTED:
             g_bUSBConfigured = true;
 
+#ifdef UART_DMA_BRIDGE
+            //
+            // Start receiving from the host and send anything already
+            // received from the UART.
+            //
+            BridgeHostReceive();
+            BridgeDeviceTransmit();
+#else
             //
             // Flush our buffers.
             //
             USBBufferFlush(&g_sTxBuffer);
             USBBufferFlush(&g_sRxBuffer);
+#endif
 
             //
             // Tell the main loop to update the display.
@@ -832,6 +1127,22 @@ ControlHandler(void *pvCBData, unsigned long ulEvent,
         //
         case USB_EVENT_DISCONNECTED:
             g_bUSBConfigured = false;
+#ifdef UART_DMA_BRIDGE
+
+            //
+            // The CDC driver has abandoned any transfers in progress.  Drop
+            // the data waiting to go to the host and free its blocks for the
+            // UART.
+            //
+            g_bHostRxBusy = false;
+            g_bDevTxBusy = false;
+            while(g_pulUARTCount[g_ulUARTSend])
+            {
+                g_pulUARTCount[g_ulUARTSend] = 0;
+                g_ulUARTSend ^= 1;
+            }
+            BridgeUARTReceive();
+#endif
             ulIntsOff = ROM_IntMasterDisable();
             g_pcStatus = "Disconnected";
             g_ulFlags |= COMMAND_STATUS_UPDATE;
@@ -932,6 +1243,20 @@ TxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
             //
             break;
 
+#ifdef UART_DMA_BRIDGE
+        //
+        // A block received from the UART has been sent to the host.  Free it
+        // and send the next one, if any.
+        //
+        case USBD_CDC_EVENT_TX_TRANSFER_DONE:
+            g_pulUARTCount[g_ulUARTSend] = 0;
+            g_ulUARTSend ^= 1;
+            g_bDevTxBusy = false;
+            BridgeUARTReceive();
+            BridgeDeviceTransmit();
+            break;
+#endif
+
         //
         // We don't expect to receive any other events.  Ignore any that show
         // up in a release build or hang in a debug build.
@@ -980,6 +1305,13 @@ RxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
         //
         case USB_EVENT_RX_AVAILABLE:
         {
+#ifdef UART_DMA_BRIDGE
+            //
+            // The packet arrived while both blocks were full.  It will be
+            // picked up by the next receive transfer.
+            //
+            break;
+#else
             //
             // Feed some characters into the UART TX FIFO and enable the
             // interrupt so we are told when there is more space.
@@ -987,7 +1319,27 @@ RxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
             USBUARTPrimeTransmit(USB_UART_BASE);
             ROM_UARTIntEnable(USB_UART_BASE, UART_INT_TX);
             break;
+#endif
+        }
+
+#ifdef UART_DMA_BRIDGE
+        //
+        // A block has been received from the host.  Queue it for the UART
+        // and start receiving into the other block.
+        //
+        case USBD_CDC_EVENT_RX_TRANSFER_DONE:
+        {
+            g_bHostRxBusy = false;
+            if(ulMsgValue)
+            {
+                g_pulHostCount[g_ulHostFill] = ulMsgValue;
+                g_ulHostFill ^= 1;
+                BridgeUARTTransmit();
+            }
+            BridgeHostReceive();
+            break;
         }
+#endif
 
         //
         // We are being asked how much unprocessed data we have still to
@@ -1003,6 +1355,9 @@ RxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
             // still has to clear the transmitter.
             //
             ulCount = ROM_UARTBusy(USB_UART_BASE) ? 1 : 0;
+#ifdef UART_DMA_BRIDGE
+            ulCount += g_pulHostCount[0] + g_pulHostCount[1];
+#endif
             return(ulCount);
         }
 
@@ -1101,6 +1456,44 @@ main(void)
     //
     ROM_UARTConfigSetExpClk(USB_UART_BASE, ROM_SysCtlClockGet(),
                             DEFAULT_BIT_RATE, DEFAULT_UART_CONFIG);
+#ifdef UART_DMA_BRIDGE
+    //
+    // Enable the uDMA controller.  The UART asks for a burst of four
+    // characters whenever four can be read or written.  The receive channel
+    // only answers bursts so that the last few characters of a message stay
+    // in the FIFO and raise the receive timeout interrupt.
+    //
+    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    ROM_uDMAEnable();
+    ROM_uDMAControlBaseSet(g_pucDMAControlTable);
+    ROM_UARTFIFOLevelSet(USB_UART_BASE, UART_FIFO_TX4_8, UART_FIFO_RX2_8);
+
+    ROM_uDMAChannelAttributeDisable(USB_UART_DMA_RX, UDMA_ATTR_ALL);
+    ROM_uDMAChannelAttributeEnable(USB_UART_DMA_RX, UDMA_ATTR_USEBURST);
+    ROM_uDMAChannelControlSet(USB_UART_DMA_RX | UDMA_PRI_SELECT,
+                              (UDMA_SIZE_8 | UDMA_SRC_INC_NONE |
+                               UDMA_DST_INC_8 | UDMA_ARB_4));
+
+    ROM_uDMAChannelAttributeDisable(USB_UART_DMA_TX, UDMA_ATTR_ALL);
+    ROM_uDMAChannelControlSet(USB_UART_DMA_TX | UDMA_PRI_SELECT,
+                              (UDMA_SIZE_8 | UDMA_SRC_INC_8 |
+                               UDMA_DST_INC_NONE | UDMA_ARB_4));
+
+    ROM_UARTDMAEnable(USB_UART_BASE, UART_DMA_RX | UART_DMA_TX);
+
+    //
+    // Configure and enable UART interrupts.  The uDMA controller services
+    // the FIFOs so only the receive timeout and errors are needed.
+    //
+    ROM_UARTIntClear(USB_UART_BASE, ROM_UARTIntStatus(USB_UART_BASE, false));
+    ROM_UARTIntEnable(USB_UART_BASE, (UART_INT_OE | UART_INT_BE | UART_INT_PE |
+                      UART_INT_FE | UART_INT_RT));
+
+    //
+    // Start receiving from the UART.
+    //
+    BridgeUARTReceive();
+#else
     ROM_UARTFIFOLevelSet(USB_UART_BASE, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
 
     //
@@ -1109,6 +1502,7 @@ main(void)
     ROM_UARTIntClear(USB_UART_BASE, ROM_UARTIntStatus(USB_UART_BASE, false));
     ROM_UARTIntEnable(USB_UART_BASE, (UART_INT_OE | UART_INT_BE | UART_INT_PE |
                       UART_INT_FE | UART_INT_RT | UART_INT_TX | UART_INT_RX));
+#endif
 
     //
     // Enable the system tick.
@@ -1133,6 +1527,14 @@ main(void)
     // on the bus.
     //
     USBDCDCInit(0, (tUSBDCDCDevice *)&g_sCDCDevice);
+#ifdef UART_DMA_BRIDGE
+
+    //
+    // Have the receive transfers end once the host stops sending so that a
+    // write that fills its last packet reaches the UART straight away.
+    //
+    USBDCDCTransferTimeoutSet((void *)&g_sCDCDevice, BRIDGE_RX_IDLE_FRAMES);
+#endif
 
     //
     // Clear our local byte counters.
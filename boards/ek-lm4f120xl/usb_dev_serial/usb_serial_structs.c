@@ -152,6 +152,9 @@ unsigned long ControlHandler(void *pvCBData, unsigned long ulEvent,
 // instance data. The buffer, in turn, has its callback set to the application
 // function and the callback data set to our CDC instance structure.
 //
+// When the UART DMA bridge is in use, the application moves whole blocks of
+// data with the uDMA controller and handles the channel callbacks itself.
+//
 //*****************************************************************************
 tCDCSerInstance g_sCDCInstance;
 
@@ -166,10 +169,17 @@ const tUSBDCDCDevice g_sCDCDevice =
     USB_CONF_ATTR_SELF_PWR,
     ControlHandler,
     (void *)&g_sCDCDevice,
+#ifdef UART_DMA_BRIDGE
+    RxHandler,
+    (void *)&g_sCDCDevice,
+    TxHandler,
+    (void *)&g_sCDCDevice,
+#else
     USBBufferEventCallback,
     (void *)&g_sRxBuffer,
     USBBufferEventCallback,
     (void *)&g_sTxBuffer,
+#endif
     g_pStringDescriptors,
     NUM_STRING_DESCRIPTORS,
     &g_sCDCInstance
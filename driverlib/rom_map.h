@@ -4800,6 +4800,13 @@
 #define MAP_USBDevEndpointConfigGet \
         USBDevEndpointConfigGet
 #endif
+#ifdef ROM_USBEndpointDMAConfigSet
+#define MAP_USBEndpointDMAConfigSet \
+        ROM_USBEndpointDMAConfigSet
+#else
+#define MAP_USBEndpointDMAConfigSet \
+        USBEndpointDMAConfigSet
+#endif
 #ifdef ROM_USBEndpointDMAEnable
 #define MAP_USBEndpointDMAEnable \
         ROM_USBEndpointDMAEnable
@@ -2458,6 +2458,100 @@ USBFIFOConfigGet(unsigned long ulBase, unsigned long ulEndpoint,
     }
 }
 
+//*****************************************************************************
+//
+//! Changes the DMA related options of a given endpoint.
+//!
+//! \param ulBase specifies the USB module base address.
+//! \param ulEndpoint is the endpoint to access.
+//! \param ulFlags specifies the direction of the endpoint and the options to
+//! use.
+//!
+//! This function changes the DMA mode and the automatic packet handling
+//! options of an endpoint that has already been configured.  Unlike
+//! USBDevEndpointConfigSet(), it does not change the maximum packet size or
+//! reset the data toggle, so it may be used to switch an endpoint between
+//! DMA and software transfers while it is in use.  The \e ulFlags parameter
+//! should have \b USB_EP_DEV_IN or \b USB_EP_DEV_OUT set, along with any of
+//! \b USB_EP_DMA_MODE_1, \b USB_EP_AUTO_SET, \b USB_EP_AUTO_CLEAR or
+//! \b USB_EP_AUTO_REQUEST.  Options that are not given are cleared.  DMA is
+//! enabled and disabled separately with USBEndpointDMAEnable() and
+//! USBEndpointDMADisable().
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBEndpointDMAConfigSet(unsigned long ulBase, unsigned long ulEndpoint,
+                        unsigned long ulFlags)
+{
+    unsigned long ulRegister;
+
+    //
+    // Check the arguments.
+    //
+    ASSERT(ulBase == USB0_BASE);
+    ASSERT((ulEndpoint == USB_EP_1) || (ulEndpoint == USB_EP_2) ||
+           (ulEndpoint == USB_EP_3) || (ulEndpoint == USB_EP_4) ||
+           (ulEndpoint == USB_EP_5) || (ulEndpoint == USB_EP_6) ||
+           (ulEndpoint == USB_EP_7) || (ulEndpoint == USB_EP_8) ||
+           (ulEndpoint == USB_EP_9) || (ulEndpoint == USB_EP_10) ||
+           (ulEndpoint == USB_EP_11) || (ulEndpoint == USB_EP_12) ||
+           (ulEndpoint == USB_EP_13) || (ulEndpoint == USB_EP_14) ||
+           (ulEndpoint == USB_EP_15));
+
+    if(ulFlags & USB_EP_DEV_IN)
+    {
+        //
+        // Keep the other transmit control bits and replace the DMA mode and
+        // auto set options.
+        //
+        ulRegister = HWREGB(ulBase + EP_OFFSET(ulEndpoint) + USB_O_TXCSRH1) &
+                     ~(USB_TXCSRH1_DMAMOD | USB_TXCSRH1_AUTOSET);
+
+        if(ulFlags & USB_EP_DMA_MODE_1)
+        {
+            ulRegister |= USB_TXCSRH1_DMAMOD;
+        }
+
+        if(ulFlags & USB_EP_AUTO_SET)
+        {
+            ulRegister |= USB_TXCSRH1_AUTOSET;
+        }
+
+        HWREGB(ulBase + EP_OFFSET(ulEndpoint) + USB_O_TXCSRH1) =
+            (unsigned char)ulRegister;
+    }
+    else
+    {
+        //
+        // Keep the other receive control bits and replace the DMA mode and
+        // auto clear and request options.
+        //
+        ulRegister = HWREGB(ulBase + EP_OFFSET(ulEndpoint) + USB_O_RXCSRH1) &
+                     ~(USB_RXCSRH1_DMAMOD | USB_RXCSRH1_AUTOCL |
+                       USB_RXCSRH1_AUTORQ);
+
+        if(ulFlags & USB_EP_DMA_MODE_1)
+        {
+            ulRegister |= USB_RXCSRH1_DMAMOD;
+        }
+
+        if(ulFlags & USB_EP_AUTO_CLEAR)
+        {
+            ulRegister |= USB_RXCSRH1_AUTOCL;
+        }
+
+        if(ulFlags & USB_EP_AUTO_REQUEST)
+        {
+            ulRegister |= USB_RXCSRH1_AUTORQ;
+        }
+
+        HWREGB(ulBase + EP_OFFSET(ulEndpoint) + USB_O_RXCSRH1) =
+            (unsigned char)ulRegister;
+    }
+}
+
 //*****************************************************************************
 //
 //! Enable DMA on a given endpoint.
@@ -429,6 +429,9 @@ extern void USBDevEndpointStatusClear(unsigned long ulBase,
                                       unsigned long ulFlags);
 extern unsigned long USBEndpointDataAvail(unsigned long ulBase,
                                           unsigned long ulEndpoint);
+extern void USBEndpointDMAConfigSet(unsigned long ulBase,
+                                    unsigned long ulEndpoint,
+                                    unsigned long ulFlags);
 extern void USBEndpointDMAEnable(unsigned long ulBase, unsigned long ulEndpoint,
                                  unsigned long ulFlags);
 extern void USBEndpointDMADisable(unsigned long ulBase,
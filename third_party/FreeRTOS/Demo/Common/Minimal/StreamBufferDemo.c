@@ -0,0 +1,530 @@
+/*
+    FreeRTOS V7.1.1 - Copyright (C) 2012 Real Time Engineers Ltd.
+	
+
+    ***************************************************************************
+     *                                                                       *
+     *    FreeRTOS tutorial books are available in pdf and paperback.        *
+     *    Complete, revised, and edited pdf reference manuals are also       *
+     *    available.                                                         *
+     *                                                                       *
+     *    Purchasing FreeRTOS documentation will not only help you, by       *
+     *    ensuring you get running as quickly as possible and with an        *
+     *    in-depth knowledge of how to use FreeRTOS, it will also help       *
+     *    the FreeRTOS project to continue with its mission of providing     *
+     *    professional grade, cross platform, de facto standard solutions    *
+     *    for microcontrollers - completely free of charge!                  *
+     *                                                                       *
+     *    >>> See http://www.FreeRTOS.org/Documentation for details. <<<     *
+     *                                                                       *
+     *    Thank you for using FreeRTOS, and thank you for your support!      *
+     *                                                                       *
+    ***************************************************************************
+
+
+    This file is part of the FreeRTOS distribution.
+
+    FreeRTOS is free software; you can redistribute it and/or modify it under
+    the terms of the GNU General Public License (version 2) as published by the
+    Free Software Foundation AND MODIFIED BY the FreeRTOS exception.
+    >>>NOTE<<< The modification to the GPL is included to allow you to
+    distribute a combined work that includes FreeRTOS without being obliged to
+    provide the source code for proprietary components outside of the FreeRTOS
+    kernel.  FreeRTOS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details. You should have received a copy of the GNU General Public
+    License and the FreeRTOS license exception along with FreeRTOS; if not it
+    can be viewed here: http://www.freertos.org/a00114.html and also obtained
+    by writing to Richard Barry, contact details for whom are available on the
+    FreeRTOS WEB site.
+
+    1 tab == 4 spaces!
+    
+    ***************************************************************************
+     *                                                                       *
+     *    Having a problem?  Start by reading the FAQ "My application does   *
+     *    not run, what could be wrong?                                      *
+     *                                                                       *
+     *    http://www.FreeRTOS.org/FAQHelp.html                               *
+     *                                                                       *
+    ***************************************************************************
+
+    
+    http://www.FreeRTOS.org - Documentation, training, latest information, 
+    license and contact details.
+    
+    http://www.FreeRTOS.org/plus - A selection of FreeRTOS ecosystem products,
+    including FreeRTOS+Trace - an indispensable productivity tool.
+
+    Real Time Engineers ltd license FreeRTOS to High Integrity Systems, who sell 
+    the code with commercial support, indemnification, and middleware, under 
+    the OpenRTOS brand: http://www.OpenRTOS.com.  High Integrity Systems also
+    provide a safety engineered and independently SIL3 certified version under 
+    the SafeRTOS brand: http://www.SafeRTOS.com.
+*/
+
+
+/*
+ * Tests the stream buffer implementation in stream_buffer.c.
+ *
+ * The 'sender' and 'receiver' tasks pass an incrementing byte sequence through
+ * a stream buffer that is smaller than some of the blocks written to it, so
+ * both tasks block - the sender waiting for space and the receiver waiting for
+ * data.  The receiver checks that every byte arrives in order.
+ *
+ * The 'trigger' task writes to a second stream buffer one byte at a time,
+ * while the higher priority 'trigger receiver' task is blocked reading from
+ * it.  The trigger receiver must not run until the trigger level number of
+ * bytes has been written, and must run as soon as it has.  The trigger level
+ * is changed on each cycle.  The trigger task also checks that sending to a
+ * full stream buffer, and receiving from an empty one, time out after the
+ * requested number of ticks.
+ *
+ * vPeriodicStreamBufferProcessingFromISR() is called from the tick hook.  It
+ * writes a byte sequence to a third stream buffer, which the 'ISR' task reads,
+ * and reads a byte sequence that the 'ISR' task writes to a fourth stream
+ * buffer, so the interrupt safe functions are used from both ends.
+ */
+
+/* Scheduler include files. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stream_buffer.h"
+
+/* Demo program include files. */
+#include "StreamBufferDemo.h"
+
+/* The size of the stream buffer used by the sender and receiver tasks, and
+the largest block written to it, which is deliberately larger. */
+#define sbufECHO_BUFFER_SIZE		( ( size_t ) 64 )
+#define sbufMAX_BLOCK_SIZE			( ( size_t ) 100 )
+
+/* The size of the stream buffer used by the trigger tasks and the trigger
+levels used in turn. */
+#define sbufTRIGGER_BUFFER_SIZE		( ( size_t ) 32 )
+#define sbufNUM_TRIGGER_LEVELS		( 3 )
+
+/* The size of the stream buffer used to test timeouts, and the timeout. */
+#define sbufTIMEOUT_BUFFER_SIZE		( ( size_t ) 16 )
+#define sbufTIMEOUT					( ( portTickType ) 20 / portTICK_RATE_MS )
+
+/* The size of the stream buffers used with the interrupt, and the most bytes
+the interrupt moves each tick. */
+#define sbufISR_BUFFER_SIZE			( ( size_t ) 20 )
+#define sbufISR_BYTES_PER_TICK		( ( size_t ) 3 )
+
+/* The time the receiving tasks wait before deciding data has been lost. */
+#define sbufRX_BLOCK_TIME			( ( portTickType ) 1000 / portTICK_RATE_MS )
+
+#define sbufDONT_BLOCK				( ( portTickType ) 0 )
+
+/*-----------------------------------------------------------*/
+
+/*
+ * The tasks described at the top of this file.
+ */
+static void prvSenderTask( void *pvParameters );
+static void prvReceiverTask( void *pvParameters );
+static void prvTriggerTask( void *pvParameters );
+static void prvTriggerReceiverTask( void *pvParameters );
+static void prvISRTask( void *pvParameters );
+
+/*
+ * Checks that sending to a full stream buffer, and receiving from an empty
+ * stream buffer, return nothing once sbufTIMEOUT ticks have passed.
+ */
+static void prvTimeoutTests( void );
+
+/*-----------------------------------------------------------*/
+
+/* The stream buffers used by the tasks. */
+static xStreamBufferHandle xEchoBuffer = NULL, xTriggerBuffer = NULL, xTimeoutBuffer = NULL;
+static xStreamBufferHandle xISRToTaskBuffer = NULL, xTaskToISRBuffer = NULL;
+
+/* The trigger levels used by the trigger task. */
+static const size_t xTriggerLevels[ sbufNUM_TRIGGER_LEVELS ] = { 1, 8, sbufTRIGGER_BUFFER_SIZE - 1 };
+
+/* Set by the trigger receiver task each time it receives data. */
+static volatile unsigned long ulTriggerReceives = 0UL;
+static volatile size_t xTriggerBytesReceived = 0;
+
+/* The next bytes written and read by the interrupt. */
+static unsigned char ucISRTxNext = 0, ucISRRxNext = 0;
+
+/* Flag that will be latched to pdTRUE should any unexpected behaviour be
+detected in any of the tasks or the interrupt. */
+static volatile portBASE_TYPE xErrorDetected = pdFALSE;
+
+/* Incremented by each test so the check task can tell it is still running. */
+static volatile unsigned long ulReceiverCycles = 0UL, ulTriggerCycles = 0UL;
+static volatile unsigned long ulISRTaskCycles = 0UL, ulISRBytesReceived = 0UL;
+
+/*-----------------------------------------------------------*/
+
+void vStartStreamBufferTasks( unsigned portBASE_TYPE uxPriority )
+{
+	xEchoBuffer = xStreamBufferCreate( sbufECHO_BUFFER_SIZE, 1 );
+	xTriggerBuffer = xStreamBufferCreate( sbufTRIGGER_BUFFER_SIZE, xTriggerLevels[ 0 ] );
+	xTimeoutBuffer = xStreamBufferCreate( sbufTIMEOUT_BUFFER_SIZE, 1 );
+	xTaskToISRBuffer = xStreamBufferCreate( sbufISR_BUFFER_SIZE, 1 );
+
+	/* The ISR task waits for a few bytes at a time so it does not wake on
+	every tick. */
+	xISRToTaskBuffer = xStreamBufferCreate( sbufISR_BUFFER_SIZE, sbufISR_BYTES_PER_TICK * 2 );
+
+	if( ( xEchoBuffer != NULL ) && ( xTriggerBuffer != NULL ) && ( xTimeoutBuffer != NULL ) && ( xTaskToISRBuffer != NULL ) && ( xISRToTaskBuffer != NULL ) )
+	{
+		xTaskCreate( prvSenderTask, ( signed char * ) "SBSend", configMINIMAL_STACK_SIZE, NULL, uxPriority, NULL );
+		xTaskCreate( prvReceiverTask, ( signed char * ) "SBRecv", configMINIMAL_STACK_SIZE, NULL, uxPriority, NULL );
+		xTaskCreate( prvTriggerTask, ( signed char * ) "SBTrig", configMINIMAL_STACK_SIZE, NULL, uxPriority, NULL );
+		xTaskCreate( prvTriggerReceiverTask, ( signed char * ) "SBTrigRx", configMINIMAL_STACK_SIZE, NULL, uxPriority + 1, NULL );
+		xTaskCreate( prvISRTask, ( signed char * ) "SBISR", configMINIMAL_STACK_SIZE, NULL, uxPriority, NULL );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvSenderTask( void *pvParameters )
+{
+unsigned char ucBlock[ sbufMAX_BLOCK_SIZE ], ucNext = 0;
+size_t xBlockSize = 1, xSent, x;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		for( x = 0; x < xBlockSize; x++ )
+		{
+			ucBlock[ x ] = ucNext++;
+		}
+
+		/* Blocks larger than the stream buffer are written in several parts,
+		each call waiting until the stream buffer is completely empty. */
+		xSent = 0;
+		while( xSent < xBlockSize )
+		{
+			xSent += xStreamBufferSend( xEchoBuffer, &( ucBlock[ xSent ] ), xBlockSize - xSent, portMAX_DELAY );
+		}
+
+		xBlockSize++;
+		if( xBlockSize > sbufMAX_BLOCK_SIZE )
+		{
+			xBlockSize = 1;
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvReceiverTask( void *pvParameters )
+{
+unsigned char ucBlock[ sbufECHO_BUFFER_SIZE ], ucNext = 0;
+size_t xReceived, x;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		xReceived = xStreamBufferReceive( xEchoBuffer, ucBlock, sizeof( ucBlock ), sbufRX_BLOCK_TIME );
+
+		/* The sender never stops, so nothing arriving means it has been
+		left blocked. */
+		if( xReceived == ( size_t ) 0 )
+		{
+			xErrorDetected = pdTRUE;
+		}
+
+		for( x = 0; x < xReceived; x++ )
+		{
+			if( ucBlock[ x ] != ucNext )
+			{
+				xErrorDetected = pdTRUE;
+			}
+			ucNext = ( unsigned char ) ( ucBlock[ x ] + 1 );
+		}
+
+		ulReceiverCycles++;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvTriggerTask( void *pvParameters )
+{
+unsigned char ucNext = 0;
+unsigned long ulReceives;
+size_t xTriggerLevel, x;
+portBASE_TYPE xLevel = 0;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		/* A trigger level larger than the stream buffer is rejected. */
+		if( xStreamBufferSetTriggerLevel( xTriggerBuffer, sbufTRIGGER_BUFFER_SIZE + 1 ) != pdFAIL )
+		{
+			xErrorDetected = pdTRUE;
+		}
+
+		xTriggerLevel = xTriggerLevels[ xLevel ];
+		if( xStreamBufferSetTriggerLevel( xTriggerBuffer, xTriggerLevel ) != pdPASS )
+		{
+			xErrorDetected = pdTRUE;
+		}
+
+		xLevel++;
+		if( xLevel >= sbufNUM_TRIGGER_LEVELS )
+		{
+			xLevel = 0;
+		}
+
+		/* The trigger receiver has the higher priority, so has already blocked
+		on the empty stream buffer. */
+		ulReceives = ulTriggerReceives;
+
+		for( x = 1; x <= xTriggerLevel; x++ )
+		{
+			if( xStreamBufferSend( xTriggerBuffer, &ucNext, sizeof( ucNext ), sbufDONT_BLOCK ) != sizeof( ucNext ) )
+			{
+				xErrorDetected = pdTRUE;
+			}
+			ucNext++;
+
+			if( x < xTriggerLevel )
+			{
+				/* Below the trigger level the receiver must stay blocked. */
+				if( ulTriggerReceives != ulReceives )
+				{
+					xErrorDetected = pdTRUE;
+				}
+			}
+			else
+			{
+				/* Reaching the trigger level must have run the receiver,
+				which read every byte. */
+				if( ( ulTriggerReceives != ( ulReceives + 1UL ) ) || ( xTriggerBytesReceived != xTriggerLevel ) )
+				{
+					xErrorDetected = pdTRUE;
+				}
+			}
+		}
+
+		prvTimeoutTests();
+
+		ulTriggerCycles++;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvTriggerReceiverTask( void *pvParameters )
+{
+unsigned char ucBlock[ sbufTRIGGER_BUFFER_SIZE ], ucNext = 0;
+size_t xReceived, x;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		xReceived = xStreamBufferReceive( xTriggerBuffer, ucBlock, sizeof( ucBlock ), portMAX_DELAY );
+
+		for( x = 0; x < xReceived; x++ )
+		{
+			if( ucBlock[ x ] != ucNext )
+			{
+				xErrorDetected = pdTRUE;
+			}
+			ucNext = ( unsigned char ) ( ucBlock[ x ] + 1 );
+		}
+
+		xTriggerBytesReceived = xReceived;
+		ulTriggerReceives++;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvTimeoutTests( void )
+{
+unsigned char ucBlock[ sbufTIMEOUT_BUFFER_SIZE + 1 ];
+portTickType xTimeBefore, xTimeTaken;
+size_t x;
+
+	/* Receiving from an empty stream buffer must time out with no data. */
+	xTimeBefore = xTaskGetTickCount();
+	if( xStreamBufferReceive( xTimeoutBuffer, ucBlock, sizeof( ucBlock ), sbufTIMEOUT ) != ( size_t ) 0 )
+	{
+		xErrorDetected = pdTRUE;
+	}
+	xTimeTaken = xTaskGetTickCount() - xTimeBefore;
+
+	if( xTimeTaken < sbufTIMEOUT )
+	{
+		xErrorDetected = pdTRUE;
+	}
+
+	/* Fill the stream buffer.  One more byte than will fit is offered, so
+	the last byte must be left behind. */
+	for( x = 0; x < sizeof( ucBlock ); x++ )
+	{
+		ucBlock[ x ] = ( unsigned char ) x;
+	}
+
+	if( xStreamBufferSend( xTimeoutBuffer, ucBlock, sizeof( ucBlock ), sbufDONT_BLOCK ) != sbufTIMEOUT_BUFFER_SIZE )
+	{
+		xErrorDetected = pdTRUE;
+	}
+
+	if( xStreamBufferIsFull( xTimeoutBuffer ) == pdFALSE )
+	{
+		xErrorDetected = pdTRUE;
+	}
+
+	/* Sending to a full stream buffer must time out having written
+	nothing. */
+	xTimeBefore = xTaskGetTickCount();
+	if( xStreamBufferSend( xTimeoutBuffer, ucBlock, sizeof( ucBlock[ 0 ] ), sbufTIMEOUT ) != ( size_t ) 0 )
+	{
+		xErrorDetected = pdTRUE;
+	}
+	xTimeTaken = xTaskGetTickCount() - xTimeBefore;
+
+	if( xTimeTaken < sbufTIMEOUT )
+	{
+		xErrorDetected = pdTRUE;
+	}
+
+	/* Data already in the stream buffer is returned without blocking. */
+	for( x = 0; x < sizeof( ucBlock ); x++ )
+	{
+		ucBlock[ x ] = 0;
+	}
+
+	if( xStreamBufferReceive( xTimeoutBuffer, ucBlock, sizeof( ucBlock ), sbufTIMEOUT ) != sbufTIMEOUT_BUFFER_SIZE )
+	{
+		xErrorDetected = pdTRUE;
+	}
+
+	for( x = 0; x < sbufTIMEOUT_BUFFER_SIZE; x++ )
+	{
+		if( ucBlock[ x ] != ( unsigned char ) x )
+		{
+			xErrorDetected = pdTRUE;
+		}
+	}
+
+	if( ( xStreamBufferIsEmpty( xTimeoutBuffer ) == pdFALSE ) || ( xStreamBufferReset( xTimeoutBuffer ) != pdPASS ) )
+	{
+		xErrorDetected = pdTRUE;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvISRTask( void *pvParameters )
+{
+unsigned char ucBlock[ sbufISR_BUFFER_SIZE ], ucTxNext = 0, ucRxNext = 0;
+size_t xReceived, x;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		/* Give the interrupt more than fits in the stream buffer, so this task
+		blocks until the interrupt has read some of it. */
+		for( x = 0; x < sizeof( ucBlock ); x++ )
+		{
+			ucBlock[ x ] = ucTxNext++;
+		}
+
+		x = 0;
+		while( x < sizeof( ucBlock ) )
+		{
+			x += xStreamBufferSend( xTaskToISRBuffer, &( ucBlock[ x ] ), sizeof( ucBlock ) - x, portMAX_DELAY );
+		}
+
+		/* Then read what the interrupt has written. */
+		xReceived = xStreamBufferReceive( xISRToTaskBuffer, ucBlock, sizeof( ucBlock ), sbufRX_BLOCK_TIME );
+
+		if( xReceived == ( size_t ) 0 )
+		{
+			xErrorDetected = pdTRUE;
+		}
+
+		for( x = 0; x < xReceived; x++ )
+		{
+			if( ucBlock[ x ] != ucRxNext )
+			{
+				xErrorDetected = pdTRUE;
+			}
+			ucRxNext = ( unsigned char ) ( ucBlock[ x ] + 1 );
+		}
+
+		ulISRTaskCycles++;
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPeriodicStreamBufferProcessingFromISR( void )
+{
+unsigned char ucBlock[ sbufISR_BYTES_PER_TICK ];
+portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+size_t xCount, x;
+
+	/* Nothing to do until the stream buffers have been created. */
+	if( ( xISRToTaskBuffer == NULL ) || ( xTaskToISRBuffer == NULL ) )
+	{
+		return;
+	}
+
+	/* Write the next few bytes of the sequence.  Those that do not fit are
+	offered again on the next tick. */
+	for( x = 0; x < sizeof( ucBlock ); x++ )
+	{
+		ucBlock[ x ] = ( unsigned char ) ( ucISRTxNext + x );
+	}
+	xCount = xStreamBufferSendFromISR( xISRToTaskBuffer, ucBlock, sizeof( ucBlock ), &xHigherPriorityTaskWoken );
+	ucISRTxNext = ( unsigned char ) ( ucISRTxNext + xCount );
+
+	/* Read and check what the ISR task has written. */
+	xCount = xStreamBufferReceiveFromISR( xTaskToISRBuffer, ucBlock, sizeof( ucBlock ), &xHigherPriorityTaskWoken );
+
+	for( x = 0; x < xCount; x++ )
+	{
+		if( ucBlock[ x ] != ucISRRxNext )
+		{
+			xErrorDetected = pdTRUE;
+		}
+		ucISRRxNext++;
+	}
+	ulISRBytesReceived += xCount;
+
+	/* The tick interrupt performs a context switch itself if one is needed,
+	so xHigherPriorityTaskWoken is not used. */
+	( void ) xHigherPriorityTaskWoken;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xAreStreamBufferTasksStillRunning( void )
+{
+static unsigned long ulLastReceiverCycles = 0UL, ulLastTriggerCycles = 0UL;
+static unsigned long ulLastISRTaskCycles = 0UL, ulLastISRBytesReceived = 0UL;
+portBASE_TYPE xReturn = pdTRUE;
+
+	if( ( ulReceiverCycles == ulLastReceiverCycles ) || ( ulTriggerCycles == ulLastTriggerCycles ) )
+	{
+		xReturn = pdFALSE;
+	}
+
+	if( ( ulISRTaskCycles == ulLastISRTaskCycles ) || ( ulISRBytesReceived == ulLastISRBytesReceived ) )
+	{
+		xReturn = pdFALSE;
+	}
+
+	if( xErrorDetected != pdFALSE )
+	{
+		xReturn = pdFALSE;
+	}
+
+	ulLastReceiverCycles = ulReceiverCycles;
+	ulLastTriggerCycles = ulTriggerCycles;
+	ulLastISRTaskCycles = ulISRTaskCycles;
+	ulLastISRBytesReceived = ulISRBytesReceived;
+
+	return xReturn;
+}
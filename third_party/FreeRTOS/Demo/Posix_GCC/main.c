@@ -0,0 +1,610 @@
+/*
+    FreeRTOS V7.1.1 - Copyright (C) 2012 Real Time Engineers Ltd.
+	
+
+    ***************************************************************************
+     *                                                                       *
+     *    FreeRTOS tutorial books are available in pdf and paperback.        *
+     *    Complete, revised, and edited pdf reference manuals are also       *
+     *    available.                                                         *
+     *                                                                       *
+     *    Purchasing FreeRTOS documentation will not only help you, by       *
+     *    ensuring you get running as quickly as possible and with an        *
+     *    in-depth knowledge of how to use FreeRTOS, it will also help       *
+     *    the FreeRTOS project to continue with its mission of providing     *
+     *    professional grade, cross platform, de facto standard solutions    *
+     *    for microcontrollers - completely free of charge!                  *
+     *                                                                       *
+     *    >>> See http://www.FreeRTOS.org/Documentation for details. <<<     *
+     *                                                                       *
+     *    Thank you for using FreeRTOS, and thank you for your support!      *
+     *                                                                       *
+    ***************************************************************************
+
+
+    This file is part of the FreeRTOS distribution.
+
+    FreeRTOS is free software; you can redistribute it and/or modify it under
+    the terms of the GNU General Public License (version 2) as published by the
+    Free Software Foundation AND MODIFIED BY the FreeRTOS exception.
+    >>>NOTE<<< The modification to the GPL is included to allow you to
+    distribute a combined work that includes FreeRTOS without being obliged to
+    provide the source code for proprietary components outside of the FreeRTOS
+    kernel.  FreeRTOS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details. You should have received a copy of the GNU General Public
+    License and the FreeRTOS license exception along with FreeRTOS; if not it
+    can be viewed here: http://www.freertos.org/a00114.html and also obtained
+    by writing to Richard Barry, contact details for whom are available on the
+    FreeRTOS WEB site.
+
+    1 tab == 4 spaces!
+    
+    ***************************************************************************
+     *                                                                       *
+     *    Having a problem?  Start by reading the FAQ "My application does   *
+     *    not run, what could be wrong?                                      *
+     *                                                                       *
+     *    http://www.FreeRTOS.org/FAQHelp.html                               *
+     *                                                                       *
+    ***************************************************************************
+
+    
+    http://www.FreeRTOS.org - Documentation, training, latest information, 
+    license and contact details.
+    
+    http://www.FreeRTOS.org/plus - A selection of FreeRTOS ecosystem products,
+    including FreeRTOS+Trace - an indispensable productivity tool.
+
+    Real Time Engineers ltd license FreeRTOS to High Integrity Systems, who sell 
+    the code with commercial support, indemnification, and middleware, under 
+    the OpenRTOS brand: http://www.OpenRTOS.com.  High Integrity Systems also
+    provide a safety engineered and independently SIL3 certified version under 
+    the SafeRTOS brand: http://www.SafeRTOS.com.
+*/
+
+
+/*
+ * This project runs the FreeRTOS kernel, and a subset of the standard demo
+ * tasks, as a normal Linux process using the POSIX simulator port found in
+ * Source/portable/GCC/Posix.  See http://www.FreeRTOS.org for more
+ * information.
+ *
+ * main() either creates the standard demo tasks and the 'check' task, or, when
+ * -b is given on the command line, just the 'benchmark' task.  It then starts
+ * the scheduler.
+ *
+ * + The 'benchmark' task runs a set of kernel and queue benchmarks.  Each
+ * benchmark times a fixed number of iterations of a primitive operation and
+ * prints the average time taken per operation.  No other tasks are created
+ * in this mode so the results are not skewed.  The scheduler is stopped once
+ * the benchmarks have completed.
+ *
+ * + The 'check' task executes every five seconds to check that all the other
+ * tasks are still operational and that no errors have been detected.  'PASS'
+ * is printed if no errors have ever been detected, otherwise 'FAIL' is
+ * printed.  The scheduler is stopped once the requested run time has elapsed.
+ *
+ * The process exit status is zero only if every check passed, so the build can
+ * run the demo as a regression and performance test on the host.
+ *
+ * Usage: rtosdemo [-t seconds] [-b]
+ *
+ * -t sets the run time, 0 meaning forever.  -b runs the benchmarks instead of
+ * the demo tasks.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "timers.h"
+
+/* Demo app includes. */
+#include "BlockQ.h"
+#include "GenQTest.h"
+#include "countsem.h"
+#include "PollQ.h"
+#include "semtest.h"
+#include "recmutex.h"
+#include "QPeek.h"
+#include "blocktim.h"
+#include "dynamic.h"
+#include "death.h"
+#include "TimerDemo.h"
+#include "StreamBufferDemo.h"
+
+/* Delay between cycles of the 'check' task. */
+#define mainCHECK_DELAY				( ( portTickType ) 5000 / portTICK_RATE_MS )
+
+/* Run time used when none is given on the command line, in seconds. */
+#define mainDEFAULT_RUN_TIME		( 20 )
+
+/* Demo task priorities. */
+#define mainCHECK_TASK_PRIORITY		( configMAX_PRIORITIES - 1 )
+#define mainBENCHMARK_PRIORITY		( configMAX_PRIORITIES - 2 )
+#define mainQUEUE_POLL_PRIORITY		( tskIDLE_PRIORITY + 2 )
+#define mainSEM_TEST_PRIORITY		( tskIDLE_PRIORITY + 1 )
+#define mainBLOCK_Q_PRIORITY		( tskIDLE_PRIORITY + 2 )
+#define mainGEN_QUEUE_PRIORITY		( tskIDLE_PRIORITY )
+#define mainCREATOR_TASK_PRIORITY	( tskIDLE_PRIORITY + 3 )
+#define mainSTREAM_BUFFER_PRIORITY	( tskIDLE_PRIORITY )
+
+/* The base period used by the timer test tasks. */
+#define mainTIMER_TEST_PERIOD		( 50 )
+
+/* The number of iterations timed by each benchmark. */
+#define mainBENCHMARK_ITERATIONS	( 100000UL )
+
+/* The timer benchmark runs mainBENCH_TIMERS auto reload timers that share a
+period, so expire in the same tick, until mainBENCH_TIMER_EXPIRIES callbacks
+have executed. */
+#define mainBENCH_TIMERS			( 200 )
+#define mainBENCH_TIMER_PERIOD		( ( portTickType ) 5 )
+#define mainBENCH_TIMER_EXPIRIES	( 50UL * mainBENCH_TIMERS )
+
+/*
+ * The 'check' task, as described at the top of this file.
+ */
+static void vCheckTask( void *pvParameters );
+
+/*
+ * The 'benchmark' task, as described at the top of this file.
+ */
+static void prvBenchmarkTask( void *pvParameters );
+
+/*
+ * Task that returns every item it receives on xBenchQueueToEcho to
+ * xBenchQueueFromEcho.
+ */
+static void prvQueueEchoTask( void *pvParameters );
+
+/*
+ * Task that answers every notification it receives with a notification back
+ * to the benchmark task.
+ */
+static void prvNotifyEchoTask( void *pvParameters );
+
+/*
+ * Task that yields continuously, used to time a context switch.
+ */
+static void prvYieldTask( void *pvParameters );
+
+/*
+ * Callback used by the software timers created by the timer benchmark.
+ */
+static void prvBenchTimerCallback( xTimerHandle xTimer );
+
+/*
+ * Print the result of one benchmark.
+ */
+static void prvReportBenchmark( const char *pcName, unsigned long ulIterations, unsigned long long ullElapsedNs );
+
+/*
+ * Return a monotonic time stamp in nanoseconds.
+ */
+static unsigned long long prvNowNs( void );
+
+/* Run time in seconds, zero to run forever. */
+static unsigned long ulRunTime = mainDEFAULT_RUN_TIME;
+
+/* Set if only the benchmarks are to be run. */
+static portBASE_TYPE xBenchmarkOnly = pdFALSE;
+
+/* Set to pdTRUE if any check fails, and returned as the exit status. */
+static portBASE_TYPE xErrorOccurred = pdFALSE;
+
+/* Queues and task handles used by the benchmarks. */
+static xQueueHandle xBenchQueueToEcho, xBenchQueueFromEcho;
+static xTaskHandle xBenchmarkTaskHandle;
+
+/* The number of context switches performed by the yield tasks. */
+static volatile unsigned long ulYieldCount;
+
+/* Used by the timer benchmark to time consecutive callbacks executed in the
+same tick. */
+static volatile unsigned long ulTimerExpiries, ulTimerIntervals;
+static unsigned long long ullTimerIntervalNs, ullLastTimerNs;
+static portTickType xLastTimerTick;
+
+/*-----------------------------------------------------------*/
+
+int main( int argc, char **argv )
+{
+int iOption;
+
+	while( ( iOption = getopt( argc, argv, "t:b" ) ) != -1 )
+	{
+		switch( iOption )
+		{
+			case 't':
+				ulRunTime = strtoul( optarg, NULL, 0 );
+				break;
+
+			case 'b':
+				xBenchmarkOnly = pdTRUE;
+				break;
+
+			default:
+				fprintf( stderr, "Usage: %s [-t seconds] [-b]\n", argv[ 0 ] );
+				return 2;
+		}
+	}
+
+	if( xBenchmarkOnly != pdFALSE )
+	{
+		xTaskCreate( prvBenchmarkTask, ( signed char * ) "Bench", configMINIMAL_STACK_SIZE, NULL, mainCHECK_TASK_PRIORITY, &xBenchmarkTaskHandle );
+	}
+	else
+	{
+		/* Start the standard demo tasks. */
+		vStartBlockingQueueTasks( mainBLOCK_Q_PRIORITY );
+		vStartGenericQueueTasks( mainGEN_QUEUE_PRIORITY );
+		vStartCountingSemaphoreTasks();
+		vStartPolledQueueTasks( mainQUEUE_POLL_PRIORITY );
+		vStartSemaphoreTasks( mainSEM_TEST_PRIORITY );
+		vStartRecursiveMutexTasks();
+		vStartQueuePeekTasks();
+		vCreateBlockTimeTasks();
+		vStartDynamicPriorityTasks();
+		vStartTimerDemoTask( mainTIMER_TEST_PERIOD );
+		vStartStreamBufferTasks( mainSTREAM_BUFFER_PRIORITY );
+
+		xTaskCreate( vCheckTask, ( signed char * ) "Check", configMINIMAL_STACK_SIZE, NULL, mainCHECK_TASK_PRIORITY, NULL );
+
+		/* The suicide tasks must be created last as they keep a count of the
+		tasks that exist. */
+		vCreateSuicidalTasks( mainCREATOR_TASK_PRIORITY );
+	}
+
+	/* Start the scheduler.  This only returns once vTaskEndScheduler() has
+	been called, or if there was insufficient heap to start the
+	scheduler. */
+	vTaskStartScheduler();
+
+	return ( xErrorOccurred == pdFALSE ) ? 0 : 1;
+}
+/*-----------------------------------------------------------*/
+
+static void vCheckTask( void *pvParameters )
+{
+portTickType xLastExecutionTime, xEndTime;
+const char *pcMessage;
+
+	( void ) pvParameters;
+
+	/* Initialise xLastExecutionTime so the first call to vTaskDelayUntil()
+	works correctly. */
+	xLastExecutionTime = xTaskGetTickCount();
+	xEndTime = xLastExecutionTime + ( portTickType ) ( ulRunTime * configTICK_RATE_HZ );
+
+	for( ;; )
+	{
+		/* Perform this check every mainCHECK_DELAY milliseconds. */
+		vTaskDelayUntil( &xLastExecutionTime, mainCHECK_DELAY );
+
+		/* Has an error been found in any task? */
+		pcMessage = NULL;
+
+		if( xAreBlockingQueuesStillRunning() != pdTRUE )
+		{
+			pcMessage = "BlockQ";
+		}
+
+		if( xAreGenericQueueTasksStillRunning() != pdTRUE )
+		{
+			pcMessage = "GenQTest";
+		}
+
+		if( xAreCountingSemaphoreTasksStillRunning() != pdTRUE )
+		{
+			pcMessage = "countsem";
+		}
+
+		if( xArePollingQueuesStillRunning() != pdTRUE )
+		{
+			pcMessage = "PollQ";
+		}
+
+		if( xAreSemaphoreTasksStillRunning() != pdTRUE )
+		{
+			pcMessage = "semtest";
+		}
+
+		if( xAreRecursiveMutexTasksStillRunning() != pdTRUE )
+		{
+			pcMessage = "recmutex";
+		}
+
+		if( xAreQueuePeekTasksStillRunning() != pdTRUE )
+		{
+			pcMessage = "QPeek";
+		}
+
+		if( xAreBlockTimeTestTasksStillRunning() != pdTRUE )
+		{
+			pcMessage = "blocktim";
+		}
+
+		if( xAreDynamicPriorityTasksStillRunning() != pdTRUE )
+		{
+			pcMessage = "dynamic";
+		}
+
+		if( xIsCreateTaskStillRunning() != pdTRUE )
+		{
+			pcMessage = "death";
+		}
+
+		if( xAreTimerDemoTasksStillRunning( mainCHECK_DELAY ) != pdTRUE )
+		{
+			pcMessage = "TimerDemo";
+		}
+
+		if( xAreStreamBufferTasksStillRunning() != pdTRUE )
+		{
+			pcMessage = "StreamBufferDemo";
+		}
+
+		if( pcMessage != NULL )
+		{
+			xErrorOccurred = pdTRUE;
+		}
+
+		/* The C library is not scheduler aware, so only print from within a
+		critical section. */
+		taskENTER_CRITICAL();
+		{
+			if( xErrorOccurred == pdFALSE )
+			{
+				printf( "%8lu ticks: PASS\n", ( unsigned long ) xLastExecutionTime );
+			}
+			else
+			{
+				printf( "%8lu ticks: FAIL%s%s\n", ( unsigned long ) xLastExecutionTime, ( pcMessage != NULL ) ? " " : "", ( pcMessage != NULL ) ? pcMessage : "" );
+			}
+			fflush( stdout );
+		}
+		taskEXIT_CRITICAL();
+
+		if( ( ulRunTime != 0 ) && ( ( portTickType ) ( xLastExecutionTime - xEndTime ) < ( portMAX_DELAY / 2 ) ) )
+		{
+			vTaskEndScheduler();
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvBenchmarkTask( void *pvParameters )
+{
+unsigned long long ullStart;
+unsigned long ul, ulValue;
+xSemaphoreHandle xSemaphore;
+xTaskHandle xEchoTask;
+static xTimerHandle xTimers[ mainBENCH_TIMERS ];
+
+	( void ) pvParameters;
+
+	xBenchQueueToEcho = xQueueCreate( 1, sizeof( unsigned long ) );
+	xBenchQueueFromEcho = xQueueCreate( 1, sizeof( unsigned long ) );
+	vSemaphoreCreateBinary( xSemaphore );
+	configASSERT( xBenchQueueToEcho && xBenchQueueFromEcho && xSemaphore );
+
+	/* Give and take a semaphore without blocking or switching - the cost of
+	the queue API itself. */
+	ullStart = prvNowNs();
+	for( ul = 0; ul < mainBENCHMARK_ITERATIONS; ul++ )
+	{
+		xSemaphoreTake( xSemaphore, 0 );
+		xSemaphoreGive( xSemaphore );
+	}
+	prvReportBenchmark( "semaphore take/give", mainBENCHMARK_ITERATIONS, prvNowNs() - ullStart );
+
+	/* Send to and receive from a queue without blocking or switching. */
+	ullStart = prvNowNs();
+	for( ul = 0; ul < mainBENCHMARK_ITERATIONS; ul++ )
+	{
+		xQueueSend( xBenchQueueToEcho, &ul, 0 );
+		xQueueReceive( xBenchQueueToEcho, &ulValue, 0 );
+	}
+	prvReportBenchmark( "queue send/receive", mainBENCHMARK_ITERATIONS, prvNowNs() - ullStart );
+
+	/* Round trip through a higher priority task - two sends, two receives
+	and two context switches per iteration. */
+	xTaskCreate( prvQueueEchoTask, ( signed char * ) "QEcho", configMINIMAL_STACK_SIZE, NULL, mainCHECK_TASK_PRIORITY, &xEchoTask );
+	ullStart = prvNowNs();
+	for( ul = 0; ul < mainBENCHMARK_ITERATIONS; ul++ )
+	{
+		xQueueSend( xBenchQueueToEcho, &ul, portMAX_DELAY );
+		xQueueReceive( xBenchQueueFromEcho, &ulValue, portMAX_DELAY );
+		if( ulValue != ul )
+		{
+			xErrorOccurred = pdTRUE;
+		}
+	}
+	prvReportBenchmark( "queue round trip", mainBENCHMARK_ITERATIONS, prvNowNs() - ullStart );
+	vTaskDelete( xEchoTask );
+
+	/* Round trip using direct to task notifications in place of queues. */
+	xTaskCreate( prvNotifyEchoTask, ( signed char * ) "NEcho", configMINIMAL_STACK_SIZE, NULL, mainCHECK_TASK_PRIORITY, &xEchoTask );
+	ullStart = prvNowNs();
+	for( ul = 0; ul < mainBENCHMARK_ITERATIONS; ul++ )
+	{
+		xTaskNotifyGive( xEchoTask );
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+	}
+	prvReportBenchmark( "notify round trip", mainBENCHMARK_ITERATIONS, prvNowNs() - ullStart );
+	vTaskDelete( xEchoTask );
+
+	/* Two tasks of equal priority yielding to each other while the benchmark
+	task is blocked. */
+	ulYieldCount = 0;
+	xTaskCreate( prvYieldTask, ( signed char * ) "Yield1", configMINIMAL_STACK_SIZE, NULL, mainBENCHMARK_PRIORITY, NULL );
+	xTaskCreate( prvYieldTask, ( signed char * ) "Yield2", configMINIMAL_STACK_SIZE, NULL, mainBENCHMARK_PRIORITY, NULL );
+	ullStart = prvNowNs();
+	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+	prvReportBenchmark( "context switch", mainBENCHMARK_ITERATIONS, prvNowNs() - ullStart );
+
+	/* The average time between the callbacks of timers that expire in the
+	same tick - the cost of processing one expired timer in the timer service
+	task. */
+	for( ul = 0; ul < mainBENCH_TIMERS; ul++ )
+	{
+		xTimers[ ul ] = xTimerCreate( ( const signed char * ) "Bench", mainBENCH_TIMER_PERIOD, pdTRUE, NULL, prvBenchTimerCallback );
+		configASSERT( xTimers[ ul ] );
+	}
+
+	ulTimerExpiries = 0;
+	ulTimerIntervals = 0;
+	ullTimerIntervalNs = 0;
+	xLastTimerTick = portMAX_DELAY;
+	vTaskDelay( 1 );
+	for( ul = 0; ul < mainBENCH_TIMERS; ul++ )
+	{
+		xTimerStart( xTimers[ ul ], portMAX_DELAY );
+	}
+	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+	for( ul = 0; ul < mainBENCH_TIMERS; ul++ )
+	{
+		xTimerDelete( xTimers[ ul ], portMAX_DELAY );
+	}
+	prvReportBenchmark( "timer expiry", ulTimerIntervals, ullTimerIntervalNs );
+
+	vQueueDelete( xBenchQueueToEcho );
+	vQueueDelete( xBenchQueueFromEcho );
+	vQueueDelete( xSemaphore );
+
+	vTaskEndScheduler();
+}
+/*-----------------------------------------------------------*/
+
+static void prvQueueEchoTask( void *pvParameters )
+{
+unsigned long ulValue;
+
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		xQueueReceive( xBenchQueueToEcho, &ulValue, portMAX_DELAY );
+		xQueueSend( xBenchQueueFromEcho, &ulValue, portMAX_DELAY );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvNotifyEchoTask( void *pvParameters )
+{
+	( void ) pvParameters;
+
+	for( ;; )
+	{
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+		xTaskNotifyGive( xBenchmarkTaskHandle );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvYieldTask( void *pvParameters )
+{
+	( void ) pvParameters;
+
+	/* Both yield tasks share the counter, so it counts context switches. */
+	while( ulYieldCount < mainBENCHMARK_ITERATIONS )
+	{
+		ulYieldCount++;
+		taskYIELD();
+	}
+
+	/* Only the first task to finish wakes the benchmark task. */
+	if( ulYieldCount == mainBENCHMARK_ITERATIONS )
+	{
+		ulYieldCount++;
+		xTaskNotifyGive( xBenchmarkTaskHandle );
+	}
+
+	vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static void prvBenchTimerCallback( xTimerHandle xTimer )
+{
+unsigned long long ullNow = prvNowNs();
+portTickType xTickNow = xTaskGetTickCount();
+
+	( void ) xTimer;
+
+	if( ulTimerExpiries < mainBENCH_TIMER_EXPIRIES )
+	{
+		if( xTickNow == xLastTimerTick )
+		{
+			ullTimerIntervalNs += ullNow - ullLastTimerNs;
+			ulTimerIntervals++;
+		}
+
+		xLastTimerTick = xTickNow;
+		ullLastTimerNs = ullNow;
+
+		ulTimerExpiries++;
+		if( ulTimerExpiries == mainBENCH_TIMER_EXPIRIES )
+		{
+			xTaskNotifyGive( xBenchmarkTaskHandle );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvReportBenchmark( const char *pcName, unsigned long ulIterations, unsigned long long ullElapsedNs )
+{
+	taskENTER_CRITICAL();
+	{
+		printf( "%-24s %8lu iterations %10.1f ns/iteration\n", pcName, ulIterations, ( double ) ullElapsedNs / ( double ) ulIterations );
+		fflush( stdout );
+	}
+	taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+static unsigned long long prvNowNs( void )
+{
+struct timespec xNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	return ( ( unsigned long long ) xNow.tv_sec * 1000000000ULL ) + ( unsigned long long ) xNow.tv_nsec;
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationIdleHook( void )
+{
+	/* Sleep until the next tick rather than spinning.  Only the tick can
+	make another task ready while the idle task is running. */
+	pause();
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationTickHook( void )
+{
+	/* Exercise the timer and stream buffer API functions that can be called
+	from an interrupt. */
+	if( xBenchmarkOnly == pdFALSE )
+	{
+		vTimerPeriodicISRTests();
+		vPeriodicStreamBufferProcessingFromISR();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vAssertCalled( const char *pcFile, unsigned long ulLine )
+{
+	taskDISABLE_INTERRUPTS();
+	fprintf( stderr, "ASSERT: %s:%lu\n", pcFile, ulLine );
+	abort();
+}
+
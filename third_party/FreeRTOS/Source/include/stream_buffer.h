@@ -0,0 +1,297 @@
+/*
+    FreeRTOS V7.1.1 - Copyright (C) 2012 Real Time Engineers Ltd.
+
+
+    ***************************************************************************
+     *                                                                       *
+     *    FreeRTOS tutorial books are available in pdf and paperback.        *
+     *    Complete, revised, and edited pdf reference manuals are also       *
+     *    available.                                                         *
+     *                                                                       *
+     *    Purchasing FreeRTOS documentation will not only help you, by       *
+     *    ensuring you get running as quickly as possible and with an        *
+     *    in-depth knowledge of how to use FreeRTOS, it will also help       *
+     *    the FreeRTOS project to continue with its mission of providing     *
+     *    professional grade, cross platform, de facto standard solutions    *
+     *    for microcontrollers - completely free of charge!                  *
+     *                                                                       *
+     *    >>> See http://www.FreeRTOS.org/Documentation for details. <<<     *
+     *                                                                       *
+     *    Thank you for using FreeRTOS, and thank you for your support!      *
+     *                                                                       *
+    ***************************************************************************
+
+
+    This file is part of the FreeRTOS distribution.
+
+    FreeRTOS is free software; you can redistribute it and/or modify it under
+    the terms of the GNU General Public License (version 2) as published by the
+    Free Software Foundation AND MODIFIED BY the FreeRTOS exception.
+    >>>NOTE<<< The modification to the GPL is included to allow you to
+    distribute a combined work that includes FreeRTOS without being obliged to
+    provide the source code for proprietary components outside of the FreeRTOS
+    kernel.  FreeRTOS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details. You should have received a copy of the GNU General Public
+    License and the FreeRTOS license exception along with FreeRTOS; if not it
+    can be viewed here: http://www.freertos.org/a00114.html and also obtained
+    by writing to Richard Barry, contact details for whom are available on the
+    FreeRTOS WEB site.
+
+    1 tab == 4 spaces!
+    
+    ***************************************************************************
+     *                                                                       *
+     *    Having a problem?  Start by reading the FAQ "My application does   *
+     *    not run, what could be wrong?                                      *
+     *                                                                       *
+     *    http://www.FreeRTOS.org/FAQHelp.html                               *
+     *                                                                       *
+    ***************************************************************************
+
+    
+    http://www.FreeRTOS.org - Documentation, training, latest information, 
+    license and contact details.
+    
+    http://www.FreeRTOS.org/plus - A selection of FreeRTOS ecosystem products,
+    including FreeRTOS+Trace - an indispensable productivity tool.
+
+    Real Time Engineers ltd license FreeRTOS to High Integrity Systems, who sell 
+    the code with commercial support, indemnification, and middleware, under 
+    the OpenRTOS brand: http://www.OpenRTOS.com.  High Integrity Systems also
+    provide a safety engineered and independently SIL3 certified version under 
+    the SafeRTOS brand: http://www.SafeRTOS.com.
+*/
+
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#ifndef INC_FREERTOS_H
+	#error "include FreeRTOS.h must appear in source files before include stream_buffer.h"
+#endif
+
+#include "task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------
+ * MACROS AND DEFINITIONS
+ *----------------------------------------------------------*/
+
+/**
+ * Type by which stream buffers are referenced.  For example, a call to
+ * xStreamBufferCreate() returns an xStreamBufferHandle variable that can then
+ * be used as a parameter to xStreamBufferSend(), xStreamBufferReceive(), etc.
+ *
+ * A stream buffer passes a continuous stream of bytes from a single writer (a
+ * task or an interrupt) to a single reader (a task or an interrupt).  Unlike a
+ * queue, data is not divided into fixed size items, so a byte oriented
+ * producer such as a UART or USB CDC interrupt can hand over any number of
+ * bytes in one call.  As there is only ever one writer and one reader, the
+ * buffer itself is accessed without a critical section - only the blocking
+ * and unblocking of tasks needs kernel protection.
+ *
+ * Stream buffers use task notifications to unblock waiting tasks, so
+ * configUSE_TASK_NOTIFICATIONS must be 1 for this file to be compiled.  Before
+ * blocking, xStreamBufferSend() and xStreamBufferReceive() discard any
+ * notification that is pending for the calling task, as it may be a late wake
+ * up from an earlier wait that timed out.  A task that blocks on a stream
+ * buffer must therefore not use its notification for any other purpose.
+ *
+ * NOTE:  If there is more than one writer then the application must serialise
+ * the calls to the send functions, for example by only writing from within a
+ * critical section.  Likewise for multiple readers.
+ */
+typedef void * xStreamBufferHandle;
+
+/**
+ * stream_buffer.h
+ * <pre>xStreamBufferHandle xStreamBufferCreate( size_t xBufferSizeBytes, size_t xTriggerLevelBytes );</pre>
+ *
+ * Creates a new stream buffer.
+ *
+ * @param xBufferSizeBytes The total number of bytes the stream buffer will be
+ * able to hold at any one time.
+ *
+ * @param xTriggerLevelBytes The number of bytes that must be in the stream
+ * buffer before a task that is blocked on the stream buffer to wait for data
+ * is moved out of the blocked state.  A trigger level of 0 is treated as 1.
+ * The trigger level cannot be greater than xBufferSizeBytes.
+ *
+ * @return NULL if there was insufficient heap to create the stream buffer,
+ * otherwise the handle of the created stream buffer.
+ *
+ * \page xStreamBufferCreate xStreamBufferCreate
+ * \ingroup StreamBufferManagement
+ */
+xStreamBufferHandle xStreamBufferCreate( size_t xBufferSizeBytes, size_t xTriggerLevelBytes ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ * <pre>void vStreamBufferDelete( xStreamBufferHandle xStreamBuffer );</pre>
+ *
+ * Deletes a stream buffer previously created by xStreamBufferCreate() and
+ * frees the memory it used.  No task may be blocked on the stream buffer when
+ * it is deleted.
+ *
+ * \page vStreamBufferDelete vStreamBufferDelete
+ * \ingroup StreamBufferManagement
+ */
+void vStreamBufferDelete( xStreamBufferHandle xStreamBuffer ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ * <pre>size_t xStreamBufferSend( xStreamBufferHandle xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes, portTickType xTicksToWait );</pre>
+ *
+ * Writes bytes to a stream buffer from a task.  Use xStreamBufferSendFromISR()
+ * to write to a stream buffer from an interrupt service routine.
+ *
+ * @param xStreamBuffer The handle of the stream buffer to write to.
+ *
+ * @param pvTxData A pointer to the bytes to copy into the stream buffer.
+ *
+ * @param xDataLengthBytes The number of bytes to copy from pvTxData.
+ *
+ * @param xTicksToWait The maximum amount of time the task should remain in the
+ * Blocked state to wait for enough space to become available in the stream
+ * buffer to hold all xDataLengthBytes bytes.  If the timeout expires then as
+ * many bytes as will fit are written.
+ * A notification pending for the calling task is discarded if it blocks.
+ *
+ * @return The number of bytes written to the stream buffer.
+ *
+ * \page xStreamBufferSend xStreamBufferSend
+ * \ingroup StreamBufferManagement
+ */
+size_t xStreamBufferSend( xStreamBufferHandle xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes, portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ * <pre>size_t xStreamBufferSendFromISR( xStreamBufferHandle xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes, portBASE_TYPE *pxHigherPriorityTaskWoken );</pre>
+ *
+ * Writes as many bytes as will fit to a stream buffer from an interrupt
+ * service routine.
+ *
+ * @param pxHigherPriorityTaskWoken Set to pdTRUE if writing the data caused a
+ * task with a priority higher than the currently running task to leave the
+ * Blocked state.  If it is set to pdTRUE then a context switch should be
+ * requested before the interrupt is exited.  Can be NULL.
+ *
+ * @return The number of bytes written to the stream buffer.
+ *
+ * \page xStreamBufferSendFromISR xStreamBufferSendFromISR
+ * \ingroup StreamBufferManagement
+ */
+size_t xStreamBufferSendFromISR( xStreamBufferHandle xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes, portBASE_TYPE *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ * <pre>size_t xStreamBufferReceive( xStreamBufferHandle xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, portTickType xTicksToWait );</pre>
+ *
+ * Reads bytes from a stream buffer from a task.  Use
+ * xStreamBufferReceiveFromISR() to read from an interrupt service routine.
+ *
+ * If the stream buffer is empty the calling task blocks until at least the
+ * trigger level number of bytes have been written, or until xTicksToWait
+ * expires.  If the stream buffer is not empty then the bytes that are already
+ * available are returned immediately.
+ *
+ * @param xStreamBuffer The handle of the stream buffer to read from.
+ *
+ * @param pvRxData A pointer to the buffer into which the bytes are copied.
+ *
+ * @param xBufferLengthBytes The length of the buffer pointed to by pvRxData.
+ * This is the maximum number of bytes that will be returned.
+ *
+ * @param xTicksToWait The maximum amount of time the task should remain in the
+ * Blocked state to wait for data if the stream buffer is empty.
+ * A notification pending for the calling task is discarded if it blocks.
+ *
+ * @return The number of bytes read from the stream buffer.
+ *
+ * \page xStreamBufferReceive xStreamBufferReceive
+ * \ingroup StreamBufferManagement
+ */
+size_t xStreamBufferReceive( xStreamBufferHandle xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ * <pre>size_t xStreamBufferReceiveFromISR( xStreamBufferHandle xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, portBASE_TYPE *pxHigherPriorityTaskWoken );</pre>
+ *
+ * Reads bytes from a stream buffer from an interrupt service routine, for
+ * example to refill a UART transmit FIFO.
+ *
+ * @param pxHigherPriorityTaskWoken Set to pdTRUE if reading the data caused a
+ * task with a priority higher than the currently running task to leave the
+ * Blocked state because space became available.  Can be NULL.
+ *
+ * @return The number of bytes read from the stream buffer.
+ *
+ * \page xStreamBufferReceiveFromISR xStreamBufferReceiveFromISR
+ * \ingroup StreamBufferManagement
+ */
+size_t xStreamBufferReceiveFromISR( xStreamBufferHandle xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, portBASE_TYPE *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ * <pre>size_t xStreamBufferBytesAvailable( xStreamBufferHandle xStreamBuffer );</pre>
+ *
+ * @return The number of bytes that can be read from the stream buffer before
+ * it is empty.
+ *
+ * \ingroup StreamBufferManagement
+ */
+size_t xStreamBufferBytesAvailable( xStreamBufferHandle xStreamBuffer ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ * <pre>size_t xStreamBufferSpacesAvailable( xStreamBufferHandle xStreamBuffer );</pre>
+ *
+ * @return The number of bytes that can be written to the stream buffer before
+ * it is full.
+ *
+ * \ingroup StreamBufferManagement
+ */
+size_t xStreamBufferSpacesAvailable( xStreamBufferHandle xStreamBuffer ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ * <pre>portBASE_TYPE xStreamBufferSetTriggerLevel( xStreamBufferHandle xStreamBuffer, size_t xTriggerLevel );</pre>
+ *
+ * Changes the trigger level of the stream buffer.
+ *
+ * @return pdPASS if the trigger level was changed, or pdFAIL if xTriggerLevel
+ * is larger than the size of the stream buffer.
+ *
+ * \ingroup StreamBufferManagement
+ */
+portBASE_TYPE xStreamBufferSetTriggerLevel( xStreamBufferHandle xStreamBuffer, size_t xTriggerLevel ) PRIVILEGED_FUNCTION;
+
+/**
+ * stream_buffer.h
+ * <pre>portBASE_TYPE xStreamBufferReset( xStreamBufferHandle xStreamBuffer );</pre>
+ *
+ * Empties the stream buffer.  A stream buffer can only be reset if no tasks
+ * are blocked on it.
+ *
+ * @return pdPASS if the stream buffer was reset, otherwise pdFAIL.
+ *
+ * \ingroup StreamBufferManagement
+ */
+portBASE_TYPE xStreamBufferReset( xStreamBufferHandle xStreamBuffer ) PRIVILEGED_FUNCTION;
+
+/*
+ * Convenience macros.
+ */
+#define xStreamBufferIsEmpty( xStreamBuffer ) ( ( portBASE_TYPE ) ( xStreamBufferBytesAvailable( xStreamBuffer ) == ( size_t ) 0 ) )
+#define xStreamBufferIsFull( xStreamBuffer ) ( ( portBASE_TYPE ) ( xStreamBufferSpacesAvailable( xStreamBuffer ) == ( size_t ) 0 ) )
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_BUFFER_H */
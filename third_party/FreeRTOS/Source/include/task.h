@@ -131,6 +131,18 @@ typedef struct xTASK_PARAMTERS
 	xMemoryRegion xRegions[ portNUM_CONFIGURABLE_REGIONS ];
 } xTaskParameters;
 
+/*
+ * Actions that can be performed when xTaskNotify() is called.
+ */
+typedef enum
+{
+	eNoAction = 0,				/* Notify the task without updating its notify value. */
+	eSetBits,					/* Set bits in the task's notification value. */
+	eIncrement,					/* Increment the task's notification value. */
+	eSetValueWithOverwrite,		/* Set the task's notification value to a specific value even if the previous value has not yet been read by the task. */
+	eSetValueWithoutOverwrite	/* Set the task's notification value if the previous value has been read by the task. */
+} eNotifyAction;
+
 /*
  * Defines the priority used by the idle task.  This must not be modified.
  *
@@ -1188,6 +1200,141 @@ portBASE_TYPE xTaskCallApplicationTaskHook( xTaskHandle xTask, void *pvParameter
  */
 xTaskHandle xTaskGetIdleTaskHandle( void );
 
+/**
+ * task. h
+ * <PRE>portBASE_TYPE xTaskNotify( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction );</PRE>
+ *
+ * configUSE_TASK_NOTIFICATIONS must be undefined or defined as 1 for this
+ * function to be available.
+ *
+ * Each task has a 32 bit notification value that is initialised to zero when
+ * the task is created.  Sending a notification to a task unblocks the task if
+ * it is blocked in xTaskNotifyWait() or ulTaskNotifyTake(), and optionally
+ * updates the notification value.  As no separate queue or semaphore object is
+ * involved, a notification is both faster to send and uses less RAM than the
+ * equivalent binary or counting semaphore.  A notification can only be sent
+ * to a single, known, receiving task.
+ *
+ * @param xTaskToNotify The handle of the task being notified.
+ *
+ * @param ulValue Data that can be sent with the notification.  How the data
+ * is used depends on the value of eAction.
+ *
+ * @param eAction eNoAction leaves the notification value unchanged.  eSetBits
+ * ORs ulValue into the notification value.  eIncrement increments the
+ * notification value (ulValue is not used).  eSetValueWithOverwrite sets the
+ * notification value to ulValue.  eSetValueWithoutOverwrite sets the
+ * notification value to ulValue only if the receiving task has no notification
+ * pending.
+ *
+ * @return pdFAIL if eAction is eSetValueWithoutOverwrite and a notification
+ * was already pending, otherwise pdPASS.
+ *
+ * \page xTaskNotify xTaskNotify
+ * \ingroup TaskNotifications
+ */
+portBASE_TYPE xTaskNotify( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <PRE>portBASE_TYPE xTaskNotifyFromISR( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, portBASE_TYPE *pxHigherPriorityTaskWoken );</PRE>
+ *
+ * A version of xTaskNotify() that can be called from an interrupt service
+ * routine.
+ *
+ * @param pxHigherPriorityTaskWoken Set to pdTRUE if sending the notification
+ * unblocked a task that has a priority higher than the currently running task.
+ * If it is set to pdTRUE then a context switch should be requested before the
+ * interrupt is exited.  pxHigherPriorityTaskWoken is an optional parameter and
+ * can be set to NULL.
+ *
+ * \page xTaskNotifyFromISR xTaskNotifyFromISR
+ * \ingroup TaskNotifications
+ */
+portBASE_TYPE xTaskNotifyFromISR( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, portBASE_TYPE *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <PRE>portBASE_TYPE xTaskNotifyWait( unsigned long ulBitsToClearOnEntry, unsigned long ulBitsToClearOnExit, unsigned long *pulNotificationValue, portTickType xTicksToWait );</pre>
+ *
+ * Waits, with an optional timeout, for the calling task to receive a
+ * notification.
+ *
+ * @param ulBitsToClearOnEntry Bits that are set in ulBitsToClearOnEntry are
+ * cleared in the calling task's notification value before the task checks to
+ * see if any notifications are pending, but only if no notification was
+ * already pending.
+ *
+ * @param ulBitsToClearOnExit Bits that are set in ulBitsToClearOnExit are
+ * cleared in the calling task's notification value before the function exits,
+ * if a notification was received.
+ *
+ * @param pulNotificationValue Used to pass out the task's notification value
+ * before any bits are cleared on exit.  Can be set to NULL if not required.
+ *
+ * @param xTicksToWait The maximum time to wait in the Blocked state for a
+ * notification to be received.  Setting xTicksToWait to portMAX_DELAY will
+ * cause the task to wait indefinitely, provided INCLUDE_vTaskSuspend is set
+ * to 1.
+ *
+ * @return pdTRUE if a notification was received, or pdFALSE if the call timed
+ * out.
+ *
+ * \page xTaskNotifyWait xTaskNotifyWait
+ * \ingroup TaskNotifications
+ */
+portBASE_TYPE xTaskNotifyWait( unsigned long ulBitsToClearOnEntry, unsigned long ulBitsToClearOnExit, unsigned long *pulNotificationValue, portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <PRE>portBASE_TYPE xTaskNotifyGive( xTaskHandle xTaskToNotify );</PRE>
+ *
+ * Increments the notification value of xTaskToNotify.  Used in combination
+ * with ulTaskNotifyTake() as a light weight replacement for xSemaphoreGive()
+ * when the semaphore is only ever taken by a single task.
+ *
+ * \page xTaskNotifyGive xTaskNotifyGive
+ * \ingroup TaskNotifications
+ */
+#define xTaskNotifyGive( xTaskToNotify ) xTaskNotify( ( xTaskToNotify ), 0, eIncrement )
+
+/**
+ * task. h
+ * <PRE>void vTaskNotifyGiveFromISR( xTaskHandle xTaskToNotify, portBASE_TYPE *pxHigherPriorityTaskWoken );</PRE>
+ *
+ * A version of xTaskNotifyGive() that can be called from an interrupt service
+ * routine.  This is the light weight equivalent of xSemaphoreGiveFromISR()
+ * and is intended to signal a task from a peripheral interrupt (such as the
+ * UART or ADC) with the minimum possible latency.
+ *
+ * \page vTaskNotifyGiveFromISR vTaskNotifyGiveFromISR
+ * \ingroup TaskNotifications
+ */
+void vTaskNotifyGiveFromISR( xTaskHandle xTaskToNotify, portBASE_TYPE *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <PRE>unsigned long ulTaskNotifyTake( portBASE_TYPE xClearCountOnExit, portTickType xTicksToWait );</pre>
+ *
+ * Waits, with an optional timeout, for the calling task's notification value
+ * to become non-zero.  Used in combination with xTaskNotifyGive() or
+ * vTaskNotifyGiveFromISR() as a light weight replacement for xSemaphoreTake().
+ *
+ * @param xClearCountOnExit If pdTRUE the notification value is cleared to
+ * zero on exit, so it behaves like a binary semaphore.  If pdFALSE the
+ * notification value is decremented on exit, so it behaves like a counting
+ * semaphore.
+ *
+ * @param xTicksToWait The maximum time to wait in the Blocked state for the
+ * notification value to become non-zero.
+ *
+ * @return The task's notification value before it was cleared or decremented.
+ *
+ * \page ulTaskNotifyTake ulTaskNotifyTake
+ * \ingroup TaskNotifications
+ */
+unsigned long ulTaskNotifyTake( portBASE_TYPE xClearCountOnExit, portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
 /*-----------------------------------------------------------
  * SCHEDULER INTERNALS AVAILABLE FOR PORTING PURPOSES
  *----------------------------------------------------------*/
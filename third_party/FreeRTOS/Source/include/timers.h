@@ -537,6 +537,14 @@ xTaskHandle xTimerGetTimerDaemonTaskHandle( void );
  * started, and the timers expiry time will be relative to when the scheduler is
  * started, not relative to when xTimerReset() was called.
  *
+ * If configUSE_TIMER_BATCH_EXPIRY is set to 1 then xTimerReset(), xTimerStart(),
+ * xTimerStop() and xTimerChangePeriod() calls made from within a timer callback
+ * function do not use the timer command queue.  The command is applied
+ * immediately, and the new expiry time is relative to the tick at which the
+ * timer service task started processing the expired timers, so a periodic
+ * timer can be re-phased from its own callback without a queue round trip.
+ * xTimerDelete() is always sent through the timer command queue.
+ *
  * The configUSE_TIMERS configuration constant must be set to 1 for xTimerReset()
  * to be available.
  *
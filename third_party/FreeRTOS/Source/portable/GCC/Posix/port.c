@@ -0,0 +1,454 @@
+/*
+    FreeRTOS V7.1.1 - Copyright (C) 2012 Real Time Engineers Ltd.
+
+
+    ***************************************************************************
+     *                                                                       *
+     *    FreeRTOS tutorial books are available in pdf and paperback.        *
+     *    Complete, revised, and edited pdf reference manuals are also       *
+     *    available.                                                         *
+     *                                                                       *
+     *    Purchasing FreeRTOS documentation will not only help you, by       *
+     *    ensuring you get running as quickly as possible and with an        *
+     *    in-depth knowledge of how to use FreeRTOS, it will also help       *
+     *    the FreeRTOS project to continue with its mission of providing     *
+     *    professional grade, cross platform, de facto standard solutions    *
+     *    for microcontrollers - completely free of charge!                  *
+     *                                                                       *
+     *    >>> See http://www.FreeRTOS.org/Documentation for details. <<<     *
+     *                                                                       *
+     *    Thank you for using FreeRTOS, and thank you for your support!      *
+     *                                                                       *
+    ***************************************************************************
+
+
+    This file is part of the FreeRTOS distribution.
+
+    FreeRTOS is free software; you can redistribute it and/or modify it under
+    the terms of the GNU General Public License (version 2) as published by the
+    Free Software Foundation AND MODIFIED BY the FreeRTOS exception.
+    >>>NOTE<<< The modification to the GPL is included to allow you to
+    distribute a combined work that includes FreeRTOS without being obliged to
+    provide the source code for proprietary components outside of the FreeRTOS
+    kernel.  FreeRTOS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details. You should have received a copy of the GNU General Public
+    License and the FreeRTOS license exception along with FreeRTOS; if not it
+    can be viewed here: http://www.freertos.org/a00114.html and also obtained
+    by writing to Richard Barry, contact details for whom are available on the
+    FreeRTOS WEB site.
+
+    1 tab == 4 spaces!
+    
+    ***************************************************************************
+     *                                                                       *
+     *    Having a problem?  Start by reading the FAQ "My application does   *
+     *    not run, what could be wrong?                                      *
+     *                                                                       *
+     *    http://www.FreeRTOS.org/FAQHelp.html                               *
+     *                                                                       *
+    ***************************************************************************
+
+    
+    http://www.FreeRTOS.org - Documentation, training, latest information, 
+    license and contact details.
+    
+    http://www.FreeRTOS.org/plus - A selection of FreeRTOS ecosystem products,
+    including FreeRTOS+Trace - an indispensable productivity tool.
+
+    Real Time Engineers ltd license FreeRTOS to High Integrity Systems, who sell 
+    the code with commercial support, indemnification, and middleware, under 
+    the OpenRTOS brand: http://www.OpenRTOS.com.  High Integrity Systems also
+    provide a safety engineered and independently SIL3 certified version under 
+    the SafeRTOS brand: http://www.SafeRTOS.com.
+*/
+
+/*-----------------------------------------------------------
+ * Implementation of functions defined in portable.h for the POSIX simulator.
+ *
+ * Every task runs in a pthread of its own.  Only the thread belonging to the
+ * task referenced by pxCurrentTCB is ever allowed to execute - all other task
+ * threads are parked on a condition variable until the scheduler selects
+ * them.  The tick interrupt is simulated by SIGALRM, generated by an interval
+ * timer, and "interrupts" are masked by blocking SIGALRM in the running
+ * thread.
+ *
+ * The C library is not aware of the scheduler, so a task can be switched out
+ * while it holds a C library lock.  Tasks should therefore only call C
+ * library functions that take locks (printf(), etc.) from within a critical
+ * section.  heap_3.c already suspends the scheduler around malloc() and
+ * free().
+ *----------------------------------------------------------*/
+
+/* Standard includes. */
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* The signal used to simulate the tick interrupt. */
+#define portTICK_SIGNAL				SIGALRM
+
+/* The interval between ticks, in microseconds. */
+#define portTICK_PERIOD_US			( 1000000UL / configTICK_RATE_HZ )
+
+/* The thread that runs a task, referenced from the top of the task's stack. */
+typedef struct xTHREAD_STATE
+{
+	pthread_t xThread;
+	pthread_mutex_t xMutex;
+	pthread_cond_t xCond;
+	volatile portBASE_TYPE xRunning;	/* Set when the thread may execute. */
+	volatile portBASE_TYPE xDying;		/* Set when the task has been deleted. */
+	pdTASK_CODE pxCode;
+	void *pvParameters;
+} xThreadState;
+
+/* The first member of the TCB is the top of stack pointer, the first stack
+word of which holds the xThreadState of the task. */
+extern void * volatile pxCurrentTCB;
+#define prvTHREAD_OF( pxTopOfStack )	( ( xThreadState * ) *( pxTopOfStack ) )
+#define prvCURRENT_THREAD()				prvTHREAD_OF( *( ( portSTACK_TYPE ** ) pxCurrentTCB ) )
+
+/* Only one task thread executes at any time, so a single nesting count is
+sufficient.  A context switch never occurs while it is non zero. */
+static volatile unsigned portBASE_TYPE uxCriticalNesting = 0;
+
+/* Set when a yield is requested from within a critical section.  The yield
+is performed when the critical section is exited, as a pended PendSV would be
+on the target. */
+static volatile portBASE_TYPE xYieldPending = pdFALSE;
+
+/* Used to hold the thread that called vTaskStartScheduler() until
+vTaskEndScheduler() is called. */
+static pthread_mutex_t xEndMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xEndCond = PTHREAD_COND_INITIALIZER;
+static volatile portBASE_TYPE xSchedulerEnded = pdFALSE;
+
+/*
+ * Block or unblock the tick signal in the calling thread.  The previous mask
+ * is returned in pxOldSet if it is not NULL.
+ */
+static void prvTickSignalMask( int iHow, sigset_t *pxOldSet );
+
+/*
+ * The entry point of every task thread.
+ */
+static void *prvThreadEntry( void *pvThread );
+
+/*
+ * Park the calling thread until the scheduler selects it to run.  A thread
+ * whose task has been deleted exits from here.
+ */
+static void prvWaitToRun( xThreadState *pxThread );
+
+/*
+ * Allow a parked thread to run.
+ */
+static void prvResumeThread( xThreadState *pxThread );
+
+/*
+ * Select the next task to run and, if it is not the calling task, hand the
+ * processor over to its thread.  Must be called with the tick signal blocked.
+ */
+static void prvSwitchContext( void );
+
+/*
+ * Handler for the simulated tick interrupt.
+ */
+static void prvTickHandler( int iSignal );
+
+/*-----------------------------------------------------------*/
+
+/*
+ * See header file for description.
+ */
+portSTACK_TYPE *pxPortInitialiseStack( portSTACK_TYPE *pxTopOfStack, pdTASK_CODE pxCode, void *pvParameters )
+{
+xThreadState *pxThread;
+pthread_attr_t xAttr;
+sigset_t xOldSet;
+int iResult;
+
+	pxThread = ( xThreadState * ) malloc( sizeof( xThreadState ) );
+	configASSERT( pxThread );
+
+	pthread_mutex_init( &( pxThread->xMutex ), NULL );
+	pthread_cond_init( &( pxThread->xCond ), NULL );
+	pxThread->xRunning = pdFALSE;
+	pxThread->xDying = pdFALSE;
+	pxThread->pxCode = pxCode;
+	pxThread->pvParameters = pvParameters;
+
+	/* The new thread inherits the signal mask of the creating thread, so
+	block the tick while creating it.  The tick is unblocked when the task
+	first runs. */
+	prvTickSignalMask( SIG_BLOCK, &xOldSet );
+	pthread_attr_init( &xAttr );
+	pthread_attr_setdetachstate( &xAttr, PTHREAD_CREATE_DETACHED );
+	iResult = pthread_create( &( pxThread->xThread ), &xAttr, prvThreadEntry, pxThread );
+	pthread_attr_destroy( &xAttr );
+	pthread_sigmask( SIG_SETMASK, &xOldSet, NULL );
+	configASSERT( iResult == 0 );
+	( void ) iResult;
+
+	/* The task's own stack is not used for context frames, it only records
+	which thread runs the task. */
+	pxTopOfStack--;
+	*pxTopOfStack = ( portSTACK_TYPE ) pxThread;
+
+	return pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xPortStartScheduler( void )
+{
+struct sigaction xAction;
+struct itimerval xTimer;
+
+	/* The calling thread never runs task code, so it must never take the
+	tick. */
+	prvTickSignalMask( SIG_BLOCK, NULL );
+
+	memset( &xAction, 0, sizeof( xAction ) );
+	xAction.sa_handler = prvTickHandler;
+	sigemptyset( &( xAction.sa_mask ) );
+	xAction.sa_flags = SA_RESTART;
+	sigaction( portTICK_SIGNAL, &xAction, NULL );
+
+	/* Start the timer that generates the tick interrupt. */
+	xTimer.it_interval.tv_sec = 0;
+	xTimer.it_interval.tv_usec = portTICK_PERIOD_US;
+	xTimer.it_value = xTimer.it_interval;
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+
+	/* Start the first task. */
+	uxCriticalNesting = 0;
+	prvResumeThread( prvCURRENT_THREAD() );
+
+	/* Wait until vTaskEndScheduler() is called. */
+	pthread_mutex_lock( &xEndMutex );
+	while( xSchedulerEnded == pdFALSE )
+	{
+		pthread_cond_wait( &xEndCond, &xEndMutex );
+	}
+	pthread_mutex_unlock( &xEndMutex );
+
+	return 0;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+struct itimerval xTimer;
+
+	/* Stop the tick. */
+	memset( &xTimer, 0, sizeof( xTimer ) );
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+
+	/* Let vTaskStartScheduler() return. */
+	pthread_mutex_lock( &xEndMutex );
+	xSchedulerEnded = pdTRUE;
+	pthread_cond_signal( &xEndCond );
+	pthread_mutex_unlock( &xEndMutex );
+
+	/* The calling task does not execute any further.  The remaining task
+	threads are reclaimed when the process exits. */
+	prvTickSignalMask( SIG_BLOCK, NULL );
+	pthread_exit( NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+sigset_t xOldSet;
+
+	if( uxCriticalNesting != 0 )
+	{
+		/* Defer the yield until the critical section is exited. */
+		xYieldPending = pdTRUE;
+	}
+	else
+	{
+		prvTickSignalMask( SIG_BLOCK, &xOldSet );
+		prvSwitchContext();
+		pthread_sigmask( SIG_SETMASK, &xOldSet, NULL );
+	}
+}
+/*-----------------------------------------------------------*/
+
+unsigned portBASE_TYPE uxPortSetInterruptMask( void )
+{
+sigset_t xOldSet;
+
+	prvTickSignalMask( SIG_BLOCK, &xOldSet );
+	return ( unsigned portBASE_TYPE ) sigismember( &xOldSet, portTICK_SIGNAL );
+}
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMask( unsigned portBASE_TYPE uxWasMasked )
+{
+	/* Unlike the Cortex-M ports the mask nests, so the tick is only unmasked
+	if it was not already masked when uxPortSetInterruptMask() was called. */
+	if( uxWasMasked == 0 )
+	{
+		prvTickSignalMask( SIG_UNBLOCK, NULL );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+	prvTickSignalMask( SIG_BLOCK, NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+	prvTickSignalMask( SIG_UNBLOCK, NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+	vPortDisableInterrupts();
+	uxCriticalNesting++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+	uxCriticalNesting--;
+	if( uxCriticalNesting == 0 )
+	{
+		if( xYieldPending != pdFALSE )
+		{
+			xYieldPending = pdFALSE;
+			vPortYield();
+		}
+
+		vPortEnableInterrupts();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortDeleteThread( volatile portSTACK_TYPE *pxTopOfStack )
+{
+xThreadState *pxThread = prvTHREAD_OF( pxTopOfStack );
+
+	/* The thread of a deleted task is parked in prvWaitToRun().  Wake it so
+	it can release its own resources and exit. */
+	pthread_mutex_lock( &( pxThread->xMutex ) );
+	pxThread->xDying = pdTRUE;
+	pxThread->xRunning = pdTRUE;
+	pthread_cond_signal( &( pxThread->xCond ) );
+	pthread_mutex_unlock( &( pxThread->xMutex ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTickSignalMask( int iHow, sigset_t *pxOldSet )
+{
+sigset_t xSet;
+
+	sigemptyset( &xSet );
+	sigaddset( &xSet, portTICK_SIGNAL );
+	pthread_sigmask( iHow, &xSet, pxOldSet );
+}
+/*-----------------------------------------------------------*/
+
+static void *prvThreadEntry( void *pvThread )
+{
+xThreadState *pxThread = ( xThreadState * ) pvThread;
+
+	prvWaitToRun( pxThread );
+
+	/* A task starts outside of any critical section with interrupts
+	enabled. */
+	vPortEnableInterrupts();
+	pxThread->pxCode( pxThread->pvParameters );
+
+	/* Tasks must not return. */
+	configASSERT( pdFALSE );
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWaitToRun( xThreadState *pxThread )
+{
+portBASE_TYPE xDying;
+
+	pthread_mutex_lock( &( pxThread->xMutex ) );
+	while( pxThread->xRunning == pdFALSE )
+	{
+		pthread_cond_wait( &( pxThread->xCond ), &( pxThread->xMutex ) );
+	}
+	xDying = pxThread->xDying;
+	pthread_mutex_unlock( &( pxThread->xMutex ) );
+
+	if( xDying != pdFALSE )
+	{
+		pthread_cond_destroy( &( pxThread->xCond ) );
+		pthread_mutex_destroy( &( pxThread->xMutex ) );
+		free( pxThread );
+		pthread_exit( NULL );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvResumeThread( xThreadState *pxThread )
+{
+	pthread_mutex_lock( &( pxThread->xMutex ) );
+	pxThread->xRunning = pdTRUE;
+	pthread_cond_signal( &( pxThread->xCond ) );
+	pthread_mutex_unlock( &( pxThread->xMutex ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvSwitchContext( void )
+{
+xThreadState *pxOldThread, *pxNewThread;
+
+	pxOldThread = prvCURRENT_THREAD();
+	vTaskSwitchContext();
+	pxNewThread = prvCURRENT_THREAD();
+
+	if( pxNewThread != pxOldThread )
+	{
+		/* Clear the running flag before the new thread is released so a
+		switch straight back to this task cannot be missed. */
+		pthread_mutex_lock( &( pxOldThread->xMutex ) );
+		pxOldThread->xRunning = pdFALSE;
+		pthread_mutex_unlock( &( pxOldThread->xMutex ) );
+
+		prvResumeThread( pxNewThread );
+		prvWaitToRun( pxOldThread );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvTickHandler( int iSignal )
+{
+int iSavedErrno = errno;
+
+	( void ) iSignal;
+
+	/* The tick signal is blocked while the handler executes, and is never
+	unblocked inside a critical section, so the kernel data is consistent. */
+	vTaskIncrementTick();
+
+	#if configUSE_PREEMPTION == 1
+	{
+		prvSwitchContext();
+	}
+	#endif
+
+	errno = iSavedErrno;
+}
+
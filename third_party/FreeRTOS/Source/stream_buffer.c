@@ -0,0 +1,559 @@
+/*
+    FreeRTOS V7.1.1 - Copyright (C) 2012 Real Time Engineers Ltd.
+
+
+    ***************************************************************************
+     *                                                                       *
+     *    FreeRTOS tutorial books are available in pdf and paperback.        *
+     *    Complete, revised, and edited pdf reference manuals are also       *
+     *    available.                                                         *
+     *                                                                       *
+     *    Purchasing FreeRTOS documentation will not only help you, by       *
+     *    ensuring you get running as quickly as possible and with an        *
+     *    in-depth knowledge of how to use FreeRTOS, it will also help       *
+     *    the FreeRTOS project to continue with its mission of providing     *
+     *    professional grade, cross platform, de facto standard solutions    *
+     *    for microcontrollers - completely free of charge!                  *
+     *                                                                       *
+     *    >>> See http://www.FreeRTOS.org/Documentation for details. <<<     *
+     *                                                                       *
+     *    Thank you for using FreeRTOS, and thank you for your support!      *
+     *                                                                       *
+    ***************************************************************************
+
+
+    This file is part of the FreeRTOS distribution.
+
+    FreeRTOS is free software; you can redistribute it and/or modify it under
+    the terms of the GNU General Public License (version 2) as published by the
+    Free Software Foundation AND MODIFIED BY the FreeRTOS exception.
+    >>>NOTE<<< The modification to the GPL is included to allow you to
+    distribute a combined work that includes FreeRTOS without being obliged to
+    provide the source code for proprietary components outside of the FreeRTOS
+    kernel.  FreeRTOS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details. You should have received a copy of the GNU General Public
+    License and the FreeRTOS license exception along with FreeRTOS; if not it
+    can be viewed here: http://www.freertos.org/a00114.html and also obtained
+    by writing to Richard Barry, contact details for whom are available on the
+    FreeRTOS WEB site.
+
+    1 tab == 4 spaces!
+    
+    ***************************************************************************
+     *                                                                       *
+     *    Having a problem?  Start by reading the FAQ "My application does   *
+     *    not run, what could be wrong?                                      *
+     *                                                                       *
+     *    http://www.FreeRTOS.org/FAQHelp.html                               *
+     *                                                                       *
+    ***************************************************************************
+
+    
+    http://www.FreeRTOS.org - Documentation, training, latest information, 
+    license and contact details.
+    
+    http://www.FreeRTOS.org/plus - A selection of FreeRTOS ecosystem products,
+    including FreeRTOS+Trace - an indispensable productivity tool.
+
+    Real Time Engineers ltd license FreeRTOS to High Integrity Systems, who sell 
+    the code with commercial support, indemnification, and middleware, under 
+    the OpenRTOS brand: http://www.OpenRTOS.com.  High Integrity Systems also
+    provide a safety engineered and independently SIL3 certified version under 
+    the SafeRTOS brand: http://www.SafeRTOS.com.
+*/
+
+#include <string.h>
+
+/* Defining MPU_WRAPPERS_INCLUDED_FROM_API_FILE prevents task.h from redefining
+all the API functions to use the MPU wrappers.  That should only be done when
+task.h is included from an application file. */
+#define MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stream_buffer.h"
+
+#undef MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+/* This entire source file will be skipped if the application is not configured
+to include task notifications, which stream buffers use to block and unblock
+tasks.  This #if is closed at the very bottom of this file. */
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+#if ( ( INCLUDE_xTaskGetCurrentTaskHandle != 1 ) && ( configUSE_MUTEXES != 1 ) )
+	#error Stream buffers require INCLUDE_xTaskGetCurrentTaskHandle or configUSE_MUTEXES to be set to 1 in FreeRTOSConfig.h.
+#endif
+
+/* Misc definitions. */
+#define sbNO_DELAY		( ( portTickType ) 0U )
+
+/* The definition of the stream buffer itself.  The single reader only ever
+updates xTail and the single writer only ever updates xHead, so the storage
+area can be accessed without a critical section.  One byte of the storage area
+is never used so that a full buffer can be distinguished from an empty one. */
+typedef struct xSTREAM_BUFFER
+{
+	volatile size_t xTail;						/*< Index to the next byte to read from pucBuffer.  Only updated by the reader. */
+	volatile size_t xHead;						/*< Index to the next byte to write into pucBuffer.  Only updated by the writer. */
+	size_t xLength;								/*< The length of pucBuffer, which is one more than the stream buffer size. */
+	volatile size_t xTriggerLevelBytes;			/*< The number of bytes that must be in the buffer before a blocked reader is unblocked. */
+	volatile xTaskHandle xTaskWaitingToReceive;	/*< The task blocked waiting for data, or NULL. */
+	volatile xTaskHandle xTaskWaitingToSend;	/*< The task blocked waiting for space, or NULL. */
+	unsigned char *pucBuffer;					/*< Points to the storage area, which immediately follows the structure. */
+} xSTREAM_BUFFER;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Returns the number of bytes currently held in the stream buffer.
+ */
+static size_t prvBytesInBuffer( const xSTREAM_BUFFER * const pxStreamBuffer ) PRIVILEGED_FUNCTION;
+
+/*
+ * Copies xCount bytes into the stream buffer, wrapping around the end of the
+ * storage area if necessary, then publishes the new head index.  The caller
+ * must have already checked that there is space.
+ */
+static void prvWriteBytes( xSTREAM_BUFFER * const pxStreamBuffer, const unsigned char *pucData, size_t xCount ) PRIVILEGED_FUNCTION;
+
+/*
+ * Copies xCount bytes out of the stream buffer, wrapping around the end of the
+ * storage area if necessary, then publishes the new tail index.  The caller
+ * must have already checked that the bytes are available.
+ */
+static void prvReadBytes( xSTREAM_BUFFER * const pxStreamBuffer, unsigned char *pucData, size_t xCount ) PRIVILEGED_FUNCTION;
+
+/*
+ * Records the calling task in *pxWaitingTask so the other end of the stream
+ * buffer knows to notify it.  Any notification pending for the calling task is
+ * discarded first, as it may have been left by a wake up that arrived after an
+ * earlier wait timed out.  This is why a task that blocks on a stream buffer
+ * cannot also use its notification for another purpose.  Must be called from a
+ * critical section.
+ */
+static void prvPrepareToWait( volatile xTaskHandle *pxWaitingTask ) PRIVILEGED_FUNCTION;
+
+/*
+ * If a task is recorded in *pxWaitingTask then clear the record and notify
+ * the task.  The FromISR version must only be called from an interrupt.
+ */
+static void prvNotifyWaitingTask( volatile xTaskHandle *pxWaitingTask ) PRIVILEGED_FUNCTION;
+static void prvNotifyWaitingTaskFromISR( volatile xTaskHandle *pxWaitingTask, portBASE_TYPE *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
+
+/*-----------------------------------------------------------*/
+
+xStreamBufferHandle xStreamBufferCreate( size_t xBufferSizeBytes, size_t xTriggerLevelBytes )
+{
+xSTREAM_BUFFER *pxStreamBuffer = NULL;
+
+	configASSERT( xBufferSizeBytes > ( size_t ) 0 );
+	configASSERT( xTriggerLevelBytes <= xBufferSizeBytes );
+
+	if( xTriggerLevelBytes == ( size_t ) 0 )
+	{
+		xTriggerLevelBytes = ( size_t ) 1;
+	}
+
+	if( ( xBufferSizeBytes > ( size_t ) 0 ) && ( xTriggerLevelBytes <= xBufferSizeBytes ) )
+	{
+		/* The control structure and the storage area are allocated in one
+		block.  One extra byte is needed to tell a full buffer from an empty
+		one. */
+		pxStreamBuffer = ( xSTREAM_BUFFER * ) pvPortMalloc( sizeof( xSTREAM_BUFFER ) + xBufferSizeBytes + ( size_t ) 1 );
+
+		if( pxStreamBuffer != NULL )
+		{
+			pxStreamBuffer->pucBuffer = ( ( unsigned char * ) pxStreamBuffer ) + sizeof( xSTREAM_BUFFER );
+			pxStreamBuffer->xLength = xBufferSizeBytes + ( size_t ) 1;
+			pxStreamBuffer->xTriggerLevelBytes = xTriggerLevelBytes;
+			pxStreamBuffer->xHead = ( size_t ) 0;
+			pxStreamBuffer->xTail = ( size_t ) 0;
+			pxStreamBuffer->xTaskWaitingToReceive = NULL;
+			pxStreamBuffer->xTaskWaitingToSend = NULL;
+		}
+	}
+
+	return ( xStreamBufferHandle ) pxStreamBuffer;
+}
+/*-----------------------------------------------------------*/
+
+void vStreamBufferDelete( xStreamBufferHandle xStreamBuffer )
+{
+	configASSERT( xStreamBuffer );
+	vPortFree( xStreamBuffer );
+}
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferSend( xStreamBufferHandle xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes, portTickType xTicksToWait )
+{
+xSTREAM_BUFFER * const pxStreamBuffer = ( xSTREAM_BUFFER * ) xStreamBuffer;
+size_t xSpace, xRequiredSpace;
+xTimeOutType xTimeOut;
+
+	configASSERT( pxStreamBuffer );
+	configASSERT( pvTxData );
+
+	/* Never wait for more space than the stream buffer can ever provide. */
+	xRequiredSpace = xDataLengthBytes;
+	if( xRequiredSpace > ( pxStreamBuffer->xLength - ( size_t ) 1 ) )
+	{
+		xRequiredSpace = pxStreamBuffer->xLength - ( size_t ) 1;
+	}
+
+	/* Only the writer can use up space, so if there is already enough there is
+	no need to enter a critical section to prepare to wait. */
+	xSpace = ( pxStreamBuffer->xLength - ( size_t ) 1 ) - prvBytesInBuffer( pxStreamBuffer );
+
+	if( ( xSpace < xRequiredSpace ) && ( xTicksToWait != sbNO_DELAY ) )
+	{
+		vTaskSetTimeOutState( &xTimeOut );
+
+		for( ;; )
+		{
+			taskENTER_CRITICAL();
+			{
+				/* Check again now the reader cannot free space without
+				seeing that this task is waiting. */
+				xSpace = ( pxStreamBuffer->xLength - ( size_t ) 1 ) - prvBytesInBuffer( pxStreamBuffer );
+
+				if( xSpace < xRequiredSpace )
+				{
+					prvPrepareToWait( &( pxStreamBuffer->xTaskWaitingToSend ) );
+				}
+			}
+			taskEXIT_CRITICAL();
+
+			if( xSpace >= xRequiredSpace )
+			{
+				break;
+			}
+
+			( void ) xTaskNotifyWait( 0UL, 0UL, NULL, xTicksToWait );
+			pxStreamBuffer->xTaskWaitingToSend = NULL;
+
+			if( xTaskCheckForTimeOut( &xTimeOut, &xTicksToWait ) != pdFALSE )
+			{
+				break;
+			}
+		}
+	}
+
+	/* Write as much as will fit. */
+	xSpace = ( pxStreamBuffer->xLength - ( size_t ) 1 ) - prvBytesInBuffer( pxStreamBuffer );
+	if( xDataLengthBytes > xSpace )
+	{
+		xDataLengthBytes = xSpace;
+	}
+
+	if( xDataLengthBytes > ( size_t ) 0 )
+	{
+		prvWriteBytes( pxStreamBuffer, ( const unsigned char * ) pvTxData, xDataLengthBytes );
+
+		if( prvBytesInBuffer( pxStreamBuffer ) >= pxStreamBuffer->xTriggerLevelBytes )
+		{
+			prvNotifyWaitingTask( &( pxStreamBuffer->xTaskWaitingToReceive ) );
+		}
+	}
+
+	return xDataLengthBytes;
+}
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferSendFromISR( xStreamBufferHandle xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes, portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+xSTREAM_BUFFER * const pxStreamBuffer = ( xSTREAM_BUFFER * ) xStreamBuffer;
+size_t xSpace;
+
+	configASSERT( pxStreamBuffer );
+	configASSERT( pvTxData );
+
+	xSpace = ( pxStreamBuffer->xLength - ( size_t ) 1 ) - prvBytesInBuffer( pxStreamBuffer );
+	if( xDataLengthBytes > xSpace )
+	{
+		xDataLengthBytes = xSpace;
+	}
+
+	if( xDataLengthBytes > ( size_t ) 0 )
+	{
+		prvWriteBytes( pxStreamBuffer, ( const unsigned char * ) pvTxData, xDataLengthBytes );
+
+		if( prvBytesInBuffer( pxStreamBuffer ) >= pxStreamBuffer->xTriggerLevelBytes )
+		{
+			prvNotifyWaitingTaskFromISR( &( pxStreamBuffer->xTaskWaitingToReceive ), pxHigherPriorityTaskWoken );
+		}
+	}
+
+	return xDataLengthBytes;
+}
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferReceive( xStreamBufferHandle xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, portTickType xTicksToWait )
+{
+xSTREAM_BUFFER * const pxStreamBuffer = ( xSTREAM_BUFFER * ) xStreamBuffer;
+size_t xBytesAvailable;
+
+	configASSERT( pxStreamBuffer );
+	configASSERT( pvRxData );
+
+	/* As above, only enter a critical section if the task might block. */
+	if( ( xTicksToWait != sbNO_DELAY ) && ( prvBytesInBuffer( pxStreamBuffer ) == ( size_t ) 0 ) )
+	{
+		taskENTER_CRITICAL();
+		{
+			xBytesAvailable = prvBytesInBuffer( pxStreamBuffer );
+
+			if( xBytesAvailable == ( size_t ) 0 )
+			{
+				prvPrepareToWait( &( pxStreamBuffer->xTaskWaitingToReceive ) );
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		if( xBytesAvailable == ( size_t ) 0 )
+		{
+			/* The writer only notifies once the trigger level is reached, so
+			a single wait is sufficient. */
+			( void ) xTaskNotifyWait( 0UL, 0UL, NULL, xTicksToWait );
+			pxStreamBuffer->xTaskWaitingToReceive = NULL;
+		}
+	}
+
+	xBytesAvailable = prvBytesInBuffer( pxStreamBuffer );
+	if( xBufferLengthBytes > xBytesAvailable )
+	{
+		xBufferLengthBytes = xBytesAvailable;
+	}
+
+	if( xBufferLengthBytes > ( size_t ) 0 )
+	{
+		prvReadBytes( pxStreamBuffer, ( unsigned char * ) pvRxData, xBufferLengthBytes );
+		prvNotifyWaitingTask( &( pxStreamBuffer->xTaskWaitingToSend ) );
+	}
+
+	return xBufferLengthBytes;
+}
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferReceiveFromISR( xStreamBufferHandle xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes, portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+xSTREAM_BUFFER * const pxStreamBuffer = ( xSTREAM_BUFFER * ) xStreamBuffer;
+size_t xBytesAvailable;
+
+	configASSERT( pxStreamBuffer );
+	configASSERT( pvRxData );
+
+	xBytesAvailable = prvBytesInBuffer( pxStreamBuffer );
+	if( xBufferLengthBytes > xBytesAvailable )
+	{
+		xBufferLengthBytes = xBytesAvailable;
+	}
+
+	if( xBufferLengthBytes > ( size_t ) 0 )
+	{
+		prvReadBytes( pxStreamBuffer, ( unsigned char * ) pvRxData, xBufferLengthBytes );
+		prvNotifyWaitingTaskFromISR( &( pxStreamBuffer->xTaskWaitingToSend ), pxHigherPriorityTaskWoken );
+	}
+
+	return xBufferLengthBytes;
+}
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferBytesAvailable( xStreamBufferHandle xStreamBuffer )
+{
+	configASSERT( xStreamBuffer );
+	return prvBytesInBuffer( ( xSTREAM_BUFFER * ) xStreamBuffer );
+}
+/*-----------------------------------------------------------*/
+
+size_t xStreamBufferSpacesAvailable( xStreamBufferHandle xStreamBuffer )
+{
+const xSTREAM_BUFFER * const pxStreamBuffer = ( xSTREAM_BUFFER * ) xStreamBuffer;
+
+	configASSERT( pxStreamBuffer );
+	return ( pxStreamBuffer->xLength - ( size_t ) 1 ) - prvBytesInBuffer( pxStreamBuffer );
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xStreamBufferSetTriggerLevel( xStreamBufferHandle xStreamBuffer, size_t xTriggerLevel )
+{
+xSTREAM_BUFFER * const pxStreamBuffer = ( xSTREAM_BUFFER * ) xStreamBuffer;
+portBASE_TYPE xReturn = pdFAIL;
+
+	configASSERT( pxStreamBuffer );
+
+	if( xTriggerLevel == ( size_t ) 0 )
+	{
+		xTriggerLevel = ( size_t ) 1;
+	}
+
+	if( xTriggerLevel < pxStreamBuffer->xLength )
+	{
+		pxStreamBuffer->xTriggerLevelBytes = xTriggerLevel;
+		xReturn = pdPASS;
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xStreamBufferReset( xStreamBufferHandle xStreamBuffer )
+{
+xSTREAM_BUFFER * const pxStreamBuffer = ( xSTREAM_BUFFER * ) xStreamBuffer;
+portBASE_TYPE xReturn = pdFAIL;
+
+	configASSERT( pxStreamBuffer );
+
+	taskENTER_CRITICAL();
+	{
+		/* Resetting while a task is blocked would leave that task waiting on
+		an event that can never be delivered. */
+		if( ( pxStreamBuffer->xTaskWaitingToReceive == NULL ) && ( pxStreamBuffer->xTaskWaitingToSend == NULL ) )
+		{
+			pxStreamBuffer->xHead = ( size_t ) 0;
+			pxStreamBuffer->xTail = ( size_t ) 0;
+			xReturn = pdPASS;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvBytesInBuffer( const xSTREAM_BUFFER * const pxStreamBuffer )
+{
+size_t xCount;
+
+	/* The head and tail may be updated by the other end at any time, so each
+	is read exactly once. */
+	xCount = pxStreamBuffer->xLength + pxStreamBuffer->xHead;
+	xCount -= pxStreamBuffer->xTail;
+
+	if( xCount >= pxStreamBuffer->xLength )
+	{
+		xCount -= pxStreamBuffer->xLength;
+	}
+
+	return xCount;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriteBytes( xSTREAM_BUFFER * const pxStreamBuffer, const unsigned char *pucData, size_t xCount )
+{
+size_t xHead, xFirstLength;
+
+	xHead = pxStreamBuffer->xHead;
+
+	/* Copy as much as possible up to the end of the storage area, then the
+	remainder (if any) to the start. */
+	xFirstLength = pxStreamBuffer->xLength - xHead;
+	if( xFirstLength > xCount )
+	{
+		xFirstLength = xCount;
+	}
+	memcpy( ( void * ) &( pxStreamBuffer->pucBuffer[ xHead ] ), ( const void * ) pucData, xFirstLength );
+
+	if( xCount > xFirstLength )
+	{
+		memcpy( ( void * ) pxStreamBuffer->pucBuffer, ( const void * ) &( pucData[ xFirstLength ] ), xCount - xFirstLength );
+	}
+
+	xHead += xCount;
+	if( xHead >= pxStreamBuffer->xLength )
+	{
+		xHead -= pxStreamBuffer->xLength;
+	}
+
+	/* Only now make the data visible to the reader. */
+	pxStreamBuffer->xHead = xHead;
+}
+/*-----------------------------------------------------------*/
+
+static void prvReadBytes( xSTREAM_BUFFER * const pxStreamBuffer, unsigned char *pucData, size_t xCount )
+{
+size_t xTail, xFirstLength;
+
+	xTail = pxStreamBuffer->xTail;
+
+	xFirstLength = pxStreamBuffer->xLength - xTail;
+	if( xFirstLength > xCount )
+	{
+		xFirstLength = xCount;
+	}
+	memcpy( ( void * ) pucData, ( const void * ) &( pxStreamBuffer->pucBuffer[ xTail ] ), xFirstLength );
+
+	if( xCount > xFirstLength )
+	{
+		memcpy( ( void * ) &( pucData[ xFirstLength ] ), ( const void * ) pxStreamBuffer->pucBuffer, xCount - xFirstLength );
+	}
+
+	xTail += xCount;
+	if( xTail >= pxStreamBuffer->xLength )
+	{
+		xTail -= pxStreamBuffer->xLength;
+	}
+
+	/* Only now release the space to the writer. */
+	pxStreamBuffer->xTail = xTail;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPrepareToWait( volatile xTaskHandle *pxWaitingTask )
+{
+	/* Clear any notification left over from an earlier wake up so the
+	following wait does not return immediately.  Passing a block time of zero
+	means this call never blocks. */
+	( void ) xTaskNotifyWait( 0UL, 0UL, NULL, sbNO_DELAY );
+
+	/* Only one task can wait on each end of a stream buffer. */
+	configASSERT( *pxWaitingTask == NULL );
+	*pxWaitingTask = xTaskGetCurrentTaskHandle();
+}
+/*-----------------------------------------------------------*/
+
+static void prvNotifyWaitingTask( volatile xTaskHandle *pxWaitingTask )
+{
+	/* The other end records itself from within a critical section after
+	checking the head and tail, so if no task is recorded now it will see the
+	bytes just moved and not block.  Most calls therefore avoid the critical
+	section. */
+	if( *pxWaitingTask != NULL )
+	{
+		taskENTER_CRITICAL();
+		{
+			if( *pxWaitingTask != NULL )
+			{
+				( void ) xTaskNotify( *pxWaitingTask, 0UL, eNoAction );
+				*pxWaitingTask = NULL;
+			}
+		}
+		taskEXIT_CRITICAL();
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvNotifyWaitingTaskFromISR( volatile xTaskHandle *pxWaitingTask, portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+xTaskHandle xTaskToNotify;
+
+	/* The waiting task only updates *pxWaitingTask from within a critical
+	section, which this interrupt cannot preempt, so no masking is needed
+	here.  Masking here would also be wrong as xTaskNotifyFromISR() masks
+	interrupts itself and the mask does not nest on all ports. */
+	xTaskToNotify = *pxWaitingTask;
+
+	if( xTaskToNotify != NULL )
+	{
+		*pxWaitingTask = NULL;
+		( void ) xTaskNotifyFromISR( xTaskToNotify, 0UL, eNoAction, pxHigherPriorityTaskWoken );
+	}
+}
+/*-----------------------------------------------------------*/
+
+/* This entire source file will be skipped if the application is not configured
+to include task notifications.  This #if is closed at the very bottom of this
+file. */
+#endif /* configUSE_TASK_NOTIFICATIONS == 1 */
+
@@ -129,6 +129,11 @@ typedef struct tskTaskControlBlock
 		unsigned long ulRunTimeCounter;		/*< Used for calculating how much CPU time each task is utilising. */
 	#endif
 
+	#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+		volatile unsigned long ulNotifiedValue;		/*< The value sent to the task by xTaskNotify() and friends. */
+		volatile unsigned char ucNotifyState;		/*< One of the tskNOT_WAITING_NOTIFICATION, tskWAITING_NOTIFICATION or tskNOTIFICATION_RECEIVED values. */
+	#endif
+
 } tskTCB;
 
 
@@ -208,6 +213,13 @@ PRIVILEGED_DATA static portTickType xNextTaskUnblockTime						= ( portTickType )
 #define tskDELETED_CHAR		( ( signed char ) 'D' )
 #define tskSUSPENDED_CHAR	( ( signed char ) 'S' )
 
+/*
+ * Values that can be assigned to the ucNotifyState member of the TCB.
+ */
+#define tskNOT_WAITING_NOTIFICATION	( ( unsigned char ) 0 )
+#define tskWAITING_NOTIFICATION		( ( unsigned char ) 1 )
+#define tskNOTIFICATION_RECEIVED	( ( unsigned char ) 2 )
+
 /*-----------------------------------------------------------*/
 
 /*
@@ -358,6 +370,29 @@ static void prvAddCurrentTaskToDelayedList( portTickType xTimeToWake ) PRIVILEGE
  */
 static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TYPE *puxStackBuffer ) PRIVILEGED_FUNCTION;
 
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	/*
+	 * Moves the calling task out of the ready list to wait for a notification
+	 * for up to xTicksToWait ticks.  Must be called from a critical section.
+	 */
+	static void prvAddCurrentTaskToNotifyWait( portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
+	/*
+	 * Readies a task that was blocked waiting for a notification.  Must be
+	 * called from a critical section or with interrupts masked.
+	 */
+	static void prvReadyNotifiedTask( tskTCB *pxTCB ) PRIVILEGED_FUNCTION;
+
+	/*
+	 * Applies eAction to the notification value of pxTCB.  Returns pdFAIL only
+	 * if eAction is eSetValueWithoutOverwrite and the previous value has not
+	 * yet been read.  Must be called from a critical section.
+	 */
+	static portBASE_TYPE prvUpdateNotifiedValue( tskTCB *pxTCB, unsigned long ulValue, eNotifyAction eAction, unsigned char ucOriginalNotifyState ) PRIVILEGED_FUNCTION;
+
+#endif
+
 /*
  * Called from vTaskList.  vListTasks details all the tasks currently under
  * control of the scheduler.  The tasks may be in one of a number of lists.
@@ -893,6 +928,18 @@ tskTCB * pxNewTCB;
 			}
 
 			vListInsertEnd( ( xList * ) &xSuspendedTaskList, &( pxTCB->xGenericListItem ) );
+
+			#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+			{
+				/* A task that was waiting for a notification is now
+				suspended, so a notification must not move it back to the
+				ready list. */
+				if( pxTCB->ucNotifyState == tskWAITING_NOTIFICATION )
+				{
+					pxTCB->ucNotifyState = tskNOT_WAITING_NOTIFICATION;
+				}
+			}
+			#endif
 		}
 		taskEXIT_CRITICAL();
 
@@ -951,6 +998,17 @@ tskTCB * pxNewTCB;
 				if( listIS_CONTAINED_WITHIN( NULL, &( pxTCB->xEventListItem ) ) == pdTRUE )
 				{
 					xReturn = pdTRUE;
+
+					#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+					{
+						/* Likewise a task blocked indefinitely waiting for a
+						notification is not in the Suspended state. */
+						if( pxTCB->ucNotifyState == tskWAITING_NOTIFICATION )
+						{
+							xReturn = pdFALSE;
+						}
+					}
+					#endif
 				}
 			}
 		}
@@ -2002,6 +2060,13 @@ static void prvInitialiseTCBVariables( tskTCB *pxTCB, const signed char * const
 	}
 	#endif
 
+	#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+	{
+		pxTCB->ulNotifiedValue = 0UL;
+		pxTCB->ucNotifyState = tskNOT_WAITING_NOTIFICATION;
+	}
+	#endif
+
 	#if ( portUSING_MPU_WRAPPERS == 1 )
 	{
 		vPortStoreTaskMPUSettings( &( pxTCB->xMPUSettings ), xRegions, pxTCB->pxStack, usStackDepth );
@@ -2475,6 +2540,320 @@ void vTaskExitCritical( void )
 #endif
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	static void prvAddCurrentTaskToNotifyWait( portTickType xTicksToWait )
+	{
+		/* We must remove ourselves from the ready list before adding
+		ourselves to the blocked list as the same list item is used for
+		both lists.  The event list item is not used as there is no event
+		list to wait on - the notification is sent directly to this TCB. */
+		vListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+
+		#if ( INCLUDE_vTaskSuspend == 1 )
+		{
+			if( xTicksToWait == portMAX_DELAY )
+			{
+				/* Block indefinitely.  xTaskIsTaskSuspended() knows not to
+				report a task in this state as suspended. */
+				vListInsertEnd( ( xList * ) &xSuspendedTaskList, ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+			}
+			else
+			{
+				prvAddCurrentTaskToDelayedList( xTickCount + xTicksToWait );
+			}
+		}
+		#else
+		{
+			prvAddCurrentTaskToDelayedList( xTickCount + xTicksToWait );
+		}
+		#endif
+	}
+
+#endif /* configUSE_TASK_NOTIFICATIONS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
 
+	static void prvReadyNotifiedTask( tskTCB *pxTCB )
+	{
+		/* A task waiting for a notification is never in an event list. */
+		configASSERT( listIS_CONTAINED_WITHIN( NULL, &( pxTCB->xEventListItem ) ) );
 
+		if( uxSchedulerSuspended == ( unsigned portBASE_TYPE ) pdFALSE )
+		{
+			vListRemove( &( pxTCB->xGenericListItem ) );
+			prvAddTaskToReadyQueue( pxTCB );
+		}
+		else
+		{
+			/* The delayed and ready lists cannot be accessed, so hold the
+			task pending until the scheduler is resumed. */
+			vListInsertEnd( ( xList * ) &( xPendingReadyList ), &( pxTCB->xEventListItem ) );
+		}
+	}
+
+#endif /* configUSE_TASK_NOTIFICATIONS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	unsigned long ulTaskNotifyTake( portBASE_TYPE xClearCountOnExit, portTickType xTicksToWait )
+	{
+	unsigned long ulReturn;
+
+		taskENTER_CRITICAL();
+		{
+			/* Only block if the notification count is not already non-zero. */
+			if( pxCurrentTCB->ulNotifiedValue == 0UL )
+			{
+				/* Mark this task as waiting for a notification. */
+				pxCurrentTCB->ucNotifyState = tskWAITING_NOTIFICATION;
+
+				if( xTicksToWait > ( portTickType ) 0U )
+				{
+					traceTASK_NOTIFY_TAKE_BLOCK();
+					prvAddCurrentTaskToNotifyWait( xTicksToWait );
+
+					/* The yield will not be performed until the critical
+					section is exited. */
+					portYIELD_WITHIN_API();
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		taskENTER_CRITICAL();
+		{
+			traceTASK_NOTIFY_TAKE();
+			ulReturn = pxCurrentTCB->ulNotifiedValue;
+
+			if( ulReturn != 0UL )
+			{
+				if( xClearCountOnExit != pdFALSE )
+				{
+					pxCurrentTCB->ulNotifiedValue = 0UL;
+				}
+				else
+				{
+					( pxCurrentTCB->ulNotifiedValue )--;
+				}
+			}
+
+			pxCurrentTCB->ucNotifyState = tskNOT_WAITING_NOTIFICATION;
+		}
+		taskEXIT_CRITICAL();
+
+		return ulReturn;
+	}
+
+#endif /* configUSE_TASK_NOTIFICATIONS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	portBASE_TYPE xTaskNotifyWait( unsigned long ulBitsToClearOnEntry, unsigned long ulBitsToClearOnExit, unsigned long *pulNotificationValue, portTickType xTicksToWait )
+	{
+	portBASE_TYPE xReturn;
+
+		taskENTER_CRITICAL();
+		{
+			/* Only block if a notification is not already pending. */
+			if( pxCurrentTCB->ucNotifyState != tskNOTIFICATION_RECEIVED )
+			{
+				/* Clear bits in the task's notification value as bits may get
+				set by the notifying task or interrupt.  This can be used to
+				clear the value to zero. */
+				pxCurrentTCB->ulNotifiedValue &= ~ulBitsToClearOnEntry;
+
+				/* Mark this task as waiting for a notification. */
+				pxCurrentTCB->ucNotifyState = tskWAITING_NOTIFICATION;
+
+				if( xTicksToWait > ( portTickType ) 0U )
+				{
+					traceTASK_NOTIFY_WAIT_BLOCK();
+					prvAddCurrentTaskToNotifyWait( xTicksToWait );
 
+					/* The yield will not be performed until the critical
+					section is exited. */
+					portYIELD_WITHIN_API();
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		taskENTER_CRITICAL();
+		{
+			traceTASK_NOTIFY_WAIT();
+
+			if( pulNotificationValue != NULL )
+			{
+				/* Output the current notification value, which may or may not
+				have changed. */
+				*pulNotificationValue = pxCurrentTCB->ulNotifiedValue;
+			}
+
+			/* If ucNotifyState is still tskWAITING_NOTIFICATION then either
+			the task never blocked (xTicksToWait was zero) or it was unblocked
+			because its block time expired. */
+			if( pxCurrentTCB->ucNotifyState == tskWAITING_NOTIFICATION )
+			{
+				/* A notification was not received. */
+				xReturn = pdFALSE;
+			}
+			else
+			{
+				/* A notification was already pending or a notification was
+				received while the task was waiting. */
+				pxCurrentTCB->ulNotifiedValue &= ~ulBitsToClearOnExit;
+				xReturn = pdTRUE;
+			}
+
+			pxCurrentTCB->ucNotifyState = tskNOT_WAITING_NOTIFICATION;
+		}
+		taskEXIT_CRITICAL();
+
+		return xReturn;
+	}
+
+#endif /* configUSE_TASK_NOTIFICATIONS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	static portBASE_TYPE prvUpdateNotifiedValue( tskTCB *pxTCB, unsigned long ulValue, eNotifyAction eAction, unsigned char ucOriginalNotifyState )
+	{
+	portBASE_TYPE xReturn = pdPASS;
+
+		switch( eAction )
+		{
+			case eSetBits	:
+				pxTCB->ulNotifiedValue |= ulValue;
+				break;
+
+			case eIncrement	:
+				( pxTCB->ulNotifiedValue )++;
+				break;
+
+			case eSetValueWithOverwrite	:
+				pxTCB->ulNotifiedValue = ulValue;
+				break;
+
+			case eSetValueWithoutOverwrite :
+				if( ucOriginalNotifyState != tskNOTIFICATION_RECEIVED )
+				{
+					pxTCB->ulNotifiedValue = ulValue;
+				}
+				else
+				{
+					/* The value could not be written to the task. */
+					xReturn = pdFAIL;
+				}
+				break;
+
+			case eNoAction :
+			default :
+				/* The task is being notified without its notify value being
+				updated. */
+				break;
+		}
+
+		return xReturn;
+	}
+
+#endif /* configUSE_TASK_NOTIFICATIONS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	portBASE_TYPE xTaskNotify( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction )
+	{
+	tskTCB *pxTCB;
+	portBASE_TYPE xReturn;
+	unsigned char ucOriginalNotifyState;
+
+		configASSERT( xTaskToNotify );
+		pxTCB = ( tskTCB * ) xTaskToNotify;
+
+		taskENTER_CRITICAL();
+		{
+			ucOriginalNotifyState = pxTCB->ucNotifyState;
+			pxTCB->ucNotifyState = tskNOTIFICATION_RECEIVED;
+
+			xReturn = prvUpdateNotifiedValue( pxTCB, ulValue, eAction, ucOriginalNotifyState );
+
+			traceTASK_NOTIFY( pxTCB );
+
+			/* If the task is in the blocked state specifically to wait for a
+			notification then unblock it now. */
+			if( ucOriginalNotifyState == tskWAITING_NOTIFICATION )
+			{
+				prvReadyNotifiedTask( pxTCB );
+
+				if( pxTCB->uxPriority > pxCurrentTCB->uxPriority )
+				{
+					/* The notified task has a priority above the currently
+					executing task so a yield is required. */
+					portYIELD_WITHIN_API();
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		return xReturn;
+	}
+
+#endif /* configUSE_TASK_NOTIFICATIONS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	portBASE_TYPE xTaskNotifyFromISR( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, portBASE_TYPE *pxHigherPriorityTaskWoken )
+	{
+	tskTCB *pxTCB;
+	portBASE_TYPE xReturn;
+	unsigned char ucOriginalNotifyState;
+	unsigned portBASE_TYPE uxSavedInterruptStatus;
+
+		configASSERT( xTaskToNotify );
+		pxTCB = ( tskTCB * ) xTaskToNotify;
+
+		uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+		{
+			ucOriginalNotifyState = pxTCB->ucNotifyState;
+			pxTCB->ucNotifyState = tskNOTIFICATION_RECEIVED;
+
+			xReturn = prvUpdateNotifiedValue( pxTCB, ulValue, eAction, ucOriginalNotifyState );
+
+			traceTASK_NOTIFY_FROM_ISR( pxTCB );
+
+			if( ucOriginalNotifyState == tskWAITING_NOTIFICATION )
+			{
+				prvReadyNotifiedTask( pxTCB );
+
+				if( ( pxTCB->uxPriority > pxCurrentTCB->uxPriority ) && ( pxHigherPriorityTaskWoken != NULL ) )
+				{
+					/* The notified task has a priority above the currently
+					executing task so a context switch should be requested on
+					exit from the interrupt. */
+					*pxHigherPriorityTaskWoken = pdTRUE;
+				}
+			}
+		}
+		portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedInterruptStatus );
+
+		return xReturn;
+	}
+
+#endif /* configUSE_TASK_NOTIFICATIONS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	void vTaskNotifyGiveFromISR( xTaskHandle xTaskToNotify, portBASE_TYPE *pxHigherPriorityTaskWoken )
+	{
+		( void ) xTaskNotifyFromISR( xTaskToNotify, 0UL, eIncrement, pxHigherPriorityTaskWoken );
+	}
+
+#endif /* configUSE_TASK_NOTIFICATIONS */
+/*-----------------------------------------------------------*/
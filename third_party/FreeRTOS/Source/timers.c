@@ -117,12 +117,27 @@ PRIVILEGED_DATA static xList *pxOverflowTimerList;
 /* A queue that is used to send commands to the timer service task. */
 PRIVILEGED_DATA static xQueueHandle xTimerQueue = NULL;
 
-#if ( INCLUDE_xTimerGetTimerDaemonTaskHandle == 1 )
+#if ( ( INCLUDE_xTimerGetTimerDaemonTaskHandle == 1 ) || ( configUSE_TIMER_BATCH_EXPIRY == 1 ) )
 	
 	PRIVILEGED_DATA static xTaskHandle xTimerTaskHandle = NULL;
 	
 #endif
 
+#if ( configUSE_TIMER_BATCH_EXPIRY == 1 )
+
+	#if ( INCLUDE_xTaskGetCurrentTaskHandle == 0 ) && ( configUSE_MUTEXES == 0 )
+		#error configUSE_TIMER_BATCH_EXPIRY requires INCLUDE_xTaskGetCurrentTaskHandle or configUSE_MUTEXES to be set to 1 in FreeRTOSConfig.h.
+	#endif
+
+	/* Set while the timer service task is calling the callbacks of expired
+	timers, at which time commands issued by those callbacks are applied
+	directly to the active timer lists.  xExpiryTimeNow holds the time at which
+	the expired timers were sampled. */
+	PRIVILEGED_DATA static portBASE_TYPE xCallingExpiredTimers = pdFALSE;
+	PRIVILEGED_DATA static portTickType xExpiryTimeNow = ( portTickType ) 0U;
+
+#endif
+
 /*-----------------------------------------------------------*/
 
 /*
@@ -144,17 +159,45 @@ static void prvTimerTask( void *pvParameters ) PRIVILEGED_FUNCTION;
  */
 static void	prvProcessReceivedCommands( void ) PRIVILEGED_FUNCTION;
 
+/*
+ * Apply a single command to a timer.  Called by prvProcessReceivedCommands(),
+ * and directly by xTimerGenericCommand() for commands issued from a timer
+ * callback when configUSE_TIMER_BATCH_EXPIRY is 1.
+ */
+static void prvProcessCommand( const xTIMER_MESSAGE *pxMessage, portTickType xTimeNow ) PRIVILEGED_FUNCTION;
+
 /*
  * Insert the timer into either xActiveTimerList1, or xActiveTimerList2,
  * depending on if the expire time causes a timer counter overflow.
  */
 static portBASE_TYPE prvInsertTimerInActiveList( xTIMER *pxTimer, portTickType xNextExpiryTime, portTickType xTimeNow, portTickType xCommandTime ) PRIVILEGED_FUNCTION;
 
-/*
- * An active timer has reached its expire time.  Reload the timer if it is an
- * auto reload timer, then call its callback.
- */
-static void prvProcessExpiredTimer( portTickType xNextExpireTime, portTickType xTimeNow ) PRIVILEGED_FUNCTION;
+#if ( configUSE_TIMER_BATCH_EXPIRY == 0 )
+
+	/*
+	 * An active timer has reached its expire time.  Reload the timer if it is
+	 * an auto reload timer, then call its callback.
+	 */
+	static void prvProcessExpiredTimer( portTickType xNextExpireTime, portTickType xTimeNow ) PRIVILEGED_FUNCTION;
+
+#else
+
+	/*
+	 * Process every timer in the current timer list that has expired by
+	 * xTimeNow in a single pass, reloading auto reload timers without using
+	 * the timer command queue.
+	 */
+	static void prvProcessExpiredTimers( portTickType xTimeNow ) PRIVILEGED_FUNCTION;
+
+	/*
+	 * Reload an auto reload timer that expired at xExpiredTime.  If the next
+	 * expiry time has also passed the timer is placed at the front of the
+	 * current timer list, so prvProcessExpiredTimers() processes it again,
+	 * rather than being restarted through the timer command queue.
+	 */
+	static void prvReloadTimer( xTIMER *pxTimer, portTickType xExpiredTime, portTickType xTimeNow ) PRIVILEGED_FUNCTION;
+
+#endif
 
 /*
  * The tick count has overflowed.  Switch the timer lists after ensuring the
@@ -196,10 +239,11 @@ portBASE_TYPE xReturn = pdFAIL;
 
 	if( xTimerQueue != NULL )
 	{
-		#if ( INCLUDE_xTimerGetTimerDaemonTaskHandle == 1 )
+		#if ( ( INCLUDE_xTimerGetTimerDaemonTaskHandle == 1 ) || ( configUSE_TIMER_BATCH_EXPIRY == 1 ) )
 		{
 			/* Create the timer task, storing its handle in xTimerTaskHandle so
-			it can be returned by the xTimerGetTimerDaemonTaskHandle() function. */
+			it can be returned by the xTimerGetTimerDaemonTaskHandle() function,
+			and so commands issued from timer callbacks can be recognised. */
 			xReturn = xTaskCreate( prvTimerTask, ( const signed char * ) "Tmr Svc", ( unsigned short ) configTIMER_TASK_STACK_DEPTH, NULL, ( unsigned portBASE_TYPE ) configTIMER_TASK_PRIORITY, &xTimerTaskHandle );	
 		}
 		#else
@@ -268,6 +312,30 @@ xTIMER_MESSAGE xMessage;
 		xMessage.xMessageValue = xOptionalValue;
 		xMessage.pxTimer = ( xTIMER * ) xTimer;
 
+		#if ( configUSE_TIMER_BATCH_EXPIRY == 1 )
+		{
+			/* A command issued by a timer callback executes in the context of
+			the timer service task, which owns the active timer lists, so can
+			be applied without a round trip through the timer command queue.
+			Deleting a timer is still deferred as the callback may be deleting
+			its own timer. */
+			if( ( xCallingExpiredTimers != pdFALSE ) && ( pxHigherPriorityTaskWoken == NULL ) && ( xCommandID != tmrCOMMAND_DELETE ) && ( xTaskGetCurrentTaskHandle() == xTimerTaskHandle ) )
+			{
+				if( xCommandID == tmrCOMMAND_START )
+				{
+					/* Restart relative to the time the expired timers were
+					sampled, which is the time the active timer lists are
+					consistent with. */
+					xMessage.xMessageValue = xExpiryTimeNow;
+				}
+
+				traceTIMER_COMMAND_SEND( xTimer, xCommandID, xOptionalValue, pdPASS );
+				prvProcessCommand( &xMessage, xExpiryTimeNow );
+				return pdPASS;
+			}
+		}
+		#endif
+
 		if( pxHigherPriorityTaskWoken == NULL )
 		{
 			if( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING )
@@ -304,40 +372,118 @@ xTIMER_MESSAGE xMessage;
 #endif
 /*-----------------------------------------------------------*/
 
-static void prvProcessExpiredTimer( portTickType xNextExpireTime, portTickType xTimeNow )
-{
-xTIMER *pxTimer;
-portBASE_TYPE xResult;
+#if ( configUSE_TIMER_BATCH_EXPIRY == 0 )
+
+	static void prvProcessExpiredTimer( portTickType xNextExpireTime, portTickType xTimeNow )
+	{
+	xTIMER *pxTimer;
+	portBASE_TYPE xResult;
+
+		/* Remove the timer from the list of active timers.  A check has already
+		been performed to ensure the list is not empty. */
+		pxTimer = ( xTIMER * ) listGET_OWNER_OF_HEAD_ENTRY( pxCurrentTimerList );
+		vListRemove( &( pxTimer->xTimerListItem ) );
+		traceTIMER_EXPIRED( pxTimer );
+
+		/* If the timer is an auto reload timer then calculate the next
+		expiry time and re-insert the timer in the list of active timers. */
+		if( pxTimer->uxAutoReload == ( unsigned portBASE_TYPE ) pdTRUE )
+		{
+			/* This is the only time a timer is inserted into a list using
+			a time relative to anything other than the current time.  It
+			will therefore be inserted into the correct list relative to
+			the time this task thinks it is now, even if a command to
+			switch lists due to a tick count overflow is already waiting in
+			the timer queue. */
+			if( prvInsertTimerInActiveList( pxTimer, ( xNextExpireTime + pxTimer->xTimerPeriodInTicks ), xTimeNow, xNextExpireTime ) == pdTRUE )
+			{
+				/* The timer expired before it was added to the active timer
+				list.  Reload it now.  */
+				xResult = xTimerGenericCommand( pxTimer, tmrCOMMAND_START, xNextExpireTime, NULL, tmrNO_DELAY );
+				configASSERT( xResult );
+				( void ) xResult;
+			}
+		}
+
+		/* Call the timer callback. */
+		pxTimer->pxCallbackFunction( ( xTimerHandle ) pxTimer );
+	}
+
+#endif /* configUSE_TIMER_BATCH_EXPIRY */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TIMER_BATCH_EXPIRY == 1 )
+
+	static void prvProcessExpiredTimers( portTickType xTimeNow )
+	{
+	xTIMER *pxTimer;
+	portTickType xNextExpireTime;
+
+		xExpiryTimeNow = xTimeNow;
+		xCallingExpiredTimers = pdTRUE;
+
+		/* Timers are held in expiry time order, so keep taking timers from
+		the head of the current list until one is found that has not yet
+		expired.  The lists cannot be switched in the mean time as only this
+		task samples the time. */
+		while( listLIST_IS_EMPTY( pxCurrentTimerList ) == pdFALSE )
+		{
+			xNextExpireTime = listGET_ITEM_VALUE_OF_HEAD_ENTRY( pxCurrentTimerList );
+			if( xNextExpireTime > xTimeNow )
+			{
+				break;
+			}
 
-	/* Remove the timer from the list of active timers.  A check has already
-	been performed to ensure the list is not empty. */
-	pxTimer = ( xTIMER * ) listGET_OWNER_OF_HEAD_ENTRY( pxCurrentTimerList );
-	vListRemove( &( pxTimer->xTimerListItem ) );
-	traceTIMER_EXPIRED( pxTimer );
+			pxTimer = ( xTIMER * ) listGET_OWNER_OF_HEAD_ENTRY( pxCurrentTimerList );
+			vListRemove( &( pxTimer->xTimerListItem ) );
+			traceTIMER_EXPIRED( pxTimer );
 
-	/* If the timer is an auto reload timer then calculate the next
-	expiry time and re-insert the timer in the list of active timers. */
-	if( pxTimer->uxAutoReload == ( unsigned portBASE_TYPE ) pdTRUE )
+			if( pxTimer->uxAutoReload == ( unsigned portBASE_TYPE ) pdTRUE )
+			{
+				prvReloadTimer( pxTimer, xNextExpireTime, xTimeNow );
+			}
+
+			/* Call the timer callback.  The timer has already been reloaded,
+			so the callback can restart, stop or change the period of its own
+			timer. */
+			pxTimer->pxCallbackFunction( ( xTimerHandle ) pxTimer );
+		}
+
+		xCallingExpiredTimers = pdFALSE;
+	}
+
+#endif /* configUSE_TIMER_BATCH_EXPIRY */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TIMER_BATCH_EXPIRY == 1 )
+
+	static void prvReloadTimer( xTIMER *pxTimer, portTickType xExpiredTime, portTickType xTimeNow )
 	{
-		/* This is the only time a timer is inserted into a list using
-		a time relative to anything other than the current time.  It
-		will therefore be inserted into the correct list relative to
-		the time this task thinks it is now, even if a command to
-		switch lists due to a tick count overflow is already waiting in
-		the timer queue. */
-		if( prvInsertTimerInActiveList( pxTimer, ( xNextExpireTime + pxTimer->xTimerPeriodInTicks ), xTimeNow, xNextExpireTime ) == pdTRUE )
+	portTickType xReloadTime;
+	portBASE_TYPE xResult;
+
+		xReloadTime = xExpiredTime + pxTimer->xTimerPeriodInTicks;
+
+		if( ( xReloadTime > xExpiredTime ) && ( xReloadTime <= xTimeNow ) )
+		{
+			/* A whole period has been missed.  Put the timer back in the
+			current list so it expires again in the current pass. */
+			listSET_LIST_ITEM_VALUE( &( pxTimer->xTimerListItem ), xReloadTime );
+			listSET_LIST_ITEM_OWNER( &( pxTimer->xTimerListItem ), pxTimer );
+			vListInsert( pxCurrentTimerList, &( pxTimer->xTimerListItem ) );
+		}
+		else if( prvInsertTimerInActiveList( pxTimer, xReloadTime, xTimeNow, xExpiredTime ) == pdTRUE )
 		{
-			/* The timer expired before it was added to the active timer
-			list.  Reload it now.  */
-			xResult = xTimerGenericCommand( pxTimer, tmrCOMMAND_START, xNextExpireTime, NULL, tmrNO_DELAY );
+			/* Only possible if the tick count overflowed after xExpiredTime,
+			in which case the command queue is still used so the timer is only
+			inserted once the lists have been switched. */
+			xResult = xTimerGenericCommand( pxTimer, tmrCOMMAND_START, xExpiredTime, NULL, tmrNO_DELAY );
 			configASSERT( xResult );
 			( void ) xResult;
 		}
 	}
 
-	/* Call the timer callback. */
-	pxTimer->pxCallbackFunction( ( xTimerHandle ) pxTimer );
-}
+#endif /* configUSE_TIMER_BATCH_EXPIRY */
 /*-----------------------------------------------------------*/
 
 static void prvTimerTask( void *pvParameters )
@@ -383,7 +529,18 @@ portBASE_TYPE xTimerListsWereSwitched;
 			if( ( xListWasEmpty == pdFALSE ) && ( xNextExpireTime <= xTimeNow ) )
 			{
 				xTaskResumeAll();
-				prvProcessExpiredTimer( xNextExpireTime, xTimeNow );
+
+				#if ( configUSE_TIMER_BATCH_EXPIRY == 1 )
+				{
+					/* Process all the timers that expired by xTimeNow in one
+					pass, rather than one per iteration of the timer task. */
+					prvProcessExpiredTimers( xTimeNow );
+				}
+				#else
+				{
+					prvProcessExpiredTimer( xNextExpireTime, xTimeNow );
+				}
+				#endif
 			}
 			else
 			{
@@ -506,72 +663,95 @@ portBASE_TYPE xProcessTimerNow = pdFALSE;
 static void	prvProcessReceivedCommands( void )
 {
 xTIMER_MESSAGE xMessage;
-xTIMER *pxTimer;
-portBASE_TYPE xTimerListsWereSwitched, xResult;
+portBASE_TYPE xTimerListsWereSwitched;
 portTickType xTimeNow;
 
-	/* In this case the xTimerListsWereSwitched parameter is not used, but it
-	must be present in the function call. */
-	xTimeNow = prvSampleTimeNow( &xTimerListsWereSwitched );
-
 	while( xQueueReceive( xTimerQueue, &xMessage, tmrNO_DELAY ) != pdFAIL )
 	{
-		pxTimer = xMessage.pxTimer;
+		/* The time is sampled after each command is received, as a command
+		sent while this task was preempted part way through emptying the
+		queue would otherwise carry a time later than xTimeNow, and be
+		mistaken for a command issued before a tick count overflow.  In this
+		case the xTimerListsWereSwitched parameter is not used, but it must be
+		present in the function call. */
+		xTimeNow = prvSampleTimeNow( &xTimerListsWereSwitched );
+		prvProcessCommand( &xMessage, xTimeNow );
+	}
+}
+/*-----------------------------------------------------------*/
 
-		/* Is the timer already in a list of active timers?  When the command
-		is trmCOMMAND_PROCESS_TIMER_OVERFLOW, the timer will be NULL as the
-		command is to the task rather than to an individual timer. */
-		if( pxTimer != NULL )
+static void prvProcessCommand( const xTIMER_MESSAGE *pxMessage, portTickType xTimeNow )
+{
+xTIMER *pxTimer;
+#if ( configUSE_TIMER_BATCH_EXPIRY == 0 )
+	portBASE_TYPE xResult;
+#endif
+
+	pxTimer = pxMessage->pxTimer;
+
+	/* Is the timer already in a list of active timers?  When the command
+	is trmCOMMAND_PROCESS_TIMER_OVERFLOW, the timer will be NULL as the
+	command is to the task rather than to an individual timer. */
+	if( pxTimer != NULL )
+	{
+		if( listIS_CONTAINED_WITHIN( NULL, &( pxTimer->xTimerListItem ) ) == pdFALSE )
 		{
-			if( listIS_CONTAINED_WITHIN( NULL, &( pxTimer->xTimerListItem ) ) == pdFALSE )
-			{
-				/* The timer is in a list, remove it. */
-				vListRemove( &( pxTimer->xTimerListItem ) );
-			}
+			/* The timer is in a list, remove it. */
+			vListRemove( &( pxTimer->xTimerListItem ) );
 		}
+	}
 
-		traceTIMER_COMMAND_RECEIVED( pxTimer, xMessage.xMessageID, xMessage.xMessageValue );
-		
-		switch( xMessage.xMessageID )
-		{
-			case tmrCOMMAND_START :	
-				/* Start or restart a timer. */
-				if( prvInsertTimerInActiveList( pxTimer,  xMessage.xMessageValue + pxTimer->xTimerPeriodInTicks, xTimeNow, xMessage.xMessageValue ) == pdTRUE )
-				{
-					/* The timer expired before it was added to the active timer
-					list.  Process it now. */
-					pxTimer->pxCallbackFunction( ( xTimerHandle ) pxTimer );
+	traceTIMER_COMMAND_RECEIVED( pxTimer, pxMessage->xMessageID, pxMessage->xMessageValue );
+	
+	switch( pxMessage->xMessageID )
+	{
+		case tmrCOMMAND_START :	
+			/* Start or restart a timer. */
+			if( prvInsertTimerInActiveList( pxTimer,  pxMessage->xMessageValue + pxTimer->xTimerPeriodInTicks, xTimeNow, pxMessage->xMessageValue ) == pdTRUE )
+			{
+				/* The timer expired before it was added to the active timer
+				list.  Process it now. */
+				pxTimer->pxCallbackFunction( ( xTimerHandle ) pxTimer );
 
-					if( pxTimer->uxAutoReload == ( unsigned portBASE_TYPE ) pdTRUE )
+				if( pxTimer->uxAutoReload == ( unsigned portBASE_TYPE ) pdTRUE )
+				{
+					#if ( configUSE_TIMER_BATCH_EXPIRY == 1 )
+					{
+						/* This task owns the timer lists, so reload the timer
+						directly rather than sending itself a command. */
+						prvReloadTimer( pxTimer, pxMessage->xMessageValue + pxTimer->xTimerPeriodInTicks, xTimeNow );
+					}
+					#else
 					{
-						xResult = xTimerGenericCommand( pxTimer, tmrCOMMAND_START, xMessage.xMessageValue + pxTimer->xTimerPeriodInTicks, NULL, tmrNO_DELAY );
+						xResult = xTimerGenericCommand( pxTimer, tmrCOMMAND_START, pxMessage->xMessageValue + pxTimer->xTimerPeriodInTicks, NULL, tmrNO_DELAY );
 						configASSERT( xResult );
 						( void ) xResult;
 					}
+					#endif
 				}
-				break;
-
-			case tmrCOMMAND_STOP :	
-				/* The timer has already been removed from the active list.
-				There is nothing to do here. */
-				break;
-
-			case tmrCOMMAND_CHANGE_PERIOD :
-				pxTimer->xTimerPeriodInTicks = xMessage.xMessageValue;
-				configASSERT( ( pxTimer->xTimerPeriodInTicks > 0 ) );
-				prvInsertTimerInActiveList( pxTimer, ( xTimeNow + pxTimer->xTimerPeriodInTicks ), xTimeNow, xTimeNow );
-				break;
-
-			case tmrCOMMAND_DELETE :
-				/* The timer has already been removed from the active list,
-				just free up the memory. */
-				vPortFree( pxTimer );
-				break;
-
-			default	:			
-				/* Don't expect to get here. */
-				break;
-		}
+			}
+			break;
+
+		case tmrCOMMAND_STOP :	
+			/* The timer has already been removed from the active list.
+			There is nothing to do here. */
+			break;
+
+		case tmrCOMMAND_CHANGE_PERIOD :
+			pxTimer->xTimerPeriodInTicks = pxMessage->xMessageValue;
+			configASSERT( ( pxTimer->xTimerPeriodInTicks > 0 ) );
+			prvInsertTimerInActiveList( pxTimer, ( xTimeNow + pxTimer->xTimerPeriodInTicks ), xTimeNow, xTimeNow );
+			break;
+
+		case tmrCOMMAND_DELETE :
+			/* The timer has already been removed from the active list,
+			just free up the memory. */
+			vPortFree( pxTimer );
+			break;
+
+		default	:			
+			/* Don't expect to get here. */
+			break;
 	}
 }
 /*-----------------------------------------------------------*/
@@ -38,6 +38,11 @@
 /*                                                                       */
 /* The same driver cannot be used to support both logical drives.        */
 /*                                                                       */
+/* When FatFs is built with _FS_REENTRANT, each volume is locked on its  */
+/* own, so the two drivers can be entered from different tasks at the    */
+/* same time.  This wrapper keeps no state of its own, but the two       */
+/* drivers must not share a peripheral (an SSI port, for example).       */
+/*                                                                       */
 /* Note that the USB MSC driver does not support a timer function so we  */
 /* need to undef DRIVEn_TIMERPROC whenever this driver is configured.    */
 /*-----------------------------------------------------------------------*/
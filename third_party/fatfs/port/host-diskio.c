@@ -0,0 +1,385 @@
+/*-----------------------------------------------------------------------*/
+/* Host (Linux) disk image and RAM disk control module                   */
+/*-----------------------------------------------------------------------*/
+/* The drives are backed by a memory mapped image file or by anonymous   */
+/* memory, so FatFs and Tiny-FatFs can be run, measured and regression   */
+/* tested on the host without any media. A latency can be injected per  */
+/* command and per sector to model the card that the firmware will use.  */
+/*-----------------------------------------------------------------------*/
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "diskio.h"
+#include "host-diskio.h"
+
+#define N_HOST_DRIVES	4
+#define SECT_SIZE		512
+
+
+/*--------------------------------------------------------------------------
+
+   Module Private Functions
+
+---------------------------------------------------------------------------*/
+
+typedef struct _HOST_DRIVE {
+	BYTE	*img;			/* Mapped image (NULL: not attached) */
+	DWORD	n_sects;		/* Number of sectors in the image */
+	size_t	size;			/* Size of the mapping in bytes */
+	BOOL	shared;			/* Writes go through to the image file */
+	DSTATUS	stat;			/* Disk status */
+	DWORD	cmd_lat;		/* Injected latency per command [us] */
+	DWORD	sect_lat;		/* Injected latency per sector [us] */
+	HOST_DISK_STAT cnt;		/* Access counters */
+} HOST_DRIVE;
+
+static
+HOST_DRIVE Drive[N_HOST_DRIVES];
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Spin for the injected latency                                         */
+/*-----------------------------------------------------------------------*/
+/* A busy wait is used since sleeping cannot resolve a few microseconds. */
+
+static
+void delay_us (
+	DWORD us		/* Time to wait [us] */
+)
+{
+	struct timespec now, end;
+
+
+	if (!us) return;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_sec += us / 1000000;
+	end.tv_nsec += (long)(us % 1000000) * 1000;
+	if (end.tv_nsec >= 1000000000L) {
+		end.tv_sec++; end.tv_nsec -= 1000000000L;
+	}
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (now.tv_sec < end.tv_sec ||
+			 (now.tv_sec == end.tv_sec && now.tv_nsec < end.tv_nsec));
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Check a drive number and a sector range                               */
+/*-----------------------------------------------------------------------*/
+
+static
+HOST_DRIVE *get_drive (	/* Pointer to the drive, NULL: invalid */
+	BYTE drv,			/* Physical drive number */
+	DWORD sector,		/* Start sector number */
+	BYTE count			/* Sector count */
+)
+{
+	HOST_DRIVE *d;
+
+
+	if (drv >= N_HOST_DRIVES) return NULL;
+	d = &Drive[drv];
+	if (!d->img || !count || sector >= d->n_sects || count > d->n_sects - sector)
+		return NULL;
+	return d;
+}
+
+
+
+/*--------------------------------------------------------------------------
+
+   Host Drive Control Functions
+
+---------------------------------------------------------------------------*/
+
+/*-----------------------------------------------------------------------*/
+/* Attach an Image File                                                  */
+/*-----------------------------------------------------------------------*/
+/* A shared mapping writes changes back to the file. A private mapping   */
+/* uses the file as the initial contents of a RAM disk.                  */
+
+int host_disk_image (	/* 0: successful, -1: failed */
+	BYTE drv,			/* Physical drive number */
+	const char *path,	/* Path of the image file */
+	BOOL shared			/* TRUE: write back to the file, FALSE: private copy */
+)
+{
+	int fd;
+	struct stat st;
+	void *img;
+
+
+	if (drv >= N_HOST_DRIVES) return -1;
+	host_disk_release(drv);
+	fd = open(path, shared ? O_RDWR : O_RDONLY);
+	if (fd < 0) return -1;
+	if (fstat(fd, &st) || st.st_size < SECT_SIZE) {
+		close(fd); return -1;
+	}
+	img = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+			   shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (img == MAP_FAILED) return -1;
+
+	Drive[drv].img = img;
+	Drive[drv].size = (size_t)st.st_size;
+	Drive[drv].n_sects = (DWORD)(st.st_size / SECT_SIZE);
+	Drive[drv].shared = shared;
+	Drive[drv].stat = STA_NOINIT;
+	return 0;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Attach a RAM Disk                                                     */
+/*-----------------------------------------------------------------------*/
+
+int host_disk_ram (		/* 0: successful, -1: failed */
+	BYTE drv,			/* Physical drive number */
+	DWORD n_sects		/* Number of sectors */
+)
+{
+	void *img;
+
+
+	if (drv >= N_HOST_DRIVES || !n_sects) return -1;
+	host_disk_release(drv);
+	img = mmap(NULL, (size_t)n_sects * SECT_SIZE, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (img == MAP_FAILED) return -1;
+
+	Drive[drv].img = img;
+	Drive[drv].size = (size_t)n_sects * SECT_SIZE;
+	Drive[drv].n_sects = n_sects;
+	Drive[drv].shared = FALSE;
+	Drive[drv].stat = STA_NOINIT;
+	return 0;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Detach a Drive                                                        */
+/*-----------------------------------------------------------------------*/
+
+void host_disk_release (
+	BYTE drv			/* Physical drive number */
+)
+{
+	HOST_DRIVE *d;
+
+
+	if (drv >= N_HOST_DRIVES) return;
+	d = &Drive[drv];
+	if (d->img) {
+		if (d->shared) msync(d->img, d->size, MS_SYNC);
+		munmap(d->img, d->size);
+	}
+	memset(d, 0, sizeof(HOST_DRIVE));
+	d->stat = STA_NOINIT | STA_NODISK;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Set Injected Latency                                                  */
+/*-----------------------------------------------------------------------*/
+
+void host_disk_latency (
+	BYTE drv,			/* Physical drive number */
+	DWORD cmd_us,		/* Latency per disk_read/disk_write call [us] */
+	DWORD sect_us		/* Latency per sector transferred [us] */
+)
+{
+	if (drv >= N_HOST_DRIVES) return;
+	Drive[drv].cmd_lat = cmd_us;
+	Drive[drv].sect_lat = sect_us;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get Access Counters                                                   */
+/*-----------------------------------------------------------------------*/
+
+void host_disk_stat (
+	BYTE drv,				/* Physical drive number */
+	HOST_DISK_STAT *stat,	/* Counters to return (NULL: only reset) */
+	BOOL reset				/* TRUE: Clear the counters */
+)
+{
+	if (drv >= N_HOST_DRIVES) return;
+	if (stat) *stat = Drive[drv].cnt;
+	if (reset) memset(&Drive[drv].cnt, 0, sizeof(HOST_DISK_STAT));
+}
+
+
+
+/*--------------------------------------------------------------------------
+
+   Public Functions
+
+---------------------------------------------------------------------------*/
+
+
+/*-----------------------------------------------------------------------*/
+/* Initialize Disk Drive                                                 */
+/*-----------------------------------------------------------------------*/
+
+DSTATUS disk_initialize (
+	BYTE drv		/* Physical drive nmuber */
+)
+{
+	if (drv >= N_HOST_DRIVES) return STA_NOINIT;
+	if (!Drive[drv].img) return STA_NOINIT | STA_NODISK;
+	Drive[drv].stat &= ~STA_NOINIT;
+	return Drive[drv].stat;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get Disk Status                                                       */
+/*-----------------------------------------------------------------------*/
+
+DSTATUS disk_status (
+	BYTE drv		/* Physical drive nmuber */
+)
+{
+	if (drv >= N_HOST_DRIVES || !Drive[drv].img) return STA_NOINIT | STA_NODISK;
+	return Drive[drv].stat;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Read Sector(s)                                                        */
+/*-----------------------------------------------------------------------*/
+
+DRESULT disk_read (
+	BYTE drv,			/* Physical drive nmuber */
+	BYTE *buff,			/* Pointer to the data buffer to store read data */
+	DWORD sector,		/* Start sector number (LBA) */
+	BYTE count			/* Sector count (1..255) */
+)
+{
+	HOST_DRIVE *d = get_drive(drv, sector, count);
+
+
+	if (!d) return RES_PARERR;
+	if (d->stat & STA_NOINIT) return RES_NOTRDY;
+
+	delay_us(d->cmd_lat + d->sect_lat * count);
+	memcpy(buff, d->img + (size_t)sector * SECT_SIZE, (size_t)count * SECT_SIZE);
+	d->cnt.rd_cmds++;
+	d->cnt.rd_sects += count;
+
+	return RES_OK;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Write Sector(s)                                                       */
+/*-----------------------------------------------------------------------*/
+
+#if _READONLY == 0
+DRESULT disk_write (
+	BYTE drv,			/* Physical drive nmuber */
+	const BYTE *buff,	/* Pointer to the data to be written */
+	DWORD sector,		/* Start sector number (LBA) */
+	BYTE count			/* Sector count (1..255) */
+)
+{
+	HOST_DRIVE *d = get_drive(drv, sector, count);
+
+
+	if (!d) return RES_PARERR;
+	if (d->stat & STA_NOINIT) return RES_NOTRDY;
+	if (d->stat & STA_PROTECT) return RES_WRPRT;
+
+	delay_us(d->cmd_lat + d->sect_lat * count);
+	memcpy(d->img + (size_t)sector * SECT_SIZE, buff, (size_t)count * SECT_SIZE);
+	d->cnt.wr_cmds++;
+	d->cnt.wr_sects += count;
+
+	return RES_OK;
+}
+#endif /* _READONLY */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Miscellaneous Functions                                               */
+/*-----------------------------------------------------------------------*/
+
+DRESULT disk_ioctl (
+	BYTE drv,		/* Physical drive nmuber */
+	BYTE ctrl,		/* Control code */
+	void *buff		/* Buffer to send/receive control data */
+)
+{
+	HOST_DRIVE *d;
+
+
+	if (drv >= N_HOST_DRIVES) return RES_PARERR;
+	d = &Drive[drv];
+	if (!d->img || (d->stat & STA_NOINIT)) return RES_NOTRDY;
+
+	switch (ctrl) {
+	case GET_SECTOR_COUNT :	/* Get number of sectors on the disk (DWORD) */
+		*(DWORD*)buff = d->n_sects;
+		return RES_OK;
+
+	case GET_SECTOR_SIZE :	/* Get sector size (WORD) */
+		*(WORD*)buff = SECT_SIZE;
+		return RES_OK;
+
+	case CTRL_SYNC :		/* Make sure that data has been written */
+		d->cnt.syncs++;
+		if (d->shared && msync(d->img, d->size, MS_ASYNC))
+			return RES_ERROR;
+		return RES_OK;
+	}
+
+	return RES_PARERR;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Device Timer Interrupt Procedure                                      */
+/*-----------------------------------------------------------------------*/
+/* Nothing to time out on the host.                                      */
+
+void disk_timerproc (void)
+{
+}
+
+
+
+/*---------------------------------------------------------*/
+/* User Provided Timer Function for FatFs module           */
+/*---------------------------------------------------------*/
+
+DWORD get_fattime (void)
+{
+	time_t t = time(NULL);
+	struct tm *tm = localtime(&t);
+
+
+	return	  ((DWORD)(tm->tm_year - 80) << 25)
+			| ((DWORD)(tm->tm_mon + 1) << 21)
+			| ((DWORD)tm->tm_mday << 16)
+			| ((DWORD)tm->tm_hour << 11)
+			| ((DWORD)tm->tm_min << 5)
+			| ((DWORD)tm->tm_sec >> 1);
+}
@@ -0,0 +1,31 @@
+/*-----------------------------------------------------------------------
+/  Host (Linux) disk image and RAM disk control module include file
+/-----------------------------------------------------------------------*/
+
+#ifndef _HOST_DISKIO
+
+#include "integer.h"
+
+
+/* Access counters of a host drive */
+typedef struct _HOST_DISK_STAT {
+	DWORD	rd_cmds;		/* Number of disk_read calls */
+	DWORD	rd_sects;		/* Number of sectors read */
+	DWORD	wr_cmds;		/* Number of disk_write calls */
+	DWORD	wr_sects;		/* Number of sectors written */
+	DWORD	syncs;			/* Number of CTRL_SYNC requests */
+} HOST_DISK_STAT;
+
+
+/*---------------------------------------*/
+/* Prototypes for host drive functions   */
+
+int  host_disk_image (BYTE, const char*, BOOL);		/* Attach an image file (shared or private mapping) */
+int  host_disk_ram (BYTE, DWORD);					/* Attach a zero-filled RAM disk */
+void host_disk_release (BYTE);						/* Detach the drive */
+void host_disk_latency (BYTE, DWORD, DWORD);		/* Set injected latency per command and per sector [us] */
+void host_disk_stat (BYTE, HOST_DISK_STAT*, BOOL);	/* Get and optionally reset the access counters */
+
+
+#define _HOST_DISKIO
+#endif
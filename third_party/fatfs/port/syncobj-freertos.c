@@ -0,0 +1,81 @@
+/*------------------------------------------------------------------------*/
+/* Volume sync object controls for FatFs on FreeRTOS                      */
+/*------------------------------------------------------------------------*/
+/* These are the functions FatFs calls when it is built with             */
+/* _FS_REENTRANT set to 1.  Each logical drive gets its own mutex, so    */
+/* that file functions on different volumes do not block each other.     */
+/* _SYNC_t must be a type that can hold an xSemaphoreHandle, for example */
+/* the default void*.                                                    */
+/*------------------------------------------------------------------------*/
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "fatfs/src/ff.h"
+
+#if _FS_REENTRANT
+
+/*------------------------------------------------------------------------*/
+/* Create a Synchronization Object for a Volume                           */
+/*------------------------------------------------------------------------*/
+/* Called in f_mount. When FALSE is returned, f_mount fails with          */
+/* FR_NOT_ENABLED.                                                        */
+
+BOOL ff_cre_syncobj (	/* TRUE:Function succeeded, FALSE:Could not create */
+	BYTE vol,			/* Logical drive being processed */
+	_SYNC_t *sobj		/* Pointer to return the created sync object */
+)
+{
+	(void)vol;
+	*sobj = xSemaphoreCreateMutex();
+
+	return (*sobj != NULL) ? TRUE : FALSE;
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Delete a Synchronization Object                                        */
+/*------------------------------------------------------------------------*/
+/* Called in f_mount. When FALSE is returned, f_mount fails with          */
+/* FR_DENIED.                                                             */
+
+BOOL ff_del_syncobj (	/* TRUE:Function succeeded, FALSE:Could not delete */
+	_SYNC_t sobj		/* Sync object tied to the logical drive */
+)
+{
+	if (sobj == NULL) return FALSE;
+	vQueueDelete(sobj);
+
+	return TRUE;
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Request Grant to Access the Volume                                     */
+/*------------------------------------------------------------------------*/
+/* Called on entering a file function. When FALSE is returned, the file   */
+/* function fails with FR_TIMEOUT.                                        */
+
+BOOL ff_req_grant (	/* TRUE:Got the grant, FALSE:Timeout */
+	_SYNC_t sobj		/* Sync object to wait */
+)
+{
+	return (xSemaphoreTake(sobj, _FS_TIMEOUT) == pdTRUE) ? TRUE : FALSE;
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Release Grant to Access the Volume                                     */
+/*------------------------------------------------------------------------*/
+/* Called on leaving a file function.                                     */
+
+void ff_rel_grant (
+	_SYNC_t sobj		/* Sync object to be signaled */
+)
+{
+	xSemaphoreGive(sobj);
+}
+
+#endif /* _FS_REENTRANT */
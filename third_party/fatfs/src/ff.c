@@ -42,6 +42,15 @@
 #include "diskio.h"        /* Include file for user provided disk functions */
 
 
+#if _FS_REENTRANT
+#define    ENTER_FF(fs)        { if (!lock_fs(fs)) return FR_TIMEOUT; }
+#define    LEAVE_FF(fs, res)    { FRESULT rv = res; unlock_fs(fs, rv); return rv; }
+#else
+#define    ENTER_FF(fs)
+#define    LEAVE_FF(fs, res)    return res
+#endif
+
+
 /*--------------------------------------------------------------------------
 
    Module Private Functions
@@ -55,6 +64,215 @@ WORD fsid;                /* File system mount ID */
 
 
 
+#if _FS_REENTRANT
+/*-----------------------------------------------------------------------*/
+/* Request/Release grant to access the volume                           */
+/*-----------------------------------------------------------------------*/
+
+static
+BOOL lock_fs (        /* TRUE: got the grant, FALSE: timeout */
+    const FATFS *fs            /* File system object */
+)
+{
+    return ff_req_grant(fs->sobj);
+}
+
+
+static
+void unlock_fs (
+    const FATFS *fs,    /* File system object */
+    FRESULT res            /* Result code to be returned */
+)
+{
+    if (res != FR_NOT_ENABLED &&    /* These codes are returned before the grant is requested */
+        res != FR_INVALID_DRIVE &&
+        res != FR_INVALID_OBJECT &&
+        res != FR_TIMEOUT)
+        ff_rel_grant(fs->sobj);
+}
+#endif /* _FS_REENTRANT */
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Clean-up the file system object                                       */
+/*-----------------------------------------------------------------------*/
+
+static
+void clear_fs (        /* No return code */
+    FATFS *fs            /* File system object */
+)
+{
+#if _FS_REENTRANT
+    _SYNC_t sobj = fs->sobj;    /* The sync object lives as long as the registration */
+
+    memset(fs, 0, sizeof(FATFS));
+    fs->sobj = sobj;
+#else
+    memset(fs, 0, sizeof(FATFS));
+#endif
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Write back a Directory/FAT sector                                     */
+/*-----------------------------------------------------------------------*/
+
+#if !_FS_READONLY
+static
+BOOL write_back (        /* TRUE: successful, FALSE: failed */
+    FATFS *fs,            /* File system object */
+    const BYTE *buff,    /* Sector data to be written */
+    DWORD sector        /* Sector number to write */
+)
+{
+    BYTE n;
+
+
+    if (disk_write(fs->drive, buff, sector, 1) != RES_OK)
+        return FALSE;
+    if (sector < (fs->fatbase + fs->sects_fat)) {    /* In FAT area */
+        for (n = fs->n_fats; n >= 2; n--) {    /* Refrect the change to FAT copy */
+            sector += fs->sects_fat;
+            disk_write(fs->drive, buff, sector, 1);
+        }
+    }
+    return TRUE;
+}
+#endif
+
+
+
+
+#if _N_WCACHE
+/*-----------------------------------------------------------------------*/
+/* Sector cache behind the window                                        */
+/*-----------------------------------------------------------------------*/
+/* The cache is exclusive of the window: a sector moved into the win[] is
+/  removed from the cache, and the sector moved out of the win[] takes the
+/  least recently used slot. */
+
+static
+void wc_order (        /* No return code */
+    FATFS *fs,        /* File system object */
+    BYTE slot,        /* Cache slot to reorder */
+    BYTE mru        /* 1: Make it most recently used, 0: Make it least recently used */
+)
+{
+    BYTE i, *ord = fs->wc_ord;
+
+
+    for (i = 0; ord[i] != slot; i++) ;    /* Remove the slot from the order list */
+    for ( ; i < _N_WCACHE - 1; i++) ord[i] = ord[i + 1];
+    if (mru) {                            /* Insert it at top of the list */
+        for (i = _N_WCACHE - 1; i; i--) ord[i] = ord[i - 1];
+        ord[0] = slot;
+    } else {                            /* Append it to end of the list */
+        ord[_N_WCACHE - 1] = slot;
+    }
+}
+
+
+static
+BOOL wc_park (        /* TRUE: successful, FALSE: failed */
+    FATFS *fs,        /* File system object */
+    BYTE keep        /* Cache slot not to be evicted (0xFF:none) */
+)
+{
+    BYTE slot;
+
+
+    slot = fs->wc_ord[_N_WCACHE - 1];        /* Least recently used slot */
+    if (slot == keep) {
+        if (_N_WCACHE < 2) {                /* No other slot, write back the window directly */
+#if !_FS_READONLY
+            if (fs->winflag && !write_back(fs, fs->win, fs->winsect))
+                return FALSE;
+            fs->winflag = 0;
+#endif
+            return TRUE;
+        }
+        slot = fs->wc_ord[_N_WCACHE - 2];
+    }
+#if !_FS_READONLY
+    if (fs->wc_flag[slot]) {                /* Write back the evicted sector if needed */
+        if (!write_back(fs, fs->wc_buf[slot], fs->wc_sect[slot]))
+            return FALSE;
+    }
+    fs->wc_flag[slot] = fs->winflag;
+    fs->winflag = 0;
+#endif
+    memcpy(fs->wc_buf[slot], fs->win, S_SIZ);    /* Move the window into the slot */
+    fs->wc_sect[slot] = fs->winsect;
+    wc_order(fs, slot, 1);
+    return TRUE;
+}
+
+
+static
+BYTE wc_find (        /* Cache slot holding the sector, 0xFF: not cached */
+    FATFS *fs,        /* File system object */
+    DWORD sector    /* Sector number to find */
+)
+{
+    BYTE slot;
+
+
+    for (slot = 0; slot < _N_WCACHE; slot++) {
+        if (fs->wc_sect[slot] == sector) return slot;
+    }
+    return 0xFF;
+}
+
+
+#if !_FS_READONLY
+static
+BOOL wc_flush (        /* TRUE: successful, FALSE: failed */
+    FATFS *fs        /* File system object */
+)
+{
+    BYTE slot;
+
+
+    for (slot = 0; slot < _N_WCACHE; slot++) {
+        if (fs->wc_flag[slot]) {
+            if (!write_back(fs, fs->wc_buf[slot], fs->wc_sect[slot]))
+                return FALSE;
+            fs->wc_flag[slot] = 0;
+        }
+    }
+    return TRUE;
+}
+
+
+static
+void wc_purge (        /* No return code */
+    FATFS *fs,        /* File system object */
+    DWORD clust        /* Cluster# being freed */
+)
+{
+    BYTE slot;
+    DWORD sect;
+
+
+    sect = (clust - 2) * fs->sects_clust + fs->database;
+    for (slot = 0; slot < _N_WCACHE; slot++) {    /* Discard any directory sector in the cluster */
+        if (fs->wc_sect[slot] - sect < fs->sects_clust) {
+            fs->wc_sect[slot] = 0;
+            fs->wc_flag[slot] = 0;
+            wc_order(fs, slot, 0);
+        }
+    }
+}
+#endif
+#endif /* _N_WCACHE */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Change window offset                                                  */
 /*-----------------------------------------------------------------------*/
@@ -70,18 +288,32 @@ BOOL move_window (        /* TRUE: successful, FALSE: failed */
 
     wsect = fs->winsect;
     if (wsect != sector) {    /* Changed current window */
+#if _N_WCACHE
+        if (sector) {
+            BYTE slot = wc_find(fs, sector);
+            if (wsect && !wc_park(fs, slot))    /* Move the current window into the cache */
+                return FALSE;
+            if (slot != 0xFF) {                    /* Cache hit, take the sector out of the cache */
+                memcpy(fs->win, fs->wc_buf[slot], S_SIZ);
+#if !_FS_READONLY
+                fs->winflag = fs->wc_flag[slot];
+                fs->wc_flag[slot] = 0;
+#endif
+                fs->wc_sect[slot] = 0;
+                wc_order(fs, slot, 0);
+            } else {
+                if (disk_read(fs->drive, fs->win, sector, 1) != RES_OK)
+                    return FALSE;
+            }
+            fs->winsect = sector;
+            return TRUE;
+        }
+#endif
 #if !_FS_READONLY
-        BYTE n;
         if (fs->winflag) {    /* Write back dirty window if needed */
-            if (disk_write(fs->drive, fs->win, wsect, 1) != RES_OK)
+            if (!write_back(fs, fs->win, wsect))
                 return FALSE;
             fs->winflag = 0;
-            if (wsect < (fs->fatbase + fs->sects_fat)) {    /* In FAT area */
-                for (n = fs->n_fats; n >= 2; n--) {    /* Refrect the change to FAT copy */
-                    wsect += fs->sects_fat;
-                    disk_write(fs->drive, fs->win, wsect, 1);
-                }
-            }
         }
 #endif
         if (sector) {
@@ -108,6 +340,9 @@ FRESULT sync (            /* FR_OK: successful, FR_RW_ERROR: failed */
 {
     fs->winflag = 1;
     if (!move_window(fs, 0)) return FR_RW_ERROR;
+#if _N_WCACHE
+    if (!wc_flush(fs)) return FR_RW_ERROR;
+#endif
 #if _USE_FSINFO
     if (fs->fs_type == FS_FAT32 && fs->fsi_flag) {        /* Update FSInfo sector if needed */
         fs->winsect = 0;
@@ -117,7 +352,7 @@ FRESULT sync (            /* FR_OK: successful, FR_RW_ERROR: failed */
         ST_DWORD(&fs->win[FSI_StrucSig], 0x61417272);
         ST_DWORD(&fs->win[FSI_Free_Count], fs->free_clust);
         ST_DWORD(&fs->win[FSI_Nxt_Free], fs->last_clust);
-        disk_write(0, fs->win, fs->fsi_sector, 1);
+        disk_write(fs->drive, fs->win, fs->fsi_sector, 1);
         fs->fsi_flag = 0;
     }
 #endif
@@ -240,6 +475,9 @@ BOOL remove_chain (        /* TRUE: successful, FALSE: failed */
         nxt = get_cluster(fs, clust);
         if (nxt == 1) return FALSE;
         if (!put_cluster(fs, clust, 0)) return FALSE;
+#if _N_WCACHE
+        wc_purge(fs, clust);
+#endif
         if (fs->free_clust != 0xFFFFFFFF) {
             fs->free_clust++;
 #if _USE_FSINFO
@@ -297,12 +535,11 @@ DWORD create_chain (    /* 0: no free cluster, 1: error, >=2: new cluster number
     if (clust && !put_cluster(fs, clust, ncl)) return 1;    /* Link it to previous one if needed */
 
     fs->last_clust = ncl;                /* Update fsinfo */
-    if (fs->free_clust != 0xFFFFFFFF) {
+    if (fs->free_clust != 0xFFFFFFFF)
         fs->free_clust--;
 #if _USE_FSINFO
-        fs->fsi_flag = 1;
+    fs->fsi_flag = 1;
 #endif
-    }
 
     return ncl;        /* Return new cluster number */
 }
@@ -329,6 +566,77 @@ DWORD clust2sect (    /* !=0: sector number, 0: failed - invalid cluster# */
 
 
 
+#if _USE_FASTSEEK && _FS_MINIMIZE <= 2
+/*-----------------------------------------------------------------------*/
+/* Build the cluster link map of a file                                  */
+/*-----------------------------------------------------------------------*/
+/* The table is {table size, mapped clusters, {run length, start cluster}..., 0}.
+/  Fragments that do not fit in the table are left to the FAT chain. */
+
+static
+BOOL make_linkmap (    /* TRUE: successful, FALSE: failed */
+    FIL *fp            /* Pointer to the file object with a link map table */
+)
+{
+    DWORD *tbl = fp->cltbl, *tp, cl, pcl, scl, ncl, nfrag;
+    FATFS *fs = fp->fs;
+
+
+    tp = &tbl[2];
+    nfrag = (tbl[0] - 3) / 2;            /* Number of fragments the table can hold */
+    ncl = 0;
+    cl = fp->org_clust;
+    while (nfrag && cl >= 2 && cl < fs->max_clust) {
+        scl = cl;                        /* Top of the fragment */
+        do {                            /* Follow the chain while it is contiguous */
+            pcl = cl;
+            cl = get_cluster(fs, cl);
+            if (cl == 1) return FALSE;
+        } while (cl == pcl + 1);
+        *tp++ = pcl - scl + 1;            /* Store the fragment */
+        *tp++ = scl;
+        ncl += pcl - scl + 1;
+        nfrag--;
+    }
+    *tp = 0;                            /* Terminate the table */
+    tbl[1] = ncl;
+
+    return TRUE;
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get cluster# from the cluster link map                                */
+/*-----------------------------------------------------------------------*/
+
+static
+DWORD clmt_clust (    /* >=2: cluster number, 1: failed */
+    FIL *fp,        /* Pointer to the file object with a link map table */
+    DWORD *cidx        /* Cluster index in the file, returns the index actually found */
+)
+{
+    DWORD *tbl = fp->cltbl, *tp, ci;
+
+
+    if (!tbl[1] && !make_linkmap(fp)) return 1;    /* Build the map on first use */
+    ci = *cidx;
+    if (!tbl[1]) {                            /* The file has no cluster yet */
+        *cidx = 0; return fp->org_clust;
+    }
+    if (ci >= tbl[1]) ci = tbl[1] - 1;        /* Stop at the last mapped cluster */
+    *cidx = ci;
+    for (tp = &tbl[2]; ci >= *tp; tp += 2)    /* Find the fragment containing the cluster */
+        ci -= *tp;
+
+    return tp[1] + ci;
+}
+#endif /* _USE_FASTSEEK && _FS_MINIMIZE <= 2 */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Move directory pointer to next                                        */
 /*-----------------------------------------------------------------------*/
@@ -474,6 +782,44 @@ char make_dirfile (            /* 1: error - detected an invalid format, '\0'or'
 
 
 
+#if _N_DCACHE
+/*-----------------------------------------------------------------------*/
+/* Directory entry cache                                                 */
+/*-----------------------------------------------------------------------*/
+
+static
+DCENT *dc_slot (    /* Pointer to the cache entry for the name */
+    FATFS *fs,            /* File system object */
+    DWORD pclust,        /* Start cluster of the parent directory */
+    const char *fn        /* Name in directory entry format */
+)
+{
+    DWORD hash = pclust;
+    BYTE n;
+
+
+    for (n = 0; n < 8+3; n++) hash = hash * 31 + (BYTE)fn[n];
+    return &fs->dcache[hash % _N_DCACHE];
+}
+
+
+#if !_FS_READONLY
+static
+void dc_clear (        /* No return code */
+    FATFS *fs            /* File system object */
+)
+{
+    WORD n;
+
+
+    for (n = 0; n < _N_DCACHE; n++) fs->dcache[n].sect = 0;
+}
+#endif
+#endif /* _N_DCACHE */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Trace a file path                                                     */
 /*-----------------------------------------------------------------------*/
@@ -490,6 +836,11 @@ FRESULT trace_path (    /* FR_OK(0): successful, !=0: error code */
     char ds;
     BYTE *dptr = NULL;
     FATFS *fs = dirobj->fs;    /* Get logical drive from the given DIR structure */
+#if _N_DCACHE
+    DCENT *dc;
+    DWORD sect;
+    WORD idx;
+#endif
 
 
     /* Initialize directory object */
@@ -510,6 +861,28 @@ FRESULT trace_path (    /* FR_OK(0): successful, !=0: error code */
     for (;;) {
         ds = make_dirfile(&path, fn);            /* Get a paragraph into fn[] */
         if (ds == 1) return FR_INVALID_NAME;
+#if _N_DCACHE
+        dc = dc_slot(fs, dirobj->sclust, fn);
+        if (dc->sect && dc->pclust == dirobj->sclust && !memcmp(dc->name, fn, 8+3)) {    /* Found in the cache? */
+            if (ds) {                                        /* A directory on the way is not read */
+                if (!(dc->attr & AM_DIR)) return FR_NO_PATH;
+                clust = dc->sclust;
+                goto tp_next;
+            }
+            sect = dirobj->sect; idx = dirobj->index;        /* Load the entry and verify it */
+            dirobj->clust = dc->clust;
+            dirobj->sect = dc->sect;
+            dirobj->index = dc->index;
+            if (!move_window(fs, dirobj->sect)) return FR_RW_ERROR;
+            dptr = &fs->win[(dirobj->index & ((S_SIZ - 1) / 32)) * 32];
+            if (dptr[DIR_Name] != 0xE5 && !memcmp(&dptr[DIR_Name], fn, 8+3)) {
+                *dir = dptr; return FR_OK;
+            }
+            dc->sect = 0;                                    /* Stale entry, scan the directory */
+            dirobj->clust = dirobj->sclust;
+            dirobj->sect = sect; dirobj->index = idx;
+        }
+#endif
         for (;;) {
             if (!move_window(fs, dirobj->sect)) return FR_RW_ERROR;
             dptr = &fs->win[(dirobj->index & ((S_SIZ - 1) / 32)) * 32];    /* Pointer to the directory entry */
@@ -521,9 +894,21 @@ FRESULT trace_path (    /* FR_OK(0): successful, !=0: error code */
             if (!next_dir_entry(dirobj))                    /* Next directory pointer */
                 return !ds ? FR_NO_FILE : FR_NO_PATH;
         }
+        clust = ((DWORD)LD_WORD(&dptr[DIR_FstClusHI]) << 16) | LD_WORD(&dptr[DIR_FstClusLO]); /* Get cluster# of the object */
+#if _N_DCACHE
+        dc->pclust = dirobj->sclust;                        /* Register the entry to the cache */
+        dc->clust = dirobj->clust;
+        dc->sect = dirobj->sect;
+        dc->sclust = clust;
+        dc->index = dirobj->index;
+        memcpy(dc->name, fn, 8+3);
+        dc->attr = dptr[DIR_Attr];
+#endif
         if (!ds) { *dir = dptr; return FR_OK; }                /* Matched with end of path */
         if (!(dptr[DIR_Attr] & AM_DIR)) return FR_NO_PATH;    /* Cannot trace because it is a file */
-        clust = ((DWORD)LD_WORD(&dptr[DIR_FstClusHI]) << 16) | LD_WORD(&dptr[DIR_FstClusLO]); /* Get cluster# of the directory */
+#if _N_DCACHE
+    tp_next:
+#endif
         dirobj->clust = dirobj->sclust = clust;                /* Restart scanning at the new directory */
         dirobj->sect = clust2sect(fs, clust);
         dirobj->index = 2;
@@ -647,6 +1032,7 @@ FRESULT auto_mount (        /* FR_OK(0): successful, !=0: any error occured */
     if (drv >= _DRIVES) return FR_INVALID_DRIVE;    /* Is the drive number valid? */
     if (!(fs = FatFs[drv])) return FR_NOT_ENABLED;    /* Is the file system object registered? */
     *rfs = fs;            /* Returen pointer to the corresponding file system object */
+    ENTER_FF(fs);        /* Lock the volume, the caller unlocks it */
 
     /* Check if the logical drive has been mounted or not */
     if (fs->fs_type) {
@@ -662,7 +1048,7 @@ FRESULT auto_mount (        /* FR_OK(0): successful, !=0: any error occured */
 
     /* The logical drive has not been mounted, following code attempts to mount the logical drive */
 
-    memset(fs, 0, sizeof(FATFS));        /* Clean-up the file system object */
+    clear_fs(fs);                        /* Clean-up the file system object */
     fs->drive = LD2PD(drv);                /* Bind the logical drive and a physical drive */
     stat = disk_initialize(fs->drive);    /* Initialize low level disk I/O layer */
     if (stat & STA_NOINIT)                /* Check if the drive is ready */
@@ -720,15 +1106,21 @@ FRESULT auto_mount (        /* FR_OK(0): successful, !=0: any error occured */
     /* Load fsinfo sector if needed */
     if (fmt == FS_FAT32) {
         fs->fsi_sector = bootsect + LD_WORD(&fs->win[BPB_FSInfo]);
-        if (disk_read(0, fs->win, fs->fsi_sector, 1) == RES_OK &&
+        if (disk_read(fs->drive, fs->win, fs->fsi_sector, 1) == RES_OK &&
             LD_WORD(&fs->win[BS_55AA]) == 0xAA55 &&
             LD_DWORD(&fs->win[FSI_LeadSig]) == 0x41615252 &&
             LD_DWORD(&fs->win[FSI_StrucSig]) == 0x61417272) {
             fs->last_clust = LD_DWORD(&fs->win[FSI_Nxt_Free]);
             fs->free_clust = LD_DWORD(&fs->win[FSI_Free_Count]);
+            if (fs->free_clust > maxclust - 2)    /* Discard a broken free cluster count */
+                fs->free_clust = 0xFFFFFFFF;
         }
     }
 #endif
+#endif
+#if _N_WCACHE
+    for (fmt = 0; fmt < _N_WCACHE; fmt++)                /* Initialize the cache order list */
+        fs->wc_ord[fmt] = fmt;
 #endif
     fs->id = ++fsid;                                    /* File system mount ID */
     return FR_OK;
@@ -749,6 +1141,7 @@ FRESULT validate (        /* FR_OK(0): The object is valid, !=0: Not valid */
 {
     if (!fs || fs->id != id)
         return FR_INVALID_OBJECT;
+    ENTER_FF(fs);        /* Lock the volume, the caller unlocks it */
     if (disk_status(fs->drive) & STA_NOINIT)
         return FR_NOT_READY;
 
@@ -780,9 +1173,20 @@ FRESULT f_mount (
 
     if (drv >= _DRIVES) return FR_INVALID_DRIVE;
     fsobj = FatFs[drv];
-    FatFs[drv] = fs;
-    if (fsobj) memset(fsobj, 0, sizeof(FATFS));
-    if (fs) memset(fs, 0, sizeof(FATFS));
+    if (fsobj) {
+#if _FS_REENTRANT
+        if (!ff_del_syncobj(fsobj->sobj)) return FR_DENIED;    /* Discard the sync object of the volume */
+#endif
+        memset(fsobj, 0, sizeof(FATFS));
+    }
+    FatFs[drv] = NULL;
+    if (fs) {
+        memset(fs, 0, sizeof(FATFS));
+#if _FS_REENTRANT
+        if (!ff_cre_syncobj(drv, &fs->sobj)) return FR_NOT_ENABLED;    /* Create a sync object for the volume */
+#endif
+        FatFs[drv] = fs;
+    }
 
     return FR_OK;
 }
@@ -815,7 +1219,7 @@ FRESULT f_open (
     mode &= FA_READ;
     res = auto_mount(&path, &fs, 0);
 #endif
-    if (res != FR_OK) return res;
+    if (res != FR_OK) LEAVE_FF(fs, res);
     dirobj.fs = fs;
 
     /* Trace the file path */
@@ -825,9 +1229,9 @@ FRESULT f_open (
     if (mode & (FA_CREATE_ALWAYS|FA_OPEN_ALWAYS|FA_CREATE_NEW)) {
         DWORD ps, rs;
         if (res != FR_OK) {        /* No file, create new */
-            if (res != FR_NO_FILE) return res;
+            if (res != FR_NO_FILE) LEAVE_FF(fs, res);
             res = reserve_direntry(&dirobj, &dir);
-            if (res != FR_OK) return res;
+            if (res != FR_OK) LEAVE_FF(fs, res);
             memset(dir, 0, 32);                        /* Initialize the new entry with open name */
             memcpy(&dir[DIR_Name], fn, 8+3);
             dir[DIR_NTres] = fn[11];
@@ -835,9 +1239,9 @@ FRESULT f_open (
         }
         else {                    /* Any object is already existing */
             if (mode & FA_CREATE_NEW)            /* Cannot create new */
-                return FR_EXIST;
+                LEAVE_FF(fs, FR_EXIST);
             if (dir == NULL || (dir[DIR_Attr] & (AM_RDO|AM_DIR)))    /* Cannot overwrite it (R/O or DIR) */
-                return FR_DENIED;
+                LEAVE_FF(fs, FR_DENIED);
             if (mode & FA_CREATE_ALWAYS) {        /* Resize it to zero if needed */
                 rs = ((DWORD)LD_WORD(&dir[DIR_FstClusHI]) << 16) | LD_WORD(&dir[DIR_FstClusLO]);    /* Get start cluster */
                 ST_WORD(&dir[DIR_FstClusHI], 0);    /* cluster = 0 */
@@ -846,7 +1250,7 @@ FRESULT f_open (
                 fs->winflag = 1;
                 ps = fs->winsect;                /* Remove the cluster chain */
                 if (!remove_chain(fs, rs) || !move_window(fs, ps))
-                    return FR_RW_ERROR;
+                    LEAVE_FF(fs, FR_RW_ERROR);
                 fs->last_clust = rs - 1;        /* Reuse the cluster hole */
             }
         }
@@ -861,12 +1265,12 @@ FRESULT f_open (
     /* Open an existing file */
     else {
 #endif /* !_FS_READONLY */
-        if (res != FR_OK) return res;        /* Trace failed */
+        if (res != FR_OK) LEAVE_FF(fs, res);        /* Trace failed */
         if (dir == NULL || (dir[DIR_Attr] & AM_DIR))    /* It is a directory */
-            return FR_NO_FILE;
+            LEAVE_FF(fs, FR_NO_FILE);
 #if !_FS_READONLY
         if ((mode & FA_WRITE) && (dir[DIR_Attr] & AM_RDO)) /* R/O violation */
-            return FR_DENIED;
+            LEAVE_FF(fs, FR_DENIED);
     }
 
     fp->dir_sect = fs->winsect;            /* Pointer to the directory entry */
@@ -878,9 +1282,12 @@ FRESULT f_open (
     fp->fsize = LD_DWORD(&dir[DIR_FileSize]);    /* File size */
     fp->fptr = 0;                        /* File ptr */
     fp->sect_clust = 1;                    /* Sector counter */
+#if _USE_FASTSEEK
+    fp->cltbl = NULL;                    /* No cluster link map */
+#endif
     fp->fs = fs; fp->id = fs->id;        /* Owner file system object of the file */
 
-    return FR_OK;
+    LEAVE_FF(fs, FR_OK);
 }
 
 
@@ -897,7 +1304,7 @@ FRESULT f_read (
     WORD *br        /* Pointer to number of bytes read */
 )
 {
-    DWORD clust, sect, remain;
+    DWORD clust, sect, remain, ncs;
     WORD rcnt;
     BYTE cc, *rbuff = buff;
     FRESULT res;
@@ -906,9 +1313,9 @@ FRESULT f_read (
 
     *br = 0;
     res = validate(fs, fp->id);                        /* Check validity of the object */
-    if (res) return res;
-    if (fp->flag & FA__ERROR) return FR_RW_ERROR;    /* Check error flag */
-    if (!(fp->flag & FA_READ)) return FR_DENIED;    /* Check access mode */
+    if (res) LEAVE_FF(fs, res);
+    if (fp->flag & FA__ERROR) LEAVE_FF(fs, FR_RW_ERROR);    /* Check error flag */
+    if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED);    /* Check access mode */
     remain = fp->fsize - fp->fptr;
     if (btr > remain) btr = (WORD)remain;            /* Truncate read count by number of bytes left */
 
@@ -936,10 +1343,17 @@ FRESULT f_read (
             fp->curr_sect = sect;                    /* Update current sector */
             cc = btr / S_SIZ;                        /* When left bytes >= S_SIZ, */
             if (cc) {                                /* Read maximum contiguous sectors directly */
-                if (cc > fp->sect_clust) cc = fp->sect_clust;
+                ncs = fp->sect_clust;                /* Sectors left in the following contiguous clusters */
+                while (cc > ncs) {                    /* Stretch the run over contiguous clusters */
+                    clust = get_cluster(fs, fp->curr_clust);
+                    if (clust != fp->curr_clust + 1) break;
+                    fp->curr_clust = clust;
+                    ncs += fs->sects_clust;
+                }
+                if (cc > ncs) cc = (BYTE)ncs;
                 if (disk_read(fs->drive, rbuff, sect, cc) != RES_OK)
                     goto fr_error;
-                fp->sect_clust -= cc - 1;
+                fp->sect_clust = (BYTE)(ncs - cc + 1);
                 fp->curr_sect += cc - 1;
                 rcnt = cc * S_SIZ; continue;
             }
@@ -951,11 +1365,11 @@ FRESULT f_read (
         memcpy(rbuff, &fp->buffer[fp->fptr & (S_SIZ - 1)], rcnt);
     }
 
-    return FR_OK;
+    LEAVE_FF(fs, FR_OK);
 
 fr_error:    /* Abort this file due to an unrecoverable error */
     fp->flag |= FA__ERROR;
-    return FR_RW_ERROR;
+    LEAVE_FF(fs, FR_RW_ERROR);
 }
 
 
@@ -973,7 +1387,7 @@ FRESULT f_write (
     WORD *bw            /* Pointer to number of bytes written */
 )
 {
-    DWORD clust, sect;
+    DWORD clust, sect, ncs;
     WORD wcnt;
     BYTE cc;
     FRESULT res;
@@ -983,10 +1397,10 @@ FRESULT f_write (
 
     *bw = 0;
     res = validate(fs, fp->id);                        /* Check validity of the object */
-    if (res) return res;
-    if (fp->flag & FA__ERROR) return FR_RW_ERROR;    /* Check error flag */
-    if (!(fp->flag & FA_WRITE)) return FR_DENIED;    /* Check access mode */
-    if (fp->fsize + btw < fp->fsize) return FR_OK;    /* File size cannot reach 4GB */
+    if (res) LEAVE_FF(fs, res);
+    if (fp->flag & FA__ERROR) LEAVE_FF(fs, FR_RW_ERROR);    /* Check error flag */
+    if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);    /* Check access mode */
+    if (fp->fsize + btw < fp->fsize) LEAVE_FF(fs, FR_OK);    /* File size cannot reach 4GB */
 
     for ( ;  btw;                                    /* Repeat until all data transferred */
         wbuff += wcnt, fp->fptr += wcnt, *bw += wcnt, btw -= wcnt) {
@@ -1015,10 +1429,18 @@ FRESULT f_write (
             fp->curr_sect = sect;                    /* Update current sector */
             cc = btw / S_SIZ;                        /* When left bytes >= S_SIZ, */
             if (cc) {                                /* Write maximum contiguous sectors directly */
-                if (cc > fp->sect_clust) cc = fp->sect_clust;
+                ncs = fp->sect_clust;                /* Sectors left in the following contiguous clusters */
+                while (cc > ncs) {                    /* Stretch the run over contiguous clusters */
+                    clust = create_chain(fs, fp->curr_clust);
+                    if (clust == 1) goto fw_error;
+                    if (clust != fp->curr_clust + 1) break;
+                    fp->curr_clust = clust;
+                    ncs += fs->sects_clust;
+                }
+                if (cc > ncs) cc = (BYTE)ncs;
                 if (disk_write(fs->drive, wbuff, sect, cc) != RES_OK)
                     goto fw_error;
-                fp->sect_clust -= cc - 1;
+                fp->sect_clust = (BYTE)(ncs - cc + 1);
                 fp->curr_sect += cc - 1;
                 wcnt = cc * S_SIZ; continue;
             }
@@ -1034,11 +1456,11 @@ FRESULT f_write (
 
     if (fp->fptr > fp->fsize) fp->fsize = fp->fptr;    /* Update file size if needed */
     fp->flag |= FA__WRITTEN;                        /* Set file changed flag */
-    return FR_OK;
+    LEAVE_FF(fs, FR_OK);
 
 fw_error:    /* Abort this file due to an unrecoverable error */
     fp->flag |= FA__ERROR;
-    return FR_RW_ERROR;
+    LEAVE_FF(fs, FR_RW_ERROR);
 }
 
 
@@ -1064,12 +1486,12 @@ FRESULT f_sync (
             /* Write back data buffer if needed */
             if (fp->flag & FA__DIRTY) {
                 if (disk_write(fs->drive, fp->buffer, fp->curr_sect, 1) != RES_OK)
-                    return FR_RW_ERROR;
+                    LEAVE_FF(fs, FR_RW_ERROR);
                 fp->flag &= ~FA__DIRTY;
             }
             /* Update the directory entry */
             if (!move_window(fs, fp->dir_sect))
-                return FR_RW_ERROR;
+                LEAVE_FF(fs, FR_RW_ERROR);
             dir = fp->dir_ptr;
             dir[DIR_Attr] |= AM_ARC;                        /* Set archive bit */
             ST_DWORD(&dir[DIR_FileSize], fp->fsize);        /* Update file size */
@@ -1081,7 +1503,7 @@ FRESULT f_sync (
             res = sync(fs);
         }
     }
-    return res;
+    LEAVE_FF(fs, res);
 }
 
 #endif /* !_FS_READONLY */
@@ -1102,12 +1524,17 @@ FRESULT f_close (
 
 #if !_FS_READONLY
     res = f_sync(fp);
-#else
-    res = validate(fp->fs, fp->id);
-#endif
     if (res == FR_OK)
         fp->fs = NULL;
     return res;
+#else
+    FATFS *fs = fp->fs;
+
+    res = validate(fs, fp->id);
+    if (res == FR_OK)
+        fp->fs = NULL;
+    LEAVE_FF(fs, res);
+#endif
 }
 
 
@@ -1124,14 +1551,17 @@ FRESULT f_lseek (
 )
 {
     DWORD clust, csize;
+#if _USE_FASTSEEK
+    DWORD ncl;
+#endif
     BYTE csect;
     FRESULT res;
     FATFS *fs = fp->fs;
 
 
     res = validate(fs, fp->id);            /* Check validity of the object */
-    if (res) return res;
-    if (fp->flag & FA__ERROR) return FR_RW_ERROR;
+    if (res) LEAVE_FF(fs, res);
+    if (fp->flag & FA__ERROR) LEAVE_FF(fs, FR_RW_ERROR);
 #if !_FS_READONLY
     if (fp->flag & FA__DIRTY) {            /* Write-back dirty buffer if needed */
         if (disk_write(fs->drive, fp->buffer, fp->curr_sect, 1) != RES_OK)
@@ -1157,6 +1587,15 @@ FRESULT f_lseek (
 #endif
         if (clust) {            /* If the file has a cluster chain, it can be followed */
             csize = (DWORD)fs->sects_clust * S_SIZ;        /* Cluster size in unit of byte */
+#if _USE_FASTSEEK
+            if (fp->cltbl && ofs > csize) {                /* Skip leading clusters with the link map */
+                ncl = (ofs - 1) / csize;
+                clust = clmt_clust(fp, &ncl);
+                if (clust == 1) goto fk_error;
+                fp->fptr = ncl * csize;
+                ofs -= ncl * csize;
+            }
+#endif
             for (;;) {                                    /* Loop to skip leading clusters */
                 fp->curr_clust = clust;                    /* Update current cluster */
                 if (ofs <= csize) break;
@@ -1189,12 +1628,42 @@ FRESULT f_lseek (
     }
 #endif
 
-    return FR_OK;
+    LEAVE_FF(fs, FR_OK);
 
 fk_error:    /* Abort this file due to an unrecoverable error */
     fp->flag |= FA__ERROR;
-    return FR_RW_ERROR;
+    LEAVE_FF(fs, FR_RW_ERROR);
+}
+
+
+
+
+#if _USE_FASTSEEK
+/*-----------------------------------------------------------------------*/
+/* Attach a Cluster Link Map Table to the File                           */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_linkmap (
+    FIL *fp,        /* Pointer to the file object */
+    DWORD *tbl,        /* Pointer to the link map table (NULL to detach) */
+    DWORD size        /* Number of items in the table (>= 5) */
+)
+{
+    FRESULT res;
+
+
+    res = validate(fp->fs, fp->id);        /* Check validity of the object */
+    if (res) LEAVE_FF(fp->fs, res);
+    if (tbl) {
+        if (size < 5) LEAVE_FF(fp->fs, FR_DENIED);    /* The table cannot hold a fragment */
+        tbl[0] = size;
+        tbl[1] = 0;                        /* The map is built on the first seek */
+    }
+    fp->cltbl = tbl;
+
+    LEAVE_FF(fp->fs, FR_OK);
 }
+#endif /* _USE_FASTSEEK */
 
 
 
@@ -1216,7 +1685,7 @@ FRESULT f_opendir (
 
 
     res = auto_mount(&path, &fs, 0);
-    if (res != FR_OK) return res;
+    if (res != FR_OK) LEAVE_FF(fs, res);
     dirobj->fs = fs;
 
     res = trace_path(dirobj, fn, path, &dir);    /* Trace the directory path */
@@ -1232,7 +1701,7 @@ FRESULT f_opendir (
         }
         dirobj->id = fs->id;
     }
-    return res;
+    LEAVE_FF(fs, res);
 }
 
 
@@ -1252,12 +1721,12 @@ FRESULT f_readdir (
 
 
     res = validate(fs, dirobj->id);            /* Check validity of the object */
-    if (res) return res;
+    if (res) LEAVE_FF(fs, res);
 
     finfo->fname[0] = 0;
     while (dirobj->sect) {
         if (!move_window(fs, dirobj->sect))
-            return FR_RW_ERROR;
+            LEAVE_FF(fs, FR_RW_ERROR);
         dir = &fs->win[(dirobj->index & ((S_SIZ - 1) >> 5)) * 32];    /* pointer to the directory entry */
         c = *dir;
         if (c == 0) break;                                /* Has it reached to end of dir? */
@@ -1267,7 +1736,7 @@ FRESULT f_readdir (
         if (finfo->fname[0]) break;                        /* Found valid entry */
     }
 
-    return FR_OK;
+    LEAVE_FF(fs, FR_OK);
 }
 
 
@@ -1291,7 +1760,7 @@ FRESULT f_stat (
 
 
     res = auto_mount(&path, &fs, 0);
-    if (res != FR_OK) return res;
+    if (res != FR_OK) LEAVE_FF(fs, res);
     dirobj.fs = fs;
 
     res = trace_path(&dirobj, fn, path, &dir);    /* Trace the file path */
@@ -1302,7 +1771,7 @@ FRESULT f_stat (
             res = FR_INVALID_NAME;
     }
 
-    return res;
+    LEAVE_FF(fs, res);
 }
 
 
@@ -1326,13 +1795,13 @@ FRESULT f_getfree (
 
     /* Get drive number */
     res = auto_mount(&drv, &fs, 0);
-    if (res != FR_OK) return res;
+    if (res != FR_OK) LEAVE_FF(fs, res);
     *fatfs = fs;
 
     /* If number of free cluster is valid, return it without cluster scan. */
     if (fs->free_clust <= fs->max_clust - 2) {
         *nclust = fs->free_clust;
-        return FR_OK;
+        LEAVE_FF(fs, FR_OK);
     }
 
     /* Count number of free clusters */
@@ -1349,7 +1818,7 @@ FRESULT f_getfree (
         f = 0; p = 0;
         do {
             if (!f) {
-                if (!move_window(fs, sect++)) return FR_RW_ERROR;
+                if (!move_window(fs, sect++)) LEAVE_FF(fs, FR_RW_ERROR);
                 p = fs->win;
             }
             if (fat == FS_FAT16) {
@@ -1367,7 +1836,87 @@ FRESULT f_getfree (
 #endif
 
     *nclust = n;
-    return FR_OK;
+    LEAVE_FF(fs, FR_OK);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Allocate a Contiguous Area to the File                                */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_expand (
+    FIL *fp,        /* Pointer to the file object */
+    DWORD fsz        /* File size to be allocated */
+)
+{
+    DWORD csz, tcl, stcl, scl, clst, ncl, n;
+    BYTE wrap;
+    FRESULT res;
+    FATFS *fs = fp->fs;
+
+
+    res = validate(fs, fp->id);                        /* Check validity of the object */
+    if (res) LEAVE_FF(fs, res);
+    if (fp->flag & FA__ERROR) LEAVE_FF(fs, FR_RW_ERROR);    /* Check error flag */
+    if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);    /* Check access mode */
+    if (fp->fsize || fp->org_clust) LEAVE_FF(fs, FR_DENIED);    /* The file must be empty */
+    if (!fsz) LEAVE_FF(fs, FR_OK);
+
+    csz = (DWORD)fs->sects_clust * S_SIZ;            /* Cluster size in unit of byte */
+    tcl = (fsz - 1) / csz + 1;                        /* Number of clusters required */
+    if (tcl > fs->max_clust - 2 ||
+        (fs->free_clust <= fs->max_clust - 2 && tcl > fs->free_clust))
+        LEAVE_FF(fs, FR_DENIED);                            /* Not enough free clusters */
+
+    /* Find a contiguous block of free clusters, starting at the last allocated cluster */
+    stcl = fs->last_clust + 1;
+    if (stcl < 2 || stcl >= fs->max_clust) stcl = 2;
+    scl = clst = stcl; ncl = 0; wrap = 0;
+    for (;;) {
+        n = get_cluster(fs, clst);
+        if (n == 1) goto fx_error;
+        if (n == 0) {                                /* A free cluster */
+            if (++ncl == tcl) break;                /* Found a block large enough */
+        } else {                                    /* A cluster in use, restart the block */
+            scl = clst + 1; ncl = 0;
+        }
+        if (++clst >= fs->max_clust) {                /* Wrap around, the block cannot straddle the end */
+            if (wrap) LEAVE_FF(fs, FR_DENIED);            /* Every start cluster has been tried */
+            scl = clst = 2; ncl = 0; wrap = 1;
+        }
+        /* After wrapping, a block starting below stcl may run on past it. Every
+           block starting at or above stcl was already tried before the wrap. */
+        if (wrap && scl >= stcl) LEAVE_FF(fs, FR_DENIED);    /* No contiguous block */
+    }
+
+    /* Chain the block and give it to the file */
+    for (clst = scl, n = tcl; --n; clst++) {
+        if (!put_cluster(fs, clst, clst + 1)) goto fx_unlink;
+    }
+    if (!put_cluster(fs, clst, 0x0FFFFFFF)) goto fx_unlink;
+    fs->last_clust = clst;
+    if (fs->free_clust != 0xFFFFFFFF)
+        fs->free_clust -= tcl;
+#if _USE_FSINFO
+    fs->fsi_flag = 1;
+#endif
+    fp->org_clust = scl;
+    fp->fsize = fsz;
+    fp->flag |= FA__WRITTEN;
+    LEAVE_FF(fs, FR_OK);
+
+fx_unlink:    /* Release the part of the block already chained */
+    remove_chain(fs, scl);
+    fs->free_clust = 0xFFFFFFFF;                    /* The failed cluster's state is unknown */
+#if _USE_FSINFO
+    fs->fsi_flag = 1;
+#endif
+
+fx_error:    /* Abort this file due to an unrecoverable error */
+    fp->flag |= FA__ERROR;
+    LEAVE_FF(fs, FR_RW_ERROR);
 }
 
 
@@ -1390,13 +1939,13 @@ FRESULT f_unlink (
 
 
     res = auto_mount(&path, &fs, 1);
-    if (res != FR_OK) return res;
+    if (res != FR_OK) LEAVE_FF(fs, res);
     dirobj.fs = fs;
 
     res = trace_path(&dirobj, fn, path, &dir);    /* Trace the file path */
-    if (res != FR_OK) return res;                /* Trace failed */
-    if (dir == NULL) return FR_INVALID_NAME;    /* It is the root directory */
-    if (dir[DIR_Attr] & AM_RDO) return FR_DENIED;    /* It is a R/O object */
+    if (res != FR_OK) LEAVE_FF(fs, res);                /* Trace failed */
+    if (dir == NULL) LEAVE_FF(fs, FR_INVALID_NAME);    /* It is the root directory */
+    if (dir[DIR_Attr] & AM_RDO) LEAVE_FF(fs, FR_DENIED);    /* It is a R/O object */
     dsect = fs->winsect;
     dclust = ((DWORD)LD_WORD(&dir[DIR_FstClusHI]) << 16) | LD_WORD(&dir[DIR_FstClusLO]);
 
@@ -1405,20 +1954,23 @@ FRESULT f_unlink (
         dirobj.sect = clust2sect(fs, dclust);
         dirobj.index = 2;
         do {
-            if (!move_window(fs, dirobj.sect)) return FR_RW_ERROR;
+            if (!move_window(fs, dirobj.sect)) LEAVE_FF(fs, FR_RW_ERROR);
             sdir = &fs->win[(dirobj.index & ((S_SIZ - 1) >> 5)) * 32];
             if (sdir[DIR_Name] == 0) break;
             if (sdir[DIR_Name] != 0xE5 && !(sdir[DIR_Attr] & AM_VOL))
-                return FR_DENIED;    /* The directory is not empty */
+                LEAVE_FF(fs, FR_DENIED);    /* The directory is not empty */
         } while (next_dir_entry(&dirobj));
     }
 
-    if (!move_window(fs, dsect)) return FR_RW_ERROR;    /* Mark the directory entry 'deleted' */
+    if (!move_window(fs, dsect)) LEAVE_FF(fs, FR_RW_ERROR);    /* Mark the directory entry 'deleted' */
     dir[DIR_Name] = 0xE5;
     fs->winflag = 1;
-    if (!remove_chain(fs, dclust)) return FR_RW_ERROR;    /* Remove the cluster chain */
+#if _N_DCACHE
+    dc_clear(fs);
+#endif
+    if (!remove_chain(fs, dclust)) LEAVE_FF(fs, FR_RW_ERROR);    /* Remove the cluster chain */
 
-    return sync(fs);
+    LEAVE_FF(fs, sync(fs));
 }
 
 
@@ -1441,27 +1993,30 @@ FRESULT f_mkdir (
 
 
     res = auto_mount(&path, &fs, 1);
-    if (res != FR_OK) return res;
+    if (res != FR_OK) LEAVE_FF(fs, res);
     dirobj.fs = fs;
 
     res = trace_path(&dirobj, fn, path, &dir);    /* Trace the file path */
-    if (res == FR_OK) return FR_EXIST;            /* Any file or directory is already existing */
-    if (res != FR_NO_FILE) return res;
+    if (res == FR_OK) LEAVE_FF(fs, FR_EXIST);            /* Any file or directory is already existing */
+    if (res != FR_NO_FILE) LEAVE_FF(fs, res);
 
     res = reserve_direntry(&dirobj, &dir);         /* Reserve a directory entry */
-    if (res != FR_OK) return res;
+    if (res != FR_OK) LEAVE_FF(fs, res);
+#if _N_DCACHE
+    dc_clear(fs);
+#endif
     sect = fs->winsect;
     dclust = create_chain(fs, 0);                /* Allocate a cluster for new directory table */
-    if (dclust == 1) return FR_RW_ERROR;
+    if (dclust == 1) LEAVE_FF(fs, FR_RW_ERROR);
     dsect = clust2sect(fs, dclust);
-    if (!dsect) return FR_DENIED;
-    if (!move_window(fs, dsect)) return FR_RW_ERROR;
+    if (!dsect) LEAVE_FF(fs, FR_DENIED);
+    if (!move_window(fs, dsect)) LEAVE_FF(fs, FR_RW_ERROR);
 
     fw = fs->win;
     memset(fw, 0, S_SIZ);                        /* Clear the new directory table */
     for (n = 1; n < fs->sects_clust; n++) {
         if (disk_write(fs->drive, fw, ++dsect, 1) != RES_OK)
-            return FR_RW_ERROR;
+            LEAVE_FF(fs, FR_RW_ERROR);
     }
     memset(&fw[DIR_Name], ' ', 8+3);            /* Create "." entry */
     fw[DIR_Name] = '.';
@@ -1479,7 +2034,7 @@ FRESULT f_mkdir (
     ST_WORD(&fw[32+DIR_FstClusLO], pclust);
     fs->winflag = 1;
 
-    if (!move_window(fs, sect)) return FR_RW_ERROR;
+    if (!move_window(fs, sect)) LEAVE_FF(fs, FR_RW_ERROR);
     memset(&dir[0], 0, 32);                        /* Initialize the new entry */
     memcpy(&dir[DIR_Name], fn, 8+3);            /* Name */
     dir[DIR_NTres] = fn[11];
@@ -1488,7 +2043,7 @@ FRESULT f_mkdir (
     ST_WORD(&dir[DIR_FstClusLO], dclust);        /* Table start cluster */
     ST_WORD(&dir[DIR_FstClusHI], dclust >> 16);
 
-    return sync(fs);
+    LEAVE_FF(fs, sync(fs));
 }
 
 
@@ -1525,7 +2080,7 @@ FRESULT f_chmod (
             }
         }
     }
-    return res;
+    LEAVE_FF(fs, res);
 }
 
 
@@ -1549,30 +2104,33 @@ FRESULT f_rename (
 
 
     res = auto_mount(&path_old, &fs, 1);
-    if (res != FR_OK) return res;
+    if (res != FR_OK) LEAVE_FF(fs, res);
     dirobj.fs = fs;
 
     res = trace_path(&dirobj, fn, path_old, &dir_old);    /* Check old object */
-    if (res != FR_OK) return res;            /* The old object is not found */
-    if (!dir_old) return FR_NO_FILE;
+    if (res != FR_OK) LEAVE_FF(fs, res);            /* The old object is not found */
+    if (!dir_old) LEAVE_FF(fs, FR_NO_FILE);
     sect_old = fs->winsect;                    /* Save the object information */
     memcpy(direntry, &dir_old[DIR_Attr], 32-11);
 
     res = trace_path(&dirobj, fn, path_new, &dir_new);    /* Check new object */
-    if (res == FR_OK) return FR_EXIST;            /* The new object name is already existing */
-    if (res != FR_NO_FILE) return res;            /* Is there no old name? */
+    if (res == FR_OK) LEAVE_FF(fs, FR_EXIST);            /* The new object name is already existing */
+    if (res != FR_NO_FILE) LEAVE_FF(fs, res);            /* Is there no old name? */
     res = reserve_direntry(&dirobj, &dir_new);     /* Reserve a directory entry */
-    if (res != FR_OK) return res;
+    if (res != FR_OK) LEAVE_FF(fs, res);
 
     memcpy(&dir_new[DIR_Attr], direntry, 32-11);    /* Create new entry */
     memcpy(&dir_new[DIR_Name], fn, 8+3);
     dir_new[DIR_NTres] = fn[11];
     fs->winflag = 1;
 
-    if (!move_window(fs, sect_old)) return FR_RW_ERROR;    /* Remove old entry */
+    if (!move_window(fs, sect_old)) LEAVE_FF(fs, FR_RW_ERROR);    /* Remove old entry */
     dir_old[DIR_Name] = 0xE5;
+#if _N_DCACHE
+    dc_clear(fs);
+#endif
 
-    return sync(fs);
+    LEAVE_FF(fs, sync(fs));
 }
 
 
@@ -1607,19 +2165,20 @@ FRESULT f_mkfs (
     if (drv >= _DRIVES) return FR_INVALID_DRIVE;
     fs = FatFs[drv];
     if (!fs) return FR_NOT_ENABLED;
-    memset(fs, 0, sizeof(FATFS));
+    ENTER_FF(fs);
+    clear_fs(fs);
     drv = LD2PD(drv);
 
     /* Check validity of the parameters */
     for (n = 1; n <= 64 && allocsize != n; n <<= 1);
-    if (n > 64 || partition >= 2) return FR_MKFS_ABORTED;
+    if (n > 64 || partition >= 2) LEAVE_FF(fs, FR_MKFS_ABORTED);
 
     /* Get disk statics */
     stat = disk_initialize(drv);
-    if (stat & STA_NOINIT) return FR_NOT_READY;
-    if (stat & STA_PROTECT) return FR_WRITE_PROTECTED;
+    if (stat & STA_NOINIT) LEAVE_FF(fs, FR_NOT_READY);
+    if (stat & STA_PROTECT) LEAVE_FF(fs, FR_WRITE_PROTECTED);
     if (disk_ioctl(drv, GET_SECTOR_COUNT, &n_part) != RES_OK || n_part < MIN_SECTOR)
-        return FR_MKFS_ABORTED;
+        LEAVE_FF(fs, FR_MKFS_ABORTED);
     if (n_part > MAX_SECTOR) n_part = MAX_SECTOR;
     b_part = (!partition) ? 63 : 0;
     n_part -= b_part;
@@ -1627,7 +2186,7 @@ FRESULT f_mkfs (
     if (disk_ioctl(drv, GET_SECTOR_SIZE, &S_SIZ) != RES_OK
         || S_SIZ > S_MAX_SIZ
         || (DWORD)S_SIZ * allocsize > 32768U)
-        return FR_MKFS_ABORTED;
+        LEAVE_FF(fs, FR_MKFS_ABORTED);
 #endif
 
     /* Pre-compute number of clusters and FAT type */
@@ -1665,7 +2224,7 @@ FRESULT f_mkfs (
     n_clust = (n_part - n_rsv - n_fat * 2 - n_dir) / allocsize;
     if (   (fmt == FS_FAT16 && n_clust < 0xFF7)
         || (fmt == FS_FAT32 && n_clust < 0xFFF7))
-        return FR_MKFS_ABORTED;
+        LEAVE_FF(fs, FR_MKFS_ABORTED);
 
     /* Create partition table if needed */
     if (!partition) {
@@ -1689,7 +2248,7 @@ FRESULT f_mkfs (
         ST_DWORD(&tbl[12], n_part);        /* Partition size in LBA */
         ST_WORD(&tbl[64], 0xAA55);        /* Signature */
         if (disk_write(drv, fs->win, 0, 1) != RES_OK)
-            return FR_RW_ERROR;
+            LEAVE_FF(fs, FR_RW_ERROR);
     }
 
     /* Create boot record */
@@ -1725,7 +2284,7 @@ FRESULT f_mkfs (
     }
     ST_WORD(&tbl[BS_55AA], 0xAA55);            /* Signature */
     if (disk_write(drv, tbl, b_part+0, 1) != RES_OK)
-        return FR_RW_ERROR;
+        LEAVE_FF(fs, FR_RW_ERROR);
     if (fmt == FS_FAT32)
         disk_write(drv, tbl, b_part+6, 1);
 
@@ -1741,18 +2300,18 @@ FRESULT f_mkfs (
             ST_DWORD(&tbl[8], 0x0FFFFFFF);    /* Reserve cluster #2 for root dir */
         }
         if (disk_write(drv, tbl, b_fat++, 1) != RES_OK)
-            return FR_RW_ERROR;
+            LEAVE_FF(fs, FR_RW_ERROR);
         memset(tbl, 0, S_SIZ);        /* Following FAT entries are filled by zero */
         for (n = 1; n < n_fat; n++) {
             if (disk_write(drv, tbl, b_fat++, 1) != RES_OK)
-                return FR_RW_ERROR;
+                LEAVE_FF(fs, FR_RW_ERROR);
         }
     }
 
     /* Initialize Root directory */
     for (m = 0; m < 64; m++) {
         if (disk_write(drv, tbl, b_fat++, 1) != RES_OK)
-            return FR_RW_ERROR;
+            LEAVE_FF(fs, FR_RW_ERROR);
     }
 
     /* Create FSInfo record if needed */
@@ -1766,7 +2325,7 @@ FRESULT f_mkfs (
         disk_write(drv, tbl, b_part+7, 1);
     }
 
-    return (disk_ioctl(drv, CTRL_SYNC, NULL) == RES_OK) ? FR_OK : FR_RW_ERROR;
+    LEAVE_FF(fs, (disk_ioctl(drv, CTRL_SYNC, NULL) == RES_OK) ? FR_OK : FR_RW_ERROR);
 }
 
 #endif /* _USE_MKFS */
@@ -16,7 +16,12 @@
 
 #ifndef _FATFS
 
+/* The configuration options below can also be given on the compiler command
+/  line, for example -D_USE_MKFS=1, and then the default here is not used. */
+
+#ifndef _MCU_ENDIAN
 #define _MCU_ENDIAN        1
+#endif
 /* The _MCU_ENDIAN defines which access method is used to the FAT structure.
 /  1: Enable word access.
 /  2: Disable word access and use byte-by-byte access instead.
@@ -24,38 +29,96 @@
 /  miss-aligned access is prohibited, the _MCU_ENDIAN must be set to 2.
 /  If it is not the case, it can be set to 1 for good code efficiency. */
 
+#ifndef _FS_READONLY
 #define _FS_READONLY    0
+#endif
 /* Setting _FS_READONLY to 1 defines read only configuration. This removes
-/  writing functions, f_write, f_sync, f_unlink, f_mkdir, f_chmod, f_rename
-/  and useless f_getfree. */
+/  writing functions, f_write, f_sync, f_unlink, f_mkdir, f_chmod, f_rename,
+/  f_expand and useless f_getfree. */
 
+#ifndef _FS_MINIMIZE
 #define _FS_MINIMIZE    0
+#endif
 /* The _FS_MINIMIZE option defines minimization level to remove some functions.
 /  0: Full function.
-/  1: f_stat, f_getfree, f_unlink, f_mkdir, f_chmod and f_rename are removed.
+/  1: f_stat, f_getfree, f_expand, f_unlink, f_mkdir, f_chmod and f_rename are removed.
 /  2: f_opendir and f_readdir are removed in addition to level 1.
 /  3: f_lseek is removed in addition to level 2. */
 
+#ifndef _DRIVES
 #define _DRIVES        2
+#endif
 /* Number of logical drives to be used. This affects the size of internal table. */
 
+#ifndef _USE_MKFS
 #define    _USE_MKFS    0
+#endif
 /* When _USE_MKFS is set to 1 and _FS_READONLY is set to 0, f_mkfs function is
 /  enabled. */
 
+#ifndef _MULTI_PARTITION
 #define    _MULTI_PARTITION    0
+#endif
 /* When _MULTI_PARTITION is set to 0, each logical drive is bound to same
 /  physical drive number and can mount only 1st primaly partition. When it is
 /  set to 1, each logical drive can mount a partition listed in Drives[]. */
 
+#ifndef _USE_FSINFO
 #define _USE_FSINFO    0
-/* To enable FSInfo support on FAT32 volume, set _USE_FSINFO to 1. */
+#endif
+/* To enable FSInfo support on FAT32 volume, set _USE_FSINFO to 1. The free
+/  cluster count and the next free cluster hint are then kept across mounts,
+/  so that f_getfree and the first allocation need not scan the FAT. A board
+/  opts in by defining _USE_FSINFO=1 on its compiler command line. */
 
+#ifndef _USE_FASTSEEK
+#define _USE_FASTSEEK    0
+#endif
+/* When _USE_FASTSEEK is set to 1, f_linkmap function is enabled. A file object
+/  given a cluster link map seeks without following the FAT chain. */
+
+#ifndef _N_WCACHE
+#define _N_WCACHE    0
+#endif
+/* Number of sectors in the LRU cache behind the FAT/directory window (0:disabled).
+/  Sectors leaving the window are kept in the cache and dirty ones are written
+/  back only when evicted or when the file system is synchronized. Each sector
+/  adds S_MAX_SIZ + 6 bytes to the file system object. */
+
+#ifndef _N_DCACHE
+#define _N_DCACHE    0
+#endif
+/* Number of entries in the directory entry cache (0:disabled). Each path
+/  segment found by a directory scan is remembered by its parent directory and
+/  name, so that opening the same paths again does not scan the directories.
+/  Each entry adds 32 bytes to the file system object. */
+
+#ifndef _FS_REENTRANT
+#define _FS_REENTRANT    0
+#endif
+#ifndef _FS_TIMEOUT
+#define _FS_TIMEOUT    1000
+#endif
+#ifndef _SYNC_t
+#define _SYNC_t        void*
+#endif
+/* When _FS_REENTRANT is set to 1, each volume is locked by a sync object while
+/  a file function works on it, so that tasks can use the file functions on
+/  different volumes at the same time. The user provided functions
+/  ff_cre_syncobj, ff_del_syncobj, ff_req_grant and ff_rel_grant manage the
+/  sync objects of type _SYNC_t, for example an RTOS mutex handle, and
+/  _FS_TIMEOUT is the time ff_req_grant may wait before a file function fails
+/  with FR_TIMEOUT. f_mount itself is not locked. */
+
+#ifndef _USE_SJIS
 #define    _USE_SJIS    1
+#endif
 /* When _USE_SJIS is set to 1, Shift-JIS code transparency is enabled, otherwise
 /  only US-ASCII(7bit) code can be accepted as file/directory name. */
 
+#ifndef _USE_NTFLAG
 #define    _USE_NTFLAG    1
+#endif
 /* When _USE_NTFLAG is set to 1, upper/lower case of the file name is preserved.
 /  Note that the files are always accessed in case insensitive. */
 
@@ -73,6 +136,20 @@
 #endif
 
 
+#if _N_DCACHE
+/* Directory entry cache item */
+typedef struct _DCENT {
+    DWORD    pclust;        /* Start cluster of the parent directory (0:root on FAT12/16) */
+    DWORD    clust;        /* Cluster of the parent directory holding the entry */
+    DWORD    sect;        /* Sector holding the entry (0:empty) */
+    DWORD    sclust;        /* Start cluster of the object */
+    WORD    index;        /* Index of the entry in the parent directory */
+    char    name[8+3];    /* Name in directory entry format */
+    BYTE    attr;        /* Attribute of the object */
+} DCENT;
+#endif
+
+
 /* File system object structure */
 typedef struct _FATFS {
     WORD    id;                /* File system mount ID */
@@ -101,7 +178,19 @@ typedef struct _FATFS {
     BYTE    drive;            /* Physical drive number */
     BYTE    winflag;        /* win[] dirty flag (1:must be written back) */
     BYTE    pad1;
+#if _FS_REENTRANT
+    _SYNC_t    sobj;            /* Sync object of the volume */
+#endif
     BYTE    win[S_MAX_SIZ];    /* Disk access window for Directory/FAT */
+#if _N_WCACHE
+    DWORD    wc_sect[_N_WCACHE];    /* Sector# held in each cache slot (0:empty) */
+    BYTE    wc_flag[_N_WCACHE];    /* Dirty flag of each cache slot (1:must be written back) */
+    BYTE    wc_ord[_N_WCACHE];    /* Cache slot numbers in order of recent use */
+    BYTE    wc_buf[_N_WCACHE][S_MAX_SIZ];    /* Sector cache for Directory/FAT */
+#endif
+#if _N_DCACHE
+    DCENT    dcache[_N_DCACHE];    /* Directory entry cache */
+#endif
 } FATFS;
 
 
@@ -130,6 +219,9 @@ typedef struct _FIL {
 #if _FS_READONLY == 0
     DWORD    dir_sect;        /* Sector containing the directory entry */
     BYTE*    dir_ptr;        /* Ponter to the directory entry in the window */
+#endif
+#if _USE_FASTSEEK
+    DWORD*    cltbl;            /* Pointer to the cluster link map table (NULL:not used) */
 #endif
     BYTE    buffer[S_MAX_SIZ];    /* File R/W buffer */
 } FIL;
@@ -183,7 +275,8 @@ typedef enum {
     FR_NOT_ENABLED,        /* 10 */
     FR_NO_FILESYSTEM,    /* 11 */
     FR_INVALID_OBJECT,    /* 12 */
-    FR_MKFS_ABORTED        /* 13 */
+    FR_MKFS_ABORTED,    /* 13 */
+    FR_TIMEOUT            /* 14 */
 } FRESULT;
 
 
@@ -196,11 +289,13 @@ FRESULT f_open (FIL*, const char*, BYTE);            /* Open or create a file */
 FRESULT f_read (FIL*, void*, WORD, WORD*);            /* Read data from a file */
 FRESULT f_write (FIL*, const void*, WORD, WORD*);    /* Write data to a file */
 FRESULT f_lseek (FIL*, DWORD);                        /* Move file pointer of a file object */
+FRESULT f_linkmap (FIL*, DWORD*, DWORD);            /* Attach a cluster link map table to a file object */
 FRESULT f_close (FIL*);                                /* Close an open file object */
 FRESULT f_opendir (DIR*, const char*);                /* Open an existing directory */
 FRESULT f_readdir (DIR*, FILINFO*);                    /* Read a directory item */
 FRESULT f_stat (const char*, FILINFO*);                /* Get file status */
 FRESULT f_getfree (const char*, DWORD*, FATFS**);    /* Get number of free clusters on the drive */
+FRESULT f_expand (FIL*, DWORD);                        /* Allocate a contiguous area to an empty file */
 FRESULT f_sync (FIL*);                                /* Flush cached data of a writing file */
 FRESULT f_unlink (const char*);                        /* Delete an existing file or directory */
 FRESULT    f_mkdir (const char*);                        /* Create a new directory */
@@ -209,6 +304,16 @@ FRESULT f_rename (const char*, const char*);        /* Rename/Move a file or dir
 FRESULT f_mkfs (BYTE, BYTE, BYTE);                    /* Create a file system on the drive */
 
 
+/* User defined functions to lock the volumes */
+
+#if _FS_REENTRANT
+BOOL ff_cre_syncobj (BYTE, _SYNC_t*);    /* Create a sync object for the logical drive */
+BOOL ff_del_syncobj (_SYNC_t);            /* Delete a sync object */
+BOOL ff_req_grant (_SYNC_t);            /* Lock, wait up to _FS_TIMEOUT */
+void ff_rel_grant (_SYNC_t);            /* Unlock */
+#endif
+
+
 /* User defined function to give a current time to fatfs module */
 
 DWORD get_fattime (void);    /* 31-25: Year(0-127 org.1980), 24-21: Month(1-12), 20-16: Day(1-31) */
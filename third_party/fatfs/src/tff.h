@@ -16,7 +16,12 @@
 
 #ifndef _FATFS
 
+/* The configuration options below can also be given on the compiler command
+/  line, for example -D_USE_MKFS=1, and then the default here is not used. */
+
+#ifndef _MCU_ENDIAN
 #define _MCU_ENDIAN		0
+#endif
 /* The _MCU_ENDIAN defines which access method is used to the FAT structure.
 /  1: Enable word access.
 /  2: Disable word access and use byte-by-byte access instead.
@@ -24,29 +29,41 @@
 /  miss-aligned access is prohibited, the _MCU_ENDIAN must be set to 2.
 /  If it is not the case, it can be set to 1 for good code efficiency. */
 
+#ifndef _FS_READONLY
 #define _FS_READONLY	0
+#endif
 /* Setting _FS_READONLY to 1 defines read only configuration. This removes
 /  writing functions, f_write, f_sync, f_unlink, f_mkdir, f_chmod, f_rename
 /  and useless f_getfree. */
 
+#ifndef _FS_MINIMIZE
 #define _FS_MINIMIZE	0
+#endif
 /* The _FS_MINIMIZE option defines minimization level to remove some functions.
 /  0: Full function.
 /  1: f_stat, f_getfree, f_unlink, f_mkdir, f_chmod and f_rename are removed.
 /  2: f_opendir and f_readdir are removed in addition to level 1.
 /  3: f_lseek is removed in addition to level 2. */
 
+#ifndef _FAT32
 #define _FAT32	0
+#endif
 /* To enable FAT32 support in addition of FAT12/16, set _FAT32 to 1. */
 
+#ifndef _USE_FSINFO
 #define _USE_FSINFO	0
+#endif
 /* To enable FSInfo support on FAT32 volume, set _USE_FSINFO to 1. */
 
+#ifndef _USE_SJIS
 #define	_USE_SJIS	1
+#endif
 /* When _USE_SJIS is set to 1, Shift-JIS code transparency is enabled, otherwise
 /  only US-ASCII(7bit) code can be accepted as file/directory name. */
 
+#ifndef _USE_NTFLAG
 #define	_USE_NTFLAG	1
+#endif
 /* When _USE_NTFLAG is set to 1, upper/lower case of the file name is preserved.
 /  Note that the files are always accessed in case insensitive. */
 
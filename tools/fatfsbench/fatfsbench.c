@@ -0,0 +1,994 @@
+//*****************************************************************************
+//
+// fatfsbench.c - Throughput, seek and lookup benchmarks for FatFs on the host.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+// 
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+// 
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+// 
+// This is part of revision 9453 of the Stellaris Firmware Development Package.
+//
+//*****************************************************************************
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//*****************************************************************************
+//
+// The same source is built against FatFs (ff.c) and, with USE_TFF defined,
+// against Tiny-FatFs (tff.c).  The two modules share their API but not their
+// object layouts, so each gets its own executable.
+//
+//*****************************************************************************
+#ifdef USE_TFF
+#include "tff.h"
+#define MODULE_NAME             "Tiny-FatFs"
+#else
+#include "ff.h"
+#define MODULE_NAME             "FatFs"
+#endif
+#include "diskio.h"
+#include "host-diskio.h"
+
+//*****************************************************************************
+//
+// The chunk sizes used by the throughput tests and the size of the buffer
+// they are taken from.  f_read and f_write take a WORD count.
+//
+//*****************************************************************************
+#define BUFFER_SIZE             32768
+static const unsigned long g_pulChunks[] = { 512, 4096, BUFFER_SIZE };
+#define NUM_CHUNKS              (sizeof(g_pulChunks) / sizeof(unsigned long))
+
+//*****************************************************************************
+//
+// Bytes read at each position by the seek test, and the number of entries in
+// the link map table given to the file when fast seek is available.
+//
+//*****************************************************************************
+#define SEEK_READ_SIZE          64
+#define LINKMAP_SIZE            8192
+
+//*****************************************************************************
+//
+// Globals controlled by various command line parameters.
+//
+//*****************************************************************************
+BOOL g_bQuiet = FALSE;
+BOOL g_bFormat = FALSE;
+BOOL g_bPrivate = FALSE;
+char *g_pszImage = NULL;
+unsigned long g_ulSectors = 131072;
+unsigned long g_ulAllocSize = 4;
+unsigned long g_ulCmdLatency = 0;
+unsigned long g_ulSectLatency = 0;
+unsigned long g_ulFileSize = 4 * 1024 * 1024;
+unsigned long g_ulSeeks = 2000;
+unsigned long g_ulFiles = 32;
+unsigned long g_ulLookups = 2000;
+
+//*****************************************************************************
+//
+// Helpful macros for generating output depending upon the quiet flag.
+//
+//*****************************************************************************
+#define QUIETPRINT(...) if(!g_bQuiet) { fprintf(stderr, __VA_ARGS__); }
+
+//*****************************************************************************
+//
+// The file system work areas and the transfer buffer.
+//
+//*****************************************************************************
+static FATFS g_sFatFs;
+static FIL g_sFile;
+static FIL g_sPadFile;
+static unsigned char g_pucBuffer[BUFFER_SIZE];
+
+//*****************************************************************************
+//
+// Print the welcome banner.
+//
+//*****************************************************************************
+void
+PrintWelcome(void)
+{
+    QUIETPRINT("\nfatfsbench - Benchmark " MODULE_NAME " on a host disk image.\n");
+    QUIETPRINT("Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.\n\n");
+}
+
+//*****************************************************************************
+//
+// Show help on the application command line parameters.
+//
+//*****************************************************************************
+void
+ShowHelp(void)
+{
+    if(g_bQuiet)
+    {
+        return;
+    }
+
+    printf("This application runs " MODULE_NAME " against a memory mapped disk\n");
+    printf("image or a RAM disk and reports read/write throughput, seek cost and\n");
+    printf("directory lookup cost, along with the number of disk calls made.\n");
+    printf("Every byte read back is checked, so it also serves as a regression\n");
+    printf("test.  The exit code is 0 only if all data verified.\n\n");
+    printf("Supported parameters are:\n\n");
+    printf("-i <file> - Disk image file.  Without -i a RAM disk is used.\n");
+    printf("-r        - Map the image privately so that it is not modified.\n");
+    printf("-f        - Format the disk first (creates the image if needed).\n");
+    printf("-s <num>  - Sectors in a new image or RAM disk (default %lu).\n",
+           g_ulSectors);
+    printf("-a <num>  - Sectors per cluster when formatting (default %lu).\n",
+           g_ulAllocSize);
+    printf("-c <us>   - Latency injected per disk command (default 0).\n");
+    printf("-l <us>   - Latency injected per sector (default 0).\n");
+    printf("-b <num>  - Size of the test file in bytes (default %lu).\n",
+           g_ulFileSize);
+    printf("-n <num>  - Number of random seeks (default %lu).\n", g_ulSeeks);
+    printf("-d <num>  - Number of files in the lookup directory (default %lu).\n",
+           g_ulFiles);
+    printf("-k <num>  - Number of path lookups (default %lu).\n", g_ulLookups);
+    printf("-? or -h  - Show this help.\n");
+    printf("-q        - Quiet mode. Disable banner and warnings.\n\n");
+    printf("Example:\n\n");
+    printf("   fatfsbench -f -i card.img -c 300 -l 40\n");
+    printf("   tfatfsbench -r -i card.img -c 300 -l 40\n\n");
+}
+
+//*****************************************************************************
+//
+// Parse the command line, extracting all parameters.
+//
+// Returns 0 on failure, 1 on success.
+//
+//*****************************************************************************
+int
+ParseCommandLine(int argc, char *argv[])
+{
+    int iRetcode;
+    BOOL bShowHelp;
+
+    bShowHelp = FALSE;
+
+    while(1)
+    {
+        iRetcode = getopt(argc, argv, "i:rfs:a:c:l:b:n:d:k:qh?");
+
+        if(iRetcode == -1)
+        {
+            break;
+        }
+
+        switch(iRetcode)
+        {
+            case 'i':
+                g_pszImage = optarg;
+                break;
+
+            case 'r':
+                g_bPrivate = TRUE;
+                break;
+
+            case 'f':
+                g_bFormat = TRUE;
+                break;
+
+            case 's':
+                g_ulSectors = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'a':
+                g_ulAllocSize = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'c':
+                g_ulCmdLatency = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'l':
+                g_ulSectLatency = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'b':
+                g_ulFileSize = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'n':
+                g_ulSeeks = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'd':
+                g_ulFiles = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'k':
+                g_ulLookups = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'q':
+                g_bQuiet = TRUE;
+                break;
+
+            case '?':
+            case 'h':
+                bShowHelp = TRUE;
+                break;
+        }
+    }
+
+    PrintWelcome();
+
+    if(bShowHelp)
+    {
+        ShowHelp();
+        return(0);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Returns the current time in seconds.
+//
+//*****************************************************************************
+double
+Now(void)
+{
+    struct timespec sNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+    return((double)sNow.tv_sec + (double)sNow.tv_nsec / 1e9);
+}
+
+//*****************************************************************************
+//
+// The byte expected at a given offset of the test file.  Mixing in the
+// sector number catches data landing in the wrong sector.
+//
+//*****************************************************************************
+#define PATTERN(ofs)            ((unsigned char)((ofs) * 7 + ((ofs) >> 9)))
+
+void
+FillPattern(unsigned char *pucBuf, unsigned long ulOfs, unsigned long ulLen)
+{
+    while(ulLen--)
+    {
+        *pucBuf++ = PATTERN(ulOfs);
+        ulOfs++;
+    }
+}
+
+BOOL
+CheckPattern(const unsigned char *pucBuf, unsigned long ulOfs,
+             unsigned long ulLen)
+{
+    while(ulLen--)
+    {
+        if(*pucBuf++ != PATTERN(ulOfs))
+        {
+            return(FALSE);
+        }
+        ulOfs++;
+    }
+    return(TRUE);
+}
+
+//*****************************************************************************
+//
+// Prints one result line, with the disk calls made since the last reset of
+// the drive counters.
+//
+//*****************************************************************************
+void
+PrintResult(const char *pcName, double dSeconds, unsigned long ulBytes,
+            unsigned long ulOps)
+{
+    HOST_DISK_STAT sStat;
+
+    host_disk_stat(0, &sStat, TRUE);
+
+    printf("%-24s %9.3f ms", pcName, dSeconds * 1000.0);
+    if(ulBytes)
+    {
+        printf(" %8.2f MB/s", (double)ulBytes / dSeconds / 1e6);
+    }
+    else
+    {
+        printf(" %8.2f us/op", dSeconds * 1e6 / (double)ulOps);
+    }
+    printf("  rd %7lu/%-8lu wr %7lu/%-8lu", (unsigned long)sStat.rd_cmds,
+           (unsigned long)sStat.rd_sects, (unsigned long)sStat.wr_cmds,
+           (unsigned long)sStat.wr_sects);
+    if(!ulBytes && ulOps)
+    {
+        printf(" (%.2f rd/op)", (double)sStat.rd_cmds / (double)ulOps);
+    }
+    printf("\n");
+}
+
+//*****************************************************************************
+//
+// Writes the test file sequentially in chunks of the given size.
+//
+//*****************************************************************************
+BOOL
+WriteTest(const char *pcPath, unsigned long ulChunk)
+{
+    unsigned long ulOfs, ulLen;
+    double dStart;
+    char pcName[32];
+    WORD usDone;
+
+    host_disk_stat(0, NULL, TRUE);
+    dStart = Now();
+
+    if(f_open(&g_sFile, pcPath, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+    {
+        QUIETPRINT("ERROR: Unable to create %s.\n", pcPath);
+        return(FALSE);
+    }
+    for(ulOfs = 0; ulOfs < g_ulFileSize; ulOfs += ulLen)
+    {
+        ulLen = g_ulFileSize - ulOfs;
+        if(ulLen > ulChunk)
+        {
+            ulLen = ulChunk;
+        }
+        FillPattern(g_pucBuffer, ulOfs, ulLen);
+        if((f_write(&g_sFile, g_pucBuffer, (WORD)ulLen, &usDone) != FR_OK) ||
+           (usDone != ulLen))
+        {
+            QUIETPRINT("ERROR: Write failed at offset %lu.\n", ulOfs);
+            f_close(&g_sFile);
+            return(FALSE);
+        }
+    }
+    if(f_close(&g_sFile) != FR_OK)
+    {
+        QUIETPRINT("ERROR: Unable to close %s.\n", pcPath);
+        return(FALSE);
+    }
+
+    snprintf(pcName, sizeof(pcName), "write %lu B chunks", ulChunk);
+    PrintResult(pcName, Now() - dStart, g_ulFileSize, 0);
+    return(TRUE);
+}
+
+//*****************************************************************************
+//
+// Reads the test file sequentially in chunks of the given size, checking
+// every byte.
+//
+//*****************************************************************************
+BOOL
+ReadTest(const char *pcPath, unsigned long ulChunk)
+{
+    unsigned long ulOfs;
+    double dStart;
+    char pcName[32];
+    WORD usDone;
+
+    host_disk_stat(0, NULL, TRUE);
+    dStart = Now();
+
+    if(f_open(&g_sFile, pcPath, FA_READ) != FR_OK)
+    {
+        QUIETPRINT("ERROR: Unable to open %s.\n", pcPath);
+        return(FALSE);
+    }
+    for(ulOfs = 0; ulOfs < g_ulFileSize; ulOfs += usDone)
+    {
+        if((f_read(&g_sFile, g_pucBuffer, (WORD)ulChunk, &usDone) != FR_OK) ||
+           !usDone || !CheckPattern(g_pucBuffer, ulOfs, usDone))
+        {
+            QUIETPRINT("ERROR: Read failed or data mismatch at offset %lu.\n",
+                       ulOfs);
+            f_close(&g_sFile);
+            return(FALSE);
+        }
+    }
+    f_close(&g_sFile);
+
+    snprintf(pcName, sizeof(pcName), "read %lu B chunks", ulChunk);
+    PrintResult(pcName, Now() - dStart, g_ulFileSize, 0);
+    return(TRUE);
+}
+
+//*****************************************************************************
+//
+// Writes the test file one cluster at a time, interleaved with a padding
+// file, so that every cluster of it is a separate fragment.
+//
+//*****************************************************************************
+BOOL
+MakeFragmented(const char *pcPath, const char *pcPad)
+{
+    unsigned long ulOfs, ulLen, ulCluster;
+    WORD usDone;
+
+    ulCluster = (unsigned long)g_sFatFs.sects_clust * 512;
+    if(ulCluster > BUFFER_SIZE)
+    {
+        ulCluster = BUFFER_SIZE;
+    }
+
+    if((f_open(&g_sFile, pcPath, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) ||
+       (f_open(&g_sPadFile, pcPad, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK))
+    {
+        QUIETPRINT("ERROR: Unable to create %s.\n", pcPath);
+        return(FALSE);
+    }
+    for(ulOfs = 0; ulOfs < g_ulFileSize; ulOfs += ulLen)
+    {
+        ulLen = g_ulFileSize - ulOfs;
+        if(ulLen > ulCluster)
+        {
+            ulLen = ulCluster;
+        }
+        FillPattern(g_pucBuffer, ulOfs, ulLen);
+        if((f_write(&g_sFile, g_pucBuffer, (WORD)ulLen, &usDone) != FR_OK) ||
+           (usDone != ulLen) ||
+           (f_write(&g_sPadFile, g_pucBuffer, (WORD)ulLen, &usDone) != FR_OK))
+        {
+            QUIETPRINT("ERROR: Write failed at offset %lu.\n", ulOfs);
+            return(FALSE);
+        }
+    }
+    f_close(&g_sPadFile);
+    return(f_close(&g_sFile) == FR_OK);
+}
+
+//*****************************************************************************
+//
+// Seeks to random offsets of the test file and reads a few bytes at each.
+//
+//*****************************************************************************
+BOOL
+SeekTest(const char *pcPath, const char *pcName)
+{
+    unsigned long ulIdx, ulOfs, ulLen;
+    double dStart;
+    WORD usDone;
+#if !defined(USE_TFF) && _USE_FASTSEEK
+    static DWORD pulLinkMap[LINKMAP_SIZE];
+#endif
+
+    srand(1);
+    host_disk_stat(0, NULL, TRUE);
+    dStart = Now();
+
+    if(f_open(&g_sFile, pcPath, FA_READ) != FR_OK)
+    {
+        QUIETPRINT("ERROR: Unable to open %s.\n", pcPath);
+        return(FALSE);
+    }
+#if !defined(USE_TFF) && _USE_FASTSEEK
+    f_linkmap(&g_sFile, pulLinkMap, LINKMAP_SIZE);
+#endif
+    for(ulIdx = 0; ulIdx < g_ulSeeks; ulIdx++)
+    {
+        ulOfs = (unsigned long)rand() % g_ulFileSize;
+        ulLen = g_ulFileSize - ulOfs;
+        if(ulLen > SEEK_READ_SIZE)
+        {
+            ulLen = SEEK_READ_SIZE;
+        }
+        if((f_lseek(&g_sFile, ulOfs) != FR_OK) ||
+           (f_read(&g_sFile, g_pucBuffer, (WORD)ulLen, &usDone) != FR_OK) ||
+           (usDone != ulLen) || !CheckPattern(g_pucBuffer, ulOfs, ulLen))
+        {
+            QUIETPRINT("ERROR: Seek read failed or data mismatch at offset "
+                       "%lu.\n", ulOfs);
+            f_close(&g_sFile);
+            return(FALSE);
+        }
+    }
+    f_close(&g_sFile);
+
+    PrintResult(pcName, Now() - dStart, 0, g_ulSeeks);
+    return(TRUE);
+}
+
+#ifndef USE_TFF
+//*****************************************************************************
+//
+// Reserves space for a new file with f_expand, searching the whole volume,
+// and unlinks it again.  Returns the result of f_expand and the first cluster
+// given to the file.
+//
+//*****************************************************************************
+FRESULT
+ExpandProbe(const char *pcPath, unsigned long ulClusters, DWORD *pulStart)
+{
+    FRESULT iRes;
+
+    if(f_open(&g_sFile, pcPath, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+    {
+        return(FR_RW_ERROR);
+    }
+
+    //
+    // Search from cluster 2 so that the result does not depend on where the
+    // last allocation ended.
+    //
+    g_sFatFs.last_clust = 0;
+    iRes = f_expand(&g_sFile, ulClusters * g_sFatFs.sects_clust * 512);
+    *pulStart = g_sFile.org_clust;
+
+    //
+    // A refused request must leave the file empty.
+    //
+    if((iRes != FR_OK) && (g_sFile.fsize || g_sFile.org_clust))
+    {
+        iRes = FR_RW_ERROR;
+    }
+    if((f_close(&g_sFile) != FR_OK) || (f_unlink(pcPath) != FR_OK))
+    {
+        iRes = FR_RW_ERROR;
+    }
+    return(iRes);
+}
+
+//*****************************************************************************
+//
+// Reserves ulClusters clusters for a new file with f_expand, then checks that
+// they are contiguous and that the file holds the test pattern once written.
+// Returns the result of f_expand, or FR_RW_ERROR if the file did not verify.
+//
+//*****************************************************************************
+FRESULT
+ExpandFile(const char *pcPath, unsigned long ulClusters)
+{
+    unsigned long ulCluster, ulSize, ulOfs, ulLen, ulIdx;
+    FRESULT iRes;
+    DWORD ulStart;
+    WORD usDone;
+
+    ulCluster = (unsigned long)g_sFatFs.sects_clust * 512;
+    ulSize = ulClusters * ulCluster;
+
+    if(f_open(&g_sFile, pcPath, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+    {
+        return(FR_RW_ERROR);
+    }
+    iRes = f_expand(&g_sFile, ulSize);
+    if(iRes != FR_OK)
+    {
+        if(g_sFile.fsize || g_sFile.org_clust)
+        {
+            iRes = FR_RW_ERROR;
+        }
+        f_close(&g_sFile);
+        return(iRes);
+    }
+    ulStart = g_sFile.org_clust;
+
+    //
+    // Write over the reserved space.
+    //
+    for(ulOfs = 0; ulOfs < ulSize; ulOfs += ulLen)
+    {
+        ulLen = ulSize - ulOfs;
+        if(ulLen > BUFFER_SIZE)
+        {
+            ulLen = BUFFER_SIZE;
+        }
+        FillPattern(g_pucBuffer, ulOfs, ulLen);
+        if((f_write(&g_sFile, g_pucBuffer, (WORD)ulLen, &usDone) != FR_OK) ||
+           (usDone != ulLen))
+        {
+            f_close(&g_sFile);
+            return(FR_RW_ERROR);
+        }
+    }
+    if((f_close(&g_sFile) != FR_OK) ||
+       (f_open(&g_sFile, pcPath, FA_READ) != FR_OK))
+    {
+        return(FR_RW_ERROR);
+    }
+    if(g_sFile.fsize != ulSize)
+    {
+        QUIETPRINT("ERROR: %s is %lu bytes, not %lu.\n", pcPath,
+                   (unsigned long)g_sFile.fsize, ulSize);
+        f_close(&g_sFile);
+        return(FR_RW_ERROR);
+    }
+
+    //
+    // Seeking into each cluster must land on the next cluster number.
+    //
+    for(ulIdx = 0; ulIdx < ulClusters; ulIdx++)
+    {
+        if((f_lseek(&g_sFile, ulIdx * ulCluster + 1) != FR_OK) ||
+           (g_sFile.curr_clust != ulStart + ulIdx))
+        {
+            QUIETPRINT("ERROR: Cluster %lu of %s is not contiguous.\n",
+                       ulIdx, pcPath);
+            f_close(&g_sFile);
+            return(FR_RW_ERROR);
+        }
+    }
+
+    //
+    // Read the data back.
+    //
+    f_lseek(&g_sFile, 0);
+    for(ulOfs = 0; ulOfs < ulSize; ulOfs += usDone)
+    {
+        if((f_read(&g_sFile, g_pucBuffer, BUFFER_SIZE, &usDone) != FR_OK) ||
+           !usDone || !CheckPattern(g_pucBuffer, ulOfs, usDone))
+        {
+            QUIETPRINT("ERROR: Read failed or data mismatch at offset %lu of "
+                       "%s.\n", ulOfs, pcPath);
+            f_close(&g_sFile);
+            return(FR_RW_ERROR);
+        }
+    }
+    f_close(&g_sFile);
+    return(FR_OK);
+}
+
+//*****************************************************************************
+//
+// Tests f_expand on a fragmented volume, with a free block that straddles
+// the point where the search starts and on a full volume.  pcFrag is a file
+// whose clusters are separated by single free clusters.
+//
+//*****************************************************************************
+BOOL
+ExpandTest(const char *pcFrag)
+{
+    unsigned long ulLow, ulHigh, ulMid;
+    DWORD ulStart, ulFree, ulFull;
+    FATFS *psFs;
+    WORD usDone;
+
+    //
+    // Disk latency is not part of these tests.
+    //
+    host_disk_latency(0, 0, 0);
+
+    //
+    // Start the search in the fragmented file, where every free cluster is a
+    // one cluster hole, so that the holes must be skipped.
+    //
+    if(f_open(&g_sFile, pcFrag, FA_READ) != FR_OK)
+    {
+        QUIETPRINT("ERROR: Unable to open %s.\n", pcFrag);
+        return(FALSE);
+    }
+    g_sFatFs.last_clust = g_sFile.org_clust;
+    f_close(&g_sFile);
+    if((ExpandFile("EXPAND.BIN", 4) != FR_OK) ||
+       (f_unlink("EXPAND.BIN") != FR_OK))
+    {
+        QUIETPRINT("ERROR: f_expand failed on a fragmented volume.\n");
+        return(FALSE);
+    }
+    printf("%-24s ok\n", "f_expand, fragmented");
+
+    //
+    // Find the largest contiguous free block.
+    //
+    if(f_getfree("", &ulFree, &psFs) != FR_OK)
+    {
+        return(FALSE);
+    }
+    ulLow = 0;
+    ulHigh = ulFree + 1;
+    while(ulHigh - ulLow > 1)
+    {
+        ulMid = (ulLow + ulHigh) / 2;
+        switch(ExpandProbe("EXPAND.BIN", ulMid, &ulStart))
+        {
+            case FR_OK:
+                ulLow = ulMid;
+                break;
+
+            case FR_DENIED:
+                ulHigh = ulMid;
+                break;
+
+            default:
+                QUIETPRINT("ERROR: f_expand failed.\n");
+                return(FALSE);
+        }
+    }
+    if(ulLow < 2)
+    {
+        QUIETPRINT("ERROR: No free block to test wrap around with.\n");
+        return(FALSE);
+    }
+
+    //
+    // Start the search in the middle of that block.  It can only be found by
+    // carrying on past the start point after wrapping around.
+    //
+    if(ExpandProbe("EXPAND.BIN", ulLow, &ulStart) != FR_OK)
+    {
+        return(FALSE);
+    }
+    g_sFatFs.last_clust = ulStart + (ulLow / 2) - 1;
+    if((ExpandFile("EXPAND.BIN", ulLow) != FR_OK) ||
+       (f_unlink("EXPAND.BIN") != FR_OK))
+    {
+        QUIETPRINT("ERROR: f_expand missed a block straddling the search "
+                   "start.\n");
+        return(FALSE);
+    }
+    printf("%-24s ok\n", "f_expand, wrap around");
+
+    //
+    // Requests larger than the largest block must be refused.
+    //
+    if((ExpandFile("EXPAND.BIN", ulLow + 1) != FR_DENIED) ||
+       (ExpandFile("EXPAND.BIN", ulFree + 1) != FR_DENIED) ||
+       (f_unlink("EXPAND.BIN") != FR_OK))
+    {
+        QUIETPRINT("ERROR: f_expand did not refuse an oversized request.\n");
+        return(FALSE);
+    }
+
+    //
+    // Fill the volume and check that nothing more can be reserved.
+    //
+    if(f_open(&g_sFile, "FULL.BIN", FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+    {
+        return(FALSE);
+    }
+    memset(g_pucBuffer, 0xa5, BUFFER_SIZE);
+    do
+    {
+        if(f_write(&g_sFile, g_pucBuffer, BUFFER_SIZE, &usDone) != FR_OK)
+        {
+            f_close(&g_sFile);
+            return(FALSE);
+        }
+    }
+    while(usDone == BUFFER_SIZE);
+    f_close(&g_sFile);
+    if((f_getfree("", &ulFull, &psFs) != FR_OK) || (ulFull != 0) ||
+       (ExpandFile("EXPAND.BIN", 1) != FR_DENIED) ||
+       (f_unlink("EXPAND.BIN") != FR_OK) || (f_unlink("FULL.BIN") != FR_OK) ||
+       (f_getfree("", &ulFull, &psFs) != FR_OK) || (ulFull != ulFree))
+    {
+        QUIETPRINT("ERROR: f_expand failed on a full volume.\n");
+        return(FALSE);
+    }
+    printf("%-24s ok\n", "f_expand, full volume");
+
+    host_disk_latency(0, g_ulCmdLatency, g_ulSectLatency);
+    return(TRUE);
+}
+#endif
+
+//*****************************************************************************
+//
+// Creates a few levels of directories holding a number of small files, then
+// resolves random paths into it with f_stat and with f_open/f_close.
+//
+//*****************************************************************************
+BOOL
+LookupTest(void)
+{
+    unsigned long ulIdx;
+    double dStart;
+    char pcPath[48];
+    FILINFO sInfo;
+    WORD usDone;
+
+    if(((f_mkdir("LK1") != FR_OK) && (f_mkdir("LK1") != FR_EXIST)) ||
+       ((f_mkdir("LK1/LK2") != FR_OK) && (f_mkdir("LK1/LK2") != FR_EXIST)))
+    {
+        QUIETPRINT("ERROR: Unable to create the lookup directories.\n");
+        return(FALSE);
+    }
+    for(ulIdx = 0; ulIdx < g_ulFiles; ulIdx++)
+    {
+        snprintf(pcPath, sizeof(pcPath), "LK1/LK2/F%05lu.TXT", ulIdx);
+        if((f_open(&g_sFile, pcPath, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) ||
+           (f_write(&g_sFile, pcPath, 16, &usDone) != FR_OK) ||
+           (f_close(&g_sFile) != FR_OK))
+        {
+            QUIETPRINT("ERROR: Unable to create %s.\n", pcPath);
+            return(FALSE);
+        }
+    }
+
+    srand(2);
+    host_disk_stat(0, NULL, TRUE);
+    dStart = Now();
+    for(ulIdx = 0; ulIdx < g_ulLookups; ulIdx++)
+    {
+        snprintf(pcPath, sizeof(pcPath), "LK1/LK2/F%05lu.TXT",
+                 (unsigned long)rand() % g_ulFiles);
+        if((f_stat(pcPath, &sInfo) != FR_OK) || (sInfo.fsize != 16))
+        {
+            QUIETPRINT("ERROR: Lookup of %s failed.\n", pcPath);
+            return(FALSE);
+        }
+    }
+    PrintResult("f_stat lookup", Now() - dStart, 0, g_ulLookups);
+
+    dStart = Now();
+    for(ulIdx = 0; ulIdx < g_ulLookups; ulIdx++)
+    {
+        snprintf(pcPath, sizeof(pcPath), "LK1/LK2/F%05lu.TXT",
+                 (unsigned long)rand() % g_ulFiles);
+        if((f_open(&g_sFile, pcPath, FA_READ) != FR_OK) ||
+           (f_close(&g_sFile) != FR_OK))
+        {
+            QUIETPRINT("ERROR: Open of %s failed.\n", pcPath);
+            return(FALSE);
+        }
+    }
+    PrintResult("f_open/f_close", Now() - dStart, 0, g_ulLookups);
+
+    //
+    // Lookups of names that do not exist scan the whole directory.
+    //
+    dStart = Now();
+    for(ulIdx = 0; ulIdx < g_ulLookups; ulIdx++)
+    {
+        snprintf(pcPath, sizeof(pcPath), "LK1/LK2/N%05lu.TXT",
+                 (unsigned long)rand() % g_ulFiles);
+        if(f_stat(pcPath, &sInfo) != FR_NO_FILE)
+        {
+            QUIETPRINT("ERROR: Lookup of missing %s did not fail.\n", pcPath);
+            return(FALSE);
+        }
+    }
+    PrintResult("missing name lookup", Now() - dStart, 0, g_ulLookups);
+
+    return(TRUE);
+}
+
+//*****************************************************************************
+//
+// Creates an image file of the requested size if it does not exist or is
+// too small to format.
+//
+//*****************************************************************************
+BOOL
+CreateImage(const char *pcPath, unsigned long ulSectors)
+{
+    int iFile;
+    BOOL bOk;
+
+    iFile = open(pcPath, O_RDWR | O_CREAT, 0644);
+    if(iFile < 0)
+    {
+        return(FALSE);
+    }
+    bOk = (ftruncate(iFile, (off_t)ulSectors * 512) == 0) ? TRUE : FALSE;
+    close(iFile);
+    return(bOk);
+}
+
+//*****************************************************************************
+//
+// The main entry point of the benchmark.
+//
+//*****************************************************************************
+int
+main(int argc, char *argv[])
+{
+    unsigned long ulIdx;
+    DWORD ulFree;
+    FATFS *psFs;
+    BOOL bOk;
+
+    if(!ParseCommandLine(argc, argv))
+    {
+        return(1);
+    }
+
+    if(g_ulFileSize == 0 || g_ulFiles == 0)
+    {
+        QUIETPRINT("ERROR: File size and file count must not be zero.\n");
+        return(1);
+    }
+
+    //
+    // Attach the disk.
+    //
+    if(g_pszImage)
+    {
+        if(g_bFormat && !g_bPrivate && !CreateImage(g_pszImage, g_ulSectors))
+        {
+            QUIETPRINT("ERROR: Unable to create image %s.\n", g_pszImage);
+            return(1);
+        }
+        if(host_disk_image(0, g_pszImage, g_bPrivate ? FALSE : TRUE))
+        {
+            QUIETPRINT("ERROR: Unable to map image %s.\n", g_pszImage);
+            return(1);
+        }
+    }
+    else
+    {
+        if(host_disk_ram(0, g_ulSectors))
+        {
+            QUIETPRINT("ERROR: Unable to allocate a RAM disk.\n");
+            return(1);
+        }
+        g_bFormat = TRUE;
+    }
+
+    f_mount(0, &g_sFatFs);
+    if(g_bFormat)
+    {
+#if !defined(USE_TFF) && _USE_MKFS
+        if(f_mkfs(0, 1, (BYTE)g_ulAllocSize) != FR_OK)
+        {
+            QUIETPRINT("ERROR: Unable to format the disk.\n");
+            return(1);
+        }
+#else
+        QUIETPRINT("ERROR: This build cannot format; give a formatted image.\n");
+        return(1);
+#endif
+    }
+
+    //
+    // The latency applies to the measured part only.
+    //
+    host_disk_latency(0, g_ulCmdLatency, g_ulSectLatency);
+    if(f_getfree("", &ulFree, &psFs) != FR_OK)
+    {
+        QUIETPRINT("ERROR: No file system on the disk.\n");
+        return(1);
+    }
+
+    printf("%s: FAT%s, %lu sectors/cluster, %lu free clusters, "
+           "latency %lu us + %lu us/sector\n", MODULE_NAME,
+           (psFs->fs_type == FS_FAT12) ? "12" :
+           (psFs->fs_type == FS_FAT16) ? "16" : "32",
+           (unsigned long)psFs->sects_clust, (unsigned long)ulFree,
+           g_ulCmdLatency, g_ulSectLatency);
+
+    bOk = TRUE;
+    for(ulIdx = 0; bOk && (ulIdx < NUM_CHUNKS); ulIdx++)
+    {
+        bOk = WriteTest("BENCH.BIN", g_pulChunks[ulIdx]) &&
+              ReadTest("BENCH.BIN", g_pulChunks[ulIdx]);
+    }
+    bOk = bOk && SeekTest("BENCH.BIN", "seek, contiguous") &&
+          MakeFragmented("FRAG.BIN", "PAD.BIN") &&
+          SeekTest("FRAG.BIN", "seek, fragmented") &&
+          (f_unlink("PAD.BIN") == FR_OK) &&
+#ifndef USE_TFF
+          ExpandTest("FRAG.BIN") &&
+#endif
+          LookupTest() && (f_unlink("FRAG.BIN") == FR_OK);
+
+    f_mount(0, NULL);
+    host_disk_release(0);
+
+    if(!bOk)
+    {
+        printf("FAIL\n");
+        return(1);
+    }
+    return(0);
+}
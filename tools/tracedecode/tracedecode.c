@@ -0,0 +1,702 @@
+//*****************************************************************************
+//
+// tracedecode.c - Decoder for the binary stream produced by utils/tracerec.c.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+// 
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+// 
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+// 
+// This is part of revision 9453 of the Stellaris Firmware Development Package.
+//
+//*****************************************************************************
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef unsigned char BOOL;
+#define FALSE 0
+#define TRUE  1
+
+//*****************************************************************************
+//
+// The trace stream definitions shared with the target.
+//
+//*****************************************************************************
+#include "../../utils/tracerec.h"
+
+//*****************************************************************************
+//
+// The size of each event in the stream, and the maximum number of each kind of
+// object that can be tracked.  Ids are 8 bits wide in the stream.
+//
+//*****************************************************************************
+#define EVENT_SIZE              8
+#define MAX_IDS                 256
+#define MAX_NAME_LEN            64
+#define MAX_ISR_NESTING         32
+
+//*****************************************************************************
+//
+// Globals controlled by various command line parameters.
+//
+//*****************************************************************************
+BOOL g_bQuiet = FALSE;
+BOOL g_bTimeline = FALSE;
+BOOL g_bStats = TRUE;
+unsigned long g_ulClockOverride = 0;
+char *g_pszInput = NULL;
+
+//*****************************************************************************
+//
+// Helpful macros for generating output depending upon the quiet flag.
+//
+//*****************************************************************************
+#define QUIETPRINT(...) if(!g_bQuiet) { fprintf(stderr, __VA_ARGS__); }
+
+//*****************************************************************************
+//
+// The statistics gathered for each task, interrupt and queue.
+//
+//*****************************************************************************
+typedef struct
+{
+    char pcName[MAX_NAME_LEN];
+    unsigned long ulSwitches;
+    unsigned long long ullCycles;
+}
+tTaskStats;
+
+typedef struct
+{
+    unsigned long ulCount;
+    unsigned long long ullCycles;
+    unsigned long long ullMaxCycles;
+}
+tISRStats;
+
+typedef struct
+{
+    BOOL bCreated;
+    unsigned long ulType;
+    unsigned long ulSends;
+    unsigned long ulReceives;
+    unsigned long ulBlockSends;
+    unsigned long ulBlockReceives;
+    unsigned long ulMaxWaiting;
+}
+tQueueStats;
+
+tTaskStats g_psTasks[MAX_IDS];
+tISRStats g_psISRs[MAX_IDS];
+tQueueStats g_psQueues[MAX_IDS];
+
+//*****************************************************************************
+//
+// Decoder state.
+//
+//*****************************************************************************
+unsigned long g_ulClock = 0;
+unsigned long long g_ullCycleBase = 0;
+unsigned long g_ulLastCycles = 0;
+unsigned long long g_ullLastTime = 0;
+unsigned long long g_ullFirstTime = 0;
+BOOL g_bTimeValid = FALSE;
+unsigned long g_ulCurrentTask = 0;
+unsigned long g_pulISRStack[MAX_ISR_NESTING];
+unsigned long long g_pullISRStart[MAX_ISR_NESTING];
+unsigned long g_ulISRDepth = 0;
+unsigned long g_ulLost = 0;
+unsigned long g_ulLastNameId = 0xFFFFFFFF;
+
+//*****************************************************************************
+//
+// Reads a little endian value from the stream.
+//
+//*****************************************************************************
+#define READ_LONG(ptr)                                                        \
+    ((unsigned long)(ptr)[0] | ((unsigned long)(ptr)[1] << 8) |               \
+     ((unsigned long)(ptr)[2] << 16) | ((unsigned long)(ptr)[3] << 24))
+#define READ_SHORT(ptr)                                                       \
+    ((unsigned long)(ptr)[0] | ((unsigned long)(ptr)[1] << 8))
+
+//*****************************************************************************
+//
+// Print the welcome banner.
+//
+//*****************************************************************************
+void
+PrintWelcome(void)
+{
+    QUIETPRINT("\ntracedecode - Decode an RTOS trace recorder stream.\n");
+    QUIETPRINT("Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.\n\n");
+}
+
+//*****************************************************************************
+//
+// Show help on the application command line parameters.
+//
+//*****************************************************************************
+void
+ShowHelp(void)
+{
+    if(g_bQuiet)
+    {
+        return;
+    }
+
+    printf("This application decodes the binary trace stream produced by the\n");
+    printf("trace recorder in utils/tracerec.c, as captured from a UART or USB\n");
+    printf("bulk endpoint, into a timeline and per task CPU statistics.\n\n");
+    printf("Supported parameters are:\n\n");
+    printf("-i <file> - The name of the captured stream (default stdin).\n");
+    printf("-t        - Print a timeline of every event.\n");
+    printf("-n        - Do not print the statistics summary.\n");
+    printf("-c <num>  - Override the CPU clock rate in Hz sent by the target.\n");
+    printf("-? or -h  - Show this help.\n");
+    printf("-q        - Quiet mode. Disable banner and warnings.\n\n");
+    printf("Example:\n\n");
+    printf("   cat /dev/ttyACM0 > trace.bin\n");
+    printf("   tracedecode -i trace.bin -t\n\n");
+}
+
+//*****************************************************************************
+//
+// Parse the command line, extracting all parameters.
+//
+// Returns 0 on failure, 1 on success.
+//
+//*****************************************************************************
+int
+ParseCommandLine(int argc, char *argv[])
+{
+    int iRetcode;
+    BOOL bShowHelp;
+
+    bShowHelp = FALSE;
+
+    while(1)
+    {
+        iRetcode = getopt(argc, argv, "i:c:tnqh?");
+
+        if(iRetcode == -1)
+        {
+            break;
+        }
+
+        switch(iRetcode)
+        {
+            case 'i':
+                g_pszInput = optarg;
+                break;
+
+            case 'c':
+                g_ulClockOverride = (unsigned long)strtoul(optarg, NULL, 0);
+                break;
+
+            case 't':
+                g_bTimeline = TRUE;
+                break;
+
+            case 'n':
+                g_bStats = FALSE;
+                break;
+
+            case 'q':
+                g_bQuiet = TRUE;
+                break;
+
+            case '?':
+            case 'h':
+                bShowHelp = TRUE;
+                break;
+        }
+    }
+
+    PrintWelcome();
+
+    if(bShowHelp)
+    {
+        ShowHelp();
+        return(0);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Returns a printable name for a task id.
+//
+//*****************************************************************************
+const char *
+TaskName(unsigned long ulId)
+{
+    static char pcBuffer[16];
+
+    if(g_psTasks[ulId].pcName[0])
+    {
+        return(g_psTasks[ulId].pcName);
+    }
+
+    snprintf(pcBuffer, sizeof(pcBuffer), "task%lu", ulId);
+    return(pcBuffer);
+}
+
+//*****************************************************************************
+//
+// Converts a cycle count to microseconds.
+//
+//*****************************************************************************
+double
+CyclesToMicroseconds(unsigned long long ullCycles)
+{
+    unsigned long ulClock;
+
+    ulClock = g_ulClockOverride ? g_ulClockOverride : g_ulClock;
+
+    return(ulClock ? ((double)ullCycles * 1000000.0) / (double)ulClock :
+                     (double)ullCycles);
+}
+
+//*****************************************************************************
+//
+// Charges the time since the previous event to whatever was running, either
+// the innermost active interrupt or the current task.
+//
+//*****************************************************************************
+void
+AccountTime(unsigned long long ullNow)
+{
+    unsigned long long ullDelta;
+
+    if(!g_bTimeValid)
+    {
+        g_ullFirstTime = ullNow;
+        g_ullLastTime = ullNow;
+        g_bTimeValid = TRUE;
+        return;
+    }
+
+    ullDelta = ullNow - g_ullLastTime;
+    g_ullLastTime = ullNow;
+
+    if(g_ulISRDepth)
+    {
+        g_psISRs[g_pulISRStack[g_ulISRDepth - 1]].ullCycles += ullDelta;
+    }
+    else
+    {
+        g_psTasks[g_ulCurrentTask].ullCycles += ullDelta;
+    }
+}
+
+//*****************************************************************************
+//
+// Decodes a single event.
+//
+//*****************************************************************************
+void
+DecodeEvent(const unsigned char *pucEvent)
+{
+    unsigned long ulCycles, ulEvent, ulId, ulData, ulLen;
+    unsigned long long ullNow;
+    tTaskStats *psTask;
+    char *pcName;
+
+    ulCycles = READ_LONG(pucEvent);
+    ulEvent = pucEvent[4];
+    ulId = pucEvent[5];
+    ulData = READ_SHORT(pucEvent + 6);
+
+    //
+    // Task name events carry characters rather than a timestamp.
+    //
+    if(ulEvent == TRACEREC_EVENT_TASK_NAME)
+    {
+        psTask = &g_psTasks[ulId];
+
+        //
+        // A name is sent as a consecutive run of events, so start a new name
+        // if the previous event was not part of this one.
+        //
+        if(g_ulLastNameId != ulId)
+        {
+            psTask->pcName[0] = 0;
+        }
+        g_ulLastNameId = ulId;
+
+        ulLen = strlen(psTask->pcName);
+        if(ulLen + 7 <= MAX_NAME_LEN)
+        {
+            pcName = psTask->pcName + ulLen;
+            pcName[0] = (char)(ulCycles & 0xFF);
+            pcName[1] = (char)((ulCycles >> 8) & 0xFF);
+            pcName[2] = (char)((ulCycles >> 16) & 0xFF);
+            pcName[3] = (char)((ulCycles >> 24) & 0xFF);
+            pcName[4] = (char)(ulData & 0xFF);
+            pcName[5] = (char)((ulData >> 8) & 0xFF);
+            pcName[6] = 0;
+        }
+        return;
+    }
+    g_ulLastNameId = 0xFFFFFFFF;
+
+    //
+    // A header starts a new session; the cycle counter may have been reset.
+    //
+    if(ulEvent == TRACEREC_EVENT_HEADER)
+    {
+        g_ulClock = ulCycles;
+        g_ulLastCycles = 0;
+        g_ullCycleBase = g_bTimeValid ? g_ullLastTime : 0;
+        g_ulISRDepth = 0;
+        if(g_bTimeline)
+        {
+            printf("# session start, version %lu, clock %lu Hz\n", ulId,
+                   g_ulClock);
+        }
+        return;
+    }
+
+    //
+    // Extend the 32 bit cycle counter to 64 bits.  This assumes at least one
+    // event is recorded every 2^32 cycles.
+    //
+    if(ulCycles < g_ulLastCycles)
+    {
+        g_ullCycleBase += 0x100000000ULL;
+    }
+    g_ulLastCycles = ulCycles;
+    ullNow = g_ullCycleBase + ulCycles;
+
+    AccountTime(ullNow);
+
+    if(g_bTimeline)
+    {
+        printf("%14.3f  ", CyclesToMicroseconds(ullNow - g_ullFirstTime));
+    }
+
+    switch(ulEvent)
+    {
+        case TRACEREC_EVENT_TASK_SWITCH:
+        {
+            g_ulCurrentTask = ulId;
+            g_psTasks[ulId].ulSwitches++;
+            if(g_bTimeline)
+            {
+                printf("switch        %s\n", TaskName(ulId));
+            }
+            break;
+        }
+
+        case TRACEREC_EVENT_ISR_ENTER:
+        {
+            g_psISRs[ulId].ulCount++;
+            if(g_ulISRDepth < MAX_ISR_NESTING)
+            {
+                g_pulISRStack[g_ulISRDepth] = ulId;
+                g_pullISRStart[g_ulISRDepth] = ullNow;
+                g_ulISRDepth++;
+            }
+            if(g_bTimeline)
+            {
+                printf("isr enter     %lu\n", ulId);
+            }
+            break;
+        }
+
+        case TRACEREC_EVENT_ISR_EXIT:
+        {
+            if(g_ulISRDepth && (g_pulISRStack[g_ulISRDepth - 1] == ulId))
+            {
+                g_ulISRDepth--;
+                if((ullNow - g_pullISRStart[g_ulISRDepth]) >
+                   g_psISRs[ulId].ullMaxCycles)
+                {
+                    g_psISRs[ulId].ullMaxCycles =
+                        ullNow - g_pullISRStart[g_ulISRDepth];
+                }
+            }
+            if(g_bTimeline)
+            {
+                printf("isr exit      %lu\n", ulId);
+            }
+            break;
+        }
+
+        case TRACEREC_EVENT_QUEUE_CREATE:
+        {
+            g_psQueues[ulId].bCreated = TRUE;
+            g_psQueues[ulId].ulType = ulData;
+            if(g_bTimeline)
+            {
+                printf("queue create  q%lu type %lu\n", ulId, ulData);
+            }
+            break;
+        }
+
+        case TRACEREC_EVENT_QUEUE_SEND:
+        case TRACEREC_EVENT_QUEUE_RECEIVE:
+        {
+            if(ulEvent == TRACEREC_EVENT_QUEUE_SEND)
+            {
+                g_psQueues[ulId].ulSends++;
+            }
+            else
+            {
+                g_psQueues[ulId].ulReceives++;
+            }
+            if(ulData > g_psQueues[ulId].ulMaxWaiting)
+            {
+                g_psQueues[ulId].ulMaxWaiting = ulData;
+            }
+            if(g_bTimeline)
+            {
+                printf("%s q%lu (%lu waiting) by %s\n",
+                       (ulEvent == TRACEREC_EVENT_QUEUE_SEND) ?
+                       "queue send   " : "queue receive",
+                       ulId, ulData, g_ulISRDepth ? "isr" :
+                       TaskName(g_ulCurrentTask));
+            }
+            break;
+        }
+
+        case TRACEREC_EVENT_QUEUE_BLOCK_SEND:
+        case TRACEREC_EVENT_QUEUE_BLOCK_RECEIVE:
+        {
+            if(ulEvent == TRACEREC_EVENT_QUEUE_BLOCK_SEND)
+            {
+                g_psQueues[ulId].ulBlockSends++;
+            }
+            else
+            {
+                g_psQueues[ulId].ulBlockReceives++;
+            }
+            if(g_bTimeline)
+            {
+                printf("%s q%lu by %s\n",
+                       (ulEvent == TRACEREC_EVENT_QUEUE_BLOCK_SEND) ?
+                       "block send   " : "block receive",
+                       ulId, TaskName(g_ulCurrentTask));
+            }
+            break;
+        }
+
+        case TRACEREC_EVENT_LOST:
+        {
+            //
+            // Anything could have happened in the gap, so interrupt nesting
+            // can no longer be trusted.
+            //
+            g_ulLost += ulData;
+            g_ulISRDepth = 0;
+            QUIETPRINT("WARNING: %lu events lost by the target.\n", ulData);
+            if(g_bTimeline)
+            {
+                printf("lost          %lu events\n", ulData);
+            }
+            break;
+        }
+
+        case TRACEREC_EVENT_USER:
+        {
+            if(g_bTimeline)
+            {
+                printf("user          id %lu data 0x%04lx\n", ulId, ulData);
+            }
+            break;
+        }
+
+        default:
+        {
+            if(g_bTimeline)
+            {
+                printf("unknown       event %lu id %lu data %lu\n", ulEvent,
+                       ulId, ulData);
+            }
+            break;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Returns TRUE if the bytes at pucEvent form a stream header.
+//
+//*****************************************************************************
+BOOL
+IsHeader(const unsigned char *pucEvent)
+{
+    return((pucEvent[4] == TRACEREC_EVENT_HEADER) &&
+           (READ_SHORT(pucEvent + 6) == TRACEREC_MAGIC));
+}
+
+//*****************************************************************************
+//
+// Prints the statistics gathered over the whole stream.
+//
+//*****************************************************************************
+void
+PrintStats(void)
+{
+    unsigned long long ullTotal;
+    unsigned long ulIdx;
+
+    ullTotal = g_bTimeValid ? (g_ullLastTime - g_ullFirstTime) : 0;
+
+    printf("\nTotal traced time: %.3f us (%llu cycles)\n",
+           CyclesToMicroseconds(ullTotal), ullTotal);
+    if(g_ulLost)
+    {
+        printf("Lost events: %lu (statistics are approximate)\n", g_ulLost);
+    }
+
+    printf("\n%-20s %10s %16s %14s %7s\n", "Task", "Switches", "Cycles",
+           "Time (us)", "CPU %");
+    for(ulIdx = 0; ulIdx < MAX_IDS; ulIdx++)
+    {
+        if(g_psTasks[ulIdx].ulSwitches || g_psTasks[ulIdx].ullCycles)
+        {
+            printf("%-20s %10lu %16llu %14.3f %6.2f%%\n", TaskName(ulIdx),
+                   g_psTasks[ulIdx].ulSwitches, g_psTasks[ulIdx].ullCycles,
+                   CyclesToMicroseconds(g_psTasks[ulIdx].ullCycles),
+                   ullTotal ? (100.0 * (double)g_psTasks[ulIdx].ullCycles /
+                               (double)ullTotal) : 0.0);
+        }
+    }
+
+    printf("\n%-20s %10s %16s %14s %7s\n", "Interrupt", "Count", "Cycles",
+           "Max (us)", "CPU %");
+    for(ulIdx = 0; ulIdx < MAX_IDS; ulIdx++)
+    {
+        if(g_psISRs[ulIdx].ulCount)
+        {
+            printf("vector %-13lu %10lu %16llu %14.3f %6.2f%%\n", ulIdx,
+                   g_psISRs[ulIdx].ulCount, g_psISRs[ulIdx].ullCycles,
+                   CyclesToMicroseconds(g_psISRs[ulIdx].ullMaxCycles),
+                   ullTotal ? (100.0 * (double)g_psISRs[ulIdx].ullCycles /
+                               (double)ullTotal) : 0.0);
+        }
+    }
+
+    printf("\n%-20s %10s %10s %10s %10s %10s\n", "Queue", "Sends",
+           "Receives", "Blk send", "Blk recv", "Max depth");
+    for(ulIdx = 0; ulIdx < MAX_IDS; ulIdx++)
+    {
+        if(g_psQueues[ulIdx].bCreated || g_psQueues[ulIdx].ulSends ||
+           g_psQueues[ulIdx].ulReceives)
+        {
+            printf("q%-19lu %10lu %10lu %10lu %10lu %10lu\n", ulIdx,
+                   g_psQueues[ulIdx].ulSends, g_psQueues[ulIdx].ulReceives,
+                   g_psQueues[ulIdx].ulBlockSends,
+                   g_psQueues[ulIdx].ulBlockReceives,
+                   g_psQueues[ulIdx].ulMaxWaiting);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Main entry function for the application.
+//
+//*****************************************************************************
+int
+main(int argc, char *argv[])
+{
+    FILE *fhInput;
+    unsigned char pucEvent[EVENT_SIZE];
+    unsigned long ulFill, ulSkipped;
+    BOOL bSynced;
+    int iChar;
+
+    if(!ParseCommandLine(argc, argv))
+    {
+        return(1);
+    }
+
+    if(g_pszInput && strcmp(g_pszInput, "-"))
+    {
+        fhInput = fopen(g_pszInput, "rb");
+        if(!fhInput)
+        {
+            QUIETPRINT("ERROR: Unable to open input file %s.\n", g_pszInput);
+            return(1);
+        }
+    }
+    else
+    {
+        fhInput = stdin;
+    }
+
+    //
+    // The capture may have started part way through an event, so slide a
+    // window through the input one byte at a time until a header is found,
+    // then decode whole events from there on.
+    //
+    bSynced = FALSE;
+    ulFill = 0;
+    ulSkipped = 0;
+
+    while((iChar = fgetc(fhInput)) != EOF)
+    {
+        pucEvent[ulFill++] = (unsigned char)iChar;
+
+        if(ulFill < EVENT_SIZE)
+        {
+            continue;
+        }
+
+        if(!bSynced)
+        {
+            if(!IsHeader(pucEvent))
+            {
+                memmove(pucEvent, pucEvent + 1, EVENT_SIZE - 1);
+                ulFill = EVENT_SIZE - 1;
+                ulSkipped++;
+                continue;
+            }
+            bSynced = TRUE;
+        }
+
+        DecodeEvent(pucEvent);
+        ulFill = 0;
+    }
+
+    if(fhInput != stdin)
+    {
+        fclose(fhInput);
+    }
+
+    if(!bSynced)
+    {
+        QUIETPRINT("ERROR: No trace header found in the input.\n");
+        return(1);
+    }
+
+    if(ulSkipped)
+    {
+        QUIETPRINT("Skipped %lu bytes before the first header.\n", ulSkipped);
+    }
+
+    if(g_bStats)
+    {
+        PrintStats();
+    }
+
+    return(0);
+}
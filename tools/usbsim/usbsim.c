@@ -0,0 +1,1758 @@
+//*****************************************************************************
+//
+// usbsim.c - A model of the USB0 controller in device mode.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+//
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+//
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+//
+// This is part of revision 9453 of the Stellaris Firmware Development Package.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "inc/hw_usb.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/udma.h"
+#include "driverlib/usb.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The largest packet the model holds.  Full speed isochronous endpoints may
+// use up to 1023 bytes.
+//
+//*****************************************************************************
+#define MAX_PACKET              1024
+
+//*****************************************************************************
+//
+// The number of back to back interrupt handler calls after which the model
+// decides that the handler is failing to clear an interrupt source.
+//
+//*****************************************************************************
+#define MAX_INT_LOOPS           10000
+
+//*****************************************************************************
+//
+// One packet held in an endpoint FIFO.  ulRead is the number of bytes of a
+// received packet that the device has already read from the FIFO.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char pucData[MAX_PACKET];
+    unsigned long ulSize;
+    unsigned long ulRead;
+}
+tSimPacket;
+
+//*****************************************************************************
+//
+// One direction of an endpoint.  A FIFO holds one packet or, when double
+// buffered, two.  Transmit data written with USBEndpointDataPut() collects in
+// the stage buffer until USBEndpointDataSend() commits it as a packet.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulMaxPacket;
+    unsigned long ulFlags;
+    unsigned long ulFIFOAddr;
+    unsigned long ulFIFOSize;
+    unsigned long ulDepth;
+    unsigned long ulDMAFlags;
+    unsigned long ulDMAChannel;
+    tBoolean bDMAEnabled;
+    unsigned long ulStatus;
+    tSimPacket psPackets[2];
+    unsigned long ulHead;
+    unsigned long ulCount;
+    unsigned char pucStage[MAX_PACKET];
+    unsigned long ulStage;
+}
+tSimFIFO;
+
+//*****************************************************************************
+//
+// One uDMA channel control structure.  The memory side of a transfer is
+// pucSrc for an IN endpoint and pucDst for an OUT endpoint, and ulRemaining
+// counts the bytes still to be moved.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulMode;
+    unsigned long ulItemSize;
+    unsigned char *pucSrc;
+    unsigned char *pucDst;
+    unsigned long ulRemaining;
+}
+tSimDMAStruct;
+
+//*****************************************************************************
+//
+// One uDMA channel.  Only the USB endpoint channels are modeled.  Each has a
+// primary and an alternate control structure; ulAlt selects the one in use,
+// which only changes when a ping-pong transfer completes or the
+// UDMA_ATTR_ALTSELECT attribute is changed.
+//
+//*****************************************************************************
+typedef struct
+{
+    tSimDMAStruct psStruct[2];
+    unsigned long ulAlt;
+    tBoolean bEnabled;
+}
+tSimDMAChannel;
+
+//*****************************************************************************
+//
+// The number of uDMA channels.
+//
+//*****************************************************************************
+#define NUM_DMA_CHANNELS        32
+
+//*****************************************************************************
+//
+// The controller state.  g_psTx holds the IN (device to host) side of each
+// endpoint and g_psRx the OUT side.  Endpoint 0 uses entry 0 of both, with
+// its control and status bits kept in g_ulCSR0.
+//
+//*****************************************************************************
+static tSimFIFO g_psTx[USBSIM_NUM_EP];
+static tSimFIFO g_psRx[USBSIM_NUM_EP];
+static tSimDMAChannel g_psDMA[NUM_DMA_CHANNELS];
+static unsigned long g_ulCSR0;
+static unsigned long g_ulAddress;
+static unsigned long g_ulFrame;
+static tBoolean g_bConnected;
+
+//*****************************************************************************
+//
+// Interrupt status and enable registers.  The transmit and receive endpoint
+// registers hold one bit per endpoint.
+//
+//*****************************************************************************
+static unsigned long g_ulTxIS, g_ulRxIS, g_ulCtrlIS;
+static unsigned long g_ulTxIE, g_ulRxIE, g_ulCtrlIE;
+
+//*****************************************************************************
+//
+// Set when a USB uDMA channel completes.  The controller raises the USB
+// interrupt for this without setting any bit in its own status registers.
+//
+//*****************************************************************************
+static tBoolean g_bDMAIntPending;
+
+//*****************************************************************************
+//
+// The uDMA channel completion status returned by uDMAIntStatus().
+//
+//*****************************************************************************
+static unsigned long g_ulDMAIntStatus;
+
+//*****************************************************************************
+//
+// The interrupt controller state seen by the USB interrupt.
+//
+//*****************************************************************************
+static void (*g_pfnIntHandler)(void);
+static tBoolean g_bUSBIntEnabled;
+static tBoolean g_bMasterDisabled;
+static tBoolean g_bInHandler;
+
+//*****************************************************************************
+//
+// Counters returned by USBSimStatsGet().
+//
+//*****************************************************************************
+static tUSBSimStats g_sStats;
+
+//*****************************************************************************
+//
+// Converts a driverlib endpoint identifier (USB_EP_n) to an endpoint index.
+//
+//*****************************************************************************
+#define EP_INDEX(ulEndpoint)    USB_EP_TO_INDEX(ulEndpoint)
+
+//*****************************************************************************
+//
+// Reports a misuse of the driverlib API that would be undefined behavior on
+// the real controller.
+//
+//*****************************************************************************
+static void
+SimFault(const char *pcMessage, unsigned long ulEndpoint)
+{
+    fprintf(stderr, "usbsim: %s (endpoint %lu)\n", pcMessage,
+            EP_INDEX(ulEndpoint));
+    abort();
+}
+
+static void DMAService(void);
+
+//*****************************************************************************
+//
+// Determines whether any enabled interrupt source is pending.
+//
+//*****************************************************************************
+static tBoolean
+IntPending(void)
+{
+    return((g_bDMAIntPending || (g_ulTxIS & g_ulTxIE) ||
+            (g_ulRxIS & g_ulRxIE) || (g_ulCtrlIS & g_ulCtrlIE)) ?
+           true : false);
+}
+
+//*****************************************************************************
+//
+// Lets the uDMA controller run, then calls the interrupt handler for as long
+// as an enabled source is pending, unless the interrupt is disabled, masked
+// or already active.
+//
+//*****************************************************************************
+static void
+IntDeliver(void)
+{
+    unsigned long ulLoops;
+
+    DMAService();
+
+    if(!g_pfnIntHandler || !g_bUSBIntEnabled || g_bMasterDisabled ||
+       g_bInHandler)
+    {
+        return;
+    }
+
+    for(ulLoops = 0; IntPending(); ulLoops++)
+    {
+        if(ulLoops == MAX_INT_LOOPS)
+        {
+            SimFault("interrupt source never cleared", 0);
+        }
+
+        g_bInHandler = true;
+        g_bDMAIntPending = false;
+        g_sStats.ulInterrupts++;
+        g_pfnIntHandler();
+        g_bInHandler = false;
+
+        DMAService();
+    }
+}
+
+//*****************************************************************************
+//
+// Discards all packets held by one direction of an endpoint.
+//
+//*****************************************************************************
+static void
+FIFOFlush(tSimFIFO *psFIFO)
+{
+    psFIFO->ulHead = 0;
+    psFIFO->ulCount = 0;
+    psFIFO->ulStage = 0;
+}
+
+//*****************************************************************************
+//
+// Adds a packet to the tail of a FIFO.  The caller has checked for space.
+//
+//*****************************************************************************
+static void
+FIFOPush(tSimFIFO *psFIFO, const unsigned char *pucData, unsigned long ulSize)
+{
+    tSimPacket *psPacket;
+
+    psPacket = &psFIFO->psPackets[(psFIFO->ulHead + psFIFO->ulCount) % 2];
+    memcpy(psPacket->pucData, pucData, ulSize);
+    psPacket->ulSize = ulSize;
+    psPacket->ulRead = 0;
+    psFIFO->ulCount++;
+}
+
+//*****************************************************************************
+//
+// Removes the packet at the head of a FIFO.
+//
+//*****************************************************************************
+static void
+FIFOPop(tSimFIFO *psFIFO)
+{
+    if(psFIFO->ulCount)
+    {
+        psFIFO->ulHead = (psFIFO->ulHead + 1) % 2;
+        psFIFO->ulCount--;
+    }
+}
+
+//*****************************************************************************
+//
+// Determines whether a FIFO has no room for another packet, which is what the
+// TXRDY bit shows for a transmit FIFO.
+//
+//*****************************************************************************
+static tBoolean
+FIFOFull(const tSimFIFO *psFIFO)
+{
+    return((psFIFO->ulCount >= psFIFO->ulDepth) ? true : false);
+}
+
+//*****************************************************************************
+//
+// Determines whether an endpoint is making uDMA requests in request mode 1.
+// In this mode the controller raises no endpoint interrupt for the maximum
+// size packets that the uDMA controller moves.
+//
+//*****************************************************************************
+static tBoolean
+DMAMode1(const tSimFIFO *psFIFO)
+{
+    return((psFIFO->bDMAEnabled && (psFIFO->ulDMAFlags & USB_EP_DMA_MODE_1)) ?
+           true : false);
+}
+
+//*****************************************************************************
+//
+// Returns the control structure in use on the uDMA channel serving an
+// endpoint if a transfer is running on it, or 0 otherwise.
+//
+//*****************************************************************************
+static tSimDMAStruct *
+DMAActive(const tSimFIFO *psFIFO)
+{
+    tSimDMAChannel *psChannel;
+    tSimDMAStruct *psStruct;
+
+    if(!psFIFO->bDMAEnabled || (psFIFO->ulDMAChannel >= NUM_DMA_CHANNELS))
+    {
+        return(0);
+    }
+
+    psChannel = &g_psDMA[psFIFO->ulDMAChannel];
+    psStruct = &psChannel->psStruct[psChannel->ulAlt];
+    if(!psChannel->bEnabled || (psStruct->ulMode == UDMA_MODE_STOP))
+    {
+        return(0);
+    }
+
+    return(psStruct);
+}
+
+//*****************************************************************************
+//
+// Ends the transfer described by the control structure in use on a uDMA
+// channel, which raises the USB interrupt.  A ping-pong transfer carries on
+// with the other control structure unless that has been stopped too.
+//
+//*****************************************************************************
+static void
+DMADone(unsigned long ulChannel)
+{
+    tSimDMAChannel *psChannel;
+    tSimDMAStruct *psStruct;
+
+    psChannel = &g_psDMA[ulChannel];
+    psStruct = &psChannel->psStruct[psChannel->ulAlt];
+
+    if(psStruct->ulMode == UDMA_MODE_PINGPONG)
+    {
+        psChannel->ulAlt ^= 1;
+    }
+    psStruct->ulMode = UDMA_MODE_STOP;
+
+    if(psChannel->psStruct[psChannel->ulAlt].ulMode == UDMA_MODE_STOP)
+    {
+        psChannel->bEnabled = false;
+    }
+
+    g_ulDMAIntStatus |= 1 << ulChannel;
+    g_bDMAIntPending = true;
+}
+
+//*****************************************************************************
+//
+// Raises the receive interrupt for the packet now at the head of an OUT
+// FIFO, unless it is a maximum size packet that the uDMA controller will
+// take.
+//
+//*****************************************************************************
+static void
+RxHeadSignal(unsigned long ulEP)
+{
+    tSimFIFO *psFIFO;
+
+    psFIFO = &g_psRx[ulEP];
+
+    if(psFIFO->ulCount &&
+       !(DMAMode1(psFIFO) &&
+         (psFIFO->psPackets[psFIFO->ulHead].ulSize == psFIFO->ulMaxPacket)))
+    {
+        g_ulRxIS |= 1 << ulEP;
+    }
+}
+
+//*****************************************************************************
+//
+// Moves data between memory and the endpoint FIFOs for every running USB
+// uDMA transfer.  The transfer is modeled as instant: an IN channel fills the
+// FIFO as far as it can and an OUT channel empties every maximum size packet
+// waiting.  With AUTO_SET each full packet is sent without software; a final
+// short packet stays in the FIFO until USBEndpointDataSend().  With
+// AUTO_CLEAR each packet is released once read.  A ping-pong transfer moves
+// straight on to the other control structure, even part way through a
+// packet.
+//
+//*****************************************************************************
+static void
+DMAService(void)
+{
+    unsigned long ulEP, ulCount;
+    tSimDMAStruct *psStruct;
+    tSimFIFO *psFIFO;
+    tSimPacket *psPacket;
+
+    for(ulEP = 1; ulEP < USBSIM_NUM_EP; ulEP++)
+    {
+        psFIFO = &g_psTx[ulEP];
+
+        while(((psStruct = DMAActive(psFIFO)) != 0) && !FIFOFull(psFIFO))
+        {
+            ulCount = psFIFO->ulMaxPacket - psFIFO->ulStage;
+            ulCount = (ulCount < psStruct->ulRemaining) ?
+                      ulCount : psStruct->ulRemaining;
+
+            memcpy(psFIFO->pucStage + psFIFO->ulStage, psStruct->pucSrc,
+                   ulCount);
+            psFIFO->ulStage += ulCount;
+            psStruct->pucSrc += ulCount;
+            psStruct->ulRemaining -= ulCount;
+
+            if((psFIFO->ulStage == psFIFO->ulMaxPacket) &&
+               (psFIFO->ulDMAFlags & USB_EP_AUTO_SET))
+            {
+                FIFOPush(psFIFO, psFIFO->pucStage, psFIFO->ulStage);
+                psFIFO->ulStage = 0;
+            }
+
+            if(psStruct->ulRemaining == 0)
+            {
+                DMADone(psFIFO->ulDMAChannel);
+            }
+            else if(ulCount == 0)
+            {
+                break;
+            }
+        }
+
+        psFIFO = &g_psRx[ulEP];
+
+        while(((psStruct = DMAActive(psFIFO)) != 0) && psFIFO->ulCount)
+        {
+            psPacket = &psFIFO->psPackets[psFIFO->ulHead];
+
+            //
+            // Short packets are left for software.
+            //
+            if(psPacket->ulSize != psFIFO->ulMaxPacket)
+            {
+                break;
+            }
+
+            ulCount = psPacket->ulSize - psPacket->ulRead;
+            ulCount = (ulCount < psStruct->ulRemaining) ?
+                      ulCount : psStruct->ulRemaining;
+
+            memcpy(psStruct->pucDst, psPacket->pucData + psPacket->ulRead,
+                   ulCount);
+            psPacket->ulRead += ulCount;
+            psStruct->pucDst += ulCount;
+            psStruct->ulRemaining -= ulCount;
+
+            if(psStruct->ulRemaining == 0)
+            {
+                DMADone(psFIFO->ulDMAChannel);
+            }
+
+            if(psPacket->ulRead != psPacket->ulSize)
+            {
+                //
+                // The transfer ended part way through the packet.  A
+                // ping-pong transfer carries on with the rest of it.
+                //
+                continue;
+            }
+            else if(psFIFO->ulDMAFlags & USB_EP_AUTO_CLEAR)
+            {
+                FIFOPop(psFIFO);
+                RxHeadSignal(ulEP);
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Driverlib API: device addressing and connection.
+//
+//*****************************************************************************
+unsigned long
+USBDevAddrGet(unsigned long ulBase)
+{
+    return(g_ulAddress);
+}
+
+void
+USBDevAddrSet(unsigned long ulBase, unsigned long ulAddress)
+{
+    g_ulAddress = ulAddress & 0x7f;
+}
+
+void
+USBDevConnect(unsigned long ulBase)
+{
+    g_bConnected = true;
+}
+
+void
+USBDevDisconnect(unsigned long ulBase)
+{
+    g_bConnected = false;
+}
+
+void
+USBDevMode(unsigned long ulBase)
+{
+}
+
+void
+USBOTGMode(unsigned long ulBase)
+{
+}
+
+unsigned long
+USBModeGet(unsigned long ulBase)
+{
+    return(USB_OTG_MODE_BSIDE_DEV);
+}
+
+//
+// Host mode is not modeled.  The device library only calls this on
+// OTG parts when resuming as a host.
+//
+void
+USBHostResume(unsigned long ulBase, tBoolean bStart)
+{
+}
+
+void
+USBPHYPowerOff(unsigned long ulBase)
+{
+}
+
+void
+USBPHYPowerOn(unsigned long ulBase)
+{
+}
+
+unsigned long
+USBNumEndpointsGet(unsigned long ulBase)
+{
+    return(USBSIM_NUM_EP);
+}
+
+unsigned long
+USBFrameNumberGet(unsigned long ulBase)
+{
+    return(g_ulFrame & 0x7ff);
+}
+
+//*****************************************************************************
+//
+// Driverlib API: endpoint and FIFO configuration.
+//
+//*****************************************************************************
+void
+USBDevEndpointConfigSet(unsigned long ulBase, unsigned long ulEndpoint,
+                        unsigned long ulMaxPacketSize, unsigned long ulFlags)
+{
+    tSimFIFO *psFIFO;
+
+    if((EP_INDEX(ulEndpoint) == 0) || (ulMaxPacketSize > MAX_PACKET - 1))
+    {
+        SimFault("invalid endpoint configuration", ulEndpoint);
+    }
+
+    psFIFO = (ulFlags & USB_EP_DEV_IN) ? &g_psTx[EP_INDEX(ulEndpoint)] :
+                                         &g_psRx[EP_INDEX(ulEndpoint)];
+
+    //
+    // As on the controller, writing the configuration clears the stall and
+    // error bits and the data toggle but leaves any data in the FIFO.
+    //
+    psFIFO->ulMaxPacket = ulMaxPacketSize;
+    psFIFO->ulFlags = ulFlags;
+    psFIFO->ulDMAFlags = ulFlags & (USB_EP_AUTO_SET | USB_EP_AUTO_CLEAR |
+                                    USB_EP_DMA_MODE_0 | USB_EP_DMA_MODE_1);
+    psFIFO->ulStatus = 0;
+}
+
+void
+USBDevEndpointConfigGet(unsigned long ulBase, unsigned long ulEndpoint,
+                        unsigned long *pulMaxPacketSize,
+                        unsigned long *pulFlags)
+{
+    tSimFIFO *psFIFO;
+
+    psFIFO = (*pulFlags & USB_EP_DEV_IN) ? &g_psTx[EP_INDEX(ulEndpoint)] :
+                                           &g_psRx[EP_INDEX(ulEndpoint)];
+    *pulMaxPacketSize = psFIFO->ulMaxPacket;
+    *pulFlags = psFIFO->ulFlags;
+}
+
+void
+USBEndpointDMAConfigSet(unsigned long ulBase, unsigned long ulEndpoint,
+                        unsigned long ulFlags)
+{
+    tSimFIFO *psFIFO;
+
+    psFIFO = (ulFlags & USB_EP_DEV_IN) ? &g_psTx[EP_INDEX(ulEndpoint)] :
+                                         &g_psRx[EP_INDEX(ulEndpoint)];
+    psFIFO->ulDMAFlags = ulFlags & (USB_EP_AUTO_SET | USB_EP_AUTO_CLEAR |
+                                    USB_EP_DMA_MODE_0 | USB_EP_DMA_MODE_1);
+}
+
+void
+USBEndpointDMAEnable(unsigned long ulBase, unsigned long ulEndpoint,
+                     unsigned long ulFlags)
+{
+    if(ulFlags & USB_EP_DEV_IN)
+    {
+        g_psTx[EP_INDEX(ulEndpoint)].bDMAEnabled = true;
+    }
+    else
+    {
+        g_psRx[EP_INDEX(ulEndpoint)].bDMAEnabled = true;
+    }
+    DMAService();
+}
+
+void
+USBEndpointDMADisable(unsigned long ulBase, unsigned long ulEndpoint,
+                      unsigned long ulFlags)
+{
+    if(ulFlags & USB_EP_DEV_IN)
+    {
+        g_psTx[EP_INDEX(ulEndpoint)].bDMAEnabled = false;
+    }
+    else
+    {
+        //
+        // A maximum size packet that was left for the uDMA controller is now
+        // signalled to software.
+        //
+        g_psRx[EP_INDEX(ulEndpoint)].bDMAEnabled = false;
+        RxHeadSignal(EP_INDEX(ulEndpoint));
+    }
+}
+
+void
+USBEndpointDMAChannel(unsigned long ulBase, unsigned long ulEndpoint,
+                      unsigned long ulChannel)
+{
+    //
+    // The channel serves whichever direction its fixed mapping gives it.
+    //
+    if(ulChannel & 1)
+    {
+        g_psTx[EP_INDEX(ulEndpoint)].ulDMAChannel = ulChannel;
+    }
+    else
+    {
+        g_psRx[EP_INDEX(ulEndpoint)].ulDMAChannel = ulChannel;
+    }
+}
+
+void
+USBFIFOConfigSet(unsigned long ulBase, unsigned long ulEndpoint,
+                 unsigned long ulFIFOAddress, unsigned long ulFIFOSize,
+                 unsigned long ulFlags)
+{
+    tSimFIFO *psFIFO;
+
+    if((EP_INDEX(ulEndpoint) == 0) ||
+       ((ulFIFOAddress + USB_FIFO_SZ_TO_BYTES(ulFIFOSize)) > USBSIM_FIFO_RAM))
+    {
+        SimFault("FIFO does not fit in FIFO RAM", ulEndpoint);
+    }
+
+    psFIFO = (ulFlags & USB_EP_DEV_IN) ? &g_psTx[EP_INDEX(ulEndpoint)] :
+                                         &g_psRx[EP_INDEX(ulEndpoint)];
+    psFIFO->ulFIFOAddr = ulFIFOAddress;
+    psFIFO->ulFIFOSize = ulFIFOSize;
+    psFIFO->ulDepth = (ulFIFOSize & USB_FIFO_SIZE_DB_FLAG) ? 2 : 1;
+}
+
+void
+USBFIFOConfigGet(unsigned long ulBase, unsigned long ulEndpoint,
+                 unsigned long *pulFIFOAddress, unsigned long *pulFIFOSize,
+                 unsigned long ulFlags)
+{
+    tSimFIFO *psFIFO;
+
+    psFIFO = (ulFlags & USB_EP_DEV_IN) ? &g_psTx[EP_INDEX(ulEndpoint)] :
+                                         &g_psRx[EP_INDEX(ulEndpoint)];
+    *pulFIFOAddress = psFIFO->ulFIFOAddr;
+    *pulFIFOSize = psFIFO->ulFIFOSize;
+}
+
+unsigned long
+USBFIFOAddrGet(unsigned long ulBase, unsigned long ulEndpoint)
+{
+    return(ulBase + USB_O_FIFO0 + (ulEndpoint >> 2));
+}
+
+void
+USBFIFOFlush(unsigned long ulBase, unsigned long ulEndpoint,
+             unsigned long ulFlags)
+{
+    if(EP_INDEX(ulEndpoint) == 0)
+    {
+        FIFOFlush(&g_psTx[0]);
+        FIFOFlush(&g_psRx[0]);
+    }
+    else if(ulFlags & USB_EP_DEV_IN)
+    {
+        FIFOFlush(&g_psTx[EP_INDEX(ulEndpoint)]);
+    }
+    else
+    {
+        FIFOFlush(&g_psRx[EP_INDEX(ulEndpoint)]);
+    }
+}
+
+//*****************************************************************************
+//
+// Driverlib API: endpoint status and stalls.
+//
+//*****************************************************************************
+unsigned long
+USBEndpointStatus(unsigned long ulBase, unsigned long ulEndpoint)
+{
+    tSimFIFO *psTx, *psRx;
+    unsigned long ulStatus;
+
+    if(EP_INDEX(ulEndpoint) == 0)
+    {
+        ulStatus = g_ulCSR0;
+        ulStatus |= g_psRx[0].ulCount ? USB_CSRL0_RXRDY : 0;
+        ulStatus |= g_psTx[0].ulCount ? USB_CSRL0_TXRDY : 0;
+        return(ulStatus);
+    }
+
+    psTx = &g_psTx[EP_INDEX(ulEndpoint)];
+    psRx = &g_psRx[EP_INDEX(ulEndpoint)];
+
+    ulStatus = psTx->ulStatus;
+    ulStatus |= FIFOFull(psTx) ? USB_TXCSRL1_TXRDY : 0;
+    ulStatus |= psTx->ulCount ? USB_TXCSRL1_FIFONE : 0;
+    ulStatus |= (psRx->ulStatus | (psRx->ulCount ? USB_RXCSRL1_RXRDY : 0) |
+                 (FIFOFull(psRx) ? USB_RXCSRL1_FULL : 0)) << 16;
+
+    return(ulStatus);
+}
+
+void
+USBDevEndpointStatusClear(unsigned long ulBase, unsigned long ulEndpoint,
+                          unsigned long ulFlags)
+{
+    if(EP_INDEX(ulEndpoint) == 0)
+    {
+        if(ulFlags & USB_DEV_EP0_OUT_PKTRDY)
+        {
+            FIFOPop(&g_psRx[0]);
+        }
+        if(ulFlags & USB_DEV_EP0_SETUP_END)
+        {
+            g_ulCSR0 &= ~USB_CSRL0_SETEND;
+        }
+        if(ulFlags & USB_DEV_EP0_SENT_STALL)
+        {
+            g_ulCSR0 &= ~USB_CSRL0_STALLED;
+        }
+    }
+    else
+    {
+        g_psTx[EP_INDEX(ulEndpoint)].ulStatus &=
+            ~(ulFlags & (USB_DEV_TX_SENT_STALL | USB_DEV_TX_UNDERRUN));
+        g_psRx[EP_INDEX(ulEndpoint)].ulStatus &=
+            ~((ulFlags & (USB_DEV_RX_SENT_STALL | USB_DEV_RX_DATA_ERROR |
+                          USB_DEV_RX_OVERRUN)) >> 16);
+    }
+}
+
+void
+USBDevEndpointStall(unsigned long ulBase, unsigned long ulEndpoint,
+                    unsigned long ulFlags)
+{
+    if(EP_INDEX(ulEndpoint) == 0)
+    {
+        g_ulCSR0 |= USB_CSRL0_STALL;
+        FIFOPop(&g_psRx[0]);
+    }
+    else if(ulFlags == USB_EP_DEV_IN)
+    {
+        g_psTx[EP_INDEX(ulEndpoint)].ulStatus |= USB_TXCSRL1_STALL;
+    }
+    else
+    {
+        g_psRx[EP_INDEX(ulEndpoint)].ulStatus |= USB_RXCSRL1_STALL;
+    }
+}
+
+void
+USBDevEndpointStallClear(unsigned long ulBase, unsigned long ulEndpoint,
+                         unsigned long ulFlags)
+{
+    if(EP_INDEX(ulEndpoint) == 0)
+    {
+        g_ulCSR0 &= ~USB_CSRL0_STALLED;
+    }
+    else if(ulFlags == USB_EP_DEV_IN)
+    {
+        g_psTx[EP_INDEX(ulEndpoint)].ulStatus &=
+            ~(USB_TXCSRL1_STALL | USB_TXCSRL1_STALLED);
+    }
+    else
+    {
+        g_psRx[EP_INDEX(ulEndpoint)].ulStatus &=
+            ~(USB_RXCSRL1_STALL | USB_RXCSRL1_STALLED);
+    }
+}
+
+//*****************************************************************************
+//
+// Driverlib API: moving data through the FIFOs.
+//
+//*****************************************************************************
+unsigned long
+USBEndpointDataAvail(unsigned long ulBase, unsigned long ulEndpoint)
+{
+    tSimFIFO *psFIFO;
+    tSimPacket *psPacket;
+
+    psFIFO = &g_psRx[EP_INDEX(ulEndpoint)];
+
+    if(!psFIFO->ulCount)
+    {
+        return(0);
+    }
+
+    psPacket = &psFIFO->psPackets[psFIFO->ulHead];
+    return(psPacket->ulSize - psPacket->ulRead);
+}
+
+long
+USBEndpointDataGet(unsigned long ulBase, unsigned long ulEndpoint,
+                   unsigned char *pucData, unsigned long *pulSize)
+{
+    tSimFIFO *psFIFO;
+    tSimPacket *psPacket;
+    unsigned long ulCount;
+
+    psFIFO = &g_psRx[EP_INDEX(ulEndpoint)];
+
+    if(!psFIFO->ulCount)
+    {
+        *pulSize = 0;
+        return(-1);
+    }
+
+    //
+    // Reading the FIFO consumes bytes, so a packet may be read in pieces.
+    //
+    psPacket = &psFIFO->psPackets[psFIFO->ulHead];
+    ulCount = psPacket->ulSize - psPacket->ulRead;
+    ulCount = (ulCount < *pulSize) ? ulCount : *pulSize;
+    memcpy(pucData, psPacket->pucData + psPacket->ulRead, ulCount);
+    psPacket->ulRead += ulCount;
+    *pulSize = ulCount;
+
+    return(0);
+}
+
+void
+USBDevEndpointDataAck(unsigned long ulBase, unsigned long ulEndpoint,
+                      tBoolean bIsLastPacket)
+{
+    if(EP_INDEX(ulEndpoint) == 0)
+    {
+        FIFOPop(&g_psRx[0]);
+        if(bIsLastPacket)
+        {
+            g_ulCSR0 |= USB_CSRL0_DATAEND;
+        }
+        return;
+    }
+
+    //
+    // Release the packet.  If a second packet is waiting in a double
+    // buffered FIFO it becomes visible and raises a new interrupt.
+    //
+    FIFOPop(&g_psRx[EP_INDEX(ulEndpoint)]);
+    RxHeadSignal(EP_INDEX(ulEndpoint));
+}
+
+long
+USBEndpointDataPut(unsigned long ulBase, unsigned long ulEndpoint,
+                   unsigned char *pucData, unsigned long ulSize)
+{
+    tSimFIFO *psFIFO;
+
+    psFIFO = &g_psTx[EP_INDEX(ulEndpoint)];
+
+    if(FIFOFull(psFIFO))
+    {
+        return(-1);
+    }
+
+    if((psFIFO->ulStage + ulSize) > MAX_PACKET)
+    {
+        SimFault("packet too large for FIFO", ulEndpoint);
+    }
+
+    memcpy(psFIFO->pucStage + psFIFO->ulStage, pucData, ulSize);
+    psFIFO->ulStage += ulSize;
+
+    return(0);
+}
+
+long
+USBEndpointDataSend(unsigned long ulBase, unsigned long ulEndpoint,
+                    unsigned long ulTransType)
+{
+    tSimFIFO *psFIFO;
+
+    psFIFO = &g_psTx[EP_INDEX(ulEndpoint)];
+
+    if(FIFOFull(psFIFO))
+    {
+        return(-1);
+    }
+
+    if((EP_INDEX(ulEndpoint) != 0) &&
+       (psFIFO->ulStage > psFIFO->ulMaxPacket))
+    {
+        SimFault("packet larger than the maximum packet size", ulEndpoint);
+    }
+
+    FIFOPush(psFIFO, psFIFO->pucStage, psFIFO->ulStage);
+    psFIFO->ulStage = 0;
+
+    if(EP_INDEX(ulEndpoint) == 0)
+    {
+        if(ulTransType & USB_CSRL0_DATAEND)
+        {
+            g_ulCSR0 |= USB_CSRL0_DATAEND;
+        }
+    }
+    else if(!FIFOFull(psFIFO))
+    {
+        //
+        // A double buffered FIFO accepted the packet and has room for another
+        // so TXRDY clears at once, raising an interrupt.
+        //
+        g_ulTxIS |= 1 << EP_INDEX(ulEndpoint);
+    }
+
+    return(0);
+}
+
+void
+USBEndpointDataToggleClear(unsigned long ulBase, unsigned long ulEndpoint,
+                           unsigned long ulFlags)
+{
+}
+
+//*****************************************************************************
+//
+// Driverlib API: interrupts.
+//
+//*****************************************************************************
+void
+USBIntEnableControl(unsigned long ulBase, unsigned long ulFlags)
+{
+    g_ulCtrlIE |= ulFlags & USB_INTCTRL_ALL;
+}
+
+void
+USBIntDisableControl(unsigned long ulBase, unsigned long ulFlags)
+{
+    g_ulCtrlIE &= ~ulFlags;
+}
+
+unsigned long
+USBIntStatusControl(unsigned long ulBase)
+{
+    unsigned long ulStatus;
+
+    ulStatus = g_ulCtrlIS & g_ulCtrlIE;
+    g_ulCtrlIS = 0;
+
+    return(ulStatus);
+}
+
+void
+USBIntEnableEndpoint(unsigned long ulBase, unsigned long ulFlags)
+{
+    g_ulTxIE |= ulFlags & 0xffff;
+    g_ulRxIE |= (ulFlags >> 16) & 0xfffe;
+}
+
+void
+USBIntDisableEndpoint(unsigned long ulBase, unsigned long ulFlags)
+{
+    g_ulTxIE &= ~(ulFlags & 0xffff);
+    g_ulRxIE &= ~((ulFlags >> 16) & 0xfffe);
+}
+
+unsigned long
+USBIntStatusEndpoint(unsigned long ulBase)
+{
+    unsigned long ulStatus;
+
+    ulStatus = g_ulTxIS | (g_ulRxIS << 16);
+    g_ulTxIS = 0;
+    g_ulRxIS = 0;
+
+    return(ulStatus);
+}
+
+//*****************************************************************************
+//
+// The original combined interrupt API, in which USB_INT_* flags place the
+// control bits at the top of the word and three endpoints in each direction
+// below them.
+//
+//*****************************************************************************
+void
+USBIntEnable(unsigned long ulBase, unsigned long ulIntFlags)
+{
+    g_ulCtrlIE |= (ulIntFlags >> 24) & 0xff;
+    g_ulTxIE |= ulIntFlags & 0x0f;
+    g_ulRxIE |= (ulIntFlags >> 8) & 0x0e;
+}
+
+void
+USBIntDisable(unsigned long ulBase, unsigned long ulIntFlags)
+{
+    g_ulCtrlIE &= ~((ulIntFlags >> 24) & 0xff);
+    g_ulTxIE &= ~(ulIntFlags & 0x0f);
+    g_ulRxIE &= ~((ulIntFlags >> 8) & 0x0e);
+}
+
+unsigned long
+USBIntStatus(unsigned long ulBase)
+{
+    unsigned long ulStatus;
+
+    ulStatus = ((g_ulCtrlIS & 0xff) << 24) | (g_ulTxIS & 0x0f) |
+               ((g_ulRxIS & 0x0e) << 8);
+    g_ulCtrlIS = 0;
+    g_ulTxIS = 0;
+    g_ulRxIS = 0;
+
+    return(ulStatus);
+}
+
+void
+USBIntRegister(unsigned long ulBase, void (*pfnHandler)(void))
+{
+    g_pfnIntHandler = pfnHandler;
+}
+
+void
+USBIntUnregister(unsigned long ulBase)
+{
+    g_pfnIntHandler = 0;
+}
+
+//*****************************************************************************
+//
+// The parts of the interrupt controller API used with the USB interrupt.
+// Unmasking interrupts delivers any that were raised while they were masked,
+// as the NVIC would.
+//
+//*****************************************************************************
+void
+IntEnable(unsigned long ulInterrupt)
+{
+    if(ulInterrupt == INT_USB0)
+    {
+        g_bUSBIntEnabled = true;
+        IntDeliver();
+    }
+}
+
+void
+IntDisable(unsigned long ulInterrupt)
+{
+    if(ulInterrupt == INT_USB0)
+    {
+        g_bUSBIntEnabled = false;
+    }
+}
+
+tBoolean
+IntMasterEnable(void)
+{
+    tBoolean bWasDisabled;
+
+    bWasDisabled = g_bMasterDisabled;
+    g_bMasterDisabled = false;
+    IntDeliver();
+
+    return(bWasDisabled);
+}
+
+tBoolean
+IntMasterDisable(void)
+{
+    tBoolean bWasDisabled;
+
+    bWasDisabled = g_bMasterDisabled;
+    g_bMasterDisabled = true;
+
+    return(bWasDisabled);
+}
+
+//*****************************************************************************
+//
+// The parts of the uDMA controller API used by the USB library.  Channel
+// numbers may carry UDMA_ALT_SELECT to pick the alternate control structure.
+// Basic, auto and ping-pong transfers are modeled.
+//
+//*****************************************************************************
+#define DMA_CHANNEL(ulIdx)      ((ulIdx) & (NUM_DMA_CHANNELS - 1))
+#define DMA_STRUCT(ulIdx)                                                     \
+        (&g_psDMA[DMA_CHANNEL(ulIdx)].psStruct[((ulIdx) & UDMA_ALT_SELECT) ?  \
+                                               1 : 0])
+
+void
+uDMAChannelEnable(unsigned long ulChannelNum)
+{
+    g_psDMA[DMA_CHANNEL(ulChannelNum)].bEnabled = true;
+    DMAService();
+}
+
+void
+uDMAChannelDisable(unsigned long ulChannelNum)
+{
+    g_psDMA[DMA_CHANNEL(ulChannelNum)].bEnabled = false;
+}
+
+tBoolean
+uDMAChannelIsEnabled(unsigned long ulChannelNum)
+{
+    return(g_psDMA[DMA_CHANNEL(ulChannelNum)].bEnabled);
+}
+
+void
+uDMAChannelAttributeEnable(unsigned long ulChannelNum, unsigned long ulAttr)
+{
+    if(ulAttr & UDMA_ATTR_ALTSELECT)
+    {
+        g_psDMA[DMA_CHANNEL(ulChannelNum)].ulAlt = 1;
+    }
+}
+
+void
+uDMAChannelAttributeDisable(unsigned long ulChannelNum, unsigned long ulAttr)
+{
+    if(ulAttr & UDMA_ATTR_ALTSELECT)
+    {
+        g_psDMA[DMA_CHANNEL(ulChannelNum)].ulAlt = 0;
+    }
+}
+
+void
+uDMAChannelControlSet(unsigned long ulChannelStructIndex,
+                      unsigned long ulControl)
+{
+    DMA_STRUCT(ulChannelStructIndex)->ulItemSize =
+        1 << ((ulControl >> 28) & 3);
+}
+
+void
+uDMAChannelTransferSet(unsigned long ulChannelStructIndex,
+                       unsigned long ulMode, void *pvSrcAddr,
+                       void *pvDstAddr, unsigned long ulTransferSize)
+{
+    tSimDMAStruct *psStruct;
+
+    psStruct = DMA_STRUCT(ulChannelStructIndex);
+
+    if((ulMode != UDMA_MODE_BASIC) && (ulMode != UDMA_MODE_AUTO) &&
+       (ulMode != UDMA_MODE_PINGPONG))
+    {
+        SimFault("uDMA mode not modeled", 0);
+    }
+
+    psStruct->ulMode = ulMode;
+    psStruct->pucSrc = pvSrcAddr;
+    psStruct->pucDst = pvDstAddr;
+    psStruct->ulRemaining = ulTransferSize * psStruct->ulItemSize;
+}
+
+unsigned long
+uDMAChannelSizeGet(unsigned long ulChannelStructIndex)
+{
+    tSimDMAStruct *psStruct;
+
+    psStruct = DMA_STRUCT(ulChannelStructIndex);
+
+    return(psStruct->ulRemaining / psStruct->ulItemSize);
+}
+
+unsigned long
+uDMAChannelModeGet(unsigned long ulChannelStructIndex)
+{
+    return(DMA_STRUCT(ulChannelStructIndex)->ulMode);
+}
+
+unsigned long
+uDMAIntStatus(void)
+{
+    return(g_ulDMAIntStatus);
+}
+
+void
+uDMAIntClear(unsigned long ulChanMask)
+{
+    g_ulDMAIntStatus &= ~ulChanMask;
+}
+
+//*****************************************************************************
+//
+//! Initializes the controller model.
+//!
+//! \param pfnIntHandler is the USB interrupt handler, normally
+//! USB0DeviceIntHandler().
+//!
+//! This function puts the model into its reset state and records the handler
+//! to call when a USB interrupt is delivered.  The device is disconnected
+//! until the USB library calls USBDevConnect().
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBSimInit(void (*pfnIntHandler)(void))
+{
+    unsigned long ulEP;
+
+    memset(g_psTx, 0, sizeof(g_psTx));
+    memset(g_psRx, 0, sizeof(g_psRx));
+    memset(g_psDMA, 0, sizeof(g_psDMA));
+    memset(&g_sStats, 0, sizeof(g_sStats));
+
+    //
+    // Endpoint n uses uDMA channels 2n - 2 (OUT) and 2n - 1 (IN) unless
+    // USBEndpointDMAChannel() selects another.
+    //
+    for(ulEP = 0; ulEP < NUM_DMA_CHANNELS; ulEP++)
+    {
+        g_psDMA[ulEP].psStruct[0].ulItemSize = 1;
+        g_psDMA[ulEP].psStruct[1].ulItemSize = 1;
+    }
+    for(ulEP = 1; ulEP < USBSIM_NUM_EP; ulEP++)
+    {
+        g_psRx[ulEP].ulDMAChannel = (ulEP - 1) * 2;
+        g_psTx[ulEP].ulDMAChannel = ((ulEP - 1) * 2) + 1;
+    }
+
+    g_psTx[0].ulMaxPacket = MAX_PACKET_SIZE_EP0;
+    g_psRx[0].ulMaxPacket = MAX_PACKET_SIZE_EP0;
+    g_psTx[0].ulDepth = 1;
+    g_psRx[0].ulDepth = 1;
+
+    g_ulCSR0 = 0;
+    g_ulAddress = 0;
+    g_ulFrame = 0;
+    g_bConnected = false;
+    g_ulTxIS = g_ulRxIS = g_ulCtrlIS = 0;
+    g_ulTxIE = g_ulRxIE = g_ulCtrlIE = 0;
+    g_bDMAIntPending = false;
+    g_ulDMAIntStatus = 0;
+    g_pfnIntHandler = pfnIntHandler;
+    g_bUSBIntEnabled = false;
+    g_bMasterDisabled = false;
+    g_bInHandler = false;
+}
+
+//*****************************************************************************
+//
+//! Delivers any pending USB interrupt.
+//!
+//! Interrupts raised by the device itself are delivered on the next bus
+//! function.  A test may call this function to deliver them earlier.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBSimPoll(void)
+{
+    IntDeliver();
+}
+
+//*****************************************************************************
+//
+//! Returns \b true if the device has connected to the bus.
+//
+//*****************************************************************************
+tBoolean
+USBSimConnected(void)
+{
+    return(g_bConnected);
+}
+
+//*****************************************************************************
+//
+//! Signals a bus reset.
+//!
+//! The device address returns to 0, all FIFOs are emptied and endpoint stall
+//! and error bits are cleared.  Endpoint and FIFO configurations are kept.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBSimBusReset(void)
+{
+    unsigned long ulEP;
+
+    g_ulAddress = 0;
+    g_ulCSR0 = 0;
+
+    for(ulEP = 0; ulEP < USBSIM_NUM_EP; ulEP++)
+    {
+        FIFOFlush(&g_psTx[ulEP]);
+        FIFOFlush(&g_psRx[ulEP]);
+        g_psTx[ulEP].ulStatus = 0;
+        g_psRx[ulEP].ulStatus = 0;
+    }
+
+    g_ulTxIS = 0;
+    g_ulRxIS = 0;
+    g_ulCtrlIS |= USB_INTCTRL_RESET;
+    IntDeliver();
+}
+
+//*****************************************************************************
+//
+//! Signals that the bus has been suspended.
+//
+//*****************************************************************************
+void
+USBSimSuspend(void)
+{
+    g_ulCtrlIS |= USB_INTCTRL_SUSPEND;
+    IntDeliver();
+}
+
+//*****************************************************************************
+//
+//! Signals that the bus has resumed.
+//
+//*****************************************************************************
+void
+USBSimResume(void)
+{
+    g_ulCtrlIS |= USB_INTCTRL_RESUME;
+    IntDeliver();
+}
+
+//*****************************************************************************
+//
+//! Starts a new frame, raising the start-of-frame interrupt.
+//
+//*****************************************************************************
+void
+USBSimFrame(void)
+{
+    g_ulFrame++;
+    g_sStats.ulFrames++;
+    g_ulCtrlIS |= USB_INTCTRL_SOF;
+    IntDeliver();
+}
+
+//*****************************************************************************
+//
+// Checks whether a device at the given address can see a transaction.
+//
+//*****************************************************************************
+static tBoolean
+Addressed(unsigned long ulAddr)
+{
+    return((g_bConnected && (ulAddr == g_ulAddress)) ? true : false);
+}
+
+//*****************************************************************************
+//
+// Handles a transaction addressed to endpoint 0 while the device is sending
+// a STALL.  The STALL is sent once, setting the STALLED bit.
+//
+//*****************************************************************************
+static unsigned long
+EP0Stall(void)
+{
+    g_ulCSR0 &= ~USB_CSRL0_STALL;
+    g_ulCSR0 |= USB_CSRL0_STALLED;
+    g_ulTxIS |= 1;
+    g_sStats.pulStalls[0]++;
+    IntDeliver();
+
+    return(USBSIM_STALL);
+}
+
+//*****************************************************************************
+//
+//! Sends a SETUP packet to endpoint 0.
+//!
+//! \param ulAddr is the device address.
+//! \param pucSetup points to the 8 byte request.
+//!
+//! A SETUP packet is always accepted.  Any control transfer in progress is
+//! abandoned, which sets the SETEND bit.
+//!
+//! \return Returns \b USBSIM_ACK or \b USBSIM_NO_RESPONSE.
+//
+//*****************************************************************************
+unsigned long
+USBSimSetup(unsigned long ulAddr, const unsigned char *pucSetup)
+{
+    if(!Addressed(ulAddr))
+    {
+        return(USBSIM_NO_RESPONSE);
+    }
+
+    if(g_psTx[0].ulCount || g_psRx[0].ulCount ||
+       (g_ulCSR0 & USB_CSRL0_DATAEND))
+    {
+        g_ulCSR0 |= USB_CSRL0_SETEND;
+    }
+
+    FIFOFlush(&g_psTx[0]);
+    FIFOFlush(&g_psRx[0]);
+    g_ulCSR0 &= ~(USB_CSRL0_DATAEND | USB_CSRL0_STALL);
+
+    FIFOPush(&g_psRx[0], pucSetup, 8);
+    g_ulTxIS |= 1;
+    g_sStats.ulSetups++;
+    IntDeliver();
+
+    return(USBSIM_ACK);
+}
+
+//*****************************************************************************
+//
+//! Sends an OUT transaction to an endpoint.
+//!
+//! \param ulAddr is the device address.
+//! \param ulEP is the endpoint number.
+//! \param pucData points to the packet data.
+//! \param ulSize is the packet size, which may be 0.
+//!
+//! On endpoint 0 this carries either the data stage of a control write or,
+//! with no data, the status stage of a control read.
+//!
+//! \return Returns one of the \b USBSIM_ result codes.
+//
+//*****************************************************************************
+unsigned long
+USBSimOut(unsigned long ulAddr, unsigned long ulEP,
+          const unsigned char *pucData, unsigned long ulSize)
+{
+    tSimFIFO *psFIFO;
+    tBoolean bIso;
+
+    if(!Addressed(ulAddr) || (ulEP >= USBSIM_NUM_EP))
+    {
+        return(USBSIM_NO_RESPONSE);
+    }
+
+    psFIFO = &g_psRx[ulEP];
+
+    if(ulEP == 0)
+    {
+        if(g_ulCSR0 & USB_CSRL0_STALL)
+        {
+            return(EP0Stall());
+        }
+
+        if(!ulSize && (g_ulCSR0 & USB_CSRL0_DATAEND) && !g_psTx[0].ulCount)
+        {
+            //
+            // This is the status stage of a control read.
+            //
+            g_ulCSR0 &= ~USB_CSRL0_DATAEND;
+            g_ulTxIS |= 1;
+            IntDeliver();
+            return(USBSIM_ACK);
+        }
+
+        if(psFIFO->ulCount || (ulSize > MAX_PACKET_SIZE_EP0))
+        {
+            g_sStats.pulOutNAKs[0]++;
+            return(USBSIM_NAK);
+        }
+
+        FIFOPush(psFIFO, pucData, ulSize);
+        g_sStats.pulOutPackets[0]++;
+        g_sStats.pulOutBytes[0] += ulSize;
+        g_ulTxIS |= 1;
+        IntDeliver();
+        return(USBSIM_ACK);
+    }
+
+    if(!psFIFO->ulMaxPacket || !psFIFO->ulDepth ||
+       (ulSize > psFIFO->ulMaxPacket))
+    {
+        return(USBSIM_NO_RESPONSE);
+    }
+
+    bIso = ((psFIFO->ulFlags & USB_EP_MODE_MASK) == USB_EP_MODE_ISOC) ?
+           true : false;
+
+    if(!bIso && (psFIFO->ulStatus & USB_RXCSRL1_STALL))
+    {
+        psFIFO->ulStatus |= USB_RXCSRL1_STALLED;
+        g_ulRxIS |= 1 << ulEP;
+        g_sStats.pulStalls[ulEP]++;
+        IntDeliver();
+        return(USBSIM_STALL);
+    }
+
+    if(FIFOFull(psFIFO))
+    {
+        if(bIso)
+        {
+            psFIFO->ulStatus |= USB_RXCSRL1_OVER;
+            return(USBSIM_OVERRUN);
+        }
+        g_sStats.pulOutNAKs[ulEP]++;
+        return(USBSIM_NAK);
+    }
+
+    //
+    // RXRDY rises, and interrupts, only when the FIFO was empty.  A second
+    // packet in a double buffered FIFO is signalled when the first is
+    // released.
+    //
+    FIFOPush(psFIFO, pucData, ulSize);
+    if(psFIFO->ulCount == 1)
+    {
+        RxHeadSignal(ulEP);
+    }
+    g_sStats.pulOutPackets[ulEP]++;
+    g_sStats.pulOutBytes[ulEP] += ulSize;
+    IntDeliver();
+
+    return(USBSIM_ACK);
+}
+
+//*****************************************************************************
+//
+//! Sends an IN transaction to an endpoint.
+//!
+//! \param ulAddr is the device address.
+//! \param ulEP is the endpoint number.
+//! \param pucData points to storage for the packet.
+//! \param pulSize points to the size of the storage on entry and is written
+//! with the packet size.
+//!
+//! On endpoint 0 this carries either the data stage of a control read or the
+//! status stage of a control write or no-data request.
+//!
+//! \return Returns one of the \b USBSIM_ result codes.
+//
+//*****************************************************************************
+unsigned long
+USBSimIn(unsigned long ulAddr, unsigned long ulEP, unsigned char *pucData,
+         unsigned long *pulSize)
+{
+    tSimFIFO *psFIFO;
+    tSimPacket *psPacket;
+    tBoolean bWasFull, bIso;
+    unsigned long ulSize;
+
+    if(!Addressed(ulAddr) || (ulEP >= USBSIM_NUM_EP))
+    {
+        return(USBSIM_NO_RESPONSE);
+    }
+
+    psFIFO = &g_psTx[ulEP];
+
+    if(ulEP == 0)
+    {
+        if(g_ulCSR0 & USB_CSRL0_STALL)
+        {
+            return(EP0Stall());
+        }
+
+        if(!psFIFO->ulCount)
+        {
+            if((g_ulCSR0 & USB_CSRL0_DATAEND) && !g_psRx[0].ulCount)
+            {
+                //
+                // This is the status stage of a control write or no-data
+                // request.
+                //
+                g_ulCSR0 &= ~USB_CSRL0_DATAEND;
+                *pulSize = 0;
+                g_ulTxIS |= 1;
+                IntDeliver();
+                return(USBSIM_ACK);
+            }
+
+            g_sStats.pulInNAKs[0]++;
+            return(USBSIM_NAK);
+        }
+    }
+    else
+    {
+        if(!psFIFO->ulMaxPacket || !psFIFO->ulDepth)
+        {
+            return(USBSIM_NO_RESPONSE);
+        }
+
+        bIso = ((psFIFO->ulFlags & USB_EP_MODE_MASK) == USB_EP_MODE_ISOC) ?
+               true : false;
+
+        if(!bIso && (psFIFO->ulStatus & USB_TXCSRL1_STALL))
+        {
+            psFIFO->ulStatus |= USB_TXCSRL1_STALLED;
+            g_ulTxIS |= 1 << ulEP;
+            g_sStats.pulStalls[ulEP]++;
+            IntDeliver();
+            return(USBSIM_STALL);
+        }
+
+        if(!psFIFO->ulCount)
+        {
+            if(bIso)
+            {
+                psFIFO->ulStatus |= USB_TXCSRL1_UNDRN;
+                *pulSize = 0;
+                return(USBSIM_UNDERRUN);
+            }
+            g_sStats.pulInNAKs[ulEP]++;
+            return(USBSIM_NAK);
+        }
+    }
+
+    //
+    // Hand the packet at the head of the FIFO to the host.
+    //
+    psPacket = &psFIFO->psPackets[psFIFO->ulHead];
+    ulSize = (psPacket->ulSize < *pulSize) ? psPacket->ulSize : *pulSize;
+    memcpy(pucData, psPacket->pucData, ulSize);
+    *pulSize = psPacket->ulSize;
+
+    bWasFull = FIFOFull(psFIFO);
+    FIFOPop(psFIFO);
+
+    g_sStats.pulInPackets[ulEP]++;
+    g_sStats.pulInBytes[ulEP] += psPacket->ulSize;
+    if(psPacket->ulSize < psFIFO->ulMaxPacket)
+    {
+        g_sStats.pulInShort[ulEP]++;
+    }
+
+    //
+    // On endpoint 0, the last packet of a control read is followed by the
+    // status stage, which raises the interrupt.  Elsewhere, an interrupt is
+    // raised as TXRDY clears unless the uDMA controller is feeding the FIFO.
+    //
+    if(ulEP == 0)
+    {
+        if(!(g_ulCSR0 & USB_CSRL0_DATAEND))
+        {
+            g_ulTxIS |= 1;
+        }
+    }
+    else if(bWasFull && !DMAMode1(psFIFO))
+    {
+        g_ulTxIS |= 1 << ulEP;
+    }
+    IntDeliver();
+
+    return(USBSIM_ACK);
+}
+
+//*****************************************************************************
+//
+//! Returns the maximum packet size configured for an endpoint.
+//!
+//! \param ulEP is the endpoint number.
+//! \param bIn is \b true for the IN direction.
+//!
+//! \return Returns the maximum packet size, or 0 if the endpoint direction
+//! is not configured.
+//
+//*****************************************************************************
+unsigned long
+USBSimMaxPacketGet(unsigned long ulEP, tBoolean bIn)
+{
+    if(ulEP >= USBSIM_NUM_EP)
+    {
+        return(0);
+    }
+
+    return(bIn ? g_psTx[ulEP].ulMaxPacket : g_psRx[ulEP].ulMaxPacket);
+}
+
+//*****************************************************************************
+//
+//! Copies the model's counters.
+//
+//*****************************************************************************
+void
+USBSimStatsGet(tUSBSimStats *psStats)
+{
+    *psStats = g_sStats;
+}
+
+//*****************************************************************************
+//
+//! Clears the model's counters.
+//
+//*****************************************************************************
+void
+USBSimStatsClear(void)
+{
+    memset(&g_sStats, 0, sizeof(g_sStats));
+}
@@ -0,0 +1,224 @@
+//*****************************************************************************
+//
+// usbsim.h - Simulated USB controller and virtual host for host builds of
+//            the USB library.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+//
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+//
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+//
+// This is part of revision 9453 of the Stellaris Firmware Development Package.
+//
+//*****************************************************************************
+
+#ifndef __USBSIM_H__
+#define __USBSIM_H__
+
+//*****************************************************************************
+//
+// The model replaces driverlib/usb.c.  usbsim.c implements the device mode
+// subset of the driverlib USB API (USBEndpointDataPut(), USBIntStatusControl()
+// and so on) on a model of the USB0 controller's endpoints, FIFOs and
+// interrupt registers.  The functions below are the other side of that model,
+// the bus, and are used by the virtual host in usbsimhost.c or directly by a
+// test that wants to issue individual transactions.
+//
+// Interrupts are delivered synchronously.  Whenever a bus function changes
+// the controller's interrupt status, the registered interrupt handler is
+// called before the function returns, provided the USB interrupt has been
+// enabled with IntEnable() and interrupts are not masked with
+// IntMasterDisable().  Interrupts raised by the device itself, for example
+// when a double buffered endpoint accepts a packet, are delivered on the
+// next bus function or call to USBSimPoll().
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+// The results of a single bus transaction.
+//
+//*****************************************************************************
+#define USBSIM_ACK              0   // The transaction completed.
+#define USBSIM_NAK              1   // The endpoint was not ready.
+#define USBSIM_STALL            2   // The endpoint is halted.
+#define USBSIM_NO_RESPONSE      3   // No device or endpoint answered.
+#define USBSIM_OVERRUN          4   // Isochronous OUT data was dropped.
+#define USBSIM_UNDERRUN         5   // No isochronous IN data was ready.
+
+//*****************************************************************************
+//
+// The number of endpoints in the model and the size of the endpoint FIFO RAM.
+//
+//*****************************************************************************
+#define USBSIM_NUM_EP           16
+#define USBSIM_FIFO_RAM         2048
+
+//*****************************************************************************
+//
+// Counters kept by the model.  Endpoint counters are indexed by endpoint
+// number and are seen from the host so "In" counts packets sent by the
+// device.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // The number of times the interrupt handler was called.
+    //
+    unsigned long ulInterrupts;
+
+    //
+    // The number of frames (SOFs) generated.
+    //
+    unsigned long ulFrames;
+
+    //
+    // The number of SETUP packets sent to endpoint 0.
+    //
+    unsigned long ulSetups;
+
+    //
+    // Per endpoint packet, byte, NAK and STALL counts for each direction.
+    //
+    unsigned long pulInPackets[USBSIM_NUM_EP];
+    unsigned long pulInBytes[USBSIM_NUM_EP];
+    unsigned long pulInNAKs[USBSIM_NUM_EP];
+    unsigned long pulOutPackets[USBSIM_NUM_EP];
+    unsigned long pulOutBytes[USBSIM_NUM_EP];
+    unsigned long pulOutNAKs[USBSIM_NUM_EP];
+    unsigned long pulStalls[USBSIM_NUM_EP];
+
+    //
+    // The number of short (less than maximum size) IN packets.
+    //
+    unsigned long pulInShort[USBSIM_NUM_EP];
+}
+tUSBSimStats;
+
+//*****************************************************************************
+//
+// Controller model and bus functions (usbsim.c).
+//
+//*****************************************************************************
+extern void USBSimInit(void (*pfnIntHandler)(void));
+extern void USBSimPoll(void);
+extern tBoolean USBSimConnected(void);
+extern void USBSimBusReset(void);
+extern void USBSimSuspend(void);
+extern void USBSimResume(void);
+extern void USBSimFrame(void);
+extern unsigned long USBSimSetup(unsigned long ulAddr,
+                                 const unsigned char *pucSetup);
+extern unsigned long USBSimOut(unsigned long ulAddr, unsigned long ulEP,
+                               const unsigned char *pucData,
+                               unsigned long ulSize);
+extern unsigned long USBSimIn(unsigned long ulAddr, unsigned long ulEP,
+                              unsigned char *pucData, unsigned long *pulSize);
+extern unsigned long USBSimMaxPacketGet(unsigned long ulEP, tBoolean bIn);
+extern void USBSimStatsGet(tUSBSimStats *psStats);
+extern void USBSimStatsClear(void);
+
+//*****************************************************************************
+//
+// The number of full speed bulk packets that fit in one frame.  The virtual
+// host advances the frame counter after this many transactions so that
+// frame counts give the time the transfers would take on the bus.
+//
+//*****************************************************************************
+#define USBSIM_PACKETS_PER_FRAME 19
+
+//*****************************************************************************
+//
+// The number of consecutive NAKs after which the virtual host gives up on a
+// transfer.
+//
+//*****************************************************************************
+#define USBSIM_NAK_LIMIT        10000
+
+//*****************************************************************************
+//
+// Errors returned by the virtual host transfer functions.
+//
+//*****************************************************************************
+#define USBSIM_ERR_STALL        (-1)
+#define USBSIM_ERR_TIMEOUT      (-2)
+#define USBSIM_ERR_NO_RESPONSE  (-3)
+#define USBSIM_ERR_PROTOCOL     (-4)
+
+//*****************************************************************************
+//
+// An endpoint of the enumerated device, as found in its configuration
+// descriptor.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned char ucAddress;
+    unsigned char ucAttributes;
+    unsigned short usMaxPacket;
+    unsigned char ucInterval;
+}
+tUSBSimEndpoint;
+
+//*****************************************************************************
+//
+// The maximum number of endpoints and the configuration descriptor size
+// recorded by the virtual host.
+//
+//*****************************************************************************
+#define USBSIM_MAX_ENDPOINTS    8
+#define USBSIM_MAX_CONFIG_SIZE  512
+
+//*****************************************************************************
+//
+// The state the virtual host keeps for the attached device.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulAddress;
+    unsigned char pucDeviceDesc[18];
+    unsigned char pucConfigDesc[USBSIM_MAX_CONFIG_SIZE];
+    unsigned long ulConfigSize;
+    unsigned long ulNumEndpoints;
+    tUSBSimEndpoint psEndpoints[USBSIM_MAX_ENDPOINTS];
+}
+tUSBSimDevice;
+
+//*****************************************************************************
+//
+// Virtual host functions (usbsimhost.c).
+//
+//*****************************************************************************
+extern tUSBSimDevice g_sUSBSimDevice;
+extern void USBSimHostIdleSet(void (*pfnIdle)(void));
+extern long USBSimHostControl(unsigned char ucRequestType,
+                              unsigned char ucRequest, unsigned short usValue,
+                              unsigned short usIndex, unsigned short usLength,
+                              unsigned char *pucData);
+extern long USBSimHostEnumerate(unsigned long ulAddress);
+extern long USBSimHostEndpointFind(unsigned char ucAttributes,
+                                   tBoolean bIn);
+extern long USBSimHostOut(unsigned long ulEP, const unsigned char *pucData,
+                          unsigned long ulSize, tBoolean bZLP);
+extern long USBSimHostIn(unsigned long ulEP, unsigned char *pucData,
+                         unsigned long ulSize);
+extern long USBSimHostIsoOut(unsigned long ulEP, const unsigned char *pucData,
+                             unsigned long ulSize);
+extern long USBSimHostIsoIn(unsigned long ulEP, unsigned char *pucData,
+                            unsigned long ulSize);
+extern void USBSimHostFrames(unsigned long ulFrames);
+
+#endif // __USBSIM_H__
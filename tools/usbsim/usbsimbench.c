@@ -0,0 +1,2542 @@
+//*****************************************************************************
+//
+// usbsimbench.c - Throughput and interrupt benchmarks for the USB device
+//                 classes, run on the simulated USB controller.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+//
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+//
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+//
+// This is part of revision 9453 of the Stellaris Firmware Development Package.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "inc/hw_types.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/usbcdc.h"
+#include "usblib/usbmsc.h"
+#include "usblib/usbaudio.h"
+#include "usblib/usb-ids.h"
+#include "usblib/device/usbdevice.h"
+#include "usblib/device/usbdaudio.h"
+#include "usblib/device/usbdbulk.h"
+#include "usblib/device/usbdcdc.h"
+#include "usblib/device/usbdmsc.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The device classes that can be benchmarked.
+//
+//*****************************************************************************
+typedef enum
+{
+    DEVICE_AUDIO,
+    DEVICE_AUDIO_ASYNC,
+    DEVICE_BULK,
+    DEVICE_CDC,
+    DEVICE_MSC,
+    DEVICE_MSC_CACHE
+}
+tBenchDevice;
+
+static tBenchDevice g_eDevice = DEVICE_BULK;
+
+//*****************************************************************************
+//
+// The size of the USBBuffer rings and of the USBBuffer workspaces.  The
+// buffer's private data holds pointers and unsigned longs, which are twice
+// as wide on an LP64 host as on the target.
+//
+//*****************************************************************************
+#define BENCH_BUFFER_SIZE       2048
+#define BENCH_WORKSPACE_SIZE    (USB_BUFFER_WORKSPACE_SIZE * 2)
+
+//*****************************************************************************
+//
+// The size of the RAM disk presented by the mass storage device.
+//
+//*****************************************************************************
+#define RAMDISK_BLOCKS          2048
+
+//*****************************************************************************
+//
+// The largest transfer made by the virtual host in one call.
+//
+//*****************************************************************************
+#define HOST_CHUNK              65536
+
+//*****************************************************************************
+//
+// The string descriptors shared by all of the devices.
+//
+//*****************************************************************************
+static const unsigned char g_pLangDescriptor[] =
+{
+    4,
+    USB_DTYPE_STRING,
+    USBShort(USB_LANG_EN_US)
+};
+
+static const unsigned char g_pManufacturerString[] =
+{
+    (17 + 1) * 2,
+    USB_DTYPE_STRING,
+    'T', 0, 'e', 0, 'x', 0, 'a', 0, 's', 0, ' ', 0, 'I', 0, 'n', 0, 's', 0,
+    't', 0, 'r', 0, 'u', 0, 'm', 0, 'e', 0, 'n', 0, 't', 0, 's', 0,
+};
+
+static const unsigned char g_pProductString[] =
+{
+    (6 + 1) * 2,
+    USB_DTYPE_STRING,
+    'U', 0, 'S', 0, 'B', 0, 'S', 0, 'i', 0, 'm', 0
+};
+
+static const unsigned char g_pSerialNumberString[] =
+{
+    (8 + 1) * 2,
+    USB_DTYPE_STRING,
+    '1', 0, '2', 0, '3', 0, '4', 0, '5', 0, '6', 0, '7', 0, '8', 0
+};
+
+static const unsigned char g_pInterfaceString[] =
+{
+    (9 + 1) * 2,
+    USB_DTYPE_STRING,
+    'I', 0, 'n', 0, 't', 0, 'e', 0, 'r', 0, 'f', 0, 'a', 0, 'c', 0,
+    'e', 0
+};
+
+static const unsigned char g_pConfigString[] =
+{
+    (13 + 1) * 2,
+    USB_DTYPE_STRING,
+    'C', 0, 'o', 0, 'n', 0, 'f', 0, 'i', 0, 'g', 0, 'u', 0, 'r', 0,
+    'a', 0, 't', 0, 'i', 0, 'o', 0, 'n', 0
+};
+
+static const unsigned char * const g_pStringDescriptors[] =
+{
+    g_pLangDescriptor,
+    g_pManufacturerString,
+    g_pProductString,
+    g_pSerialNumberString,
+    g_pInterfaceString,
+    g_pConfigString
+};
+
+#define NUM_STRING_DESCRIPTORS (sizeof(g_pStringDescriptors) /                \
+                                sizeof(unsigned char *))
+
+//*****************************************************************************
+//
+// The application's side of the data streams.  Data flows in both directions
+// as a fixed byte pattern so that the receiver can check every byte.
+//
+//*****************************************************************************
+static unsigned long g_ulDevRxCount;
+static unsigned long g_ulDevRxErrors;
+static unsigned long g_ulDevTxTarget;
+static unsigned long g_ulDevTxCount;
+static unsigned long g_ulDevWriteSize = 64;
+static unsigned long g_ulHostOutCount;
+static unsigned long g_ulHostInCount;
+
+//*****************************************************************************
+//
+// When true, the application sends with USBBufferDescQueue() instead of
+// copying data into the transmit ring with USBBufferWrite().
+//
+//*****************************************************************************
+static tBoolean g_bDevUseDesc;
+
+//*****************************************************************************
+//
+// The descriptors used to queue transmit data without copying, and the data
+// they point to, which holds the pattern for one period of 256 bytes plus
+// the largest write.
+//
+//*****************************************************************************
+#define NUM_DESCS               8
+#define MAX_WRITE_SIZE          1024
+
+static tUSBBufferDesc g_psDescs[NUM_DESCS];
+static unsigned long g_ulDescsFree = (1 << NUM_DESCS) - 1;
+static unsigned char g_pucPattern[256 + MAX_WRITE_SIZE];
+
+//*****************************************************************************
+//
+// Returns the byte of the test pattern at a given stream offset.
+//
+//*****************************************************************************
+static unsigned char
+Pattern(unsigned long ulOffset)
+{
+    return(g_pucPattern[ulOffset & 0xff]);
+}
+
+//*****************************************************************************
+//
+// Fills a buffer with the test pattern starting at a stream offset.
+//
+//*****************************************************************************
+static void
+PatternFill(unsigned char *pucData, unsigned long ulOffset,
+            unsigned long ulSize)
+{
+    while(ulSize--)
+    {
+        *pucData++ = Pattern(ulOffset++);
+    }
+}
+
+//*****************************************************************************
+//
+// Checks a buffer against the test pattern starting at a stream offset,
+// returning the number of bytes that differ.
+//
+//*****************************************************************************
+static unsigned long
+PatternCheck(const unsigned char *pucData, unsigned long ulOffset,
+             unsigned long ulSize)
+{
+    unsigned long ulErrors;
+
+    for(ulErrors = 0; ulSize--; )
+    {
+        if(*pucData++ != Pattern(ulOffset++))
+        {
+            ulErrors++;
+        }
+    }
+
+    return(ulErrors);
+}
+
+//*****************************************************************************
+//
+// The bulk and CDC device definitions.  Both use USBBuffers between the class
+// and the application.
+//
+//*****************************************************************************
+static unsigned long RxHandler(void *pvCBData, unsigned long ulEvent,
+                               unsigned long ulMsgValue, void *pvMsgData);
+static unsigned long TxHandler(void *pvCBData, unsigned long ulEvent,
+                               unsigned long ulMsgValue, void *pvMsgData);
+static unsigned long ControlHandler(void *pvCBData, unsigned long ulEvent,
+                                    unsigned long ulMsgValue,
+                                    void *pvMsgData);
+
+extern const tUSBBuffer g_sBulkTxBuffer;
+extern const tUSBBuffer g_sBulkRxBuffer;
+extern const tUSBBuffer g_sCDCTxBuffer;
+extern const tUSBBuffer g_sCDCRxBuffer;
+
+static tBulkInstance g_sBulkInstance;
+
+static const tUSBDBulkDevice g_sBulkDevice =
+{
+    USB_VID_STELLARIS,
+    USB_PID_BULK,
+    500,
+    USB_CONF_ATTR_SELF_PWR,
+    USBBufferEventCallback,
+    (void *)&g_sBulkRxBuffer,
+    USBBufferEventCallback,
+    (void *)&g_sBulkTxBuffer,
+    g_pStringDescriptors,
+    NUM_STRING_DESCRIPTORS,
+    &g_sBulkInstance
+};
+
+static tCDCSerInstance g_sCDCInstance;
+
+static const tUSBDCDCDevice g_sCDCDevice =
+{
+    USB_VID_STELLARIS,
+    USB_PID_SERIAL,
+    0,
+    USB_CONF_ATTR_SELF_PWR,
+    ControlHandler,
+    (void *)&g_sCDCDevice,
+    USBBufferEventCallback,
+    (void *)&g_sCDCRxBuffer,
+    USBBufferEventCallback,
+    (void *)&g_sCDCTxBuffer,
+    g_pStringDescriptors,
+    NUM_STRING_DESCRIPTORS,
+    &g_sCDCInstance
+};
+
+static unsigned char g_pucRxBuffer[BENCH_BUFFER_SIZE];
+static unsigned char g_pucRxWorkspace[BENCH_WORKSPACE_SIZE];
+static unsigned char g_pucTxBuffer[BENCH_BUFFER_SIZE];
+static unsigned char g_pucTxWorkspace[BENCH_WORKSPACE_SIZE];
+
+const tUSBBuffer g_sBulkRxBuffer =
+{
+    false,
+    RxHandler,
+    0,
+    USBDBulkPacketRead,
+    USBDBulkRxPacketAvailable,
+    (void *)&g_sBulkDevice,
+    g_pucRxBuffer,
+    BENCH_BUFFER_SIZE,
+    g_pucRxWorkspace
+};
+
+const tUSBBuffer g_sBulkTxBuffer =
+{
+    true,
+    TxHandler,
+    0,
+    USBDBulkPacketWrite,
+    USBDBulkTxPacketAvailable,
+    (void *)&g_sBulkDevice,
+    g_pucTxBuffer,
+    BENCH_BUFFER_SIZE,
+    g_pucTxWorkspace
+};
+
+const tUSBBuffer g_sCDCRxBuffer =
+{
+    false,
+    RxHandler,
+    0,
+    USBDCDCPacketRead,
+    USBDCDCRxPacketAvailable,
+    (void *)&g_sCDCDevice,
+    g_pucRxBuffer,
+    BENCH_BUFFER_SIZE,
+    g_pucRxWorkspace
+};
+
+const tUSBBuffer g_sCDCTxBuffer =
+{
+    true,
+    TxHandler,
+    0,
+    USBDCDCPacketWrite,
+    USBDCDCTxPacketAvailable,
+    (void *)&g_sCDCDevice,
+    g_pucTxBuffer,
+    BENCH_BUFFER_SIZE,
+    g_pucTxWorkspace
+};
+
+//*****************************************************************************
+//
+// The buffers in use by the current device.
+//
+//*****************************************************************************
+static const tUSBBuffer *g_psTxBuffer;
+static const tUSBBuffer *g_psRxBuffer;
+
+//*****************************************************************************
+//
+// The buffer used by the bulk device's transfer API and the byte counts given
+// by the last transfer done events, which are -1 while a transfer is in
+// progress.  The events reach the receive and transmit handlers through the
+// USB buffers, which pass on events that they do not handle themselves.
+//
+//*****************************************************************************
+#define XFER_SIZE               16384
+
+//*****************************************************************************
+//
+// The receive transfer idle timeout, in frames, used by the transfer tests.
+//
+//*****************************************************************************
+#define XFER_IDLE_FRAMES        2
+
+static unsigned long g_pulXferData[(XFER_SIZE + 64) / 4];
+static volatile long g_lXferRxDone, g_lXferTxDone;
+
+//*****************************************************************************
+//
+// The mass storage device and its RAM disk.
+//
+//*****************************************************************************
+static unsigned char g_pucRAMDisk[RAMDISK_BLOCKS * DEVICE_BLOCK_SIZE];
+static unsigned long g_ulRAMDiskReads, g_ulRAMDiskWrites;
+
+static void *
+RAMDiskOpen(unsigned long ulDrive)
+{
+    return(g_pucRAMDisk);
+}
+
+static void
+RAMDiskClose(void *pvDrive)
+{
+}
+
+static unsigned long
+RAMDiskRead(void *pvDrive, unsigned char *pucData, unsigned long ulSector,
+            unsigned long ulNumBlocks)
+{
+    g_ulRAMDiskReads++;
+    memcpy(pucData, g_pucRAMDisk + (ulSector * DEVICE_BLOCK_SIZE),
+           ulNumBlocks * DEVICE_BLOCK_SIZE);
+    return(ulNumBlocks * DEVICE_BLOCK_SIZE);
+}
+
+static unsigned long
+RAMDiskWrite(void *pvDrive, unsigned char *pucData, unsigned long ulSector,
+             unsigned long ulNumBlocks)
+{
+    g_ulRAMDiskWrites++;
+    memcpy(g_pucRAMDisk + (ulSector * DEVICE_BLOCK_SIZE), pucData,
+           ulNumBlocks * DEVICE_BLOCK_SIZE);
+    return(ulNumBlocks * DEVICE_BLOCK_SIZE);
+}
+
+static unsigned long
+RAMDiskNumBlocks(void *pvDrive)
+{
+    return(RAMDISK_BLOCKS);
+}
+
+static tMSCInstance g_sMSCInstance;
+
+static const tUSBDMSCDevice g_sMSCDevice =
+{
+    USB_VID_STELLARIS,
+    USB_PID_MSC,
+    "TI      ",
+    "USB Sim RAM Disk",
+    "1.00",
+    500,
+    USB_CONF_ATTR_SELF_PWR,
+    g_pStringDescriptors,
+    NUM_STRING_DESCRIPTORS,
+    {
+        RAMDiskOpen,
+        RAMDiskClose,
+        RAMDiskRead,
+        RAMDiskWrite,
+        RAMDiskNumBlocks,
+        0
+    },
+    0,
+    &g_sMSCInstance
+};
+
+//*****************************************************************************
+//
+// The mass storage device with the RAM disk behind the block cache.  The
+// cache is not const so that the benchmark can try it with several sizes of
+// read cache, read-ahead and write buffer.
+//
+//*****************************************************************************
+#define CACHE_LINES             8
+#define CACHE_READ_AHEAD        16
+#define CACHE_ERASE_BLOCKS      32
+
+static const tMSCDMedia g_sRAMDiskMedia =
+{
+    RAMDiskOpen,
+    RAMDiskClose,
+    RAMDiskRead,
+    RAMDiskWrite,
+    RAMDiskNumBlocks,
+    0
+};
+
+static unsigned char g_pucCacheLines[CACHE_LINES * DEVICE_BLOCK_SIZE];
+static tMSCCacheLine g_psCacheLines[CACHE_LINES];
+static unsigned char g_pucCacheReadAhead[CACHE_READ_AHEAD * DEVICE_BLOCK_SIZE];
+static unsigned char g_pucCacheErase[CACHE_ERASE_BLOCKS * DEVICE_BLOCK_SIZE];
+static tMSCCacheInstance g_sCacheInstance;
+
+static tUSBDMSCCache g_sMSCCache =
+{
+    &g_sRAMDiskMedia,
+    g_pucCacheLines,
+    g_psCacheLines,
+    CACHE_LINES,
+    g_pucCacheReadAhead,
+    CACHE_READ_AHEAD,
+    g_pucCacheErase,
+    CACHE_ERASE_BLOCKS,
+    &g_sCacheInstance
+};
+
+static tMSCInstance g_sMSCCacheInstance;
+
+static const tUSBDMSCDevice g_sMSCCacheDevice =
+{
+    USB_VID_STELLARIS,
+    USB_PID_MSC,
+    "TI      ",
+    "USB Sim RAM Disk",
+    "1.00",
+    500,
+    USB_CONF_ATTR_SELF_PWR,
+    g_pStringDescriptors,
+    NUM_STRING_DESCRIPTORS,
+    USBDMSC_CACHE_MEDIA_FUNCTIONS,
+    0,
+    &g_sMSCCacheInstance
+};
+
+//*****************************************************************************
+//
+// The audio devices, one using adaptive and one using asynchronous
+// synchronization.
+//
+//*****************************************************************************
+static unsigned long AudioHandler(void *pvCBData, unsigned long ulEvent,
+                                  unsigned long ulMsgValue, void *pvMsgData);
+
+static tAudioInstance g_sAudioInstance;
+
+static const tUSBDAudioDevice g_sAudioDevice =
+{
+    USB_VID_STELLARIS,
+    USB_PID_AUDIO,
+    "TI      ",
+    "USB Sim Audio   ",
+    "1.00",
+    500,
+    USB_CONF_ATTR_SELF_PWR,
+    AudioHandler,
+    g_pStringDescriptors,
+    NUM_STRING_DESCRIPTORS,
+    0,
+    (short)0x8000,
+    0x100,
+    &g_sAudioInstance,
+    0
+};
+
+static const tUSBDAudioDevice g_sAudioAsyncDevice =
+{
+    USB_VID_STELLARIS,
+    USB_PID_AUDIO,
+    "TI      ",
+    "USB Sim Audio   ",
+    "1.00",
+    500,
+    USB_CONF_ATTR_SELF_PWR,
+    AudioHandler,
+    g_pStringDescriptors,
+    NUM_STRING_DESCRIPTORS,
+    0,
+    (short)0x8000,
+    0x100,
+    &g_sAudioInstance,
+    USBD_AUDIO_FLAG_ASYNC
+};
+
+static void *g_pvAudioDevice;
+
+//*****************************************************************************
+//
+// Handles events from the receive buffer by reading and checking all of the
+// data available, as an application draining a serial stream would.
+//
+//*****************************************************************************
+static unsigned long
+RxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    unsigned char pucData[256];
+    unsigned long ulRead;
+
+    switch(ulEvent)
+    {
+        case USB_EVENT_RX_AVAILABLE:
+        {
+            while((ulRead = USBBufferRead(g_psRxBuffer, pucData,
+                                          sizeof(pucData))) != 0)
+            {
+                g_ulDevRxErrors += PatternCheck(pucData, g_ulDevRxCount,
+                                                ulRead);
+                g_ulDevRxCount += ulRead;
+            }
+            return(0);
+        }
+
+        case USB_EVENT_DATA_REMAINING:
+        {
+            return(0);
+        }
+
+        case USBD_BULK_EVENT_RX_TRANSFER_DONE:
+        {
+            g_lXferRxDone = (long)ulMsgValue;
+            return(0);
+        }
+
+        default:
+        {
+            return(0);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Handles events from the transmit buffer.  Descriptors are returned to the
+// free pool as they complete.
+//
+//*****************************************************************************
+static unsigned long
+TxHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+          void *pvMsgData)
+{
+    if(ulEvent == USB_EVENT_BUFFER_DESC_COMPLETE)
+    {
+        g_ulDescsFree |= 1 << ((tUSBBufferDesc *)pvMsgData - g_psDescs);
+    }
+    else if(ulEvent == USBD_BULK_EVENT_TX_TRANSFER_DONE)
+    {
+        g_lXferTxDone = (long)ulMsgValue;
+    }
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Handles CDC control events.  The line coding is simply stored.
+//
+//*****************************************************************************
+static tLineCoding g_sLineCoding = { 115200, USB_CDC_STOP_BITS_1,
+                                     USB_CDC_PARITY_NONE, 8 };
+
+static unsigned long
+ControlHandler(void *pvCBData, unsigned long ulEvent,
+               unsigned long ulMsgValue, void *pvMsgData)
+{
+    switch(ulEvent)
+    {
+        case USBD_CDC_EVENT_GET_LINE_CODING:
+        {
+            *(tLineCoding *)pvMsgData = g_sLineCoding;
+            break;
+        }
+
+        case USBD_CDC_EVENT_SET_LINE_CODING:
+        {
+            g_sLineCoding = *(tLineCoding *)pvMsgData;
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// The application's main loop, called by the virtual host between
+// transactions.  Each call writes one block of g_ulDevWriteSize bytes of the
+// pending transmit data if the transmit buffer has room, modeling a source
+// such as a UART that produces data at a steady rate.
+//
+//*****************************************************************************
+static void
+DeviceIdle(void)
+{
+    unsigned long ulSize, ulIdx;
+
+    if(!g_psTxBuffer)
+    {
+        return;
+    }
+
+    if(g_ulDevTxCount < g_ulDevTxTarget)
+    {
+        ulSize = g_ulDevTxTarget - g_ulDevTxCount;
+        ulSize = (ulSize < g_ulDevWriteSize) ? ulSize : g_ulDevWriteSize;
+
+        if(g_bDevUseDesc)
+        {
+            //
+            // Queue a descriptor pointing at the pattern, if one is free.
+            //
+            if(!g_ulDescsFree)
+            {
+                return;
+            }
+
+            for(ulIdx = 0; !(g_ulDescsFree & (1 << ulIdx)); ulIdx++)
+            {
+            }
+            g_ulDescsFree &= ~(1 << ulIdx);
+
+            g_psDescs[ulIdx].pucData = g_pucPattern + (g_ulDevTxCount & 0xff);
+            g_psDescs[ulIdx].ulLength = ulSize;
+            USBBufferDescQueue(g_psTxBuffer, &g_psDescs[ulIdx]);
+        }
+        else
+        {
+            if(USBBufferSpaceAvailable(g_psTxBuffer) < ulSize)
+            {
+                return;
+            }
+
+            USBBufferWrite(g_psTxBuffer,
+                           g_pucPattern + (g_ulDevTxCount & 0xff), ulSize);
+        }
+
+        g_ulDevTxCount += ulSize;
+    }
+}
+
+//*****************************************************************************
+//
+// Starts the selected device and enumerates it.
+//
+//*****************************************************************************
+static int
+DeviceStart(void)
+{
+    long lRet;
+
+    USBSimInit(USB0DeviceIntHandler);
+
+    switch(g_eDevice)
+    {
+        case DEVICE_BULK:
+        {
+            g_psTxBuffer = &g_sBulkTxBuffer;
+            g_psRxBuffer = &g_sBulkRxBuffer;
+            USBBufferInit(g_psTxBuffer);
+            USBBufferInit(g_psRxBuffer);
+            USBDBulkInit(0, &g_sBulkDevice);
+            break;
+        }
+
+        case DEVICE_CDC:
+        {
+            g_psTxBuffer = &g_sCDCTxBuffer;
+            g_psRxBuffer = &g_sCDCRxBuffer;
+            USBBufferInit(g_psTxBuffer);
+            USBBufferInit(g_psRxBuffer);
+            USBDCDCInit(0, &g_sCDCDevice);
+            break;
+        }
+
+        case DEVICE_MSC:
+        {
+            g_psTxBuffer = 0;
+            g_psRxBuffer = 0;
+            USBDMSCInit(0, &g_sMSCDevice);
+            break;
+        }
+
+        case DEVICE_MSC_CACHE:
+        {
+            g_psTxBuffer = 0;
+            g_psRxBuffer = 0;
+            USBDMSCCacheInit(&g_sMSCCache);
+            USBDMSCInit(0, &g_sMSCCacheDevice);
+            break;
+        }
+
+        case DEVICE_AUDIO:
+        case DEVICE_AUDIO_ASYNC:
+        {
+            g_psTxBuffer = 0;
+            g_psRxBuffer = 0;
+            g_pvAudioDevice = USBDAudioInit(0,
+                                            (g_eDevice == DEVICE_AUDIO) ?
+                                            &g_sAudioDevice :
+                                            &g_sAudioAsyncDevice);
+            break;
+        }
+    }
+
+    USBSimHostIdleSet(DeviceIdle);
+
+    lRet = USBSimHostEnumerate(1);
+    if(lRet < 0)
+    {
+        fprintf(stderr, "Enumeration failed (%ld).\n", lRet);
+        return(0);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Statistics for one benchmark run.
+//
+//*****************************************************************************
+static clock_t g_ulStartClock;
+
+static void
+RunStart(void)
+{
+    USBSimStatsClear();
+    g_ulStartClock = clock();
+}
+
+static void
+RunReport(const char *pcName, unsigned long ulBytes, unsigned long ulEP,
+          tBoolean bIn)
+{
+    tUSBSimStats sStats;
+    double dSeconds;
+
+    dSeconds = (double)(clock() - g_ulStartClock) / CLOCKS_PER_SEC;
+    USBSimStatsGet(&sStats);
+
+    printf("%-26s %8lu %6lu %8.1f %7lu %6lu %6lu %6lu %7.3f\n", pcName,
+           ulBytes, sStats.ulFrames,
+           sStats.ulFrames ? ((double)ulBytes / sStats.ulFrames) : 0.0,
+           sStats.ulInterrupts,
+           bIn ? sStats.pulInPackets[ulEP] : sStats.pulOutPackets[ulEP],
+           bIn ? sStats.pulInShort[ulEP] : 0,
+           bIn ? sStats.pulInNAKs[ulEP] : sStats.pulOutNAKs[ulEP],
+           dSeconds);
+}
+
+static void
+ReportHeader(void)
+{
+    printf("%-26s %8s %6s %8s %7s %6s %6s %6s %7s\n", "test", "bytes", "ms",
+           "KB/s", "ints", "pkts", "short", "NAKs", "cpu s");
+}
+
+//*****************************************************************************
+//
+// The number of enumerations made by each enumeration test, the number of
+// string descriptors read during each and the memory for the device's
+// descriptor cache.
+//
+//*****************************************************************************
+#define ENUM_COUNT              1000
+#define ENUM_STRINGS            4
+
+static unsigned long g_pulDescCache[256];
+
+//*****************************************************************************
+//
+// Enumerates the device ENUM_COUNT times, reading the string descriptors as a
+// PC host does, and stores the descriptors read in the last enumeration in
+// pucDesc.  Returns the number of descriptor bytes stored or 0 on failure.
+//
+//*****************************************************************************
+static unsigned long
+EnumerateRun(const char *pcName, unsigned char *pucDesc, unsigned long ulSize)
+{
+    unsigned long ulCount, ulIdx, ulUsed, ulBytes;
+    long lRet;
+
+    RunStart();
+
+    for(ulCount = 0; ulCount < ENUM_COUNT; ulCount++)
+    {
+        if(USBSimHostEnumerate(1) < 0)
+        {
+            fprintf(stderr, "%s: enumeration failed.\n", pcName);
+            return(0);
+        }
+
+        memcpy(pucDesc, g_sUSBSimDevice.pucDeviceDesc, 18);
+        memcpy(pucDesc + 18, g_sUSBSimDevice.pucConfigDesc,
+               g_sUSBSimDevice.ulConfigSize);
+        ulUsed = 18 + g_sUSBSimDevice.ulConfigSize;
+
+        for(ulIdx = 0; ulIdx < ENUM_STRINGS; ulIdx++)
+        {
+            lRet = USBSimHostControl(USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                                     USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                                     (USB_DTYPE_STRING << 8) | ulIdx,
+                                     ulIdx ? 0x0409 : 0, 255,
+                                     pucDesc + ulUsed);
+            if((lRet < 0) || ((ulUsed + 255) > ulSize))
+            {
+                fprintf(stderr, "%s: string %lu failed.\n", pcName, ulIdx);
+                return(0);
+            }
+            ulUsed += lRet;
+        }
+    }
+
+    //
+    // Report the control IN bytes moved by all of the enumerations.
+    //
+    ulBytes = ulUsed * ENUM_COUNT;
+    RunReport(pcName, ulBytes, 0, true);
+
+    return(ulUsed);
+}
+
+//*****************************************************************************
+//
+// Times enumeration with descriptors built on each request and with the
+// descriptor cache, and checks that the device returns the same descriptors
+// both ways.
+//
+//*****************************************************************************
+static int
+BenchEnumerate(void)
+{
+    static unsigned char pucPlain[1024], pucCached[1024];
+    unsigned long ulPlain, ulCached;
+    char pcName[40];
+    const char *pcDev;
+
+    pcDev = (g_eDevice == DEVICE_CDC) ? "cdc" :
+            (g_eDevice == DEVICE_MSC) ? "msc" :
+            (g_eDevice == DEVICE_MSC_CACHE) ? "msc-cache" : "bulk";
+
+    USBDCDDescCacheSet(0, 0, 0);
+    snprintf(pcName, sizeof(pcName), "%s enumerate", pcDev);
+    ulPlain = EnumerateRun(pcName, pucPlain, sizeof(pucPlain));
+
+    USBDCDDescCacheSet(0, g_pulDescCache, sizeof(g_pulDescCache));
+    snprintf(pcName, sizeof(pcName), "%s enumerate, cached", pcDev);
+    ulCached = EnumerateRun(pcName, pucCached, sizeof(pucCached));
+    USBDCDDescCacheSet(0, 0, 0);
+
+    if(!ulPlain || (ulPlain != ulCached) ||
+       memcmp(pucPlain, pucCached, ulPlain))
+    {
+        fprintf(stderr, "%s: cached descriptors differ.\n", pcDev);
+        return(0);
+    }
+
+    //
+    // Leave the device configured for the benchmarks that follow.
+    //
+    return(USBSimHostEnumerate(1) == 0);
+}
+
+//*****************************************************************************
+//
+// Sends a stream of pattern data from the host and checks that the device
+// application received it.
+//
+//*****************************************************************************
+static int
+StreamOut(const char *pcName, unsigned long ulEP, unsigned long ulBytes)
+{
+    unsigned char pucData[HOST_CHUNK];
+    unsigned long ulChunk, ulStart;
+    long lRet;
+
+    RunStart();
+    ulStart = g_ulHostOutCount;
+
+    while((g_ulHostOutCount - ulStart) < ulBytes)
+    {
+        ulChunk = ulBytes - (g_ulHostOutCount - ulStart);
+        ulChunk = (ulChunk < HOST_CHUNK) ? ulChunk : HOST_CHUNK;
+        PatternFill(pucData, g_ulHostOutCount, ulChunk);
+
+        lRet = USBSimHostOut(ulEP, pucData, ulChunk, false);
+        if(lRet <= 0)
+        {
+            fprintf(stderr, "%s: OUT failed (%ld).\n", pcName, lRet);
+            return(0);
+        }
+        g_ulHostOutCount += lRet;
+    }
+
+    //
+    // Let the application drain anything still in its buffer.
+    //
+    USBSimHostFrames(2);
+
+    RunReport(pcName, ulBytes, ulEP, false);
+
+    if((g_ulDevRxCount != g_ulHostOutCount) || g_ulDevRxErrors)
+    {
+        fprintf(stderr, "%s: device received %lu of %lu bytes, %lu bad.\n",
+                pcName, g_ulDevRxCount, g_ulHostOutCount, g_ulDevRxErrors);
+        return(0);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Has the device application send a stream of pattern data in writes of a
+// given size and checks what the host receives.
+//
+//*****************************************************************************
+static int
+StreamIn(const char *pcName, unsigned long ulEP, unsigned long ulBytes,
+         unsigned long ulWriteSize, tBoolean bDesc)
+{
+    unsigned char pucData[HOST_CHUNK];
+    unsigned long ulChunk, ulStart, ulErrors;
+    long lRet;
+
+    g_ulDevWriteSize = ulWriteSize;
+    g_bDevUseDesc = bDesc;
+
+    RunStart();
+    ulStart = g_ulHostInCount;
+    g_ulDevTxTarget += ulBytes;
+    ulErrors = 0;
+
+    while((g_ulHostInCount - ulStart) < ulBytes)
+    {
+        ulChunk = ulBytes - (g_ulHostInCount - ulStart);
+        ulChunk = (ulChunk < HOST_CHUNK) ? ulChunk : HOST_CHUNK;
+
+        lRet = USBSimHostIn(ulEP, pucData, ulChunk);
+        if(lRet < 0)
+        {
+            fprintf(stderr, "%s: IN failed after %lu bytes (%ld).\n", pcName,
+                    g_ulHostInCount - ulStart, lRet);
+            return(0);
+        }
+        ulErrors += PatternCheck(pucData, g_ulHostInCount, lRet);
+        g_ulHostInCount += lRet;
+    }
+
+    RunReport(pcName, ulBytes, ulEP, true);
+
+    g_bDevUseDesc = false;
+
+    if(ulErrors)
+    {
+        fprintf(stderr, "%s: %lu bad bytes.\n", pcName, ulErrors);
+        return(0);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Runs the bulk and CDC benchmarks, which share the same data path.
+//
+//*****************************************************************************
+static int
+BenchSerial(unsigned long ulBytes)
+{
+    static const unsigned long pulWriteSizes[] = { 1, 16, 64, 200, 1024 };
+    unsigned long ulIdx, ulIn, ulOut;
+    char pcName[40];
+    const char *pcDev;
+
+    pcDev = (g_eDevice == DEVICE_CDC) ? "cdc" : "bulk";
+
+    if(g_eDevice == DEVICE_CDC)
+    {
+        unsigned char pucCoding[7] = { 0x00, 0xc2, 0x01, 0x00, 0, 0, 8 };
+        unsigned char pucRead[7];
+
+        //
+        // Set and read back 115200 8N1, then raise DTR and RTS.
+        //
+        RunStart();
+        if((USBSimHostControl(USB_RTYPE_DIR_OUT | USB_RTYPE_CLASS |
+                              USB_RTYPE_INTERFACE, USB_CDC_SET_LINE_CODING,
+                              0, 0, 7, pucCoding) != 7) ||
+           (USBSimHostControl(USB_RTYPE_DIR_IN | USB_RTYPE_CLASS |
+                              USB_RTYPE_INTERFACE, USB_CDC_GET_LINE_CODING,
+                              0, 0, 7, pucRead) != 7) ||
+           memcmp(pucCoding, pucRead, 7) ||
+           (USBSimHostControl(USB_RTYPE_DIR_OUT | USB_RTYPE_CLASS |
+                              USB_RTYPE_INTERFACE,
+                              USB_CDC_SET_CONTROL_LINE_STATE, 3, 0, 0,
+                              0) != 0))
+        {
+            fprintf(stderr, "cdc: line coding requests failed.\n");
+            return(0);
+        }
+        RunReport("cdc line coding", 14, 0, true);
+    }
+
+    ulIn = USBSimHostEndpointFind(USB_EP_ATTR_BULK, true);
+    ulOut = USBSimHostEndpointFind(USB_EP_ATTR_BULK, false);
+
+    snprintf(pcName, sizeof(pcName), "%s out", pcDev);
+    if(!StreamOut(pcName, ulOut, ulBytes))
+    {
+        return(0);
+    }
+
+    for(ulIdx = 0; ulIdx < (sizeof(pulWriteSizes) / sizeof(unsigned long));
+        ulIdx++)
+    {
+        snprintf(pcName, sizeof(pcName), "%s in, %lu byte writes", pcDev,
+                 pulWriteSizes[ulIdx]);
+        if(!StreamIn(pcName, ulIn, ulBytes, pulWriteSizes[ulIdx], false))
+        {
+            return(0);
+        }
+    }
+
+    //
+    // Repeat the small writes with the transmit buffer holding partial
+    // packets back until the next start of frame.
+    //
+    USBBufferCoalesceSet(g_psTxBuffer, true, 0);
+    for(ulIdx = 0; ulIdx < 2; ulIdx++)
+    {
+        snprintf(pcName, sizeof(pcName), "%s in, %lu, coalesced", pcDev,
+                 pulWriteSizes[ulIdx]);
+        if(!StreamIn(pcName, ulIn, ulBytes, pulWriteSizes[ulIdx], false))
+        {
+            return(0);
+        }
+    }
+    USBBufferCoalesceSet(g_psTxBuffer, false, 0);
+
+    snprintf(pcName, sizeof(pcName), "%s in, 1024, descriptors", pcDev);
+    return(StreamIn(pcName, ulIn, ulBytes, 1024, true));
+}
+
+//*****************************************************************************
+//
+// Sends ulLength bytes of the test pattern from the bulk device with
+// USBDBulkTransferWrite() and reads them on the host.  The host asks for a
+// packet more than is sent so that the transfer must end with a short or
+// zero length packet.
+//
+//*****************************************************************************
+static int
+XferIn(unsigned long ulIn, unsigned long ulLength, unsigned long ulOffset)
+{
+    static unsigned char pucHost[XFER_SIZE + 64];
+    long lRet;
+
+    PatternFill((unsigned char *)g_pulXferData, ulOffset, ulLength);
+    g_lXferTxDone = -1;
+
+    if(!USBDBulkTransferWrite((void *)&g_sBulkDevice,
+                              (unsigned char *)g_pulXferData, ulLength))
+    {
+        fprintf(stderr, "bulk: transfer write of %lu bytes refused.\n",
+                ulLength);
+        return(0);
+    }
+
+    lRet = USBSimHostIn(ulIn, pucHost, ulLength + USBSimMaxPacketGet(ulIn,
+                                                                     true));
+    if((lRet != (long)ulLength) || (g_lXferTxDone != (long)ulLength) ||
+       PatternCheck(pucHost, ulOffset, ulLength))
+    {
+        fprintf(stderr, "bulk: transfer write of %lu bytes, host read %ld, "
+                "done %ld.\n", ulLength, lRet, g_lXferTxDone);
+        return(0);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Sends ulLength bytes of the test pattern from the host and receives them on
+// the bulk device with a USBDBulkTransferRead() of ulBufSize bytes.  With
+// bZLP set the host ends a transfer that fills its last packet with a zero
+// length packet.  Without it, such a transfer that does not fill the buffer
+// must be ended by the idle timeout.
+//
+//*****************************************************************************
+static int
+XferOut(unsigned long ulOut, unsigned long ulLength, unsigned long ulBufSize,
+        tBoolean bZLP, unsigned long ulOffset)
+{
+    static unsigned char pucHost[XFER_SIZE + 64];
+    long lRet;
+
+    memset(g_pulXferData, 0, sizeof(g_pulXferData));
+    g_lXferRxDone = -1;
+
+    if(!USBDBulkTransferRead((void *)&g_sBulkDevice,
+                             (unsigned char *)g_pulXferData, ulBufSize))
+    {
+        fprintf(stderr, "bulk: transfer read of %lu bytes refused.\n",
+                ulBufSize);
+        return(0);
+    }
+
+    PatternFill(pucHost, ulOffset, ulLength);
+    lRet = USBSimHostOut(ulOut, pucHost, ulLength, bZLP);
+
+    //
+    // The idle timeout must not end the transfer until the host has been
+    // quiet for XFER_IDLE_FRAMES whole frames, the first frame after the
+    // data having been partly busy.
+    //
+    if(!bZLP && (ulLength < ulBufSize) && !(ulLength % 64))
+    {
+        USBSimHostFrames(XFER_IDLE_FRAMES);
+        if(g_lXferRxDone != -1)
+        {
+            fprintf(stderr, "bulk: transfer read of %lu bytes ended early, "
+                    "done %ld.\n", ulLength, g_lXferRxDone);
+            return(0);
+        }
+        USBSimHostFrames(1);
+    }
+
+    if((lRet != (long)ulLength) || (g_lXferRxDone != (long)ulLength) ||
+       PatternCheck((unsigned char *)g_pulXferData, ulOffset, ulLength))
+    {
+        fprintf(stderr, "bulk: transfer read of %lu into %lu bytes, host sent "
+                "%ld, done %ld.\n", ulLength, ulBufSize, lRet, g_lXferRxDone);
+        return(0);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Runs the bulk device's transfer API.  Transfers of lengths around the
+// packet size and the 4 KB uDMA limit are checked in both directions: those
+// sent by the device must end in a short or zero length packet, and those
+// received must end on a short packet, a zero length packet or when the
+// buffer is full.  Transfers of whole packets into a larger buffer are then
+// ended by the idle timeout.  Then ulBytes are moved each way in XFER_SIZE
+// transfers.
+//
+//*****************************************************************************
+static int
+BenchBulkTransfer(unsigned long ulBytes)
+{
+    static const unsigned long pulLengths[] =
+    {
+        0, 1, 63, 64, 65, 127, 128, 4032, 4095, 4096, 4097, 4160, 8192,
+        12289, XFER_SIZE
+    };
+    unsigned long ulIdx, ulLength, ulIn, ulOut, ulCount;
+
+    ulIn = USBSimHostEndpointFind(USB_EP_ATTR_BULK, true);
+    ulOut = USBSimHostEndpointFind(USB_EP_ATTR_BULK, false);
+
+    RunStart();
+    ulCount = 0;
+    for(ulIdx = 0; ulIdx < (sizeof(pulLengths) / sizeof(unsigned long));
+        ulIdx++)
+    {
+        ulLength = pulLengths[ulIdx];
+
+        //
+        // Send the transfer to the host, then receive it into a buffer with
+        // room to spare so that the host's short or zero length packet ends
+        // it.
+        //
+        if(!XferIn(ulIn, ulLength, ulIdx) ||
+           !XferOut(ulOut, ulLength, ((ulLength / 64) + 1) * 64, true,
+                    ulIdx))
+        {
+            return(0);
+        }
+        ulCount += 2 * ulLength;
+
+        //
+        // A transfer that exactly fills the buffer ends without a zero
+        // length packet.
+        //
+        if(ulLength && !(ulLength % 64))
+        {
+            if(!XferOut(ulOut, ulLength, ulLength, false, ulIdx + 1))
+            {
+                return(0);
+            }
+            ulCount += ulLength;
+        }
+    }
+    RunReport("bulk transfer, edge cases", ulCount, ulIn, true);
+
+    //
+    // With an idle timeout set, transfers that fill their last packet but
+    // not the buffer end once the host stops sending, with no zero length
+    // packet.
+    //
+    if(!USBDBulkTransferTimeoutSet((void *)&g_sBulkDevice, XFER_IDLE_FRAMES))
+    {
+        fprintf(stderr, "bulk: no frame handler for the idle timeout.\n");
+        return(0);
+    }
+    RunStart();
+    ulCount = 0;
+    for(ulIdx = 0; ulIdx < (sizeof(pulLengths) / sizeof(unsigned long));
+        ulIdx++)
+    {
+        ulLength = pulLengths[ulIdx];
+        if(ulLength && !(ulLength % 64) && (ulLength < XFER_SIZE))
+        {
+            if(!XferOut(ulOut, ulLength, XFER_SIZE, false, ulIdx + 2))
+            {
+                return(0);
+            }
+            ulCount += ulLength;
+        }
+    }
+    RunReport("bulk transfer, idle timeout", ulCount, ulOut, false);
+    USBDBulkTransferTimeoutSet((void *)&g_sBulkDevice, 0);
+
+    RunStart();
+    for(ulCount = 0; ulCount < ulBytes; ulCount += XFER_SIZE)
+    {
+        if(!XferOut(ulOut, XFER_SIZE, XFER_SIZE, false, ulCount))
+        {
+            return(0);
+        }
+    }
+    RunReport("bulk transfer out, 16K", ulCount, ulOut, false);
+
+    RunStart();
+    for(ulCount = 0; ulCount < ulBytes; ulCount += XFER_SIZE)
+    {
+        if(!XferIn(ulIn, XFER_SIZE, ulCount))
+        {
+            return(0);
+        }
+    }
+    RunReport("bulk transfer in, 16K", ulCount, ulIn, true);
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Performs one mass storage Bulk-Only Transport command.  The data stage is
+// ulSize bytes, read into or written from pucData.
+//
+//*****************************************************************************
+static int
+MSCCommand(const unsigned char *pucCDB, unsigned long ulCDBSize,
+           unsigned char *pucData, unsigned long ulSize, tBoolean bIn)
+{
+    static unsigned long ulTag;
+    unsigned char pucCBW[31], pucCSW[13];
+    unsigned long ulIn, ulOut, ulDone;
+    long lRet;
+
+    ulIn = USBSimHostEndpointFind(USB_EP_ATTR_BULK, true);
+    ulOut = USBSimHostEndpointFind(USB_EP_ATTR_BULK, false);
+
+    //
+    // Build and send the Command Block Wrapper.
+    //
+    memset(pucCBW, 0, sizeof(pucCBW));
+    ulTag++;
+    pucCBW[0] = 'U';
+    pucCBW[1] = 'S';
+    pucCBW[2] = 'B';
+    pucCBW[3] = 'C';
+    pucCBW[4] = ulTag & 0xff;
+    pucCBW[5] = (ulTag >> 8) & 0xff;
+    pucCBW[6] = (ulTag >> 16) & 0xff;
+    pucCBW[7] = (ulTag >> 24) & 0xff;
+    pucCBW[8] = ulSize & 0xff;
+    pucCBW[9] = (ulSize >> 8) & 0xff;
+    pucCBW[10] = (ulSize >> 16) & 0xff;
+    pucCBW[11] = (ulSize >> 24) & 0xff;
+    pucCBW[12] = bIn ? CBWFLAGS_DIR_IN : CBWFLAGS_DIR_OUT;
+    pucCBW[14] = ulCDBSize;
+    memcpy(pucCBW + 15, pucCDB, ulCDBSize);
+
+    if(USBSimHostOut(ulOut, pucCBW, sizeof(pucCBW), false) != sizeof(pucCBW))
+    {
+        fprintf(stderr, "msc: CBW failed.\n");
+        return(0);
+    }
+
+    //
+    // Move the data.
+    //
+    for(ulDone = 0; ulDone < ulSize; ulDone += lRet)
+    {
+        if(bIn)
+        {
+            lRet = USBSimHostIn(ulIn, pucData + ulDone, ulSize - ulDone);
+        }
+        else
+        {
+            lRet = USBSimHostOut(ulOut, pucData + ulDone, ulSize - ulDone,
+                                 false);
+        }
+
+        if(lRet <= 0)
+        {
+            fprintf(stderr, "msc: data stage failed after %lu bytes (%ld).\n",
+                    ulDone, lRet);
+            return(0);
+        }
+
+        //
+        // A short packet ends an IN data stage early.
+        //
+        if(bIn && (ulDone + lRet < ulSize) &&
+           ((lRet % USBSimMaxPacketGet(ulIn, true)) != 0))
+        {
+            ulDone += lRet;
+            break;
+        }
+    }
+
+    //
+    // Read and check the Command Status Wrapper.
+    //
+    lRet = USBSimHostIn(ulIn, pucCSW, sizeof(pucCSW));
+    if((lRet != sizeof(pucCSW)) || memcmp(pucCSW, "USBS", 4) ||
+       memcmp(pucCSW + 4, pucCBW + 4, 4) || (pucCSW[12] != 0))
+    {
+        fprintf(stderr, "msc: bad CSW (%ld, status %d).\n", lRet,
+                (lRet == sizeof(pucCSW)) ? pucCSW[12] : -1);
+        return(0);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Builds a READ(10) or WRITE(10) command block.
+//
+//*****************************************************************************
+static void
+MSCBlockCDB(unsigned char *pucCDB, unsigned char ucOp, unsigned long ulLBA,
+            unsigned long ulBlocks)
+{
+    memset(pucCDB, 0, 10);
+    pucCDB[0] = ucOp;
+    pucCDB[2] = (ulLBA >> 24) & 0xff;
+    pucCDB[3] = (ulLBA >> 16) & 0xff;
+    pucCDB[4] = (ulLBA >> 8) & 0xff;
+    pucCDB[5] = ulLBA & 0xff;
+    pucCDB[7] = (ulBlocks >> 8) & 0xff;
+    pucCDB[8] = ulBlocks & 0xff;
+}
+
+//*****************************************************************************
+//
+// Runs the mass storage benchmark: identifies the RAM disk, then writes the
+// test pattern to it and reads it back in commands of several sizes.
+//
+//*****************************************************************************
+static int
+BenchMSC(unsigned long ulBytes)
+{
+    static const unsigned long pulBlocks[] = { 1, 8, 64, 128 };
+    static unsigned char pucData[HOST_CHUNK];
+    unsigned char pucCDB[10];
+    unsigned long ulIdx, ulLBA, ulBlocks, ulCount, ulIn, ulOut;
+    char pcName[40];
+
+    ulIn = USBSimHostEndpointFind(USB_EP_ATTR_BULK, true);
+    ulOut = USBSimHostEndpointFind(USB_EP_ATTR_BULK, false);
+
+    if(ulBytes > sizeof(g_pucRAMDisk))
+    {
+        ulBytes = sizeof(g_pucRAMDisk);
+    }
+
+    RunStart();
+    memset(pucCDB, 0, sizeof(pucCDB));
+    pucCDB[0] = SCSI_INQUIRY_CMD;
+    pucCDB[4] = 36;
+    if(!MSCCommand(pucCDB, 6, pucData, 36, true) ||
+       memcmp(pucData + 16, g_sMSCDevice.pucProduct, 16))
+    {
+        fprintf(stderr, "msc: INQUIRY failed.\n");
+        return(0);
+    }
+
+    memset(pucCDB, 0, sizeof(pucCDB));
+    pucCDB[0] = SCSI_READ_CAPACITY;
+    if(!MSCCommand(pucCDB, 10, pucData, 8, true) ||
+       (((pucData[0] << 24) | (pucData[1] << 16) | (pucData[2] << 8) |
+         pucData[3]) != (RAMDISK_BLOCKS - 1)))
+    {
+        fprintf(stderr, "msc: READ CAPACITY failed.\n");
+        return(0);
+    }
+    RunReport("msc inquiry, capacity", 44, ulIn, true);
+
+    for(ulIdx = 0; ulIdx < (sizeof(pulBlocks) / sizeof(unsigned long));
+        ulIdx++)
+    {
+        ulBlocks = pulBlocks[ulIdx];
+
+        //
+        // Write the pattern, offset by the command size so that each pass
+        // writes different data.
+        //
+        snprintf(pcName, sizeof(pcName), "msc write, %lu blocks", ulBlocks);
+        RunStart();
+        for(ulLBA = 0; ulLBA < (ulBytes / DEVICE_BLOCK_SIZE);
+            ulLBA += ulBlocks)
+        {
+            ulCount = ulBlocks * DEVICE_BLOCK_SIZE;
+            PatternFill(pucData, (ulLBA * DEVICE_BLOCK_SIZE) + ulIdx,
+                        ulCount);
+            MSCBlockCDB(pucCDB, SCSI_WRITE_10, ulLBA, ulBlocks);
+            if(!MSCCommand(pucCDB, 10, pucData, ulCount, false))
+            {
+                return(0);
+            }
+        }
+        RunReport(pcName, ulBytes, ulOut, false);
+
+        if(PatternCheck(g_pucRAMDisk, ulIdx, ulBytes))
+        {
+            fprintf(stderr, "msc: RAM disk does not hold written data.\n");
+            return(0);
+        }
+
+        snprintf(pcName, sizeof(pcName), "msc read, %lu blocks", ulBlocks);
+        RunStart();
+        for(ulLBA = 0; ulLBA < (ulBytes / DEVICE_BLOCK_SIZE);
+            ulLBA += ulBlocks)
+        {
+            ulCount = ulBlocks * DEVICE_BLOCK_SIZE;
+            MSCBlockCDB(pucCDB, SCSI_READ_10, ulLBA, ulBlocks);
+            if(!MSCCommand(pucCDB, 10, pucData, ulCount, true))
+            {
+                return(0);
+            }
+            if(PatternCheck(pucData, (ulLBA * DEVICE_BLOCK_SIZE) + ulIdx,
+                            ulCount))
+            {
+                fprintf(stderr, "msc: read data mismatch at block %lu.\n",
+                        ulLBA);
+                return(0);
+            }
+        }
+        RunReport(pcName, ulBytes, ulIn, true);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// The cache configurations tried by the mass storage cache test, as the
+// number of read cache lines, read-ahead blocks and write buffer blocks, and
+// the number of commands sent to each.
+//
+//*****************************************************************************
+static const unsigned long g_ppulCacheConfigs[][3] =
+{
+    { 0, 0, 0 },
+    { CACHE_LINES, 0, 0 },
+    { 0, CACHE_READ_AHEAD, 0 },
+    { 0, 0, CACHE_ERASE_BLOCKS },
+    { 3, 4, 8 },
+    { CACHE_LINES, CACHE_READ_AHEAD, CACHE_ERASE_BLOCKS }
+};
+
+#define CACHE_TEST_COMMANDS     4000
+#define CACHE_TEST_BLOCKS       512
+#define CACHE_TEST_HOT_BLOCKS   16
+#define CACHE_TEST_MAX_BLOCKS   40
+
+//*****************************************************************************
+//
+// Returns a pseudo-random number for the cache test.  A fixed generator is
+// used rather than rand() so that each run sends the same commands.
+//
+//*****************************************************************************
+static unsigned long g_ulCacheRandom;
+
+static unsigned long
+CacheRandom(void)
+{
+    g_ulCacheRandom = (g_ulCacheRandom * 1103515245 + 12345) & 0xffffffff;
+    return(g_ulCacheRandom >> 16);
+}
+
+//*****************************************************************************
+//
+// Runs the mass storage cache test.  For each cache configuration the host
+// sends a random mix of READ(10), WRITE(10) and SYNCHRONIZE CACHE commands,
+// most of them to a small group of blocks as a file system does for its FAT
+// and directories and the rest as runs of sequential reads and writes.  Every
+// block read is checked against a copy of what the host has written, and
+// after a final SYNCHRONIZE CACHE the RAM disk itself must match the copy.
+// The number of calls made to the RAM disk shows how much of the host's
+// traffic the cache absorbed.
+//
+//*****************************************************************************
+static int
+BenchMSCCache(void)
+{
+    static unsigned char pucRef[CACHE_TEST_BLOCKS * DEVICE_BLOCK_SIZE];
+    static unsigned char pucData[CACHE_TEST_MAX_BLOCKS * DEVICE_BLOCK_SIZE];
+    unsigned char pucCDB[10];
+    unsigned long ulConfig, ulCmd, ulLBA, ulBlocks, ulNext, ulIdx, ulOp;
+    unsigned long ulIn, ulRead, ulWritten;
+    char pcName[40];
+
+    ulIn = USBSimHostEndpointFind(USB_EP_ATTR_BULK, true);
+
+    for(ulConfig = 0;
+        ulConfig < (sizeof(g_ppulCacheConfigs) / sizeof(g_ppulCacheConfigs[0]));
+        ulConfig++)
+    {
+        //
+        // Write back anything held by the previous configuration, then give
+        // the cache its new sizes and reopen the RAM disk behind it.  The
+        // mass storage device keeps using the same cache structure.
+        //
+        USBDMSCCacheClose(&g_sMSCCache);
+        g_sMSCCache.ulNumLines = g_ppulCacheConfigs[ulConfig][0];
+        g_sMSCCache.ulReadAhead = g_ppulCacheConfigs[ulConfig][1];
+        g_sMSCCache.ulEraseBlocks = g_ppulCacheConfigs[ulConfig][2];
+        USBDMSCCacheInit(&g_sMSCCache);
+        if(USBDMSCCacheOpen(0) != &g_sMSCCache)
+        {
+            fprintf(stderr, "msc-cache: media open failed.\n");
+            return(0);
+        }
+
+        memcpy(pucRef, g_pucRAMDisk, sizeof(pucRef));
+        g_ulCacheRandom = ulConfig + 1;
+        g_ulRAMDiskReads = 0;
+        g_ulRAMDiskWrites = 0;
+        ulRead = 0;
+        ulWritten = 0;
+        ulNext = 0;
+
+        snprintf(pcName, sizeof(pcName), "msc cache %lu/%lu/%lu",
+                 g_sMSCCache.ulNumLines, g_sMSCCache.ulReadAhead,
+                 g_sMSCCache.ulEraseBlocks);
+        RunStart();
+
+        for(ulCmd = 0; ulCmd < CACHE_TEST_COMMANDS; ulCmd++)
+        {
+            ulOp = CacheRandom() % 16;
+
+            //
+            // Now and then the host flushes the device's cache.
+            //
+            if(ulOp == 0)
+            {
+                memset(pucCDB, 0, sizeof(pucCDB));
+                pucCDB[0] = SCSI_SYNCHRONIZE_CACHE;
+                if(!MSCCommand(pucCDB, 10, pucData, 0, false))
+                {
+                    return(0);
+                }
+                continue;
+            }
+
+            //
+            // Pick single blocks in the busy area, or runs of blocks that
+            // often carry on from the end of the last command.
+            //
+            if(ulOp < 9)
+            {
+                ulLBA = CacheRandom() % CACHE_TEST_HOT_BLOCKS;
+                ulBlocks = 1;
+            }
+            else
+            {
+                ulLBA = (CacheRandom() & 1) ? ulNext :
+                        (CACHE_TEST_HOT_BLOCKS +
+                         (CacheRandom() %
+                          (CACHE_TEST_BLOCKS - CACHE_TEST_HOT_BLOCKS)));
+                ulBlocks = (CacheRandom() % CACHE_TEST_MAX_BLOCKS) + 1;
+                if(ulLBA >= CACHE_TEST_BLOCKS)
+                {
+                    ulLBA = CACHE_TEST_HOT_BLOCKS;
+                }
+                if((ulLBA + ulBlocks) > CACHE_TEST_BLOCKS)
+                {
+                    ulBlocks = CACHE_TEST_BLOCKS - ulLBA;
+                }
+            }
+            ulNext = ulLBA + ulBlocks;
+
+            if(ulOp & 1)
+            {
+                for(ulIdx = 0; ulIdx < (ulBlocks * DEVICE_BLOCK_SIZE);
+                    ulIdx++)
+                {
+                    pucData[ulIdx] = (unsigned char)CacheRandom();
+                }
+                memcpy(pucRef + (ulLBA * DEVICE_BLOCK_SIZE), pucData,
+                       ulBlocks * DEVICE_BLOCK_SIZE);
+
+                MSCBlockCDB(pucCDB, SCSI_WRITE_10, ulLBA, ulBlocks);
+                if(!MSCCommand(pucCDB, 10, pucData,
+                               ulBlocks * DEVICE_BLOCK_SIZE, false))
+                {
+                    return(0);
+                }
+                ulWritten += ulBlocks;
+            }
+            else
+            {
+                MSCBlockCDB(pucCDB, SCSI_READ_10, ulLBA, ulBlocks);
+                if(!MSCCommand(pucCDB, 10, pucData,
+                               ulBlocks * DEVICE_BLOCK_SIZE, true))
+                {
+                    return(0);
+                }
+                if(memcmp(pucData, pucRef + (ulLBA * DEVICE_BLOCK_SIZE),
+                          ulBlocks * DEVICE_BLOCK_SIZE))
+                {
+                    fprintf(stderr, "%s: read mismatch at block %lu, "
+                            "command %lu.\n", pcName, ulLBA, ulCmd);
+                    return(0);
+                }
+                ulRead += ulBlocks;
+            }
+        }
+
+        memset(pucCDB, 0, sizeof(pucCDB));
+        pucCDB[0] = SCSI_SYNCHRONIZE_CACHE;
+        if(!MSCCommand(pucCDB, 10, pucData, 0, false))
+        {
+            return(0);
+        }
+
+        RunReport(pcName, (ulRead + ulWritten) * DEVICE_BLOCK_SIZE, ulIn,
+                  true);
+
+        if(memcmp(g_pucRAMDisk, pucRef, sizeof(pucRef)))
+        {
+            fprintf(stderr, "%s: RAM disk differs after SYNCHRONIZE CACHE.\n",
+                    pcName);
+            return(0);
+        }
+
+        printf("  %lu blocks read in %lu media reads, %lu blocks written in "
+               "%lu media writes\n", ulRead, g_ulRAMDiskReads, ulWritten,
+               g_ulRAMDiskWrites);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// The audio application.  Each sample is a 32 bit word holding its own
+// position in the stream, so the application can tell exactly how many
+// samples the host sent that never reached it.  The application plays samples
+// at the rate of its own clock, which is g_lAudioPPM parts per million faster
+// than the host's, and returns each buffer to the audio class once it has
+// been played.  Playback starts once AUDIO_PREFILL buffers are waiting.
+//
+//*****************************************************************************
+#define AUDIO_BUFFER_SIZE       1152
+#define AUDIO_PREFILL           2
+#define AUDIO_SAMPLES_PER_FRAME 48
+
+static unsigned int g_ppuiAudioBuffers[USBD_AUDIO_NUM_BUFFERS]
+                                      [AUDIO_BUFFER_SIZE / 4];
+static unsigned int *g_ppuiAudioPlay[USBD_AUDIO_NUM_BUFFERS];
+static unsigned long g_pulAudioPlaySize[USBD_AUDIO_NUM_BUFFERS];
+static unsigned long g_ulAudioPlayHead, g_ulAudioPlayCount, g_ulAudioPlayPos;
+static tBoolean g_bAudioPlaying;
+static long g_lAudioPPM;
+static unsigned long g_ulAudioClock;
+static unsigned long g_ulAudioNext;
+static unsigned long g_ulAudioLost;
+static unsigned long g_ulAudioStarved;
+static unsigned long g_ulAudioErrors;
+
+static void
+AudioBufferCallback(void *pvBuffer, unsigned long ulParam,
+                    unsigned long ulEvent)
+{
+    unsigned int *puiSample;
+    unsigned long ulIdx;
+
+    //
+    // Check that the samples carry on from the last ones received.
+    //
+    puiSample = pvBuffer;
+    for(ulIdx = 0; ulIdx < (ulParam / 4); ulIdx++)
+    {
+        if(puiSample[ulIdx] > g_ulAudioNext)
+        {
+            g_ulAudioLost += puiSample[ulIdx] - g_ulAudioNext;
+        }
+        else if(puiSample[ulIdx] < g_ulAudioNext)
+        {
+            g_ulAudioErrors++;
+        }
+        g_ulAudioNext = puiSample[ulIdx] + 1;
+    }
+
+    //
+    // Queue the buffer for playback.
+    //
+    ulIdx = (g_ulAudioPlayHead + g_ulAudioPlayCount) %
+            USBD_AUDIO_NUM_BUFFERS;
+    g_ppuiAudioPlay[ulIdx] = pvBuffer;
+    g_pulAudioPlaySize[ulIdx] = ulParam / 4;
+    g_ulAudioPlayCount++;
+}
+
+static unsigned long
+AudioHandler(void *pvCBData, unsigned long ulEvent, unsigned long ulMsgValue,
+             void *pvMsgData)
+{
+    return(0);
+}
+
+//*****************************************************************************
+//
+// Plays one frame's worth of samples at the application's clock rate.
+//
+//*****************************************************************************
+static void
+AudioPlay(void)
+{
+    unsigned long ulSamples;
+
+    //
+    // Work out how many samples the application's clock plays this frame.
+    //
+    g_ulAudioClock += (AUDIO_SAMPLES_PER_FRAME * (1000000 + g_lAudioPPM));
+    ulSamples = g_ulAudioClock / 1000000;
+    g_ulAudioClock -= ulSamples * 1000000;
+
+    if(!g_bAudioPlaying)
+    {
+        if(g_ulAudioPlayCount < AUDIO_PREFILL)
+        {
+            return;
+        }
+        g_bAudioPlaying = true;
+    }
+
+    while(ulSamples)
+    {
+        if(!g_ulAudioPlayCount)
+        {
+            g_ulAudioStarved += ulSamples;
+            return;
+        }
+
+        if((g_pulAudioPlaySize[g_ulAudioPlayHead] - g_ulAudioPlayPos) >
+           ulSamples)
+        {
+            g_ulAudioPlayPos += ulSamples;
+            return;
+        }
+
+        //
+        // This buffer has been played so give it back to the audio class.
+        //
+        ulSamples -= g_pulAudioPlaySize[g_ulAudioPlayHead] - g_ulAudioPlayPos;
+        g_ulAudioPlayPos = 0;
+        USBAudioBufferOut(g_pvAudioDevice, g_ppuiAudioPlay[g_ulAudioPlayHead],
+                          AUDIO_BUFFER_SIZE, AudioBufferCallback);
+        g_ulAudioPlayHead = (g_ulAudioPlayHead + 1) % USBD_AUDIO_NUM_BUFFERS;
+        g_ulAudioPlayCount--;
+    }
+}
+
+//*****************************************************************************
+//
+// Streams audio to the device for a number of frames with the device's clock
+// offset from the host's by lPPM parts per million.  With adaptive
+// synchronization the host sends 48 samples in every frame.  With
+// asynchronous synchronization it reads the feedback endpoint as often as
+// the endpoint asks and sends the number of samples per frame that the
+// device reports.
+//
+//*****************************************************************************
+static int
+AudioRun(unsigned long ulFrames, long lPPM)
+{
+    unsigned int puiPacket[(AUDIO_SAMPLES_PER_FRAME + 2)];
+    unsigned char pucFeedback[4];
+    unsigned long ulFrame, ulIdx, ulSample, ulSamples, ulFeedback, ulAcc;
+    unsigned long ulOut, ulIn, ulSize, ulRefresh;
+    tUSBSimStats sStats;
+    double dSeconds;
+    char pcName[40];
+    long lRet;
+
+    //
+    // Start the device again and select the active alternate setting of the
+    // streaming interface.
+    //
+    if(!DeviceStart() ||
+       (USBSimHostControl(USB_RTYPE_DIR_OUT | USB_RTYPE_STANDARD |
+                          USB_RTYPE_INTERFACE, USBREQ_SET_INTERFACE, 1, 1, 0,
+                          0) < 0))
+    {
+        fprintf(stderr, "audio: unable to start streaming.\n");
+        return(0);
+    }
+
+    g_ulAudioPlayHead = g_ulAudioPlayCount = g_ulAudioPlayPos = 0;
+    g_bAudioPlaying = false;
+    g_lAudioPPM = lPPM;
+    g_ulAudioClock = 0;
+    g_ulAudioNext = 0;
+    g_ulAudioLost = g_ulAudioStarved = g_ulAudioErrors = 0;
+
+    for(ulIdx = 0; ulIdx < USBD_AUDIO_NUM_BUFFERS; ulIdx++)
+    {
+        USBAudioBufferOut(g_pvAudioDevice, g_ppuiAudioBuffers[ulIdx],
+                          AUDIO_BUFFER_SIZE, AudioBufferCallback);
+    }
+
+    ulOut = USBSimHostEndpointFind(USB_EP_ATTR_ISOC, false);
+    ulIn = USBSimHostEndpointFind(USB_EP_ATTR_ISOC, true);
+    ulFeedback = AUDIO_SAMPLES_PER_FRAME << 14;
+    ulAcc = 0;
+    ulSample = 0;
+    ulRefresh = 1 << 5;
+
+    RunStart();
+
+    for(ulFrame = 0; ulFrame < ulFrames; ulFrame++)
+    {
+        //
+        // Read the feedback endpoint when it is due.
+        //
+        if((g_eDevice == DEVICE_AUDIO_ASYNC) && !(ulFrame % ulRefresh))
+        {
+            ulSize = sizeof(pucFeedback);
+            if((USBSimIn(g_sUSBSimDevice.ulAddress, ulIn, pucFeedback,
+                         &ulSize) == USBSIM_ACK) && (ulSize == 3))
+            {
+                ulFeedback = pucFeedback[0] | (pucFeedback[1] << 8) |
+                             (pucFeedback[2] << 16);
+            }
+        }
+
+        //
+        // Work out how many samples to send in this frame.
+        //
+        ulAcc += ulFeedback;
+        ulSamples = ulAcc >> 14;
+        ulAcc -= ulSamples << 14;
+        if(ulSamples > (AUDIO_SAMPLES_PER_FRAME + 1))
+        {
+            ulSamples = AUDIO_SAMPLES_PER_FRAME + 1;
+        }
+
+        for(ulIdx = 0; ulIdx < ulSamples; ulIdx++)
+        {
+            puiPacket[ulIdx] = ulSample++;
+        }
+
+        lRet = USBSimHostIsoOut(ulOut, (unsigned char *)puiPacket,
+                                ulSamples * 4);
+        if(lRet < 0)
+        {
+            fprintf(stderr, "audio: OUT failed (%ld).\n", lRet);
+            return(0);
+        }
+
+        AudioPlay();
+    }
+
+    dSeconds = (double)(clock() - g_ulStartClock) / CLOCKS_PER_SEC;
+    USBSimStatsGet(&sStats);
+
+    snprintf(pcName, sizeof(pcName), "%s, %+ld ppm",
+             (g_eDevice == DEVICE_AUDIO) ? "audio adaptive" : "audio async",
+             lPPM);
+    printf("%-26s %8lu %8lu %8lu %7lu %9.4f %7.3f\n", pcName, ulSample,
+           g_ulAudioLost, g_ulAudioStarved, sStats.ulInterrupts,
+           (double)ulFeedback / (1 << 14), dSeconds);
+
+    if(g_ulAudioErrors)
+    {
+        fprintf(stderr, "audio: %lu samples out of order.\n", g_ulAudioErrors);
+        return(0);
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Runs the audio benchmark: streams for ulBytes / 192 frames, the time that
+// many bytes take at 48 kHz, with the device's clock matching the host's,
+// running fast and running slow.  The number of samples that were sent but
+// never reached the application (lost) and of samples the application had to
+// play without data (starved) show whether the synchronization keeps the
+// two clocks together.
+//
+//*****************************************************************************
+static int
+BenchAudio(unsigned long ulBytes)
+{
+    static const long plPPM[] = { 0, 1000, -1000 };
+    unsigned long ulIdx, ulFrames;
+
+    printf("%-26s %8s %8s %8s %7s %9s %7s\n", "test", "samples", "lost",
+           "starved", "ints", "feedback", "cpu s");
+
+    ulFrames = ulBytes / (AUDIO_SAMPLES_PER_FRAME * 4);
+
+    for(ulIdx = 0; ulIdx < (sizeof(plPPM) / sizeof(plPPM[0])); ulIdx++)
+    {
+        if(!AudioRun(ulFrames, plPPM[ulIdx]))
+        {
+            return(0);
+        }
+    }
+
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Parses an endpoint given in a script as a number or as one of bulk-in,
+// bulk-out, int-in, int-out, iso-in and iso-out.
+//
+//*****************************************************************************
+static long
+ScriptEndpoint(const char *pcToken)
+{
+    static const struct
+    {
+        const char *pcName;
+        unsigned char ucType;
+        tBoolean bIn;
+    }
+    psNames[] =
+    {
+        { "bulk-in", USB_EP_ATTR_BULK, true },
+        { "bulk-out", USB_EP_ATTR_BULK, false },
+        { "int-in", USB_EP_ATTR_INT, true },
+        { "int-out", USB_EP_ATTR_INT, false },
+        { "iso-in", USB_EP_ATTR_ISOC, true },
+        { "iso-out", USB_EP_ATTR_ISOC, false }
+    };
+    unsigned long ulIdx;
+
+    if(!pcToken)
+    {
+        return(-1);
+    }
+
+    for(ulIdx = 0; ulIdx < (sizeof(psNames) / sizeof(psNames[0])); ulIdx++)
+    {
+        if(!strcmp(pcToken, psNames[ulIdx].pcName))
+        {
+            return(USBSimHostEndpointFind(psNames[ulIdx].ucType,
+                                          psNames[ulIdx].bIn));
+        }
+    }
+
+    return(strtol(pcToken, 0, 0));
+}
+
+//*****************************************************************************
+//
+// Returns the next numeric argument of a script line, or ulDefault if there
+// are no more.
+//
+//*****************************************************************************
+static unsigned long
+ScriptNumber(unsigned long ulDefault)
+{
+    char *pcToken;
+
+    pcToken = strtok(0, " \t\r\n");
+
+    return(pcToken ? strtoul(pcToken, 0, 0) : ulDefault);
+}
+
+//*****************************************************************************
+//
+// Reads the remaining numeric arguments of a script line into a buffer.
+//
+//*****************************************************************************
+static unsigned long
+ScriptBytes(unsigned char *pucData, unsigned long ulMax)
+{
+    unsigned long ulCount;
+    char *pcToken;
+
+    for(ulCount = 0;
+        (ulCount < ulMax) && ((pcToken = strtok(0, " \t\r\n")) != 0);
+        ulCount++)
+    {
+        pucData[ulCount] = strtoul(pcToken, 0, 0);
+    }
+
+    return(ulCount);
+}
+
+//*****************************************************************************
+//
+// Runs one line of a script, returning the result of the virtual host
+// function it called, negative on failure.
+//
+//*****************************************************************************
+static long
+ScriptLine(char *pcCommand)
+{
+    static unsigned char pucData[HOST_CHUNK], pucExpect[HOST_CHUNK];
+    unsigned short usValue, usIndex, usLength;
+    unsigned char ucRequestType, ucRequest;
+    unsigned long ulSize, ulExpect;
+    tUSBSimStats sStats;
+    long lEP, lRet;
+
+    if(!strcmp(pcCommand, "reset"))
+    {
+        USBSimBusReset();
+        g_sUSBSimDevice.ulAddress = 0;
+        return(0);
+    }
+
+    if(!strcmp(pcCommand, "enumerate"))
+    {
+        return(USBSimHostEnumerate(ScriptNumber(1)));
+    }
+
+    if(!strcmp(pcCommand, "frames"))
+    {
+        USBSimHostFrames(ScriptNumber(1));
+        return(0);
+    }
+
+    if(!strcmp(pcCommand, "suspend"))
+    {
+        USBSimSuspend();
+        return(0);
+    }
+
+    if(!strcmp(pcCommand, "resume"))
+    {
+        USBSimResume();
+        return(0);
+    }
+
+    //
+    // setup bmRequestType bRequest wValue wIndex wLength [data...]
+    //
+    if(!strcmp(pcCommand, "setup"))
+    {
+        ucRequestType = ScriptNumber(0);
+        ucRequest = ScriptNumber(0);
+        usValue = ScriptNumber(0);
+        usIndex = ScriptNumber(0);
+        usLength = ScriptNumber(0);
+
+        if(ucRequestType & USB_RTYPE_DIR_IN)
+        {
+            //
+            // Any bytes given are the data the device is expected to return.
+            //
+            ulExpect = ScriptBytes(pucExpect, usLength);
+            lRet = USBSimHostControl(ucRequestType, ucRequest, usValue,
+                                     usIndex, usLength, pucData);
+            if(lRet >= 0)
+            {
+                for(ulSize = 0; ulSize < (unsigned long)lRet; ulSize++)
+                {
+                    printf("%s0x%02x", ulSize ? " " : "  ", pucData[ulSize]);
+                }
+                printf("\n");
+
+                if(ulExpect && ((ulExpect != (unsigned long)lRet) ||
+                                memcmp(pucData, pucExpect, ulExpect)))
+                {
+                    return(USBSIM_ERR_PROTOCOL);
+                }
+            }
+            return(lRet);
+        }
+
+        if(ScriptBytes(pucData, usLength) != usLength)
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+        return(USBSimHostControl(ucRequestType, ucRequest, usValue, usIndex,
+                                 usLength, pucData));
+    }
+
+    //
+    // out ep count - sends count bytes of the pattern stream.
+    //
+    if(!strcmp(pcCommand, "out") || !strcmp(pcCommand, "iso-out"))
+    {
+        lEP = ScriptEndpoint(strtok(0, " \t\r\n"));
+        ulSize = ScriptNumber(0);
+        if((lEP < 0) || (ulSize > HOST_CHUNK))
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+
+        PatternFill(pucData, g_ulHostOutCount, ulSize);
+        lRet = (pcCommand[0] == 'i') ?
+               USBSimHostIsoOut(lEP, pucData, ulSize) :
+               USBSimHostOut(lEP, pucData, ulSize, false);
+        if(lRet > 0)
+        {
+            g_ulHostOutCount += lRet;
+        }
+        return(lRet);
+    }
+
+    //
+    // in ep count - reads up to count bytes of the pattern stream.
+    //
+    if(!strcmp(pcCommand, "in") || !strcmp(pcCommand, "iso-in"))
+    {
+        lEP = ScriptEndpoint(strtok(0, " \t\r\n"));
+        ulSize = ScriptNumber(0);
+        if((lEP < 0) || (ulSize > HOST_CHUNK))
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+
+        lRet = (pcCommand[0] == 'i') ?
+               USBSimHostIsoIn(lEP, pucData, ulSize) :
+               USBSimHostIn(lEP, pucData, ulSize);
+        if(lRet > 0)
+        {
+            if(PatternCheck(pucData, g_ulHostInCount, lRet))
+            {
+                return(USBSIM_ERR_PROTOCOL);
+            }
+            g_ulHostInCount += lRet;
+        }
+        return(lRet);
+    }
+
+    //
+    // outb ep byte... - sends the given bytes.
+    //
+    if(!strcmp(pcCommand, "outb"))
+    {
+        lEP = ScriptEndpoint(strtok(0, " \t\r\n"));
+        ulSize = ScriptBytes(pucData, HOST_CHUNK);
+        return((lEP < 0) ? USBSIM_ERR_PROTOCOL :
+               USBSimHostOut(lEP, pucData, ulSize, false));
+    }
+
+    //
+    // inb ep count [byte...] - reads up to count bytes, printing them and
+    // comparing them with any bytes given.
+    //
+    if(!strcmp(pcCommand, "inb"))
+    {
+        lEP = ScriptEndpoint(strtok(0, " \t\r\n"));
+        ulSize = ScriptNumber(0);
+        if((lEP < 0) || (ulSize > HOST_CHUNK))
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+
+        ulExpect = ScriptBytes(pucExpect, HOST_CHUNK);
+        lRet = USBSimHostIn(lEP, pucData, ulSize);
+        if(lRet >= 0)
+        {
+            for(ulSize = 0; ulSize < (unsigned long)lRet; ulSize++)
+            {
+                printf("%s0x%02x", ulSize ? " " : "  ", pucData[ulSize]);
+            }
+            printf("\n");
+
+            if(ulExpect && ((ulExpect != (unsigned long)lRet) ||
+                            memcmp(pucData, pucExpect, ulExpect)))
+            {
+                return(USBSIM_ERR_PROTOCOL);
+            }
+        }
+        return(lRet);
+    }
+
+    //
+    // write count [size] - has the device application send count bytes of
+    // the pattern stream in writes of size bytes.
+    //
+    if(!strcmp(pcCommand, "write"))
+    {
+        if(!g_psTxBuffer)
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+        g_ulDevTxTarget += ScriptNumber(0);
+        g_ulDevWriteSize = ScriptNumber(g_ulDevWriteSize);
+        if(!g_ulDevWriteSize || (g_ulDevWriteSize > MAX_WRITE_SIZE))
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+        DeviceIdle();
+        return(0);
+    }
+
+    //
+    // received count - checks the number of bytes the device application
+    // has received.
+    //
+    if(!strcmp(pcCommand, "received"))
+    {
+        ulExpect = ScriptNumber(0);
+        if((g_ulDevRxCount != ulExpect) || g_ulDevRxErrors)
+        {
+            printf("  device received %lu bytes, %lu bad\n", g_ulDevRxCount,
+                   g_ulDevRxErrors);
+            return(USBSIM_ERR_PROTOCOL);
+        }
+        return(0);
+    }
+
+    if(!strcmp(pcCommand, "stats"))
+    {
+        USBSimStatsGet(&sStats);
+        printf("  %lu frames, %lu interrupts, %lu setups\n", sStats.ulFrames,
+               sStats.ulInterrupts, sStats.ulSetups);
+        for(ulSize = 0; ulSize < USBSIM_NUM_EP; ulSize++)
+        {
+            if(sStats.pulInPackets[ulSize] || sStats.pulOutPackets[ulSize] ||
+               sStats.pulInNAKs[ulSize] || sStats.pulOutNAKs[ulSize] ||
+               sStats.pulStalls[ulSize])
+            {
+                printf("  ep%lu: in %lu pkts %lu bytes %lu short %lu NAKs, "
+                       "out %lu pkts %lu bytes %lu NAKs, %lu stalls\n",
+                       ulSize, sStats.pulInPackets[ulSize],
+                       sStats.pulInBytes[ulSize], sStats.pulInShort[ulSize],
+                       sStats.pulInNAKs[ulSize],
+                       sStats.pulOutPackets[ulSize],
+                       sStats.pulOutBytes[ulSize],
+                       sStats.pulOutNAKs[ulSize], sStats.pulStalls[ulSize]);
+            }
+        }
+        USBSimStatsClear();
+        return(0);
+    }
+
+    return(USBSIM_ERR_PROTOCOL);
+}
+
+//*****************************************************************************
+//
+// Runs a script.  Each line holds one command; a line starting with "stall"
+// runs the rest of the line and expects the device to stall it.  Lines
+// starting with '#' are comments.
+//
+//*****************************************************************************
+static int
+ScriptRun(const char *pcFile)
+{
+    char pcLine[1024], pcCopy[1024];
+    unsigned long ulLine;
+    tBoolean bStall;
+    char *pcToken;
+    FILE *pFile;
+    long lRet;
+
+    pFile = fopen(pcFile, "r");
+    if(!pFile)
+    {
+        fprintf(stderr, "Unable to open %s.\n", pcFile);
+        return(0);
+    }
+
+    for(ulLine = 1; fgets(pcLine, sizeof(pcLine), pFile); ulLine++)
+    {
+        strcpy(pcCopy, pcLine);
+        pcCopy[strcspn(pcCopy, "\r\n")] = 0;
+
+        pcToken = strtok(pcLine, " \t\r\n");
+        if(!pcToken || (pcToken[0] == '#'))
+        {
+            continue;
+        }
+
+        bStall = !strcmp(pcToken, "stall");
+        if(bStall)
+        {
+            pcToken = strtok(0, " \t\r\n");
+            if(!pcToken)
+            {
+                continue;
+            }
+        }
+
+        printf("%s\n", pcCopy);
+        lRet = ScriptLine(pcToken);
+
+        if(bStall ? (lRet != USBSIM_ERR_STALL) : (lRet < 0))
+        {
+            fprintf(stderr, "%s:%lu: failed (%ld).\n", pcFile, ulLine, lRet);
+            fclose(pFile);
+            return(0);
+        }
+    }
+
+    fclose(pFile);
+    return(1);
+}
+
+//*****************************************************************************
+//
+// Shows the command line usage.
+//
+//*****************************************************************************
+static void
+Usage(const char *pcProgram)
+{
+    printf("Usage: %s [-d audio|audio-async|bulk|cdc|msc|msc-cache] "
+           "[-n bytes] [-s script]\n", pcProgram);
+    printf("\n");
+    printf("Runs a USB device class on a simulated USB controller and moves\n");
+    printf("data to and from it with a virtual host, reporting the simulated\n");
+    printf("time in frames (ms), throughput, interrupts, packets and NAKs.\n");
+    printf("\n");
+    printf("  -d   The device class to run (default bulk).\n");
+    printf("  -n   The number of bytes moved by each test (default 262144,\n");
+    printf("       or 30 seconds of audio for the audio devices).\n");
+    printf("  -s   Run a script instead of the benchmarks.\n");
+}
+
+//*****************************************************************************
+//
+// The main entry point.
+//
+//*****************************************************************************
+int
+main(int argc, char *argv[])
+{
+    unsigned long ulBytes, ulIdx;
+    const char *pcScript;
+    int iOpt, iOK;
+
+    ulBytes = 0;
+    pcScript = 0;
+
+    while((iOpt = getopt(argc, argv, "d:n:s:h")) != -1)
+    {
+        switch(iOpt)
+        {
+            case 'd':
+            {
+                if(!strcmp(optarg, "audio"))
+                {
+                    g_eDevice = DEVICE_AUDIO;
+                }
+                else if(!strcmp(optarg, "audio-async"))
+                {
+                    g_eDevice = DEVICE_AUDIO_ASYNC;
+                }
+                else if(!strcmp(optarg, "bulk"))
+                {
+                    g_eDevice = DEVICE_BULK;
+                }
+                else if(!strcmp(optarg, "cdc"))
+                {
+                    g_eDevice = DEVICE_CDC;
+                }
+                else if(!strcmp(optarg, "msc"))
+                {
+                    g_eDevice = DEVICE_MSC;
+                }
+                else if(!strcmp(optarg, "msc-cache"))
+                {
+                    g_eDevice = DEVICE_MSC_CACHE;
+                }
+                else
+                {
+                    Usage(argv[0]);
+                    return(1);
+                }
+                break;
+            }
+
+            case 'n':
+            {
+                ulBytes = strtoul(optarg, 0, 0);
+                break;
+            }
+
+            case 's':
+            {
+                pcScript = optarg;
+                break;
+            }
+
+            default:
+            {
+                Usage(argv[0]);
+                return(1);
+            }
+        }
+    }
+
+    if(!ulBytes)
+    {
+        ulBytes = ((g_eDevice == DEVICE_AUDIO) ||
+                   (g_eDevice == DEVICE_AUDIO_ASYNC)) ?
+                  (30000 * AUDIO_SAMPLES_PER_FRAME * 4) : 262144;
+    }
+
+    for(ulIdx = 0; ulIdx < sizeof(g_pucPattern); ulIdx++)
+    {
+        g_pucPattern[ulIdx] = (unsigned char)((ulIdx & 0xff) * 37 + 11);
+    }
+
+    IntMasterEnable();
+
+    if(!DeviceStart())
+    {
+        return(1);
+    }
+
+    if(pcScript)
+    {
+        return(ScriptRun(pcScript) ? 0 : 1);
+    }
+
+    if((g_eDevice == DEVICE_AUDIO) || (g_eDevice == DEVICE_AUDIO_ASYNC))
+    {
+        return(BenchAudio(ulBytes) ? 0 : 1);
+    }
+
+    ReportHeader();
+
+    iOK = BenchEnumerate();
+
+    if(iOK && (g_eDevice == DEVICE_MSC))
+    {
+        iOK = BenchMSC(ulBytes);
+    }
+    else if(iOK && (g_eDevice == DEVICE_MSC_CACHE))
+    {
+        iOK = BenchMSCCache();
+    }
+    else if(iOK)
+    {
+        iOK = BenchSerial(ulBytes);
+    }
+
+    if(iOK && (g_eDevice == DEVICE_BULK))
+    {
+        iOK = BenchBulkTransfer(ulBytes);
+    }
+
+    return(iOK ? 0 : 1);
+}
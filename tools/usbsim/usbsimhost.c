@@ -0,0 +1,662 @@
+//*****************************************************************************
+//
+// usbsimhost.c - A scriptable virtual host for the simulated USB controller.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+//
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+//
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+//
+// This is part of revision 9453 of the Stellaris Firmware Development Package.
+//
+//*****************************************************************************
+
+#include <string.h>
+#include "inc/hw_types.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usbsim.h"
+
+//*****************************************************************************
+//
+// The device as seen by the virtual host.
+//
+//*****************************************************************************
+tUSBSimDevice g_sUSBSimDevice;
+
+//*****************************************************************************
+//
+// The function called between transactions, standing in for the
+// application's main loop.
+//
+//*****************************************************************************
+static void (*g_pfnIdle)(void);
+
+//*****************************************************************************
+//
+// The number of transactions issued in the current frame.
+//
+//*****************************************************************************
+static unsigned long g_ulFrameTransactions;
+
+//*****************************************************************************
+//
+// Counts one transaction, starting a new frame when the current one is full.
+//
+//*****************************************************************************
+static void
+Transaction(void)
+{
+    if(++g_ulFrameTransactions >= USBSIM_PACKETS_PER_FRAME)
+    {
+        g_ulFrameTransactions = 0;
+        USBSimFrame();
+    }
+}
+
+//*****************************************************************************
+//
+// Called after each transaction to let the application run.
+//
+//*****************************************************************************
+static void
+Idle(void)
+{
+    if(g_pfnIdle)
+    {
+        g_pfnIdle();
+    }
+    USBSimPoll();
+}
+
+//*****************************************************************************
+//
+// Maps a transaction result to a virtual host error.
+//
+//*****************************************************************************
+static long
+ResultToError(unsigned long ulResult)
+{
+    switch(ulResult)
+    {
+        case USBSIM_STALL:
+        {
+            return(USBSIM_ERR_STALL);
+        }
+        case USBSIM_NO_RESPONSE:
+        {
+            return(USBSIM_ERR_NO_RESPONSE);
+        }
+        case USBSIM_NAK:
+        {
+            return(USBSIM_ERR_TIMEOUT);
+        }
+        default:
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Issues an OUT transaction, retrying while the device NAKs.
+//
+//*****************************************************************************
+static unsigned long
+OutRetry(unsigned long ulEP, const unsigned char *pucData,
+         unsigned long ulSize)
+{
+    unsigned long ulResult, ulNAKs;
+
+    for(ulNAKs = 0; ; ulNAKs++)
+    {
+        ulResult = USBSimOut(g_sUSBSimDevice.ulAddress, ulEP, pucData,
+                             ulSize);
+        Transaction();
+        Idle();
+
+        if((ulResult != USBSIM_NAK) || (ulNAKs == USBSIM_NAK_LIMIT))
+        {
+            return(ulResult);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Issues an IN transaction, retrying while the device NAKs.
+//
+//*****************************************************************************
+static unsigned long
+InRetry(unsigned long ulEP, unsigned char *pucData, unsigned long *pulSize)
+{
+    unsigned long ulResult, ulNAKs, ulSize;
+
+    for(ulNAKs = 0; ; ulNAKs++)
+    {
+        ulSize = *pulSize;
+        ulResult = USBSimIn(g_sUSBSimDevice.ulAddress, ulEP, pucData, &ulSize);
+        Transaction();
+        Idle();
+
+        if((ulResult != USBSIM_NAK) || (ulNAKs == USBSIM_NAK_LIMIT))
+        {
+            *pulSize = ulSize;
+            return(ulResult);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Sets the function called between transactions.
+//!
+//! \param pfnIdle is the function, or 0 for none.
+//!
+//! The function stands in for the device application's main loop.  It is
+//! called after every transaction issued by the virtual host, including
+//! NAKed ones, and may write or read data through the class API.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBSimHostIdleSet(void (*pfnIdle)(void))
+{
+    g_pfnIdle = pfnIdle;
+}
+
+//*****************************************************************************
+//
+//! Performs a control transfer on endpoint 0.
+//!
+//! \param ucRequestType is the bmRequestType field; bit 7 selects a control
+//! read.
+//! \param ucRequest is the bRequest field.
+//! \param usValue is the wValue field.
+//! \param usIndex is the wIndex field.
+//! \param usLength is the wLength field, the size of the data stage.
+//! \param pucData holds the data stage for a control write or receives it
+//! for a control read.
+//!
+//! \return Returns the number of data stage bytes transferred, or a negative
+//! \b USBSIM_ERR_ value.
+//
+//*****************************************************************************
+long
+USBSimHostControl(unsigned char ucRequestType, unsigned char ucRequest,
+                  unsigned short usValue, unsigned short usIndex,
+                  unsigned short usLength, unsigned char *pucData)
+{
+    unsigned char pucSetup[8];
+    unsigned long ulResult, ulCount, ulSize;
+
+    pucSetup[0] = ucRequestType;
+    pucSetup[1] = ucRequest;
+    pucSetup[2] = usValue & 0xff;
+    pucSetup[3] = usValue >> 8;
+    pucSetup[4] = usIndex & 0xff;
+    pucSetup[5] = usIndex >> 8;
+    pucSetup[6] = usLength & 0xff;
+    pucSetup[7] = usLength >> 8;
+
+    ulResult = USBSimSetup(g_sUSBSimDevice.ulAddress, pucSetup);
+    Transaction();
+    if(ulResult != USBSIM_ACK)
+    {
+        return(ResultToError(ulResult));
+    }
+
+    ulCount = 0;
+
+    if(ucRequestType & USB_RTYPE_DIR_IN)
+    {
+        //
+        // Read until wLength bytes or a short packet arrive.
+        //
+        while(ulCount < usLength)
+        {
+            ulSize = usLength - ulCount;
+            ulResult = InRetry(0, pucData + ulCount, &ulSize);
+            if(ulResult != USBSIM_ACK)
+            {
+                return(ResultToError(ulResult));
+            }
+            if(ulSize > usLength - ulCount)
+            {
+                return(USBSIM_ERR_PROTOCOL);
+            }
+            ulCount += ulSize;
+            if(ulSize < MAX_PACKET_SIZE_EP0)
+            {
+                break;
+            }
+        }
+
+        //
+        // The status stage is a zero length OUT packet.
+        //
+        ulResult = OutRetry(0, 0, 0);
+    }
+    else
+    {
+        //
+        // Send the data stage, if any.
+        //
+        while(ulCount < usLength)
+        {
+            ulSize = usLength - ulCount;
+            ulSize = (ulSize < MAX_PACKET_SIZE_EP0) ? ulSize :
+                     MAX_PACKET_SIZE_EP0;
+            ulResult = OutRetry(0, pucData + ulCount, ulSize);
+            if(ulResult != USBSIM_ACK)
+            {
+                return(ResultToError(ulResult));
+            }
+            ulCount += ulSize;
+        }
+
+        //
+        // The status stage is a zero length IN packet.
+        //
+        ulSize = 0;
+        ulResult = InRetry(0, 0, &ulSize);
+        if((ulResult == USBSIM_ACK) && ulSize)
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+    }
+
+    if(ulResult != USBSIM_ACK)
+    {
+        return(ResultToError(ulResult));
+    }
+
+    return((long)ulCount);
+}
+
+//*****************************************************************************
+//
+//! Resets and enumerates the device.
+//!
+//! \param ulAddress is the address to assign, from 1 to 127.
+//!
+//! This function resets the bus, reads the device and configuration
+//! descriptors, assigns the address and selects the first configuration.
+//! The descriptors and the endpoints found are kept in \b g_sUSBSimDevice.
+//!
+//! \return Returns 0 on success or a negative \b USBSIM_ERR_ value.
+//
+//*****************************************************************************
+long
+USBSimHostEnumerate(unsigned long ulAddress)
+{
+    long lRet;
+    unsigned long ulIdx, ulSize;
+    unsigned char *pucDesc, pucPacket[MAX_PACKET_SIZE_EP0];
+
+    memset(&g_sUSBSimDevice, 0, sizeof(g_sUSBSimDevice));
+
+    if(!USBSimConnected())
+    {
+        return(USBSIM_ERR_NO_RESPONSE);
+    }
+
+    USBSimBusReset();
+    USBSimHostFrames(1);
+
+    //
+    // Read the start of the device descriptor at the default address, as a
+    // PC host does, then assign the address.
+    //
+    lRet = USBSimHostControl(USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                             USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                             USB_DTYPE_DEVICE << 8, 0, MAX_PACKET_SIZE_EP0,
+                             pucPacket);
+    if(lRet < 0)
+    {
+        return(lRet);
+    }
+
+    lRet = USBSimHostControl(USB_RTYPE_DIR_OUT | USB_RTYPE_STANDARD |
+                             USB_RTYPE_DEVICE, USBREQ_SET_ADDRESS,
+                             ulAddress, 0, 0, 0);
+    if(lRet < 0)
+    {
+        return(lRet);
+    }
+    g_sUSBSimDevice.ulAddress = ulAddress;
+
+    lRet = USBSimHostControl(USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                             USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                             USB_DTYPE_DEVICE << 8, 0, 18,
+                             g_sUSBSimDevice.pucDeviceDesc);
+    if(lRet < 0)
+    {
+        return(lRet);
+    }
+    if(lRet != 18)
+    {
+        return(USBSIM_ERR_PROTOCOL);
+    }
+
+    //
+    // Read the configuration descriptor header to learn the total size, then
+    // the whole configuration.
+    //
+    pucDesc = g_sUSBSimDevice.pucConfigDesc;
+    lRet = USBSimHostControl(USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                             USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                             USB_DTYPE_CONFIGURATION << 8, 0, 9, pucDesc);
+    if(lRet < 0)
+    {
+        return(lRet);
+    }
+    if(lRet != 9)
+    {
+        return(USBSIM_ERR_PROTOCOL);
+    }
+
+    ulSize = pucDesc[2] | (pucDesc[3] << 8);
+    if(ulSize > USBSIM_MAX_CONFIG_SIZE)
+    {
+        return(USBSIM_ERR_PROTOCOL);
+    }
+
+    lRet = USBSimHostControl(USB_RTYPE_DIR_IN | USB_RTYPE_STANDARD |
+                             USB_RTYPE_DEVICE, USBREQ_GET_DESCRIPTOR,
+                             USB_DTYPE_CONFIGURATION << 8, 0, ulSize,
+                             pucDesc);
+    if(lRet < 0)
+    {
+        return(lRet);
+    }
+    if((unsigned long)lRet != ulSize)
+    {
+        return(USBSIM_ERR_PROTOCOL);
+    }
+    g_sUSBSimDevice.ulConfigSize = ulSize;
+
+    //
+    // Record every endpoint in the configuration.
+    //
+    for(ulIdx = 0; (ulIdx + 1) < ulSize; ulIdx += pucDesc[ulIdx])
+    {
+        if(pucDesc[ulIdx] == 0)
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+
+        if((pucDesc[ulIdx + 1] == USB_DTYPE_ENDPOINT) &&
+           (g_sUSBSimDevice.ulNumEndpoints < USBSIM_MAX_ENDPOINTS))
+        {
+            tUSBSimEndpoint *psEP;
+
+            psEP = &g_sUSBSimDevice.psEndpoints[
+                                            g_sUSBSimDevice.ulNumEndpoints++];
+            psEP->ucAddress = pucDesc[ulIdx + 2];
+            psEP->ucAttributes = pucDesc[ulIdx + 3];
+            psEP->usMaxPacket = pucDesc[ulIdx + 4] |
+                                (pucDesc[ulIdx + 5] << 8);
+            psEP->ucInterval = pucDesc[ulIdx + 6];
+        }
+    }
+
+    lRet = USBSimHostControl(USB_RTYPE_DIR_OUT | USB_RTYPE_STANDARD |
+                             USB_RTYPE_DEVICE, USBREQ_SET_CONFIG,
+                             pucDesc[5], 0, 0, 0);
+
+    return((lRet < 0) ? lRet : 0);
+}
+
+//*****************************************************************************
+//
+//! Finds an endpoint of the enumerated device.
+//!
+//! \param ucAttributes is the transfer type, \b USB_EP_ATTR_BULK,
+//! \b USB_EP_ATTR_INT or \b USB_EP_ATTR_ISOC.
+//! \param bIn is \b true to find an IN endpoint.
+//!
+//! \return Returns the number of the first matching endpoint or -1 if there
+//! is none.
+//
+//*****************************************************************************
+long
+USBSimHostEndpointFind(unsigned char ucAttributes, tBoolean bIn)
+{
+    unsigned long ulIdx;
+    tUSBSimEndpoint *psEP;
+
+    for(ulIdx = 0; ulIdx < g_sUSBSimDevice.ulNumEndpoints; ulIdx++)
+    {
+        psEP = &g_sUSBSimDevice.psEndpoints[ulIdx];
+
+        if(((psEP->ucAttributes & USB_EP_ATTR_TYPE_M) ==
+            (ucAttributes & USB_EP_ATTR_TYPE_M)) &&
+           (((psEP->ucAddress & USB_EP_DESC_IN) ? true : false) == bIn))
+        {
+            return(psEP->ucAddress & USB_EP_DESC_NUM_M);
+        }
+    }
+
+    return(-1);
+}
+
+//*****************************************************************************
+//
+// Returns the maximum packet size of an enumerated endpoint, or of the
+// model's endpoint if the host did not find it in the configuration.
+//
+//*****************************************************************************
+static unsigned long
+MaxPacketGet(unsigned long ulEP, tBoolean bIn)
+{
+    unsigned long ulIdx;
+    tUSBSimEndpoint *psEP;
+
+    for(ulIdx = 0; ulIdx < g_sUSBSimDevice.ulNumEndpoints; ulIdx++)
+    {
+        psEP = &g_sUSBSimDevice.psEndpoints[ulIdx];
+
+        if(((psEP->ucAddress & USB_EP_DESC_NUM_M) == ulEP) &&
+           (((psEP->ucAddress & USB_EP_DESC_IN) ? true : false) == bIn))
+        {
+            return(psEP->usMaxPacket);
+        }
+    }
+
+    return(USBSimMaxPacketGet(ulEP, bIn));
+}
+
+//*****************************************************************************
+//
+//! Sends data to a bulk or interrupt OUT endpoint.
+//!
+//! \param ulEP is the endpoint number.
+//! \param pucData points to the data.
+//! \param ulSize is the number of bytes to send.
+//! \param bZLP is \b true to end a transfer that fills its last packet with
+//! a zero length packet.
+//!
+//! \return Returns the number of bytes sent or a negative \b USBSIM_ERR_
+//! value.
+//
+//*****************************************************************************
+long
+USBSimHostOut(unsigned long ulEP, const unsigned char *pucData,
+              unsigned long ulSize, tBoolean bZLP)
+{
+    unsigned long ulMaxPacket, ulCount, ulPacket, ulResult;
+
+    ulMaxPacket = MaxPacketGet(ulEP, false);
+    if(!ulMaxPacket)
+    {
+        return(USBSIM_ERR_NO_RESPONSE);
+    }
+
+    for(ulCount = 0; ulCount < ulSize; ulCount += ulPacket)
+    {
+        ulPacket = ulSize - ulCount;
+        ulPacket = (ulPacket < ulMaxPacket) ? ulPacket : ulMaxPacket;
+
+        ulResult = OutRetry(ulEP, pucData + ulCount, ulPacket);
+        if(ulResult != USBSIM_ACK)
+        {
+            return(ulCount ? (long)ulCount : ResultToError(ulResult));
+        }
+    }
+
+    if(bZLP && ((ulSize % ulMaxPacket) == 0))
+    {
+        ulResult = OutRetry(ulEP, 0, 0);
+        if(ulResult != USBSIM_ACK)
+        {
+            return(ResultToError(ulResult));
+        }
+    }
+
+    return((long)ulCount);
+}
+
+//*****************************************************************************
+//
+//! Reads data from a bulk or interrupt IN endpoint.
+//!
+//! \param ulEP is the endpoint number.
+//! \param pucData points to storage for the data.
+//! \param ulSize is the number of bytes wanted.
+//!
+//! Packets are read until \e ulSize bytes or a short packet have arrived or
+//! the device has NAKed \b USBSIM_NAK_LIMIT times in a row.
+//!
+//! \return Returns the number of bytes read or a negative \b USBSIM_ERR_
+//! value.
+//
+//*****************************************************************************
+long
+USBSimHostIn(unsigned long ulEP, unsigned char *pucData, unsigned long ulSize)
+{
+    unsigned long ulMaxPacket, ulCount, ulPacket, ulResult;
+
+    ulMaxPacket = MaxPacketGet(ulEP, true);
+    if(!ulMaxPacket)
+    {
+        return(USBSIM_ERR_NO_RESPONSE);
+    }
+
+    for(ulCount = 0; ulCount < ulSize; ulCount += ulPacket)
+    {
+        ulPacket = ulSize - ulCount;
+        ulResult = InRetry(ulEP, pucData + ulCount, &ulPacket);
+        if(ulResult != USBSIM_ACK)
+        {
+            return(ulCount ? (long)ulCount : ResultToError(ulResult));
+        }
+
+        if(ulPacket > (ulSize - ulCount))
+        {
+            return(USBSIM_ERR_PROTOCOL);
+        }
+
+        if(ulPacket < ulMaxPacket)
+        {
+            ulCount += ulPacket;
+            break;
+        }
+    }
+
+    return((long)ulCount);
+}
+
+//*****************************************************************************
+//
+//! Sends one packet to an isochronous OUT endpoint and ends the frame.
+//!
+//! \param ulEP is the endpoint number.
+//! \param pucData points to the packet.
+//! \param ulSize is the packet size.
+//!
+//! \return Returns the number of bytes the device accepted, 0 if the device
+//! FIFO overran, or a negative \b USBSIM_ERR_ value.
+//
+//*****************************************************************************
+long
+USBSimHostIsoOut(unsigned long ulEP, const unsigned char *pucData,
+                 unsigned long ulSize)
+{
+    unsigned long ulResult;
+
+    ulResult = USBSimOut(g_sUSBSimDevice.ulAddress, ulEP, pucData, ulSize);
+    Idle();
+    USBSimHostFrames(1);
+
+    if(ulResult == USBSIM_OVERRUN)
+    {
+        return(0);
+    }
+
+    return((ulResult == USBSIM_ACK) ? (long)ulSize : ResultToError(ulResult));
+}
+
+//*****************************************************************************
+//
+//! Reads one packet from an isochronous IN endpoint and ends the frame.
+//!
+//! \param ulEP is the endpoint number.
+//! \param pucData points to storage for the packet.
+//! \param ulSize is the size of the storage.
+//!
+//! \return Returns the packet size, 0 if the device had no data ready, or a
+//! negative \b USBSIM_ERR_ value.
+//
+//*****************************************************************************
+long
+USBSimHostIsoIn(unsigned long ulEP, unsigned char *pucData,
+                unsigned long ulSize)
+{
+    unsigned long ulResult;
+
+    ulResult = USBSimIn(g_sUSBSimDevice.ulAddress, ulEP, pucData, &ulSize);
+    Idle();
+    USBSimHostFrames(1);
+
+    if(ulResult == USBSIM_UNDERRUN)
+    {
+        return(0);
+    }
+
+    return((ulResult == USBSIM_ACK) ? (long)ulSize : ResultToError(ulResult));
+}
+
+//*****************************************************************************
+//
+//! Lets a number of frames pass with no transfers, calling the idle function
+//! once per frame.
+//!
+//! \param ulFrames is the number of frames.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBSimHostFrames(unsigned long ulFrames)
+{
+    while(ulFrames--)
+    {
+        g_ulFrameTransactions = 0;
+        USBSimFrame();
+        Idle();
+    }
+}
@@ -0,0 +1,70 @@
+//*****************************************************************************
+//
+// usbsimsys.c - System control stand-ins for host builds of the USB library.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+//
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+//
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+//
+// This is part of revision 9453 of the Stellaris Firmware Development Package.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "driverlib/sysctl.h"
+
+//*****************************************************************************
+//
+// The USB library reads the system clock only to size delays, and delays
+// take no time in the model.
+//
+//*****************************************************************************
+#define SIM_SYSTEM_CLOCK        80000000
+
+unsigned long
+SysCtlClockGet(void)
+{
+    return(SIM_SYSTEM_CLOCK);
+}
+
+void
+SysCtlDelay(unsigned long ulCount)
+{
+}
+
+void
+SysCtlPeripheralEnable(unsigned long ulPeripheral)
+{
+}
+
+void
+SysCtlPeripheralDisable(unsigned long ulPeripheral)
+{
+}
+
+void
+SysCtlPeripheralReset(unsigned long ulPeripheral)
+{
+}
+
+void
+SysCtlUSBPLLEnable(void)
+{
+}
+
+void
+SysCtlUSBPLLDisable(void)
+{
+}
@@ -25,6 +25,7 @@
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "driverlib/debug.h"
+#include "driverlib/interrupt.h"
 #include "driverlib/rom.h"
 #include "driverlib/rom_map.h"
 #include "driverlib/usb.h"
@@ -65,6 +66,7 @@
 //*****************************************************************************
 #define ISOC_OUT_ENDPOINT       USB_EP_1
 #define ISOC_OUT_DMA_CHANNEL    UDMA_CHANNEL_USBEP1RX
+#define ISOC_FEEDBACK_ENDPOINT  USB_EP_1
 
 //*****************************************************************************
 //
@@ -73,6 +75,46 @@
 //*****************************************************************************
 #define ISOC_OUT_EP_MAX_SIZE    ((48000*4)/1000)
 
+//*****************************************************************************
+//
+// In asynchronous mode the host may send one sample more than the nominal
+// number in a frame.
+//
+//*****************************************************************************
+#define ISOC_OUT_EP_MAX_SIZE_ASYNC                                            \
+                                (((48000/1000) + 1) * 4)
+
+//*****************************************************************************
+//
+// The feedback value is the number of samples per frame in 10.14 fixed
+// point, sent in 3 bytes.  The host reads it every 2^AUDIO_FEEDBACK_REFRESH
+// frames.  Values derived from the buffer level are kept within one sample
+// per frame of the nominal rate.
+//
+//*****************************************************************************
+#define ISOC_FEEDBACK_EP_SIZE   3
+#define AUDIO_FEEDBACK_REFRESH  5
+#define AUDIO_FEEDBACK_NOMINAL  ((48000 << 14) / 1000)
+#define AUDIO_FEEDBACK_MAX_ADJ  (1 << 14)
+
+//*****************************************************************************
+//
+// The states of the buffer level measurement used for the feedback value.
+// The level is taken each time the application returns a buffer, so the
+// setpoint is only taken once a buffer has been filled and returned.
+//
+//*****************************************************************************
+#define AUDIO_LEVEL_IDLE        0
+#define AUDIO_LEVEL_FILLED      1
+#define AUDIO_LEVEL_VALID       2
+
+//*****************************************************************************
+//
+// The largest buffer that a single uDMA transfer can fill.
+//
+//*****************************************************************************
+#define AUDIO_DMA_MAX_SIZE      (1024 * 4)
+
 //*****************************************************************************
 //
 // Device Descriptor.  This is stored in RAM to allow several fields to be
@@ -335,6 +377,113 @@ const unsigned char g_pAudioStreamInterface[] =
     USBShort(0),                    // No lock delay.
 };
 
+//*****************************************************************************
+//
+// The audio streaming interface descriptor used in asynchronous mode.  This
+// is the same as g_pAudioStreamInterface except that the data endpoint is
+// asynchronous and the active alternate setting has an isochronous feedback
+// endpoint that tells the host the sample rate to use.
+//
+//*****************************************************************************
+const unsigned char g_pAudioStreamInterfaceAsync[] =
+{
+    //
+    // Vendor-specific Interface Descriptor.
+    //
+    9,                          // Size of the interface descriptor.
+    USB_DTYPE_INTERFACE,        // Type of this descriptor.
+    AUDIO_INTERFACE_OUTPUT,     // The index for this interface.
+    0,                          // The alternate setting for this interface.
+    0,                          // The number of endpoints used by this
+                                // interface.
+    USB_CLASS_AUDIO,            // The interface class
+    USB_ASC_AUDIO_STREAMING,    // The interface sub-class.
+    0,                          // Unused must be 0.
+    0,                          // The string index for this interface.
+
+    //
+    // Vendor-specific Interface Descriptor.
+    //
+    9,                          // Size of the interface descriptor.
+    USB_DTYPE_INTERFACE,        // Type of this descriptor.
+    1,                          // The index for this interface.
+    1,                          // The alternate setting for this interface.
+    2,                          // The number of endpoints used by this
+                                // interface.
+    USB_CLASS_AUDIO,            // The interface class
+    USB_ASC_AUDIO_STREAMING,    // The interface sub-class.
+    0,                          // Unused must be 0.
+    0,                          // The string index for this interface.
+
+    //
+    // Class specific Audio Streaming Interface descriptor.
+    //
+    7,                          // Size of the interface descriptor.
+    USB_DTYPE_CS_INTERFACE,     // Interface descriptor is class specific.
+    USB_ASDSTYPE_GENERAL,       // General information.
+    AUDIO_IN_TERMINAL_ID,       // ID of the terminal to which this streaming
+                                // interface is connected.
+    1,                          // One frame delay.
+    USBShort(USB_ADF_PCM),      //
+
+    //
+    // Format type Audio Streaming descriptor.
+    //
+    11,                         // Size of the interface descriptor.
+    USB_DTYPE_CS_INTERFACE,     // Interface descriptor is class specific.
+    USB_ASDSTYPE_FORMAT_TYPE,   // Audio Streaming format type.
+    USB_AF_TYPE_TYPE_I,         // Type I audio format type.
+    2,                          // Two audio channels.
+    2,                          // Two bytes per audio sub-frame.
+    16,                         // 16 bits per sample.
+    1,                          // One sample rate provided.
+    USB3Byte(48000),            // Only 48000 sample rate supported.
+
+    //
+    // Endpoint Descriptor
+    //
+    9,                              // The size of the endpoint descriptor.
+    USB_DTYPE_ENDPOINT,             // Descriptor type is an endpoint.
+                                    // OUT endpoint with address
+                                    // ISOC_OUT_ENDPOINT.
+    USB_EP_DESC_OUT | USB_EP_TO_INDEX(ISOC_OUT_ENDPOINT),
+    USB_EP_ATTR_ISOC |              // Endpoint is an asynchronous isochronous
+    USB_EP_ATTR_ISOC_ASYNC |        //  data endpoint.
+    USB_EP_ATTR_USAGE_DATA,
+                                    // The maximum packet size.
+    USBShort(ISOC_OUT_EP_MAX_SIZE_ASYNC),
+    1,                              // The polling interval for this endpoint.
+    0,                              // Refresh is unused.
+                                    // Synch endpoint address.
+    USB_EP_DESC_IN | USB_EP_TO_INDEX(ISOC_FEEDBACK_ENDPOINT),
+
+    //
+    // Audio Streaming Isochronous Audio Data Endpoint Descriptor
+    //
+    7,                              // The size of the descriptor.
+    USB_ACSDT_ENDPOINT,             // Audio Class Specific Endpoint Descriptor.
+    USB_ASDSTYPE_GENERAL,           // This is a general descriptor.
+    USB_EP_ATTR_ACG_SAMPLING,       // Sampling frequency is supported.
+    USB_EP_LOCKDELAY_UNDEF,         // Undefined lock delay units.
+    USBShort(0),                    // No lock delay.
+
+    //
+    // Feedback Endpoint Descriptor
+    //
+    9,                              // The size of the endpoint descriptor.
+    USB_DTYPE_ENDPOINT,             // Descriptor type is an endpoint.
+                                    // IN endpoint with address
+                                    // ISOC_FEEDBACK_ENDPOINT.
+    USB_EP_DESC_IN | USB_EP_TO_INDEX(ISOC_FEEDBACK_ENDPOINT),
+    USB_EP_ATTR_ISOC |              // Endpoint is an isochronous feedback
+    USB_EP_ATTR_USAGE_FEEDBACK,     //  endpoint.
+    USBShort(ISOC_FEEDBACK_EP_SIZE),// The maximum packet size.
+    1,                              // The polling interval for this endpoint.
+    AUDIO_FEEDBACK_REFRESH,         // The feedback refresh rate as a power
+                                    // of 2 frames.
+    0,                              // Synch endpoint address.
+};
+
 //*****************************************************************************
 //
 // The audio device configuration descriptor is defined as three sections,
@@ -361,6 +510,12 @@ const tConfigSection g_sAudioControlInterfaceSection =
     g_pAudioControlInterface
 };
 
+const tConfigSection g_sAudioStreamInterfaceAsyncSection =
+{
+    sizeof(g_pAudioStreamInterfaceAsync),
+    g_pAudioStreamInterfaceAsync
+};
+
 //*****************************************************************************
 //
 // This array lists all the sections that must be concatenated to make a
@@ -378,6 +533,23 @@ const tConfigSection *g_psAudioSections[] =
 #define NUM_AUDIO_SECTIONS      (sizeof(g_psAudioSections) /                  \
                                  sizeof(tConfigSection *))
 
+//*****************************************************************************
+//
+// The sections of the configuration descriptor used in asynchronous mode.
+//
+//*****************************************************************************
+const tConfigSection *g_psAudioAsyncSections[] =
+{
+    &g_sAudioConfigSection,
+    &g_sIADAudioConfigSection,
+    &g_sAudioControlInterfaceSection,
+    &g_sAudioStreamInterfaceAsyncSection
+};
+
+#define NUM_AUDIO_ASYNC_SECTIONS                                              \
+                                (sizeof(g_psAudioAsyncSections) /             \
+                                 sizeof(tConfigSection *))
+
 //*****************************************************************************
 //
 // The header for the single configuration we support.  This is the root of
@@ -401,6 +573,22 @@ const tConfigHeader * const g_pAudioConfigDescriptors[] =
     &g_sAudioConfigHeader
 };
 
+//*****************************************************************************
+//
+// The configuration descriptor used in asynchronous mode.
+//
+//*****************************************************************************
+const tConfigHeader g_sAudioAsyncConfigHeader =
+{
+    NUM_AUDIO_ASYNC_SECTIONS,
+    g_psAudioAsyncSections
+};
+
+const tConfigHeader * const g_pAudioAsyncConfigDescriptors[] =
+{
+    &g_sAudioAsyncConfigHeader
+};
+
 //*****************************************************************************
 //
 // Various internal handlers needed by this class.
@@ -466,6 +654,57 @@ const tFIFOConfig g_sUSBAudioFIFOConfig =
     },
 };
 
+//*****************************************************************************
+//
+// The FIFO configuration used in asynchronous mode, in which the OUT endpoint
+// is read by software.
+//
+//*****************************************************************************
+const tFIFOConfig g_sUSBAudioAsyncFIFOConfig =
+{
+    //
+    // IN endpoints.
+    //
+    {
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN },
+        { false, USB_EP_DEV_IN }
+    },
+
+    //
+    // OUT endpoints.
+    //
+    {
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT },
+        { false, USB_EP_DEV_OUT }
+    },
+};
+
 //*****************************************************************************
 //
 // The device information structure for the USB Audio device.
@@ -601,6 +840,332 @@ DataReceived(void *pvInstance, unsigned long ulInfo)
     }
 }
 
+//*****************************************************************************
+//
+// Loads queued buffers into the free uDMA control structures of the OUT
+// endpoint channel.  The channel runs in ping-pong mode so that, once the
+// oldest buffer is full, it moves straight on to the next one without waiting
+// for the interrupt.  This must be called with interrupts disabled or from
+// the USB interrupt.
+//
+//*****************************************************************************
+static void
+DMAArm(tAudioInstance *psInst)
+{
+    tAudioBuffer *psBuffer;
+    unsigned long ulStruct;
+
+    while((psInst->ucDMAArmed < 2) &&
+          (psInst->ucDMAArmed < psInst->ucBufferCount))
+    {
+        psBuffer = &psInst->psBuffers[(psInst->ucBufferHead +
+                                       psInst->ucDMAArmed) &
+                                      (USBD_AUDIO_NUM_BUFFERS - 1)];
+
+        //
+        // The two control structures are used alternately starting with
+        // the one holding the oldest buffer.
+        //
+        ulStruct = ((psInst->ucDMAHeadAlt ^ psInst->ucDMAArmed) & 1) ?
+                   UDMA_ALT_SELECT : UDMA_PRI_SELECT;
+
+        MAP_uDMAChannelTransferSet(psInst->ucOUTDMA | ulStruct,
+                                   UDMA_MODE_PINGPONG,
+                                   (void *)USBFIFOAddrGet(USB0_BASE,
+                                                      psInst->ucOUTEndpoint),
+                                   psBuffer->pvData, psBuffer->ulSize >> 2);
+
+        psInst->ucDMAArmed++;
+    }
+
+    //
+    // Start the channel if it had run out of buffers.
+    //
+    if(psInst->ucDMAArmed && !MAP_uDMAChannelIsEnabled(psInst->ucOUTDMA))
+    {
+        MAP_uDMAChannelEnable(psInst->ucOUTDMA);
+    }
+}
+
+//*****************************************************************************
+//
+// Returns the oldest queued buffer to the application.
+//
+//*****************************************************************************
+static void
+BufferDone(tAudioInstance *psInst)
+{
+    tAudioBuffer sBuffer;
+
+    //
+    // Take the buffer off the queue.
+    //
+    sBuffer = psInst->psBuffers[psInst->ucBufferHead];
+    psInst->ucBufferHead = (psInst->ucBufferHead + 1) &
+                           (USBD_AUDIO_NUM_BUFFERS - 1);
+    psInst->ucBufferCount--;
+
+    //
+    // Refill the uDMA channel before calling the application so that it does
+    // not wait on the callback.
+    //
+    if(!(psInst->ulFlags & USBD_AUDIO_FLAG_ASYNC))
+    {
+        DMAArm(psInst);
+    }
+
+    //
+    // Note that a buffer has been filled for the level measurement.
+    //
+    if(psInst->ucLevelState == AUDIO_LEVEL_IDLE)
+    {
+        psInst->ucLevelState = AUDIO_LEVEL_FILLED;
+    }
+
+    //
+    // Inform the callback of the new data.
+    //
+    sBuffer.pfnCallback(sBuffer.pvData, sBuffer.ulNumBytes,
+                        USBD_AUDIO_EVENT_DATAOUT);
+}
+
+//*****************************************************************************
+//
+// Handles the completion of uDMA transfers on the OUT endpoint.  Each full
+// buffer is returned to the application.
+//
+//*****************************************************************************
+static void
+DMAComplete(tAudioInstance *psInst)
+{
+    unsigned long ulStruct;
+
+    while(psInst->ucDMAArmed)
+    {
+        //
+        // Stop if the oldest buffer is still being filled.
+        //
+        ulStruct = psInst->ucDMAHeadAlt ? UDMA_ALT_SELECT : UDMA_PRI_SELECT;
+        if(MAP_uDMAChannelModeGet(psInst->ucOUTDMA | ulStruct) !=
+           UDMA_MODE_STOP)
+        {
+            break;
+        }
+
+        //
+        // The next buffer, if any, is in the other control structure.
+        //
+        psInst->ucDMAArmed--;
+        psInst->ucDMAHeadAlt ^= 1;
+
+        //
+        // If the channel has stopped, start again from the primary control
+        // structure next time.
+        //
+        if(!psInst->ucDMAArmed)
+        {
+            MAP_uDMAChannelAttributeDisable(psInst->ucOUTDMA,
+                                            UDMA_ATTR_ALTSELECT);
+            psInst->ucDMAHeadAlt = 0;
+        }
+
+        psInst->psBuffers[psInst->ucBufferHead].ulNumBytes =
+            psInst->psBuffers[psInst->ucBufferHead].ulSize;
+        BufferDone(psInst);
+    }
+}
+
+//*****************************************************************************
+//
+// Reads a packet from the OUT endpoint into the oldest queued buffer.  This
+// is used in asynchronous mode, where the packet size varies.
+//
+//*****************************************************************************
+static void
+PacketRead(tAudioInstance *psInst)
+{
+    tAudioBuffer *psBuffer;
+    unsigned long ulEPStatus, ulSize;
+
+    //
+    // Read out and clear the current endpoint status.
+    //
+    ulEPStatus = MAP_USBEndpointStatus(USB0_BASE, psInst->ucOUTEndpoint);
+    MAP_USBDevEndpointStatusClear(USB0_BASE, psInst->ucOUTEndpoint,
+                                  ulEPStatus);
+
+    if(!(ulEPStatus & USB_DEV_RX_PKT_RDY))
+    {
+        return;
+    }
+
+    ulSize = MAP_USBEndpointDataAvail(USB0_BASE, psInst->ucOUTEndpoint);
+
+    //
+    // Return the oldest buffer if this packet does not fit in it.
+    //
+    psBuffer = &psInst->psBuffers[psInst->ucBufferHead];
+    if(psInst->ucBufferCount &&
+       ((psBuffer->ulSize - psBuffer->ulNumBytes) < ulSize))
+    {
+        BufferDone(psInst);
+        psBuffer = &psInst->psBuffers[psInst->ucBufferHead];
+    }
+
+    //
+    // The packet is lost if the application has not provided a buffer.
+    //
+    if(psInst->ucBufferCount)
+    {
+        MAP_USBEndpointDataGet(USB0_BASE, psInst->ucOUTEndpoint,
+                               ((unsigned char *)psBuffer->pvData +
+                                psBuffer->ulNumBytes), &ulSize);
+        psBuffer->ulNumBytes += ulSize;
+    }
+
+    //
+    // Acknowledge that the data was read, this will not cause a bus
+    // acknowledgment.
+    //
+    MAP_USBDevEndpointDataAck(USB0_BASE, psInst->ucOUTEndpoint, 0);
+
+    //
+    // Return the buffer now if the largest packet would not fit in it.
+    //
+    if(psInst->ucBufferCount &&
+       ((psBuffer->ulSize - psBuffer->ulNumBytes) <
+        ISOC_OUT_EP_MAX_SIZE_ASYNC))
+    {
+        BufferDone(psInst);
+    }
+}
+
+//*****************************************************************************
+//
+// Measures the free space in the queued buffers.  This is done each time the
+// application returns a buffer.  If the host sends samples more slowly than
+// the application plays them, buffers come back sooner and the free space
+// grows; if it sends them faster, the free space shrinks.  This must be called
+// with interrupts disabled.
+//
+//*****************************************************************************
+static void
+LevelUpdate(tAudioInstance *psInst)
+{
+    tAudioBuffer *psBuffer;
+    unsigned long ulIdx;
+    long lLevel;
+
+    //
+    // Nothing can be measured until a buffer has been filled and returned.
+    //
+    if(psInst->ucLevelState == AUDIO_LEVEL_IDLE)
+    {
+        return;
+    }
+
+    lLevel = 0;
+    for(ulIdx = 0; ulIdx < psInst->ucBufferCount; ulIdx++)
+    {
+        psBuffer = &psInst->psBuffers[(psInst->ucBufferHead + ulIdx) &
+                                      (USBD_AUDIO_NUM_BUFFERS - 1)];
+        lLevel += (long)(psBuffer->ulSize - psBuffer->ulNumBytes);
+    }
+
+    if(psInst->ucLevelState == AUDIO_LEVEL_FILLED)
+    {
+        //
+        // The first buffer has come back so the application is now playing.
+        // Hold the level seen now.
+        //
+        psInst->lLevelSetpoint = lLevel;
+        psInst->lLevelError = 0;
+        psInst->ucLevelState = AUDIO_LEVEL_VALID;
+    }
+    else
+    {
+        //
+        // Filter the difference from the setpoint, which moves by up to a
+        // packet depending on where in a packet the buffer came back.
+        //
+        psInst->lLevelError += (((lLevel - psInst->lLevelSetpoint) * 16) -
+                                psInst->lLevelError) / 8;
+    }
+}
+
+//*****************************************************************************
+//
+// Returns the feedback value for the host in 10.14 samples per frame.
+//
+//*****************************************************************************
+static unsigned long
+FeedbackValue(tAudioInstance *psInst)
+{
+    long lAdjust;
+
+    //
+    // Use the value the application has measured, if any.
+    //
+    if(psInst->ulFeedback)
+    {
+        return(psInst->ulFeedback);
+    }
+
+    //
+    // Otherwise ask for 1/4096 of a sample per frame more for each byte of
+    // free space gained since the setpoint was taken.
+    //
+    lAdjust = psInst->lLevelError / 4;
+    if(lAdjust > AUDIO_FEEDBACK_MAX_ADJ)
+    {
+        lAdjust = AUDIO_FEEDBACK_MAX_ADJ;
+    }
+    else if(lAdjust < -AUDIO_FEEDBACK_MAX_ADJ)
+    {
+        lAdjust = -AUDIO_FEEDBACK_MAX_ADJ;
+    }
+
+    return((unsigned long)(AUDIO_FEEDBACK_NOMINAL + lAdjust));
+}
+
+//*****************************************************************************
+//
+// Loads the next feedback value into the feedback endpoint if the host has
+// read the last one.
+//
+//*****************************************************************************
+static void
+FeedbackSend(tAudioInstance *psInst)
+{
+    unsigned long ulEPStatus, ulValue;
+    unsigned char pucPacket[ISOC_FEEDBACK_EP_SIZE];
+
+    //
+    // Read out and clear the current endpoint status.
+    //
+    ulEPStatus = MAP_USBEndpointStatus(USB0_BASE, psInst->ucFeedbackEndpoint);
+    MAP_USBDevEndpointStatusClear(USB0_BASE, psInst->ucFeedbackEndpoint,
+                                  ulEPStatus);
+
+    if(!psInst->bActive || (ulEPStatus & USB_DEV_TX_TXPKTRDY))
+    {
+        return;
+    }
+
+    //
+    // The value is sent least significant byte first.
+    //
+    ulValue = FeedbackValue(psInst);
+    pucPacket[0] = (unsigned char)ulValue;
+    pucPacket[1] = (unsigned char)(ulValue >> 8);
+    pucPacket[2] = (unsigned char)(ulValue >> 16);
+
+    MAP_USBEndpointDataPut(USB0_BASE, psInst->ucFeedbackEndpoint, pucPacket,
+                           ISOC_FEEDBACK_EP_SIZE);
+    MAP_USBEndpointDataSend(USB0_BASE, psInst->ucFeedbackEndpoint,
+                            USB_TRANS_IN);
+}
+
 //*****************************************************************************
 //
 // This function is called to handle the interrupts on the isochronous endpoint
@@ -612,7 +1177,6 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
 {
     unsigned long ulEPStatus;
     tAudioInstance *psInst;
-    unsigned char *pucData;
     const tUSBDAudioDevice *psDevice;
 
     ASSERT(pvInstance != 0);
@@ -627,44 +1191,49 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
     //
     psInst = psDevice->psPrivateData;
 
-    //
-    // Make sure this was for the isochronous out endpoint.
-    //
-    if((psInst->sBuffer.pvData != 0) &&
-       (MAP_uDMAChannelModeGet(psInst->ucOUTDMA) == UDMA_MODE_STOP))
+    if(psInst->ulFlags & USBD_AUDIO_FLAG_ASYNC)
     {
         //
-        // Save the pointer to the data buffer.
+        // Read any packet received on the isochronous OUT endpoint.
         //
-        pucData = psInst->sBuffer.pvData;
-
-        //
-        // Clear out the buffer pointer to indicate it is no longer in use.
-        //
-        psInst->sBuffer.pvData = 0;
+        if(ulStatus & (0x10000 << USB_EP_TO_INDEX(psInst->ucOUTEndpoint)))
+        {
+            PacketRead(psInst);
+        }
 
         //
-        // Inform the callback of the new data.
+        // Load the next feedback value once the host has read the last one.
         //
-        psInst->sBuffer.pfnCallback(pucData, psInst->sBuffer.ulSize,
-                                    USBD_AUDIO_EVENT_DATAOUT);
-
+        if(ulStatus & (1 << USB_EP_TO_INDEX(psInst->ucFeedbackEndpoint)))
+        {
+            FeedbackSend(psInst);
+        }
+    }
+    else
+    {
         //
-        // Read out the current endpoint status.
+        // uDMA only takes full packets, so the endpoint interrupt only occurs
+        // for a short packet.  The host should never send one; drop it so
+        // that it does not block the packets behind it.
         //
-        ulEPStatus = MAP_USBEndpointStatus(USB0_BASE, psInst->ucOUTEndpoint);
+        if(ulStatus & (0x10000 << USB_EP_TO_INDEX(psInst->ucOUTEndpoint)))
+        {
+            ulEPStatus = MAP_USBEndpointStatus(USB0_BASE,
+                                               psInst->ucOUTEndpoint);
+            MAP_USBDevEndpointStatusClear(USB0_BASE, psInst->ucOUTEndpoint,
+                                          ulEPStatus);
 
-        //
-        // Acknowledge that the data was read, this will not cause a bus
-        // acknowledgment.
-        //
-        MAP_USBDevEndpointDataAck(USB0_BASE, psInst->ucOUTEndpoint, 0);
+            if(ulEPStatus & USB_DEV_RX_PKT_RDY)
+            {
+                MAP_USBDevEndpointDataAck(USB0_BASE, psInst->ucOUTEndpoint,
+                                          0);
+            }
+        }
 
         //
-        // Clear the status bits.
+        // Return any buffers that uDMA has filled.
         //
-        MAP_USBDevEndpointStatusClear(USB0_BASE, psInst->ucOUTEndpoint,
-                                      ulEPStatus);
+        DMAComplete(psInst);
     }
 }
 
@@ -677,7 +1246,8 @@ static void
 HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
 {
     tAudioInstance *psInst;
-    unsigned char *pucData;
+    unsigned char *pucData, *pucDesc;
+    unsigned long ulOffset, ulSize;
 
     //
     // Create the serial instance data.
@@ -733,9 +1303,13 @@ HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
                                    (((pucData[1] & 0x7f) - 1) * 2);
 
                 //
-                // Basic configuration for DMA on the OUT endpoint.
+                // Basic configuration for DMA on the OUT endpoint.  Both
+                // control structures are used in ping-pong mode.
                 //
-                MAP_uDMAChannelControlSet(psInst->ucOUTDMA,
+                MAP_uDMAChannelControlSet(psInst->ucOUTDMA | UDMA_PRI_SELECT,
+                                          (UDMA_SIZE_32 | UDMA_SRC_INC_NONE|
+                                           UDMA_DST_INC_32 | UDMA_ARB_16));
+                MAP_uDMAChannelControlSet(psInst->ucOUTDMA | UDMA_ALT_SELECT,
                                           (UDMA_SIZE_32 | UDMA_SRC_INC_NONE|
                                            UDMA_DST_INC_32 | UDMA_ARB_16));
 
@@ -746,6 +1320,14 @@ HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
                 MAP_USBEndpointDMAChannel(USB0_BASE, psInst->ucOUTEndpoint,
                                           psInst->ucOUTDMA);
             }
+            else
+            {
+                //
+                // The only IN endpoint is the feedback endpoint.
+                //
+                psInst->ucFeedbackEndpoint =
+                    INDEX_TO_USB_EP(pucData[1] & 0x7f);
+            }
             break;
         }
 
@@ -762,6 +1344,33 @@ HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
             //
             pucData[2] = psInst->ucInterfaceControl;
 
+            //
+            // In asynchronous mode the data endpoint refers to the feedback
+            // endpoint, which may have been renumbered, so find the data
+            // endpoint descriptor and update its bSynchAddress field.
+            //
+            if(psInst->ulFlags & USBD_AUDIO_FLAG_ASYNC)
+            {
+                ulSize = sizeof(g_pIADAudioDescriptor) +
+                         sizeof(g_pAudioControlInterface) +
+                         sizeof(g_pAudioStreamInterfaceAsync);
+
+                for(ulOffset = 0; ulOffset < ulSize; ulOffset += pucDesc[0])
+                {
+                    pucDesc = pucData + ulOffset;
+
+                    if((pucDesc[1] == USB_DTYPE_ENDPOINT) &&
+                       (pucDesc[2] ==
+                        USB_EP_TO_INDEX(psInst->ucOUTEndpoint)))
+                    {
+                        pucDesc[8] =
+                            (USB_EP_DESC_IN |
+                             USB_EP_TO_INDEX(psInst->ucFeedbackEndpoint));
+                        break;
+                    }
+                }
+            }
+
             break;
         }
 
@@ -790,6 +1399,11 @@ HandleDisconnect(void *pvInstance)
     //
     psDevice = (const tUSBDAudioDevice *)pvInstance;
 
+    //
+    // The streaming interface is no longer active.
+    //
+    psDevice->psPrivateData->bActive = false;
+
     //
     // Inform the application that the device has been disconnected.
     //
@@ -810,6 +1424,7 @@ InterfaceChange(void *pvInstance, unsigned char ucInterface,
                 unsigned char ucAlternateSetting)
 {
     const tUSBDAudioDevice *psDevice;
+    tAudioInstance *psInst;
 
     ASSERT(pvInstance != 0);
 
@@ -817,6 +1432,7 @@ InterfaceChange(void *pvInstance, unsigned char ucInterface,
     // Create the instance pointer.
     //
     psDevice = (const tUSBDAudioDevice *)pvInstance;
+    psInst = psDevice->psPrivateData;
 
     //
     // Check which interface to change into.
@@ -826,6 +1442,8 @@ InterfaceChange(void *pvInstance, unsigned char ucInterface,
         //
         // Alternate setting 0 is an inactive state.
         //
+        psInst->bActive = false;
+
         if(psDevice->pfnCallback)
         {
             psDevice->pfnCallback(0, USBD_AUDIO_EVENT_IDLE, 0, 0);
@@ -842,12 +1460,28 @@ InterfaceChange(void *pvInstance, unsigned char ucInterface,
         }
 
         //
-        // Enable uDMA on the endpoint now that the active configuration
-        // has been selected.
+        // Start a new buffer level measurement for the feedback value.
         //
-        MAP_USBEndpointDMAEnable(USB0_BASE,
-                                 psDevice->psPrivateData->ucOUTEndpoint,
-                                 USB_EP_DEV_OUT);
+        psInst->bActive = true;
+        psInst->ucLevelState = AUDIO_LEVEL_IDLE;
+        psInst->lLevelError = 0;
+
+        if(psInst->ulFlags & USBD_AUDIO_FLAG_ASYNC)
+        {
+            //
+            // Have the first feedback value ready for the host.
+            //
+            FeedbackSend(psInst);
+        }
+        else
+        {
+            //
+            // Enable uDMA on the endpoint now that the active configuration
+            // has been selected.
+            //
+            MAP_USBEndpointDMAEnable(USB0_BASE, psInst->ucOUTEndpoint,
+                                     USB_EP_DEV_OUT);
+        }
     }
 }
 
@@ -927,11 +1561,19 @@ USBDAudioInit(unsigned long ulIndex, const tUSBDAudioDevice *psDevice)
     USBDCDInit(ulIndex, psDevice->psPrivateData->psDevInfo);
 
     //
-    // Basic configuration for DMA on the OUT endpoint.
+    // Basic configuration for DMA on the OUT endpoint.  Both control
+    // structures are used in ping-pong mode.
     //
-    MAP_uDMAChannelControlSet(psDevice->psPrivateData->ucOUTDMA,
+    MAP_uDMAChannelControlSet(psDevice->psPrivateData->ucOUTDMA |
+                              UDMA_PRI_SELECT,
                               (UDMA_SIZE_32 | UDMA_SRC_INC_NONE|
                                UDMA_DST_INC_32 | UDMA_ARB_16));
+    MAP_uDMAChannelControlSet(psDevice->psPrivateData->ucOUTDMA |
+                              UDMA_ALT_SELECT,
+                              (UDMA_SIZE_32 | UDMA_SRC_INC_NONE|
+                               UDMA_DST_INC_32 | UDMA_ARB_16));
+    MAP_uDMAChannelAttributeDisable(psDevice->psPrivateData->ucOUTDMA,
+                                    UDMA_ATTR_ALTSELECT);
 
     //
     // Select this channel for this endpoint, this only affects devices that
@@ -1010,9 +1652,23 @@ USBDAudioCompositeInit(unsigned long ulIndex, const tUSBDAudioDevice *psDevice)
     psInst->ucOUTDMA = ISOC_OUT_DMA_CHANNEL;
 
     //
-    // Set the initial buffer to null.
+    // Set the default feedback endpoint and the selected options.
     //
-    psInst->sBuffer.pvData = 0;
+    psInst->ucFeedbackEndpoint = ISOC_FEEDBACK_ENDPOINT;
+    psInst->ulFlags = psDevice->ulFlags;
+
+    //
+    // No buffers are queued yet and the stream is not active.
+    //
+    psInst->ucBufferHead = 0;
+    psInst->ucBufferCount = 0;
+    psInst->ucDMAArmed = 0;
+    psInst->ucDMAHeadAlt = 0;
+    psInst->bActive = false;
+    psInst->ulFeedback = 0;
+    psInst->ucLevelState = AUDIO_LEVEL_IDLE;
+    psInst->lLevelSetpoint = 0;
+    psInst->lLevelError = 0;
 
     //
     // Save the volume settings.
@@ -1048,6 +1704,22 @@ USBDAudioCompositeInit(unsigned long ulIndex, const tUSBDAudioDevice *psDevice)
         psDevice->ulNumStringDescriptors;
     psInst->psDevInfo->pvInstance = (void *)psDevice;
 
+    //
+    // Select the descriptors and FIFO configuration for the synchronization
+    // mode in use.
+    //
+    if(psInst->ulFlags & USBD_AUDIO_FLAG_ASYNC)
+    {
+        psInst->psDevInfo->ppConfigDescriptors =
+            g_pAudioAsyncConfigDescriptors;
+        psInst->psDevInfo->psFIFOConfig = &g_sUSBAudioAsyncFIFOConfig;
+    }
+    else
+    {
+        psInst->psDevInfo->ppConfigDescriptors = g_pAudioConfigDescriptors;
+        psInst->psDevInfo->psFIFOConfig = &g_sUSBAudioFIFOConfig;
+    }
+
     //
     // Return the pointer to the instance indicating that everything went well.
     //
@@ -1408,16 +2080,35 @@ HandleRequests(void *pvInstance, tUSBRequest *pUSBRequest)
 //! \param pfnCallback is a callback that will provide notification when this
 //! buffer has valid data.
 //!
-//! This function fills the buffer pointed to by the \e pvBuffer parameter with
-//! at most \e ulSize one packet of data from the host controller.  The ulSize
-//! has a minimum value of \b ISOC_OUT_EP_MAX_SIZE since each USB packet can be
-//! at most \b ISOC_OUT_EP_MAX_SIZE bytes in size.  Since the audio data may
-//! not be received in amounts that evenly fit in the buffer provided, the
-//! buffer may not be completely filled.  The \e pfnCallback function will
-//! provide the amount of valid data that was actually stored in the buffer
-//! provided.  The function will return zero if the buffer could be scheduled
-//! to be filled, otherwise the function will return a non-zero value if there
-//! was some reason that the buffer could not be added.
+//! This function adds the buffer pointed to by the \e pvBuffer parameter to
+//! the queue of buffers to be filled with audio data from the host
+//! controller.  Up to \b USBD_AUDIO_NUM_BUFFERS buffers may be queued and
+//! they are filled in the order that they were queued.  Once a buffer is
+//! filled, the audio class moves straight on to the next one and then returns
+//! the full buffer with the \e pfnCallback function, which will provide the
+//! amount of valid data that was actually stored in the buffer.  An
+//! application that queues a buffer again from the callback keeps a
+//! continuous chain of buffers going.
+//!
+//! With adaptive synchronization the buffer is filled by uDMA, the \e ulSize
+//! parameter must be a multiple of 4 bytes and no more than 4096 bytes and
+//! the buffer is always completely filled.  Data received after one buffer
+//! is full carries on straight into the next, so a packet may be split
+//! between two buffers.  The uDMA controller moves between two buffers
+//! without software, so the interrupt occurs only once per buffer.
+//!
+//! With asynchronous synchronization, selected with \b USBD_AUDIO_FLAG_ASYNC,
+//! each packet is read into the buffer by the endpoint interrupt and packets
+//! are never split.  A buffer is returned once it does not have room for
+//! another packet of the largest size that the host may send, which is one
+//! sample more than the nominal packet size, so buffers are only partly
+//! filled unless \e ulSize is chosen accordingly.
+//!
+//! In either case \e ulSize has a minimum value of the largest packet size
+//! since each USB packet must fit in a buffer.  The function will return zero
+//! if the buffer could be scheduled to be filled, otherwise the function will
+//! return a non-zero value if there was some reason that the buffer could not
+//! be added.
 //!
 //! \return Returns 0 to indicate success any other value indicates that the
 //! buffer will not be filled.
@@ -1428,13 +2119,16 @@ USBAudioBufferOut(void *pvInstance, void *pvBuffer, unsigned long ulSize,
                   tUSBAudioBufferCallback pfnCallback)
 {
     tAudioInstance *psInst;
+    tAudioBuffer *psBuffer;
     const tUSBDAudioDevice *psDevice;
+    tBoolean bIntsOff;
 
     //
     // Make sure we were not passed NULL pointers.
     //
     ASSERT(pvInstance != 0);
     ASSERT(pvBuffer != 0);
+    ASSERT(pfnCallback);
 
     //
     // Create the instance pointer.
@@ -1442,40 +2136,142 @@ USBAudioBufferOut(void *pvInstance, void *pvBuffer, unsigned long ulSize,
     psDevice = (const tUSBDAudioDevice *)pvInstance;
 
     //
-    // Buffer must be at least one packet in size.
+    // Create a pointer of the correct type from the private pointer.
     //
-    ASSERT(ulSize >= ISOC_OUT_EP_MAX_SIZE);
-    ASSERT(pfnCallback);
+    psInst = psDevice->psPrivateData;
 
     //
-    // Create a pointer of the correct type from the private pointer.
+    // Buffer must be at least one packet in size and, if it is filled by
+    // uDMA, a whole number of words that one transfer can fill.
     //
-    psInst = psDevice->psPrivateData;
+    if(psInst->ulFlags & USBD_AUDIO_FLAG_ASYNC)
+    {
+        ASSERT(ulSize >= ISOC_OUT_EP_MAX_SIZE_ASYNC);
+    }
+    else
+    {
+        ASSERT(ulSize >= ISOC_OUT_EP_MAX_SIZE);
+        ASSERT(ulSize <= AUDIO_DMA_MAX_SIZE);
+        ASSERT((ulSize & 3) == 0);
+    }
 
     //
-    // Initialize the buffer instance.
+    // The queue is also changed in the context of the USB interrupt so
+    // turn interrupts off while adding the buffer.
     //
-    psInst->sBuffer.pvData = pvBuffer;
-    psInst->sBuffer.ulSize = ulSize;
-    psInst->sBuffer.ulNumBytes = 0;
-    psInst->sBuffer.pfnCallback = pfnCallback;
+    bIntsOff = IntMasterDisable();
 
     //
-    // Configure and enable DMA for the OUT transfer.
+    // Fail if the queue is already full.
     //
-    MAP_uDMAChannelTransferSet(psInst->ucOUTDMA, UDMA_MODE_BASIC,
-                               (void *)USBFIFOAddrGet(USB0_BASE,
-                                                      psInst->ucOUTEndpoint),
-                               psInst->sBuffer.pvData, ulSize >> 2);
+    if(psInst->ucBufferCount == USBD_AUDIO_NUM_BUFFERS)
+    {
+        if(!bIntsOff)
+        {
+            IntMasterEnable();
+        }
+        return(-1);
+    }
 
     //
-    // Start the DMA transfer.
+    // Add the buffer to the end of the queue.
     //
-    MAP_uDMAChannelEnable(psInst->ucOUTDMA);
+    psBuffer = &psInst->psBuffers[(psInst->ucBufferHead +
+                                   psInst->ucBufferCount) &
+                                  (USBD_AUDIO_NUM_BUFFERS - 1)];
+    psBuffer->pvData = pvBuffer;
+    psBuffer->ulSize = ulSize;
+    psBuffer->ulNumBytes = 0;
+    psBuffer->pfnCallback = pfnCallback;
+    psInst->ucBufferCount++;
+
+    if(psInst->ulFlags & USBD_AUDIO_FLAG_ASYNC)
+    {
+        //
+        // Take the buffer level for the feedback value.
+        //
+        LevelUpdate(psInst);
+    }
+    else
+    {
+        //
+        // Hand the buffer to the uDMA controller if one of its control
+        // structures is free.
+        //
+        DMAArm(psInst);
+    }
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
 
     return(0);
 }
 
+//*****************************************************************************
+//
+//! Sets the feedback value that an asynchronous audio device reports to the
+//! host.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDAudioInit() or USBDAudioInitComposite().
+//! \param ulFeedback is the number of samples that the device plays in each
+//! USB frame, as an unsigned 10.14 fixed point value, or 0 to have the audio
+//! class derive the value.
+//!
+//! An audio device initialized with \b USBD_AUDIO_FLAG_ASYNC tells the host
+//! how many samples to send in each frame so that the host follows the
+//! device's sample clock.  The most accurate value comes from measuring the
+//! sample clock against the USB start of frame, and an application able to do
+//! this passes its result to this function whenever it changes.  A value of
+//! 48 samples per frame is 0x000C0000.
+//!
+//! By default, or after this function is called with \e ulFeedback set to 0,
+//! the audio class derives the value from how quickly the application returns
+//! buffers with USBAudioBufferOut().  The free space in the queued buffers
+//! when the application first returns a buffer is taken as the setpoint, and
+//! the value is raised as the free space grows beyond that and lowered as it
+//! shrinks, by up to one sample per frame.  This assumes that the application
+//! returns each buffer once it has played the data in it.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDAudioFeedbackSet(void *pvInstance, unsigned long ulFeedback)
+{
+    ASSERT(pvInstance != 0);
+
+    ((const tUSBDAudioDevice *)pvInstance)->psPrivateData->ulFeedback =
+        ulFeedback;
+}
+
+//*****************************************************************************
+//
+//! Returns the feedback value that an asynchronous audio device reports to
+//! the host.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDAudioInit() or USBDAudioInitComposite().
+//!
+//! This function returns the value that will be sent on the feedback endpoint
+//! next, either the one set with USBDAudioFeedbackSet() or the one derived
+//! from the buffer level.
+//!
+//! \return Returns the number of samples per frame as an unsigned 10.14 fixed
+//! point value.
+//
+//*****************************************************************************
+unsigned long
+USBDAudioFeedbackGet(void *pvInstance)
+{
+    ASSERT(pvInstance != 0);
+
+    return(FeedbackValue(((const tUSBDAudioDevice *)pvInstance)->
+                         psPrivateData));
+}
+
 //*****************************************************************************
 //
 // Close the Doxygen group.
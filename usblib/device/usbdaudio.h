@@ -46,6 +46,45 @@ extern "C"
 typedef void (* tUSBAudioBufferCallback)(void *pvBuffer, unsigned long ulParam,
                                          unsigned long ulEvent);
 
+//*****************************************************************************
+//
+//! The number of buffers that may be queued with USBAudioBufferOut() at any
+//! one time.  This must be a power of two.
+//
+//*****************************************************************************
+#define USBD_AUDIO_NUM_BUFFERS  4
+
+//*****************************************************************************
+//
+// PRIVATE
+//
+// A buffer queued with USBAudioBufferOut().
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // Pointer to a buffer provided by caller.
+    //
+    void *pvData;
+
+    //
+    // Size of the data area provided in pvData in bytes.
+    //
+    unsigned long ulSize;
+
+    //
+    // Number of valid bytes copied into the pvData area.
+    //
+    unsigned long ulNumBytes;
+
+    //
+    // The buffer callback for this function.
+    //
+    tUSBAudioBufferCallback pfnCallback;
+}
+tAudioBuffer;
+
 //*****************************************************************************
 //
 // PRIVATE
@@ -78,28 +117,25 @@ typedef struct
     //
     short sVolumeStep;
 
-    struct
-    {
-        //
-        // Pointer to a buffer provided by caller.
-        //
-        void *pvData;
-
-        //
-        // Size of the data area provided in pvData in bytes.
-        //
-        unsigned long ulSize;
+    //
+    // The buffers queued by the application.  They are filled in order
+    // starting with the one at index ucBufferHead.
+    //
+    tAudioBuffer psBuffers[USBD_AUDIO_NUM_BUFFERS];
 
-        //
-        // Number of valid bytes copied into the pvData area.
-        //
-        unsigned long ulNumBytes;
+    //
+    // The index of the oldest queued buffer and the number of buffers queued.
+    //
+    unsigned char ucBufferHead;
+    unsigned char ucBufferCount;
 
-        //
-        // The buffer callback for this function.
-        //
-        tUSBAudioBufferCallback pfnCallback;
-    } sBuffer;
+    //
+    // The number of queued buffers loaded into the primary and alternate
+    // uDMA control structures of the OUT endpoint channel, and whether the
+    // oldest of them is in the alternate structure.
+    //
+    unsigned char ucDMAArmed;
+    unsigned char ucDMAHeadAlt;
 
     //
     // Pending request type.
@@ -150,6 +186,37 @@ typedef struct
     // The audio interface number associated with this instance.
     //
     unsigned char ucInterfaceAudio;
+
+    //
+    // The flags passed in the ulFlags field of tUSBDAudioDevice.
+    //
+    unsigned long ulFlags;
+
+    //
+    // Indicates that the streaming interface is in its active alternate
+    // setting.
+    //
+    tBoolean bActive;
+
+    //
+    // The isochronous feedback IN endpoint used in asynchronous mode.
+    //
+    unsigned char ucFeedbackEndpoint;
+
+    //
+    // The feedback value set by USBDAudioFeedbackSet() or 0 if the value is
+    // derived from the buffer level.
+    //
+    unsigned long ulFeedback;
+
+    //
+    // The state of the buffer level measurement, the free buffer space seen
+    // when the application first returned a buffer, and the filtered
+    // difference from that seen since, in sixteenths of a byte.
+    //
+    unsigned char ucLevelState;
+    long lLevelSetpoint;
+    long lLevelError;
 }
 tAudioInstance;
 
@@ -169,10 +236,11 @@ tAudioInstance;
 //
 // This value must be at least sizeof(g_pIADAudioDescriptor) +
 // sizeof(g_pAudioControlInterface) +
-// sizeof(g_sAudioStreamInterfaceSection)
+// sizeof(g_pAudioStreamInterfaceAsync), the larger of the two streaming
+// interfaces.
 //
 //*****************************************************************************
-#define COMPOSITE_DAUDIO_SIZE   (8 + 52 + 52)
+#define COMPOSITE_DAUDIO_SIZE   (8 + 52 + 61)
 
 //*****************************************************************************
 //
@@ -269,9 +337,27 @@ typedef struct
     //! must not be modified by any code outside the audio class driver.
     //
     tAudioInstance *psPrivateData;
+
+    //
+    //! Options for the audio device.  This may be 0 or
+    //! \b USBD_AUDIO_FLAG_ASYNC.
+    //
+    unsigned long ulFlags;
 }
 tUSBDAudioDevice;
 
+//*****************************************************************************
+//
+//! This flag in the ulFlags field of tUSBDAudioDevice selects asynchronous
+//! rather than adaptive synchronization.  The streaming interface then has a
+//! feedback endpoint that tells the host how many samples to send in each
+//! frame, so that the host follows the device's sample clock rather than its
+//! own.  The host varies the packet size by a sample at a time to do this, so
+//! packets are read by the endpoint interrupt rather than by uDMA.
+//
+//*****************************************************************************
+#define USBD_AUDIO_FLAG_ASYNC   0x00000001
+
 //*****************************************************************************
 //
 // Audio specific device class driver events
@@ -341,6 +427,8 @@ extern void USBDAudioTerm(void *pvInstance);
 extern long USBAudioBufferOut(void *pvInstance, void *pvBuffer,
                               unsigned long ulSize,
                               tUSBAudioBufferCallback pfnCallback);
+extern void USBDAudioFeedbackSet(void *pvInstance, unsigned long ulFeedback);
+extern unsigned long USBDAudioFeedbackGet(void *pvInstance);
 
 //*****************************************************************************
 //
@@ -22,11 +22,15 @@
 //
 //*****************************************************************************
 
+#include "inc/hw_ints.h"
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "driverlib/debug.h"
+#include "driverlib/interrupt.h"
 #include "driverlib/rom.h"
 #include "driverlib/rom_map.h"
+#include "driverlib/rtos_bindings.h"
+#include "driverlib/udma.h"
 #include "driverlib/usb.h"
 #include "usblib/usblib.h"
 #include "usblib/device/usbdevice.h"
@@ -315,7 +319,86 @@ SetDeferredOpFlag(volatile unsigned short *pusDeferredOp, unsigned short usBit,
     //
     // Set the flag bit to 1 or 0 using a bitband access.
     //
-    HWREGBITH(pusDeferredOp, usBit) = bSet ? 1 : 0;
+    InternalUSBBitSetH(pusDeferredOp, usBit, bSet);
+}
+
+//*****************************************************************************
+//
+// Moves the current transmit transfer on following an interrupt from the
+// bulk IN endpoint or the completion of its uDMA transfer, and tells the
+// client once the transfer is complete.
+//
+//*****************************************************************************
+static void
+BulkTxXferProcess(const tUSBDBulkDevice *psDevice, unsigned long ulEPStatus)
+{
+    tBulkInstance *psInst;
+
+    psInst = psDevice->psPrivateBulkData;
+
+    if(InternalUSBDXferTxProcess(&psInst->sTxXfer, ulEPStatus))
+    {
+        psInst->eBulkTxState = BULK_STATE_IDLE;
+        psDevice->pfnTxCallback(psDevice->pvTxCBData,
+                                USBD_BULK_EVENT_TX_TRANSFER_DONE,
+                                psInst->sTxXfer.ulSize,
+                                psInst->sTxXfer.pucData);
+    }
+}
+
+//*****************************************************************************
+//
+// Tells the client that the current receive transfer has ended.
+//
+//*****************************************************************************
+static void
+BulkRxXferDone(const tUSBDBulkDevice *psDevice)
+{
+    tBulkInstance *psInst;
+
+    psInst = psDevice->psPrivateBulkData;
+
+    psDevice->pfnRxCallback(psDevice->pvRxCBData,
+                            USBD_BULK_EVENT_RX_TRANSFER_DONE,
+                            psInst->sRxXfer.ulCount, psInst->sRxXfer.pucData);
+}
+
+//*****************************************************************************
+//
+// Moves the current receive transfer on following an interrupt from the
+// bulk OUT endpoint or the completion of its uDMA transfer.
+//
+//*****************************************************************************
+static void
+BulkRxXferProcess(const tUSBDBulkDevice *psDevice, unsigned long ulEPStatus)
+{
+    tBulkInstance *psInst;
+
+    psInst = psDevice->psPrivateBulkData;
+
+    if(InternalUSBDXferRxProcess(&psInst->sRxXfer, ulEPStatus))
+    {
+        BulkRxXferDone(psDevice);
+    }
+}
+
+//*****************************************************************************
+//
+// Called on every frame while a receive transfer idle timeout is set.  Ends
+// the current receive transfer if the host has stopped sending data.
+//
+//*****************************************************************************
+static void
+BulkFrameHandler(void *pvInstance, unsigned long ulTicksmS)
+{
+    const tUSBDBulkDevice *psDevice;
+
+    psDevice = (const tUSBDBulkDevice *)pvInstance;
+
+    if(InternalUSBDXferRxFrame(&psDevice->psPrivateBulkData->sRxXfer))
+    {
+        BulkRxXferDone(psDevice);
+    }
 }
 
 //*****************************************************************************
@@ -357,6 +440,15 @@ ProcessDataFromHost(const tUSBDBulkDevice *psDevice, unsigned long ulStatus)
     //
     MAP_USBDevEndpointStatusClear(USB0_BASE, psInst->ucOUTEndpoint, ulEPStatus);
 
+    //
+    // If a receive transfer is in progress then the packet belongs to it.
+    //
+    if(psInst->sRxXfer.eState != USBD_XFER_IDLE)
+    {
+        BulkRxXferProcess(psDevice, ulEPStatus);
+        return(true);
+    }
+
     //
     // Has a packet been received?
     //
@@ -446,6 +538,15 @@ ProcessDataToHost(const tUSBDBulkDevice *psDevice, unsigned long ulStatus)
     MAP_USBDevEndpointStatusClear(psInst->ulUSBBase, psInst->ucINEndpoint,
                                   ulEPStatus);
 
+    //
+    // If a transmit transfer is in progress then let it move on.
+    //
+    if(psInst->sTxXfer.eState != USBD_XFER_IDLE)
+    {
+        BulkTxXferProcess(psDevice, ulEPStatus);
+        return(true);
+    }
+
     //
     // Our last transmission completed.  Clear our state back to idle and
     // see if we need to send any more data.
@@ -487,9 +588,12 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
     psInst = psBulkInst->psPrivateBulkData;
 
     //
-    // Handler for the bulk OUT data endpoint.
+    // Handler for the bulk OUT data endpoint.  Since there is no way to tell
+    // whether a uDMA transfer caused this interrupt, check for completion of
+    // any receive transfer that is in progress too.
     //
-    if(ulStatus & (0x10000 << USB_EP_TO_INDEX(psInst->ucOUTEndpoint)))
+    if((ulStatus & (0x10000 << USB_EP_TO_INDEX(psInst->ucOUTEndpoint))) ||
+       InternalUSBDXferDMADone(&psInst->sRxXfer))
     {
         //
         // Data is being sent to us from the host.
@@ -498,9 +602,11 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
     }
 
     //
-    // Handler for the bulk IN data endpoint.
+    // Handler for the bulk IN data endpoint, including completion of the
+    // uDMA part of any transmit transfer in progress.
     //
-    if(ulStatus & (1 << USB_EP_TO_INDEX(psInst->ucINEndpoint)))
+    if((ulStatus & (1 << USB_EP_TO_INDEX(psInst->ucINEndpoint))) ||
+       InternalUSBDXferDMADone(&psInst->sTxXfer))
     {
         ProcessDataToHost(pvInstance, ulStatus);
     }
@@ -534,6 +640,8 @@ HandleConfigChange(void *pvInstance, unsigned long ulInfo)
     //
     psInst->eBulkRxState = BULK_STATE_IDLE;
     psInst->eBulkTxState = BULK_STATE_IDLE;
+    psInst->sTxXfer.eState = USBD_XFER_IDLE;
+    psInst->sRxXfer.eState = USBD_XFER_IDLE;
 
     //
     // If we have a control callback, let the client know we are open for
@@ -652,6 +760,12 @@ HandleDisconnect(void *pvInstance)
                                     USB_EVENT_DISCONNECTED, 0, (void *)0);
     }
 
+    //
+    // Abandon any transfers that were in progress.
+    //
+    InternalUSBDXferAbort(&psInst->sTxXfer);
+    InternalUSBDXferAbort(&psInst->sRxXfer);
+
     //
     // Remember that we are no longer connected.
     //
@@ -743,7 +857,8 @@ BulkTickHandler(void *pvInstance, unsigned long ulTimemS)
     //
     // Do we have a deferred receive waiting
     //
-    if(psInst->usDeferredOpFlags & (1 << BULK_DO_PACKET_RX))
+    if((psInst->usDeferredOpFlags & (1 << BULK_DO_PACKET_RX)) &&
+       (psInst->sRxXfer.eState == USBD_XFER_IDLE))
     {
         //
         // Yes - how big is the waiting packet?
@@ -794,6 +909,13 @@ BulkTickHandler(void *pvInstance, unsigned long ulTimemS)
 //! USB_EVENT_TX_COMPLETE event is sent to the application callback to inform
 //! it that another packet may be transmitted.
 //!
+//! Transfer Operation:
+//!
+//! USBDBulkTransferWrite() and USBDBulkTransferRead() move whole buffers of
+//! many packets using the uDMA controller, ending each transmitted transfer
+//! with a short or zero length packet.  A single event is sent to the
+//! relevant callback when each transfer completes.
+//!
 //! Receive Operation:
 //!
 //! An incoming USB data packet will result in a call to the application
@@ -886,6 +1008,9 @@ USBDBulkCompositeInit(unsigned long ulIndex, const tUSBDBulkDevice *psDevice)
     psInst->ucINEndpoint = DATA_IN_ENDPOINT;
     psInst->ucOUTEndpoint = DATA_OUT_ENDPOINT;
     psInst->ucInterface = 0;
+    psInst->sTxXfer.eState = USBD_XFER_IDLE;
+    psInst->sRxXfer.eState = USBD_XFER_IDLE;
+    psInst->sRxXfer.ulIdleFrames = 0;
 
     //
     // Fix up the device descriptor with the client-supplied values.
@@ -968,6 +1093,15 @@ USBDBulkTerm(void *pvInstance)
     //
     USBDCDTerm(USB_BASE_TO_INDEX(psInst->ulUSBBase));
 
+    //
+    // Release the frame handler used by any receive transfer idle timeout.
+    //
+    if(psInst->sRxXfer.ulIdleFrames)
+    {
+        InternalUSBUnregisterFrameHandler(BulkFrameHandler, pvInstance);
+        psInst->sRxXfer.ulIdleFrames = 0;
+    }
+
     psInst->ulUSBBase = 0;
     psInst->psDevInfo = (tDeviceInfo *)0;
     psInst->psConfDescriptor = (tConfigDescriptor *)0;
@@ -1213,6 +1347,14 @@ USBDBulkPacketRead(void *pvInstance, unsigned char *pcData,
     //
     psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
 
+    //
+    // Packets may not be read while a receive transfer owns the endpoint.
+    //
+    if(psInst->sRxXfer.eState != USBD_XFER_IDLE)
+    {
+        return(0);
+    }
+
     //
     // Does the relevant endpoint FIFO have a packet waiting for us?
     //
@@ -1279,6 +1421,227 @@ USBDBulkPacketRead(void *pvInstance, unsigned char *pcData,
     return(0);
 }
 
+//*****************************************************************************
+//
+//! Transmits a buffer of data to the USB host via the bulk data interface
+//! using the uDMA controller.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit().
+//! \param pucData points to the data to send.  This must be word aligned and
+//! must remain valid until the transfer has completed.
+//! \param ulLength is the number of bytes to send.
+//!
+//! This function sends a buffer of any length to the host as a single bulk
+//! transfer.  Whole packets are moved from the buffer to the endpoint FIFO by
+//! the uDMA controller and sent without any processor involvement.  The
+//! transfer ends with a short packet holding the remaining bytes or, if the
+//! length is a multiple of the maximum packet size, a zero length packet.
+//!
+//! Once the last packet has been sent, a single
+//! USBD_BULK_EVENT_TX_TRANSFER_DONE event is sent to the transmit channel
+//! callback.  No USB_EVENT_TX_COMPLETE events are sent for the packets of
+//! the transfer, and USBDBulkPacketWrite() may not be used until it has
+//! completed.
+//!
+//! The application must have enabled the uDMA controller and set its control
+//! table before calling this function.
+//!
+//! \return Returns \b true if the transfer was started or \b false if another
+//! transmission is in progress.
+//
+//*****************************************************************************
+tBoolean
+USBDBulkTransferWrite(void *pvInstance, unsigned char *pucData,
+                      unsigned long ulLength)
+{
+    tBulkInstance *psInst;
+
+    ASSERT(pvInstance);
+    ASSERT(((unsigned long)pucData & 3) == 0);
+
+    //
+    // Get our instance data pointer
+    //
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
+    //
+    // Keep the USB interrupt from moving the endpoint on while the transfer
+    // is being set up.
+    //
+    OS_INT_DISABLE(INT_USB0);
+
+    //
+    // We can't start a transfer while another packet or transfer is being
+    // sent.
+    //
+    if((psInst->eBulkTxState != BULK_STATE_IDLE) ||
+       (psInst->sTxXfer.eState != USBD_XFER_IDLE))
+    {
+        OS_INT_ENABLE(INT_USB0);
+        return(false);
+    }
+
+    psInst->eBulkTxState = BULK_STATE_WAIT_DATA;
+    InternalUSBDXferTxStart(&psInst->sTxXfer, psInst->ulUSBBase,
+                            psInst->ucINEndpoint, DATA_IN_EP_MAX_SIZE,
+                            pucData, ulLength);
+
+    OS_INT_ENABLE(INT_USB0);
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+//! Receives a buffer of data from the USB host via the bulk data interface
+//! using the uDMA controller.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit().
+//! \param pucData points to the buffer to receive the data.  This must be
+//! word aligned and must remain valid until the transfer has completed.
+//! \param ulLength is the size of the buffer in bytes.  This must be a
+//! multiple of the maximum packet size of the endpoint (64 bytes).
+//!
+//! This function receives a bulk transfer from the host directly into the
+//! buffer.  Whole packets are moved from the endpoint FIFO by the uDMA
+//! controller without any processor involvement.  The transfer ends when the
+//! buffer is full or when the host sends a short or zero length packet,
+//! which is also placed in the buffer.  Hosts do not send a zero length
+//! packet after data that fills its last packet, so an application that does
+//! not know how much data to expect should also set an idle timeout using
+//! USBDBulkTransferTimeoutSet().
+//!
+//! A single USBD_BULK_EVENT_RX_TRANSFER_DONE event is then sent to the
+//! receive channel callback giving the number of bytes received.  No
+//! USB_EVENT_RX_AVAILABLE events are sent for the packets of the transfer,
+//! and USBDBulkPacketRead() may not be used until it has completed.
+//!
+//! The application must have enabled the uDMA controller and set its control
+//! table before calling this function.
+//!
+//! \return Returns \b true if the transfer was started or \b false if another
+//! receive transfer is in progress.
+//
+//*****************************************************************************
+tBoolean
+USBDBulkTransferRead(void *pvInstance, unsigned char *pucData,
+                     unsigned long ulLength)
+{
+    tBulkInstance *psInst;
+    tBoolean bDone;
+
+    ASSERT(pvInstance);
+    ASSERT(((unsigned long)pucData & 3) == 0);
+    ASSERT(ulLength && ((ulLength % DATA_OUT_EP_MAX_SIZE) == 0));
+
+    //
+    // Get our instance data pointer
+    //
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
+    //
+    // Keep the USB interrupt from moving the endpoint on while the transfer
+    // is being set up.
+    //
+    OS_INT_DISABLE(INT_USB0);
+
+    if(psInst->sRxXfer.eState != USBD_XFER_IDLE)
+    {
+        OS_INT_ENABLE(INT_USB0);
+        return(false);
+    }
+
+    //
+    // Any packet that is already waiting now belongs to the transfer, so
+    // stop telling the client about it.
+    //
+    SetDeferredOpFlag(&psInst->usDeferredOpFlags, BULK_DO_PACKET_RX, false);
+
+    //
+    // Start the transfer.  A short packet may already be waiting, in which
+    // case it ends the transfer now, but the client is only told once the
+    // USB interrupt has been enabled again.
+    //
+    bDone = InternalUSBDXferRxStart(&psInst->sRxXfer, psInst->ulUSBBase,
+                                    psInst->ucOUTEndpoint, DATA_OUT_EP_MAX_SIZE,
+                                    pucData, ulLength);
+
+    OS_INT_ENABLE(INT_USB0);
+
+    if(bDone)
+    {
+        BulkRxXferDone((const tUSBDBulkDevice *)pvInstance);
+    }
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+//! Sets the idle timeout for transfers started by USBDBulkTransferRead().
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDBulkInit().
+//! \param ulFrames is the number of USB frames without data after which a
+//! receive transfer is ended, or 0 to disable the timeout.
+//!
+//! A receive transfer normally ends only when its buffer is full or when the
+//! host sends a short packet.  Hosts do not send a zero length packet after
+//! data that fills its last packet, so such data would be held until the
+//! host sends more.  With a timeout set, a receive transfer that has received
+//! some data and then received nothing more for \e ulFrames frames is ended,
+//! and the USBD_BULK_EVENT_RX_TRANSFER_DONE event gives the number of bytes
+//! received.  A transfer that has not received anything is never ended by
+//! the timeout.
+//!
+//! The timeout is checked on every start-of-frame so its granularity is one
+//! full speed frame (1 millisecond).  Disabling the timeout releases the
+//! frame handler used to check it.
+//!
+//! \note The start-of-frame interrupt must be enabled for the timeout to
+//! operate.  This is the case by default.
+//!
+//! \return Returns \b true on success or \b false if no frame handler was
+//! available to service the timeout.
+//
+//*****************************************************************************
+tBoolean
+USBDBulkTransferTimeoutSet(void *pvInstance, unsigned long ulFrames)
+{
+    tBulkInstance *psInst;
+
+    ASSERT(pvInstance);
+
+    //
+    // Get our instance data pointer
+    //
+    psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
+
+    if(ulFrames)
+    {
+        //
+        // Make sure we get called on each frame to check the timeout, unless
+        // only the timeout is changing.
+        //
+        if(!psInst->sRxXfer.ulIdleFrames &&
+           InternalUSBRegisterFrameHandler(BulkFrameHandler, pvInstance))
+        {
+            return(false);
+        }
+    }
+    else
+    {
+        InternalUSBUnregisterFrameHandler(BulkFrameHandler, pvInstance);
+    }
+
+    psInst->sRxXfer.ulIdleCount = 0;
+    psInst->sRxXfer.ulIdleFrames = ulFrames;
+
+    return(true);
+}
+
 //*****************************************************************************
 //
 //! Returns the number of free bytes in the transmit buffer.
@@ -1356,6 +1719,14 @@ USBDBulkRxPacketAvailable(void *pvInstance)
     //
     psInst = ((tUSBDBulkDevice *)pvInstance)->psPrivateBulkData;
 
+    //
+    // Packets received during a receive transfer belong to the transfer.
+    //
+    if(psInst->sRxXfer.eState != USBD_XFER_IDLE)
+    {
+        return(0);
+    }
+
     //
     // Does the relevant endpoint FIFO have a packet waiting for us?
     //
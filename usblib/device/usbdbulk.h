@@ -107,6 +107,13 @@ typedef struct
     unsigned char ucINEndpoint;
     unsigned char ucOUTEndpoint;
     unsigned char ucInterface;
+
+    //
+    // The transfers started by USBDBulkTransferWrite() and
+    // USBDBulkTransferRead().
+    //
+    tUSBDXfer sTxXfer;
+    tUSBDXfer sRxXfer;
 }
 tBulkInstance;
 
@@ -223,6 +230,34 @@ typedef struct
 }
 tUSBDBulkDevice;
 
+//*****************************************************************************
+//
+// Bulk-specific device class driver events
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! This event is sent to the transmit callback when a transfer started by
+//! USBDBulkTransferWrite() has completed.  The ulMsgValue parameter is the
+//! number of bytes sent and pvMsgData is the buffer passed to
+//! USBDBulkTransferWrite().
+//
+//*****************************************************************************
+#define USBD_BULK_EVENT_TX_TRANSFER_DONE (USBD_BULK_EVENT_BASE + 0)
+
+//*****************************************************************************
+//
+//! This event is sent to the receive callback when a transfer started by
+//! USBDBulkTransferRead() has completed, either because the buffer is full,
+//! because the host sent a short packet or because the idle timeout set by
+//! USBDBulkTransferTimeoutSet() expired.  The ulMsgValue parameter is the
+//! number of bytes received and pvMsgData is the buffer passed to
+//! USBDBulkTransferRead().
+//
+//*****************************************************************************
+#define USBD_BULK_EVENT_RX_TRANSFER_DONE (USBD_BULK_EVENT_BASE + 1)
+
 extern tDeviceInfo g_sBulkDeviceInfo;
 
 //*****************************************************************************
@@ -245,6 +280,14 @@ extern unsigned long USBDBulkPacketRead(void *pvInstance,
                                         unsigned char *pcData,
                                         unsigned long ulLength,
                                         tBoolean bLast);
+extern tBoolean USBDBulkTransferWrite(void *pvInstance,
+                                      unsigned char *pucData,
+                                      unsigned long ulLength);
+extern tBoolean USBDBulkTransferRead(void *pvInstance,
+                                     unsigned char *pucData,
+                                     unsigned long ulLength);
+extern tBoolean USBDBulkTransferTimeoutSet(void *pvInstance,
+                                           unsigned long ulFrames);
 extern unsigned long USBDBulkTxPacketAvailable(void *pvInstance);
 extern unsigned long USBDBulkRxPacketAvailable(void *pvInstance);
 extern void USBDBulkPowerStatusSet(void *pvInstance, unsigned char ucPower);
@@ -22,11 +22,15 @@
 //
 //*****************************************************************************
 
+#include "inc/hw_ints.h"
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "driverlib/debug.h"
+#include "driverlib/interrupt.h"
 #include "driverlib/rom.h"
 #include "driverlib/rom_map.h"
+#include "driverlib/rtos_bindings.h"
+#include "driverlib/udma.h"
 #include "driverlib/usb.h"
 #include "usblib/usblib.h"
 #include "usblib/usbcdc.h"
@@ -601,7 +605,7 @@ SetDeferredOpFlag(volatile unsigned short *pusDeferredOp,
     //
     // Set the flag bit to 1 or 0 using a bitband access.
     //
-    HWREGBITH(pusDeferredOp, usBit) = bSet ? 1 : 0;
+    InternalUSBBitSetH(pusDeferredOp, usBit, bSet);
 }
 
 //*****************************************************************************
@@ -990,6 +994,85 @@ SendSerialState(const tUSBDCDCDevice *psDevice)
     }
 }
 
+//*****************************************************************************
+//
+// Moves the current transmit transfer on following an interrupt from the
+// bulk IN endpoint or the completion of its uDMA transfer, and tells the
+// client once the transfer is complete.
+//
+//*****************************************************************************
+static void
+CDCTxXferProcess(const tUSBDCDCDevice *psDevice, unsigned long ulEPStatus)
+{
+    tCDCSerInstance *psInst;
+
+    psInst = psDevice->psPrivateCDCSerData;
+
+    if(InternalUSBDXferTxProcess(&psInst->sTxXfer, ulEPStatus))
+    {
+        psInst->eCDCTxState = CDC_STATE_IDLE;
+        psDevice->pfnTxCallback(psDevice->pvTxCBData,
+                                USBD_CDC_EVENT_TX_TRANSFER_DONE,
+                                psInst->sTxXfer.ulSize,
+                                psInst->sTxXfer.pucData);
+    }
+}
+
+//*****************************************************************************
+//
+// Tells the client that the current receive transfer has ended.
+//
+//*****************************************************************************
+static void
+CDCRxXferDone(const tUSBDCDCDevice *psDevice)
+{
+    tCDCSerInstance *psInst;
+
+    psInst = psDevice->psPrivateCDCSerData;
+
+    psDevice->pfnRxCallback(psDevice->pvRxCBData,
+                            USBD_CDC_EVENT_RX_TRANSFER_DONE,
+                            psInst->sRxXfer.ulCount, psInst->sRxXfer.pucData);
+}
+
+//*****************************************************************************
+//
+// Moves the current receive transfer on following an interrupt from the
+// bulk OUT endpoint or the completion of its uDMA transfer.
+//
+//*****************************************************************************
+static void
+CDCRxXferProcess(const tUSBDCDCDevice *psDevice, unsigned long ulEPStatus)
+{
+    tCDCSerInstance *psInst;
+
+    psInst = psDevice->psPrivateCDCSerData;
+
+    if(InternalUSBDXferRxProcess(&psInst->sRxXfer, ulEPStatus))
+    {
+        CDCRxXferDone(psDevice);
+    }
+}
+
+//*****************************************************************************
+//
+// Called on every frame while a receive transfer idle timeout is set.  Ends
+// the current receive transfer if the host has stopped sending data.
+//
+//*****************************************************************************
+static void
+CDCFrameHandler(void *pvInstance, unsigned long ulTicksmS)
+{
+    const tUSBDCDCDevice *psDevice;
+
+    psDevice = (const tUSBDCDCDevice *)pvInstance;
+
+    if(InternalUSBDXferRxFrame(&psDevice->psPrivateCDCSerData->sRxXfer))
+    {
+        CDCRxXferDone(psDevice);
+    }
+}
+
 //*****************************************************************************
 //
 // Receives notifications related to data received from the host.
@@ -1031,6 +1114,15 @@ ProcessDataFromHost(const tUSBDCDCDevice *psDevice, unsigned long ulStatus)
     MAP_USBDevEndpointStatusClear(psInst->ulUSBBase, psInst->ucBulkOUTEndpoint,
                                   ulEPStatus);
 
+    //
+    // If a receive transfer is in progress then the packet belongs to it.
+    //
+    if(psInst->sRxXfer.eState != USBD_XFER_IDLE)
+    {
+        CDCRxXferProcess(psDevice, ulEPStatus);
+        return(true);
+    }
+
     //
     // Has a packet been received?
     //
@@ -1200,6 +1292,15 @@ ProcessDataToHost(const tUSBDCDCDevice *psDevice, unsigned long ulStatus)
     MAP_USBDevEndpointStatusClear(psInst->ulUSBBase,
                                   psInst->ucBulkINEndpoint, ulEPStatus);
 
+    //
+    // If a transmit transfer is in progress then let it move on.
+    //
+    if(psInst->sTxXfer.eState != USBD_XFER_IDLE)
+    {
+        CDCTxXferProcess(psDevice, ulEPStatus);
+        return(true);
+    }
+
     //
     // Our last transmission completed.  Clear our state back to idle and
     // see if we need to send any more data.
@@ -1248,6 +1349,17 @@ ProcessDataToHost(const tUSBDCDCDevice *psDevice, unsigned long ulStatus)
                                     USB_TRANS_IN);
         }
     }
+    else
+    {
+        //
+        // A zero-length packet has been sent.  Let the client know that the
+        // endpoint is free again so that any data it passed us while the
+        // packet was in flight is scheduled now rather than waiting for the
+        // next write.
+        //
+        psDevice->pfnTxCallback(psDevice->pvTxCBData, USB_EVENT_TX_COMPLETE,
+                                0, (void *)0);
+    }
 
     return(true);
 }
@@ -1287,9 +1399,12 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
     }
 
     //
-    // Handler for the bulk OUT data endpoint.
+    // Handler for the bulk OUT data endpoint.  Since there is no way to tell
+    // whether a uDMA transfer caused this interrupt, check for completion of
+    // any receive transfer that is in progress too.
     //
-    if(ulStatus & (0x10000 << USB_EP_TO_INDEX(psInst->ucBulkOUTEndpoint)))
+    if((ulStatus & (0x10000 << USB_EP_TO_INDEX(psInst->ucBulkOUTEndpoint))) ||
+       InternalUSBDXferDMADone(&psInst->sRxXfer))
     {
         //
         // Data is being sent to us from the host.
@@ -1298,9 +1413,11 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
     }
 
     //
-    // Handler for the bulk IN data endpoint.
+    // Handler for the bulk IN data endpoint, including completion of the
+    // uDMA part of any transmit transfer in progress.
     //
-    if(ulStatus & (1 << USB_EP_TO_INDEX(psInst->ucBulkINEndpoint)))
+    if((ulStatus & (1 << USB_EP_TO_INDEX(psInst->ucBulkINEndpoint))) ||
+       InternalUSBDXferDMADone(&psInst->sTxXfer))
     {
         ProcessDataToHost(psDeviceInst, ulStatus);
     }
@@ -1336,6 +1453,8 @@ HandleConfigChange(void *pvInstance, unsigned long ulInfo)
     psInst->eCDCRequestState = CDC_STATE_IDLE;
     psInst->eCDCRxState = CDC_STATE_IDLE;
     psInst->eCDCTxState = CDC_STATE_IDLE;
+    psInst->sTxXfer.eState = USBD_XFER_IDLE;
+    psInst->sRxXfer.eState = USBD_XFER_IDLE;
 
     //
     // If we are not currently connected so let the client know we are open
@@ -1741,9 +1860,10 @@ HandleRequests(void *pvInstance, tUSBRequest *pUSBRequest)
         case USB_CDC_SET_CONTROL_LINE_STATE:
         {
             //
-            // ACK what we have already received
+            // ACK what we have already received.  This request has no data
+            // stage so this also lets the status stage complete.
             //
-            MAP_USBDevEndpointDataAck(psInst->ulUSBBase, USB_EP_0, false);
+            MAP_USBDevEndpointDataAck(psInst->ulUSBBase, USB_EP_0, true);
 
             //
             // Set the handshake lines as required.
@@ -1778,9 +1898,10 @@ HandleRequests(void *pvInstance, tUSBRequest *pUSBRequest)
         case USB_CDC_SEND_BREAK:
         {
             //
-            // ACK what we have already received
+            // ACK what we have already received.  This request has no data
+            // stage so this also lets the status stage complete.
             //
-            MAP_USBDevEndpointDataAck(psInst->ulUSBBase, USB_EP_0, false);
+            MAP_USBDevEndpointDataAck(psInst->ulUSBBase, USB_EP_0, true);
 
             //
             // Keep a copy of the requested break duration.
@@ -1895,6 +2016,12 @@ HandleDisconnect(void *pvInstance)
                                         USB_EVENT_DISCONNECTED, 0, (void *)0);
     }
 
+    //
+    // Abandon any transfers that were in progress.
+    //
+    InternalUSBDXferAbort(&psInst->sTxXfer);
+    InternalUSBDXferAbort(&psInst->sRxXfer);
+
     //
     // Remember that we are no longer connected.
     //
@@ -2084,7 +2211,8 @@ CDCTickHandler(void *pvInstance, unsigned long ulTimemS)
             //
             // Do we have a deferred receive waiting
             //
-            if(psInst->usDeferredOpFlags & (1 << CDC_DO_PACKET_RX))
+            if((psInst->usDeferredOpFlags & (1 << CDC_DO_PACKET_RX)) &&
+               (psInst->sRxXfer.eState == USBD_XFER_IDLE))
             {
                 //
                 // Yes - how big is the waiting packet?
@@ -2171,6 +2299,9 @@ USBDCDCCompositeInit(unsigned long ulIndex, const tUSBDCDCDevice *psCDCDevice)
     psInst->bRxBlocked = false;
     psInst->bControlBlocked = false;
     psInst->bConnected = false;
+    psInst->sTxXfer.eState = USBD_XFER_IDLE;
+    psInst->sRxXfer.eState = USBD_XFER_IDLE;
+    psInst->sRxXfer.ulIdleFrames = 0;
 
     //
     // Fix up the device descriptor with the client-supplied values.
@@ -2254,6 +2385,14 @@ USBDCDCCompositeInit(unsigned long ulIndex, const tUSBDCDCDevice *psCDCDevice)
 //! size of the received packet may be queried by calling
 //! USBDCDCRxPacketAvailable().
 //!
+//! Transfer Operation:
+//!
+//! USBDCDCTransferWrite() and USBDCDCTransferRead() move whole buffers of
+//! many packets using the uDMA controller, ending each transmitted transfer
+//! with a short or zero length packet.  A single
+//! \b USBD_CDC_EVENT_TX_TRANSFER_DONE or \b USBD_CDC_EVENT_RX_TRANSFER_DONE
+//! event is sent to the relevant callback when each transfer completes.
+//!
 //! \note The application must not make any calls to the low level USB Device
 //! API if interacting with USB via the CDC device class API.  Doing so
 //! will cause unpredictable (though almost certainly unpleasant) behavior.
@@ -2342,6 +2481,15 @@ USBDCDCTerm(void *pvInstance)
     //
     USBDCDTerm(USB_BASE_TO_INDEX(psInst->ulUSBBase));
 
+    //
+    // Release the frame handler used by any receive transfer idle timeout.
+    //
+    if(psInst->sRxXfer.ulIdleFrames)
+    {
+        InternalUSBUnregisterFrameHandler(CDCFrameHandler, pvInstance);
+        psInst->sRxXfer.ulIdleFrames = 0;
+    }
+
     psInst->ulUSBBase = 0;
     psInst->psDevInfo = (tDeviceInfo *)0;
     psInst->psConfDescriptor = (tConfigDescriptor *)0;
@@ -2624,6 +2772,14 @@ USBDCDCPacketRead(void *pvInstance, unsigned char *pcData,
     //
     psInst = ((tUSBDCDCDevice *)pvInstance)->psPrivateCDCSerData;
 
+    //
+    // Packets may not be read while a receive transfer owns the endpoint.
+    //
+    if(psInst->sRxXfer.eState != USBD_XFER_IDLE)
+    {
+        return(0);
+    }
+
     //
     // Does the relevant endpoint FIFO have a packet waiting for us?
     //
@@ -2707,6 +2863,234 @@ USBDCDCPacketRead(void *pvInstance, unsigned char *pcData,
     return(0);
 }
 
+//*****************************************************************************
+//
+//! Transmits a buffer of data to the USB host via the CDC data interface
+//! using the uDMA controller.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDCDCInit().
+//! \param pucData points to the data to send.  This must be word aligned and
+//! must remain valid until the transfer has completed.
+//! \param ulLength is the number of bytes to send.
+//!
+//! This function sends a buffer of any length to the host as a single bulk
+//! transfer.  Whole packets are moved from the buffer to the endpoint FIFO by
+//! the uDMA controller and sent without any processor involvement.  The
+//! transfer ends with a short packet holding the remaining bytes or, if the
+//! length is a multiple of the maximum packet size, a zero length packet.
+//!
+//! Once the last packet has been sent, a single
+//! \b USBD_CDC_EVENT_TX_TRANSFER_DONE event is sent to the transmit channel
+//! callback.  No \b USB_EVENT_TX_COMPLETE events are sent for the packets of
+//! the transfer, and USBDCDCPacketWrite() may not be used until it has
+//! completed.
+//!
+//! The application must have enabled the uDMA controller and set its control
+//! table before calling this function.
+//!
+//! \return Returns \b true if the transfer was started or \b false if another
+//! transmission is in progress.
+//
+//*****************************************************************************
+tBoolean
+USBDCDCTransferWrite(void *pvInstance, unsigned char *pucData,
+                     unsigned long ulLength)
+{
+    tCDCSerInstance *psInst;
+
+    ASSERT(pvInstance);
+    ASSERT(((unsigned long)pucData & 3) == 0);
+
+    //
+    // Get our instance data pointer
+    //
+    psInst = ((tUSBDCDCDevice *)pvInstance)->psPrivateCDCSerData;
+
+    //
+    // Keep the USB interrupt from moving the endpoint on while the transfer
+    // is being set up.
+    //
+    OS_INT_DISABLE(INT_USB0);
+
+    //
+    // We can't start a transfer while another packet or transfer is being
+    // sent.
+    //
+    if((psInst->eCDCTxState != CDC_STATE_IDLE) ||
+       (psInst->sTxXfer.eState != USBD_XFER_IDLE))
+    {
+        OS_INT_ENABLE(INT_USB0);
+        return(false);
+    }
+
+    psInst->eCDCTxState = CDC_STATE_WAIT_DATA;
+    psInst->usLastTxSize = 0;
+    InternalUSBDXferTxStart(&psInst->sTxXfer, psInst->ulUSBBase,
+                            psInst->ucBulkINEndpoint, DATA_IN_EP_MAX_SIZE,
+                            pucData, ulLength);
+
+    OS_INT_ENABLE(INT_USB0);
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+//! Receives a buffer of data from the USB host via the CDC data interface
+//! using the uDMA controller.
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDCDCInit().
+//! \param pucData points to the buffer to receive the data.  This must be
+//! word aligned and must remain valid until the transfer has completed.
+//! \param ulLength is the size of the buffer in bytes.  This must be a
+//! multiple of the maximum packet size of the endpoint (64 bytes).
+//!
+//! This function receives a bulk transfer from the host directly into the
+//! buffer.  Whole packets are moved from the endpoint FIFO by the uDMA
+//! controller without any processor involvement.  The transfer ends when the
+//! buffer is full or when the host sends a short or zero length packet,
+//! which is also placed in the buffer.  Hosts do not send a zero length
+//! packet after data that fills its last packet, so an application that does
+//! not know how much data to expect, such as a serial bridge, should also
+//! set an idle timeout using USBDCDCTransferTimeoutSet().
+//!
+//! A single \b USBD_CDC_EVENT_RX_TRANSFER_DONE event is then sent to the
+//! receive channel callback giving the number of bytes received.  No
+//! \b USB_EVENT_RX_AVAILABLE events are sent for the packets of the transfer,
+//! and USBDCDCPacketRead() may not be used until it has completed.
+//!
+//! Packets that form part of a transfer are not held back while a line
+//! coding, line state or break request is pending.  An application using
+//! this function should include the data that it has received but not yet
+//! written to the serial line in its reply to \b USB_EVENT_DATA_REMAINING so
+//! that such requests are still deferred until that data has been sent.
+//!
+//! The application must have enabled the uDMA controller and set its control
+//! table before calling this function.
+//!
+//! \return Returns \b true if the transfer was started or \b false if another
+//! receive transfer is in progress.
+//
+//*****************************************************************************
+tBoolean
+USBDCDCTransferRead(void *pvInstance, unsigned char *pucData,
+                    unsigned long ulLength)
+{
+    tCDCSerInstance *psInst;
+    tBoolean bDone;
+
+    ASSERT(pvInstance);
+    ASSERT(((unsigned long)pucData & 3) == 0);
+    ASSERT(ulLength && ((ulLength % DATA_OUT_EP_MAX_SIZE) == 0));
+
+    //
+    // Get our instance data pointer
+    //
+    psInst = ((tUSBDCDCDevice *)pvInstance)->psPrivateCDCSerData;
+
+    //
+    // Keep the USB interrupt from moving the endpoint on while the transfer
+    // is being set up.
+    //
+    OS_INT_DISABLE(INT_USB0);
+
+    if(psInst->sRxXfer.eState != USBD_XFER_IDLE)
+    {
+        OS_INT_ENABLE(INT_USB0);
+        return(false);
+    }
+
+    //
+    // Any packet that is already waiting now belongs to the transfer, so
+    // stop telling the client about it.
+    //
+    SetDeferredOpFlag(&psInst->usDeferredOpFlags, CDC_DO_PACKET_RX, false);
+
+    //
+    // Start the transfer.  A short packet may already be waiting, in which
+    // case it ends the transfer now, but the client is only told once the
+    // USB interrupt has been enabled again.
+    //
+    bDone = InternalUSBDXferRxStart(&psInst->sRxXfer, psInst->ulUSBBase,
+                                    psInst->ucBulkOUTEndpoint,
+                                    DATA_OUT_EP_MAX_SIZE, pucData, ulLength);
+
+    OS_INT_ENABLE(INT_USB0);
+
+    if(bDone)
+    {
+        CDCRxXferDone((const tUSBDCDCDevice *)pvInstance);
+    }
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+//! Sets the idle timeout for transfers started by USBDCDCTransferRead().
+//!
+//! \param pvInstance is the pointer to the device instance structure as
+//! returned by USBDCDCInit().
+//! \param ulFrames is the number of USB frames without data after which a
+//! receive transfer is ended, or 0 to disable the timeout.
+//!
+//! A receive transfer normally ends only when its buffer is full or when the
+//! host sends a short packet.  Hosts do not send a zero length packet after
+//! data that fills its last packet, so such data would be held until the
+//! host sends more.  With a timeout set, a receive transfer that has received
+//! some data and then received nothing more for \e ulFrames frames is ended,
+//! and the USBD_CDC_EVENT_RX_TRANSFER_DONE event gives the number of bytes
+//! received.  A transfer that has not received anything is never ended by
+//! the timeout.
+//!
+//! The timeout is checked on every start-of-frame so its granularity is one
+//! full speed frame (1 millisecond).  Disabling the timeout releases the
+//! frame handler used to check it.
+//!
+//! \note The start-of-frame interrupt must be enabled for the timeout to
+//! operate.  This is the case by default.
+//!
+//! \return Returns \b true on success or \b false if no frame handler was
+//! available to service the timeout.
+//
+//*****************************************************************************
+tBoolean
+USBDCDCTransferTimeoutSet(void *pvInstance, unsigned long ulFrames)
+{
+    tCDCSerInstance *psInst;
+
+    ASSERT(pvInstance);
+
+    //
+    // Get our instance data pointer
+    //
+    psInst = ((tUSBDCDCDevice *)pvInstance)->psPrivateCDCSerData;
+
+    if(ulFrames)
+    {
+        //
+        // Make sure we get called on each frame to check the timeout, unless
+        // only the timeout is changing.
+        //
+        if(!psInst->sRxXfer.ulIdleFrames &&
+           InternalUSBRegisterFrameHandler(CDCFrameHandler, pvInstance))
+        {
+            return(false);
+        }
+    }
+    else
+    {
+        InternalUSBUnregisterFrameHandler(CDCFrameHandler, pvInstance);
+    }
+
+    psInst->sRxXfer.ulIdleCount = 0;
+    psInst->sRxXfer.ulIdleFrames = ulFrames;
+
+    return(true);
+}
+
 //*****************************************************************************
 //
 //! Returns the number of free bytes in the transmit buffer.
@@ -2785,9 +3169,11 @@ USBDCDCRxPacketAvailable(void *pvInstance)
     psInst = ((tUSBDCDCDevice *)pvInstance)->psPrivateCDCSerData;
 
     //
-    // If receive is currently blocked, return 0.
+    // If receive is currently blocked or a receive transfer owns the
+    // endpoint, return 0.
     //
-    if(psInst->bRxBlocked || psInst->bControlBlocked)
+    if(psInst->bRxBlocked || psInst->bControlBlocked ||
+       (psInst->sRxXfer.eState != USBD_XFER_IDLE))
     {
         return(0);
     }
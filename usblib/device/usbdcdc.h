@@ -119,6 +119,13 @@ typedef struct
     unsigned char ucBulkOUTEndpoint;
     unsigned char ucInterfaceControl;
     unsigned char ucInterfaceData;
+
+    //
+    // The transfers started by USBDCDCTransferWrite() and
+    // USBDCDCTransferRead().
+    //
+    tUSBDXfer sTxXfer;
+    tUSBDXfer sRxXfer;
 }
 tCDCSerInstance;
 
@@ -204,6 +211,24 @@ tCDCSerInstance;
 //
 #define USBD_CDC_EVENT_GET_LINE_CODING (USBD_CDC_EVENT_BASE + 4)
 
+//
+//! A transmit transfer started by USBDCDCTransferWrite() has completed.  This
+//! event is sent to the transmit channel callback.  The ulMsgValue parameter
+//! is the number of bytes sent and pvMsgData is the buffer that was passed to
+//! USBDCDCTransferWrite().
+//
+#define USBD_CDC_EVENT_TX_TRANSFER_DONE (USBD_CDC_EVENT_BASE + 5)
+
+//
+//! A receive transfer started by USBDCDCTransferRead() has completed, either
+//! because the buffer is full, because the host sent a short packet or
+//! because the idle timeout set by USBDCDCTransferTimeoutSet() expired.  This
+//! event is sent to the receive channel callback.  The ulMsgValue parameter
+//! is the number of bytes received and pvMsgData is the buffer that was
+//! passed to USBDCDCTransferRead().
+//
+#define USBD_CDC_EVENT_RX_TRANSFER_DONE (USBD_CDC_EVENT_BASE + 6)
+
 //*****************************************************************************
 //
 //! The structure used by the application to define operating parameters for
@@ -327,6 +352,14 @@ extern unsigned long USBDCDCPacketRead(void *pvInstance,
                                        unsigned char *pcData,
                                        unsigned long ulLength,
                                        tBoolean bLast);
+extern tBoolean USBDCDCTransferWrite(void *pvInstance,
+                                     unsigned char *pucData,
+                                     unsigned long ulLength);
+extern tBoolean USBDCDCTransferRead(void *pvInstance,
+                                    unsigned char *pucData,
+                                    unsigned long ulLength);
+extern tBoolean USBDCDCTransferTimeoutSet(void *pvInstance,
+                                          unsigned long ulFrames);
 extern unsigned long USBDCDCTxPacketAvailable(void *pvInstance);
 extern unsigned long USBDCDCRxPacketAvailable(void *pvInstance);
 extern void USBDCDCSerialStateChange(void *pvInstance,
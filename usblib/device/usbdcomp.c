@@ -23,11 +23,13 @@
 //****************************************************************************
 
 #include "inc/hw_memmap.h"
+#include "inc/hw_sysctl.h"
 #include "inc/hw_types.h"
 #include "driverlib/debug.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/rom.h"
 #include "driverlib/rom_map.h"
+#include "driverlib/udma.h"
 #include "driverlib/usb.h"
 #include "usblib/usblib.h"
 #include "usblib/usb-ids.h"
@@ -125,6 +127,16 @@ static const unsigned char g_pCompConfigDescriptor[] =
 //****************************************************************************
 #define INVALID_DEVICE_INDEX 0xFFFFFFFF
 
+//****************************************************************************
+//
+// The number of uDMA channels used by the USB controller and a mask of these
+// channels in the uDMA interrupt status.  Endpoints 1 to 3 each have a receive
+// channel followed by a transmit channel, starting at channel 0.
+//
+//****************************************************************************
+#define NUM_USB_DMA_CHANNELS    6
+#define USB_DMA_CHANNEL_MASK    ((1 << NUM_USB_DMA_CHANNELS) - 1)
+
 //*****************************************************************************
 //
 // Macros to convert between USB controller base address and an index.  These
@@ -696,9 +708,10 @@ DataReceived(void *pvInstance, unsigned long ulInfo)
 static void
 HandleEndpoints(void *pvInstance, unsigned long ulStatus)
 {
-    unsigned long ulIdx;
+    unsigned long ulIdx, ulCall, ulDMAStatus;
     const tDeviceInfo *pDeviceInfo;
     tUSBDCompositeDevice *psDevice;
+    tCompositeInstance *psInst;
 
     ASSERT(pvInstance != 0);
 
@@ -706,16 +719,61 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
     // Create the device instance pointer.
     //
     psDevice = (tUSBDCompositeDevice *)pvInstance;
+    psInst = psDevice->psPrivateData;
 
     //
-    // Call each of the endpoint handlers.  This may seem odd since we should
-    // only call the handler whose endpoint needs service.  Unfortunately, if
-    // the device class driver is using uDMA, we have no way of knowing which
-    // handler to call (since ulStatus will be 0).  Since the handlers are
-    // set up to ignore any callback that isn't for them, this is safe.
+    // Find the devices that own the endpoints needing service.  Endpoint 0
+    // is handled by the device stack.
     //
-    for(ulIdx = 0; ulIdx < psDevice->ulNumDevices; ulIdx++)
+    ulCall = 0;
+    for(ulIdx = 1; ulIdx < USBLIB_NUM_EP; ulIdx++)
+    {
+        if(ulStatus & (1 << ulIdx))
+        {
+            ulCall |= psInst->pulINOwners[ulIdx];
+        }
+
+        if(ulStatus & (0x10000 << ulIdx))
+        {
+            ulCall |= psInst->pulOUTOwners[ulIdx];
+        }
+    }
+
+    //
+    // A uDMA transfer that has completed also causes this interrupt but
+    // leaves no trace in ulStatus, so use the uDMA channel interrupt status
+    // to find the devices that own the channels that have finished.  No
+    // transfers can have been made if the uDMA controller is not clocked, in
+    // which case it must not be accessed.
+    //
+    if(HWREG(SYSCTL_RCGC2) & SYSCTL_RCGC2_UDMA)
+    {
+        ulDMAStatus = MAP_uDMAIntStatus() & USB_DMA_CHANNEL_MASK;
+
+        if(ulDMAStatus)
+        {
+            MAP_uDMAIntClear(ulDMAStatus);
+
+            for(ulIdx = 0; ulIdx < NUM_USB_DMA_CHANNELS; ulIdx++)
+            {
+                if(ulDMAStatus & (1 << ulIdx))
+                {
+                    ulCall |= psInst->pulDMAOwners[ulIdx];
+                }
+            }
+        }
+    }
+
+    //
+    // Call the endpoint handler of each of these devices once.
+    //
+    for(ulIdx = 0; ulCall; ulIdx++, ulCall >>= 1)
     {
+        if(!(ulCall & 1))
+        {
+            continue;
+        }
+
         pDeviceInfo = psDevice->psDevices[ulIdx].psDevice;
 
         if(pDeviceInfo->sCallbacks.pfnEndpointHandler)
@@ -1059,6 +1117,15 @@ BuildCompositeDescriptor(tUSBDCompositeDevice *psCompDevice)
     ulOffset = 0;
     ulFixINT = 0;
 
+    //
+    // No endpoints are owned by any device yet.
+    //
+    for(ulIdx = 0; ulIdx < USBLIB_NUM_EP; ulIdx++)
+    {
+        psCompDevice->psPrivateData->pulINOwners[ulIdx] = 0;
+        psCompDevice->psPrivateData->pulOUTOwners[ulIdx] = 0;
+    }
+
     //
     // This puts the first section pointer in the first entry in the list
     // of sections.
@@ -1276,6 +1343,9 @@ BuildCompositeDescriptor(tUSBDCompositeDevice *psCompDevice)
 
                             psEndpoint->bEndpointAddress = ulFixINT |
                                                            USB_RTYPE_DIR_IN;
+
+                            psCompDevice->psPrivateData->pulINOwners[ulFixINT]
+                                |= 1 << ulDev;
                         }
                         else
                         {
@@ -1287,6 +1357,9 @@ BuildCompositeDescriptor(tUSBDCompositeDevice *psCompDevice)
                                               psEndpoint->bEndpointAddress,
                                               ucINEndpoint);
 
+                            psCompDevice->psPrivateData->pulINOwners[
+                                ucINEndpoint] |= 1 << ulDev;
+
                             psEndpoint->bEndpointAddress = ucINEndpoint++ |
                                                            USB_RTYPE_DIR_IN;
                         }
@@ -1300,6 +1373,10 @@ BuildCompositeDescriptor(tUSBDCompositeDevice *psCompDevice)
                         CompositeEPChange(&psCompDevice->psDevices[ulDev],
                                           psEndpoint->bEndpointAddress,
                                           ucOUTEndpoint);
+
+                        psCompDevice->psPrivateData->pulOUTOwners[
+                            ucOUTEndpoint] |= 1 << ulDev;
+
                         psEndpoint->bEndpointAddress = ucOUTEndpoint++;
                     }
                 }
@@ -1350,6 +1427,17 @@ BuildCompositeDescriptor(tUSBDCompositeDevice *psCompDevice)
     psCompDevice->psPrivateData->sConfigDescriptor.wTotalLength =
        usTotalLength;
 
+    //
+    // Each of the first few endpoints has a fixed pair of uDMA channels, so
+    // the owners of those channels follow from the endpoint owners.
+    //
+    for(ulIdx = 0; ulIdx < NUM_USB_DMA_CHANNELS; ulIdx += 2)
+    {
+        psCompDevice->psPrivateData->pulDMAOwners[ulIdx] =
+            psCompDevice->psPrivateData->pulOUTOwners[(ulIdx / 2) + 1];
+        psCompDevice->psPrivateData->pulDMAOwners[ulIdx + 1] =
+            psCompDevice->psPrivateData->pulINOwners[(ulIdx / 2) + 1];
+    }
 
     return(0);
 }
@@ -1403,6 +1491,7 @@ USBDCompositeInit(unsigned long ulIndex, tUSBDCompositeDevice *psDevice,
     ASSERT(psDevice);
     ASSERT(psDevice->ppStringDescriptors);
     ASSERT(psDevice->psPrivateData);
+    ASSERT(psDevice->ulNumDevices <= 32);
 
     //
     // Initialize the work space in the passed instance structure.
@@ -133,6 +133,21 @@ typedef struct
     // class which is currently transferring data on EP0.
     //
     unsigned long ulEP0Owner;
+
+    //
+    // The devices that own each IN and OUT endpoint, indexed by endpoint
+    // number.  Each entry has bit n set if device n uses the endpoint.  More
+    // than one device may share the fixed interrupt endpoint of a composite
+    // serial device.
+    //
+    unsigned long pulINOwners[USBLIB_NUM_EP];
+    unsigned long pulOUTOwners[USBLIB_NUM_EP];
+
+    //
+    // The devices that own each of the uDMA channels used by the USB
+    // controller, in the same form and indexed by uDMA channel number.
+    //
+    unsigned long pulDMAOwners[6];
 }
 tCompositeInstance;
 
@@ -220,7 +235,8 @@ typedef struct
     unsigned long ulNumStringDescriptors;
 
     //
-    //! The number of devices in the psDevices array.
+    //! The number of devices in the psDevices array.  This must be no more
+    //! than 32.
     //
     unsigned long ulNumDevices;
 
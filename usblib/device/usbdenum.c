@@ -64,6 +64,9 @@ static void USBDSetInterface(void *pvInstance, tUSBRequest *pUSBRequest);
 static void USBDSyncFrame(void *pvInstance, tUSBRequest *pUSBRequest);
 static void USBDEP0StateTx(unsigned long ulIndex);
 static void USBDEP0StateTxConfig(unsigned long ulIndex);
+static void USBDDescCacheBuild(tDeviceInstance *psDevInst);
+static const tDescCacheEntry *USBDDescCacheFind(tDeviceInstance *psDevInst,
+                                                tUSBRequest *pUSBRequest);
 static long USBDStringIndexFromRequest(unsigned short usLang,
                                        unsigned short usIndex);
 
@@ -285,6 +288,12 @@ USBDCDInit(unsigned long ulIndex, tDeviceInfo *psDevice)
     g_psUSBDevice[0].pvInstance = psDevice->pvInstance;
     g_psUSBDevice[0].eEP0State = USB_STATE_IDLE;
 
+    //
+    // Flatten the descriptors into the cache if the application has given
+    // us memory for one.
+    //
+    USBDDescCacheBuild(&g_psUSBDevice[0]);
+
     //
     // Default to device mode if no mode was set.
     //
@@ -456,6 +465,7 @@ USBDCDTerm(unsigned long ulIndex)
 
     g_psUSBDevice[0].psInfo = (tDeviceInfo *)0;
     g_psUSBDevice[0].pvInstance = 0;
+    g_psUSBDevice[0].psDescCache = 0;
 
     MAP_USBIntDisableControl(USB0_BASE, USB_INTCTRL_ALL);
     MAP_USBIntDisableEndpoint(USB0_BASE, USB_INTEP_ALL);
@@ -619,6 +629,105 @@ USBDCDSetDefaultConfiguration(unsigned long ulIndex,
     g_psUSBDevice[0].ulDefaultConfiguration = ulDefaultConfig;
 }
 
+//*****************************************************************************
+//
+//! Provides memory in which the device's descriptors are cached.
+//!
+//! \param ulIndex is the index of the USB controller.
+//! \param pvCache is a word aligned block of memory to hold the cache, or 0
+//! to stop caching descriptors.
+//! \param ulSize is the size of the memory pointed to by \e pvCache in bytes.
+//!
+//! By default, every GET_DESCRIPTOR request for a configuration descriptor
+//! is answered by walking the sections of the configuration and the string
+//! descriptor to return is found by searching the language table.  When a
+//! cache is provided, USBDCDInit() flattens the device descriptor, each
+//! configuration descriptor and the string table into an index table and a
+//! contiguous image in \e pvCache, and GET_DESCRIPTOR requests for these
+//! descriptors are then answered directly from the cache.  This shortens
+//! enumeration, which helps devices that are power cycled often.
+//!
+//! This function must be called before the class initialization function
+//! (USBDBulkInit(), USBDCompositeInit() and so on) since the cache is built
+//! when the class calls USBDCDInit().  If it is called while a device is
+//! initialized, the cache is rebuilt immediately.  The memory must remain
+//! allocated until USBDCDTerm() is called or caching is turned off.  The
+//! size required is given by USBDCD_DESC_CACHE_SIZE() or, once the device
+//! has been initialized, by USBDCDDescCacheSizeGet().  If \e ulSize is too
+//! small, descriptors are not cached and requests are handled as if no
+//! cache had been provided.
+//!
+//! Only the configuration descriptors are copied into the cache.  The
+//! device and string descriptors are already contiguous so the index table
+//! points at the application's copies.  None of the descriptors may be
+//! changed while they are cached.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDCDDescCacheSet(unsigned long ulIndex, void *pvCache, unsigned long ulSize)
+{
+    ASSERT(ulIndex == 0);
+    ASSERT(((unsigned long)pvCache & 3) == 0);
+
+    g_psUSBDevice[0].pvDescCache = pvCache;
+    g_psUSBDevice[0].ulDescCacheSize = pvCache ? ulSize : 0;
+    g_psUSBDevice[0].psDescCache = 0;
+
+    //
+    // If the device is already running, build the cache now.
+    //
+    if(g_psUSBDevice[0].psInfo)
+    {
+        USBDDescCacheBuild(&g_psUSBDevice[0]);
+    }
+}
+
+//*****************************************************************************
+//
+//! Returns the size of the descriptor cache needed by the current device.
+//!
+//! \param ulIndex is the index of the USB controller.
+//!
+//! This function returns the number of bytes of memory that must be passed
+//! to USBDCDDescCacheSet() to cache all of the descriptors of the device
+//! that was last passed to USBDCDInit().  It is intended to help size the
+//! cache during development.
+//!
+//! \return Returns the size of the cache in bytes, or 0 if no device has
+//! been initialized.
+//
+//*****************************************************************************
+unsigned long
+USBDCDDescCacheSizeGet(unsigned long ulIndex)
+{
+    tDeviceInfo *psDevice;
+    const tDeviceDescriptor *psDeviceDesc;
+    unsigned long ulConfigBytes, ulIdx;
+
+    ASSERT(ulIndex == 0);
+
+    psDevice = g_psUSBDevice[0].psInfo;
+    if(!psDevice)
+    {
+        return(0);
+    }
+
+    psDeviceDesc = (const tDeviceDescriptor *)psDevice->pDeviceDescriptor;
+
+    ulConfigBytes = 0;
+    for(ulIdx = 0; ulIdx < psDeviceDesc->bNumConfigurations; ulIdx++)
+    {
+        ulConfigBytes +=
+            USBDCDConfigDescGetSize(psDevice->ppConfigDescriptors[ulIdx]);
+    }
+
+    return(USBDCD_DESC_CACHE_SIZE(psDeviceDesc->bNumConfigurations,
+                                  psDevice->ulNumStringDescriptors,
+                                  ulConfigBytes));
+}
+
 //*****************************************************************************
 //
 //! This function generates a stall condition on endpoint zero.
@@ -1673,6 +1782,7 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
     tBoolean bConfig;
     tDeviceInstance *psUSBControl;
     tDeviceInfo *psDevice;
+    const tDescCacheEntry *psEntry;
 
     ASSERT(pUSBRequest != 0);
     ASSERT(pvInstance != 0);
@@ -1689,6 +1799,35 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
     //
     MAP_USBDevEndpointDataAck(USB0_BASE, USB_EP_0, false);
 
+    //
+    // If the descriptors are cached then device, configuration and string
+    // descriptors can be sent directly from the cache.
+    //
+    if(psUSBControl->psDescCache &&
+       (((pUSBRequest->wValue >> 8) == USB_DTYPE_DEVICE) ||
+        ((pUSBRequest->wValue >> 8) == USB_DTYPE_CONFIGURATION) ||
+        ((pUSBRequest->wValue >> 8) == USB_DTYPE_STRING)))
+    {
+        psEntry = USBDDescCacheFind(psUSBControl, pUSBRequest);
+
+        if(!psEntry)
+        {
+            USBDCDStallEP0(0);
+            return;
+        }
+
+        psUSBControl->pEP0Data = (unsigned char *)psEntry->pucData;
+        psUSBControl->ulEP0DataRemain = psEntry->ulSize;
+
+        if(psUSBControl->ulEP0DataRemain > pUSBRequest->wLength)
+        {
+            psUSBControl->ulEP0DataRemain = pUSBRequest->wLength;
+        }
+
+        USBDEP0StateTx(0);
+        return;
+    }
+
     //
     // Assume we are not sending the configuration descriptor until we
     // determine otherwise.
@@ -1880,6 +2019,206 @@ USBDGetDescriptor(void *pvInstance, tUSBRequest *pUSBRequest)
     }
 }
 
+//*****************************************************************************
+//
+// This internal function builds the descriptor cache for a device.
+//
+// \param psDevInst is the device instance whose descriptors are cached.
+//
+// The cache starts with an index table holding the device descriptor, each
+// configuration descriptor and each string descriptor in that order, so any
+// of them can be found from the request by indexing.  The configuration
+// descriptors are copied section by section into the image that follows the
+// table and their wTotalLength fields are filled in, so each can be sent
+// with the same code as any other descriptor.  The string table layout
+// checks made by USBDStringIndexFromRequest() are made once here.
+//
+// If no cache memory was provided or it is too small, the cache is left
+// unused.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+USBDDescCacheBuild(tDeviceInstance *psDevInst)
+{
+    tDeviceInfo *psDevice;
+    const tDeviceDescriptor *psDeviceDesc;
+    const tConfigHeader *psConfig;
+    tDescCacheEntry *psEntry;
+    const unsigned char *pucData;
+    unsigned char *pucImage;
+    unsigned long ulIdx, ulSection, ulSize, ulNumConfigs, ulNumStrings;
+
+    psDevInst->psDescCache = 0;
+
+    if(!psDevInst->pvDescCache ||
+       (USBDCDDescCacheSizeGet(0) > psDevInst->ulDescCacheSize))
+    {
+        return;
+    }
+
+    psDevice = psDevInst->psInfo;
+    psDeviceDesc = (const tDeviceDescriptor *)psDevice->pDeviceDescriptor;
+    ulNumConfigs = psDeviceDesc->bNumConfigurations;
+    ulNumStrings = psDevice->ulNumStringDescriptors;
+
+    psEntry = (tDescCacheEntry *)psDevInst->pvDescCache;
+    pucImage = (unsigned char *)(psEntry + 1 + ulNumConfigs + ulNumStrings);
+
+    //
+    // The device descriptor's size is in its first byte.
+    //
+    psEntry->pucData = psDevice->pDeviceDescriptor;
+    psEntry->ulSize = psDevice->pDeviceDescriptor[0];
+    psEntry++;
+
+    //
+    // Flatten each configuration descriptor into the image.
+    //
+    for(ulIdx = 0; ulIdx < ulNumConfigs; ulIdx++)
+    {
+        psConfig = psDevice->ppConfigDescriptors[ulIdx];
+
+        psEntry->pucData = pucImage;
+        psEntry->ulSize = 0;
+
+        for(ulSection = 0; ulSection < psConfig->ucNumSections; ulSection++)
+        {
+            pucData = psConfig->psSections[ulSection]->pucData;
+
+            for(ulSize = 0; ulSize < psConfig->psSections[ulSection]->usSize;
+                ulSize++)
+            {
+                *pucImage++ = pucData[ulSize];
+            }
+
+            psEntry->ulSize += ulSize;
+        }
+
+        //
+        // Fill in the wTotalLength field of the configuration descriptor.
+        //
+        ((unsigned char *)psEntry->pucData)[2] = psEntry->ulSize & 0xff;
+        ((unsigned char *)psEntry->pucData)[3] = (psEntry->ulSize >> 8) & 0xff;
+        psEntry++;
+    }
+
+    //
+    // The string descriptors' sizes are in their first bytes.
+    //
+    for(ulIdx = 0; ulIdx < ulNumStrings; ulIdx++)
+    {
+        psEntry->pucData = psDevice->ppStringDescriptors[ulIdx];
+        psEntry->ulSize = psDevice->ppStringDescriptors[ulIdx][0];
+        psEntry++;
+    }
+
+    //
+    // Work out how the string table is divided between the languages listed
+    // in string descriptor 0.  The table must hold the same number of strings
+    // for each language, otherwise only string descriptor 0 can be returned.
+    //
+    psDevInst->ulDescCacheLangs = 0;
+    psDevInst->ulDescCacheStrings = 0;
+
+    if(ulNumStrings)
+    {
+        psDevInst->ulDescCacheLangs =
+            (psDevice->ppStringDescriptors[0][0] - 2) / 2;
+
+        if(psDevInst->ulDescCacheLangs &&
+           !((ulNumStrings - 1) % psDevInst->ulDescCacheLangs))
+        {
+            psDevInst->ulDescCacheStrings =
+                (ulNumStrings - 1) / psDevInst->ulDescCacheLangs;
+        }
+    }
+
+    psDevInst->ulDescCacheConfigs = ulNumConfigs;
+    psDevInst->psDescCache = (const tDescCacheEntry *)psDevInst->pvDescCache;
+}
+
+//*****************************************************************************
+//
+// This internal function finds the answer to a GET_DESCRIPTOR request in the
+// descriptor cache.
+//
+// \param psDevInst is the device instance.
+// \param pUSBRequest holds the request.
+//
+// \return Returns the cache entry for the requested descriptor or 0 if the
+// request does not name a valid descriptor.
+//
+//*****************************************************************************
+static const tDescCacheEntry *
+USBDDescCacheFind(tDeviceInstance *psDevInst, tUSBRequest *pUSBRequest)
+{
+    const tString0Descriptor *pLang;
+    unsigned long ulIndex, ulLang;
+
+    ulIndex = pUSBRequest->wValue & 0xff;
+
+    switch(pUSBRequest->wValue >> 8)
+    {
+        case USB_DTYPE_DEVICE:
+        {
+            return(psDevInst->psDescCache);
+        }
+
+        case USB_DTYPE_CONFIGURATION:
+        {
+            if(ulIndex >= psDevInst->ulDescCacheConfigs)
+            {
+                return(0);
+            }
+
+            return(psDevInst->psDescCache + 1 + ulIndex);
+        }
+
+        case USB_DTYPE_STRING:
+        {
+            //
+            // String descriptor 0 holds the language IDs and is returned
+            // whatever language is asked for.
+            //
+            if((ulIndex == 0) && psDevInst->ulDescCacheLangs)
+            {
+                return(psDevInst->psDescCache + 1 +
+                       psDevInst->ulDescCacheConfigs);
+            }
+
+            //
+            // Find the group of strings for the requested language.
+            //
+            pLang = (const tString0Descriptor *)
+                    psDevInst->psInfo->ppStringDescriptors[0];
+
+            for(ulLang = 0; ulLang < psDevInst->ulDescCacheLangs; ulLang++)
+            {
+                if(pLang->wLANGID[ulLang] == pUSBRequest->wIndex)
+                {
+                    break;
+                }
+            }
+
+            if((ulIndex == 0) || (ulIndex > psDevInst->ulDescCacheStrings) ||
+               (ulLang == psDevInst->ulDescCacheLangs))
+            {
+                return(0);
+            }
+
+            return(psDevInst->psDescCache + 1 + psDevInst->ulDescCacheConfigs +
+                   (ulLang * psDevInst->ulDescCacheStrings) + ulIndex);
+        }
+
+        default:
+        {
+            return(0);
+        }
+    }
+}
+
 //*****************************************************************************
 //
 // This function determines which string descriptor to send to satisfy a
@@ -2863,6 +3202,11 @@ USBDeviceIntHandlerInternal(unsigned long ulIndex, unsigned long ulStatus)
         //
         USBDeviceResumeTickHandler(&g_psUSBDevice[0]);
 
+        //
+        // Call any handlers that need to run on every frame.
+        //
+        InternalUSBFrameTick();
+
         //
         // Have we counted enough SOFs to allow us to call the tick function?
         //
@@ -156,6 +156,19 @@ struct tDeviceInfo
 //*****************************************************************************
 extern const tFIFOConfig g_sUSBDefaultFIFOConfig;
 
+//*****************************************************************************
+//
+//! This macro returns the number of bytes of memory that must be passed to
+//! USBDCDDescCacheSet() to cache the descriptors of a device with
+//! \e ulNumConfigs configurations whose descriptors total \e ulConfigBytes
+//! bytes (the sum of their <tt>wTotalLength</tt> fields) and with
+//! \e ulNumStrings entries in its string descriptor table.
+//
+//*****************************************************************************
+#define USBDCD_DESC_CACHE_SIZE(ulNumConfigs, ulNumStrings, ulConfigBytes)    \
+        ((sizeof(tDescCacheEntry) * (1 + (ulNumConfigs) + (ulNumStrings))) + \
+         (ulConfigBytes))
+
 //*****************************************************************************
 //
 // Public APIs offered by the USB library device control driver.
@@ -170,6 +183,9 @@ extern void USBDCDSendDataEP0(unsigned long ulIndex, unsigned char *pucData,
                               unsigned long ulSize);
 extern void USBDCDSetDefaultConfiguration(unsigned long ulIndex,
                                           unsigned long ulDefaultConfig);
+extern void USBDCDDescCacheSet(unsigned long ulIndex, void *pvCache,
+                               unsigned long ulSize);
+extern unsigned long USBDCDDescCacheSizeGet(unsigned long ulIndex);
 extern unsigned long USBDCDConfigDescGetSize(const tConfigHeader *psConfig);
 extern unsigned long USBDCDConfigDescGetNum(const tConfigHeader *psConfig,
                                             unsigned long ulType);
@@ -84,6 +84,27 @@ typedef enum
 }
 tEP0State;
 
+//*****************************************************************************
+//
+// An entry in the index table at the start of a descriptor cache.  It is
+// visible to applications only so that USBDCD_DESC_CACHE_SIZE() can size
+// the cache.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // The descriptor's data.
+    //
+    const unsigned char *pucData;
+
+    //
+    // The total size of the descriptor in bytes.
+    //
+    unsigned long ulSize;
+}
+tDescCacheEntry;
+
 typedef struct tDeviceInfo tDeviceInfo;
 typedef struct tDeviceInstance tDeviceInstance;
 
@@ -194,6 +215,30 @@ struct tDeviceInstance
     // number of milliseconds since the signaling was initiated.
     //
     unsigned char ucRemoteWakeupCount;
+
+    //
+    // The memory given to USBDCDDescCacheSet() for the descriptor cache and
+    // its size in bytes, or 0 if descriptors are not to be cached.
+    //
+    void *pvDescCache;
+    unsigned long ulDescCacheSize;
+
+    //
+    // The index table of the built descriptor cache, or 0 if the cache is
+    // not in use.  The table holds the device descriptor, then each
+    // configuration descriptor, then each string descriptor.
+    //
+    const tDescCacheEntry *psDescCache;
+
+    //
+    // The number of configuration descriptors in the cache, the number of
+    // languages in string descriptor 0 and the number of strings for each
+    // language, which is 0 if the string table is not evenly divided between
+    // the languages.
+    //
+    unsigned long ulDescCacheConfigs;
+    unsigned long ulDescCacheLangs;
+    unsigned long ulDescCacheStrings;
 };
 
 extern tDeviceInstance g_psUSBDevice[];
@@ -211,6 +256,106 @@ extern tBoolean USBDeviceConfigAlternate(tDeviceInstance *psDevInst,
                                          unsigned char ucInterfaceNum,
                                          unsigned char ucAlternateSetting);
 
+//*****************************************************************************
+//
+// The states of a multi-packet uDMA transfer on a bulk endpoint.
+//
+//*****************************************************************************
+typedef enum
+{
+    //
+    // No transfer is in progress.
+    //
+    USBD_XFER_IDLE,
+
+    //
+    // The uDMA controller is moving whole packets.
+    //
+    USBD_XFER_DMA,
+
+    //
+    // Waiting for the last packet moved by the uDMA controller to be sent
+    // before the final short or zero length packet is written.
+    //
+    USBD_XFER_WAIT_TAIL,
+
+    //
+    // Waiting for the final short or zero length packet to be sent.
+    //
+    USBD_XFER_TAIL
+}
+tUSBDXferState;
+
+//*****************************************************************************
+//
+// The state of a multi-packet uDMA transfer on a bulk endpoint.  Device
+// classes that offer a transfer API keep one of these for each direction in
+// their instance data and pass it to the functions in device/usbdxfer.c.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // The current state of the transfer.
+    //
+    volatile tUSBDXferState eState;
+
+    //
+    // The USB controller, endpoint and uDMA channel in use, the endpoint's
+    // maximum packet size and whether it is an IN endpoint.
+    //
+    unsigned long ulUSBBase;
+    unsigned char ucEndpoint;
+    unsigned char ucDMAChannel;
+    unsigned short usMaxPacket;
+    tBoolean bIn;
+
+    //
+    // The buffer and its size, the number of bytes that have been moved and
+    // the number in the uDMA transfer that is in progress.
+    //
+    unsigned char *pucData;
+    unsigned long ulSize;
+    unsigned long ulCount;
+    unsigned long ulChunk;
+
+    //
+    // For receive transfers, the number of frames without data after which a
+    // transfer that has received something is ended, or 0 to wait for a
+    // short packet or a full buffer.  ulIdleCount counts the frames since
+    // ulIdleMark bytes had been received.
+    //
+    unsigned long ulIdleFrames;
+    unsigned long ulIdleCount;
+    unsigned long ulIdleMark;
+}
+tUSBDXfer;
+
+//*****************************************************************************
+//
+// Multi-packet uDMA transfer functions provided by device/usbdxfer.c and
+// used by the bulk and CDC device classes.
+//
+//*****************************************************************************
+extern void InternalUSBDXferTxStart(tUSBDXfer *psXfer, unsigned long ulBase,
+                                    unsigned long ulEndpoint,
+                                    unsigned long ulMaxPacket,
+                                    unsigned char *pucData,
+                                    unsigned long ulLength);
+extern tBoolean InternalUSBDXferTxProcess(tUSBDXfer *psXfer,
+                                          unsigned long ulEPStatus);
+extern tBoolean InternalUSBDXferRxStart(tUSBDXfer *psXfer,
+                                        unsigned long ulBase,
+                                        unsigned long ulEndpoint,
+                                        unsigned long ulMaxPacket,
+                                        unsigned char *pucData,
+                                        unsigned long ulLength);
+extern tBoolean InternalUSBDXferRxProcess(tUSBDXfer *psXfer,
+                                          unsigned long ulEPStatus);
+extern tBoolean InternalUSBDXferRxFrame(tUSBDXfer *psXfer);
+extern tBoolean InternalUSBDXferDMADone(tUSBDXfer *psXfer);
+extern void InternalUSBDXferAbort(tUSBDXfer *psXfer);
+
 //*****************************************************************************
 //
 // Mark the end of the C bindings section for C++ compilers.
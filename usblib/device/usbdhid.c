@@ -368,7 +368,7 @@ SetDeferredOpFlag(volatile unsigned short *pusDeferredOp,
     //
     // Set the flag bit to 1 or 0 using a bitband access.
     //
-    HWREGBITH(pusDeferredOp, usBit) = bSet ? 1 : 0;
+    InternalUSBBitSetH(pusDeferredOp, usBit, bSet);
 }
 
 //*****************************************************************************
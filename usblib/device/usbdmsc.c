@@ -31,6 +31,7 @@
 #include "driverlib/usb.h"
 #include "driverlib/udma.h"
 #include "usblib/usblib.h"
+#include "usblib/usblibpriv.h"
 #include "usblib/usbmsc.h"
 #include "usblib/device/usbdevice.h"
 #include "usblib/device/usbdmsc.h"
@@ -49,6 +50,17 @@
 //*****************************************************************************
 #define USBD_FLAG_DMA_IN        0x00000001
 #define USBD_FLAG_DMA_OUT       0x00000002
+#define USBD_FLAG_FLUSH         0x00000004
+
+//*****************************************************************************
+//
+// The number of milliseconds that the host must leave the device idle after
+// a write before the media Flush() function is called.
+//
+//*****************************************************************************
+#ifndef USBDMSC_FLUSH_IDLE_MS
+#define USBDMSC_FLUSH_IDLE_MS   100
+#endif
 
 //*****************************************************************************
 //
@@ -92,7 +104,6 @@
 // These defines control the sizes of USB transfers for data and commands.
 //
 //*****************************************************************************
-#define MAX_TRANSFER_SIZE       512
 #define COMMAND_BUFFER_SIZE     64
 
 //*****************************************************************************
@@ -307,10 +318,15 @@ static void ConfigChangeHandler(void *pvInstance, unsigned long ulValue);
 static void HandleEndpoints(void *pvInstance, unsigned long ulStatus);
 static void HandleRequests(void *pvInstance, tUSBRequest *pUSBRequest);
 static void USBDSCSISendStatus(const tUSBDMSCDevice *psDevice);
+static unsigned long USBDSCSIReadBuffer(const tUSBDMSCDevice *psDevice,
+                                        unsigned long ulHalf);
+static void USBDSCSIStartIN(tMSCInstance *psInst);
+static void USBDSCSIStartOUT(tMSCInstance *psInst);
 unsigned long USBDSCSICommand(const tUSBDMSCDevice *psDevice,
                               tMSCCBW *pSCSICBW);
 static void HandleDevice(void *pvInstance, unsigned long ulRequest,
                          void *pvRequestData);
+static void MSCTickHandler(void *pvInstance, unsigned long ulTimemS);
 
 //*****************************************************************************
 //
@@ -491,6 +507,95 @@ USBDMSCMediaChange(void *pvInstance, tUSBDMSCMediaStatus eMediaStatus)
     psDevice->psPrivateData->eMediaStatus = eMediaStatus;
 }
 
+//*****************************************************************************
+//
+// This function reads the next run of blocks for a READ(10) command from the
+// media into one half of the instance's double buffer.  Up to
+// DEVICE_BUFFER_BLOCKS blocks are passed to the media BlockRead() function in
+// a single call.  The return value is the value returned by BlockRead().
+//
+//*****************************************************************************
+static unsigned long
+USBDSCSIReadBuffer(const tUSBDMSCDevice *psDevice, unsigned long ulHalf)
+{
+    tMSCInstance *psInst;
+    unsigned long ulBlocks;
+    unsigned long ulRead;
+
+    psInst = psDevice->psPrivateData;
+
+    //
+    // Read as many blocks as will fit in one half of the buffer.
+    //
+    ulBlocks = psInst->ulBlocksToQueue;
+    if(ulBlocks > DEVICE_BUFFER_BLOCKS)
+    {
+        ulBlocks = DEVICE_BUFFER_BLOCKS;
+    }
+
+    ulRead = psDevice->sMediaFunctions.BlockRead(psInst->pvMedia,
+                 (unsigned char *)psInst->pulBuffer[ulHalf],
+                 psInst->ulCurrentLBA, ulBlocks);
+
+    //
+    // Move on to the next run of logical blocks.
+    //
+    psInst->pucBufferBlocks[ulHalf] = (unsigned char)ulBlocks;
+    psInst->ulCurrentLBA += ulBlocks;
+    psInst->ulBlocksToQueue -= ulBlocks;
+
+    return(ulRead);
+}
+
+//*****************************************************************************
+//
+// This function starts the IN DMA transfer of the buffer half selected by
+// ucBufferDMA.  The half must already have been filled by
+// USBDSCSIReadBuffer().
+//
+//*****************************************************************************
+static void
+USBDSCSIStartIN(tMSCInstance *psInst)
+{
+    MAP_uDMAChannelTransferSet(psInst->ucINDMA,
+                               UDMA_MODE_BASIC,
+                               psInst->pulBuffer[psInst->ucBufferDMA],
+                               (void *)USBFIFOAddrGet(USB0_BASE,
+                                                      psInst->ucINEndpoint),
+                               ((psInst->pucBufferBlocks[psInst->ucBufferDMA] *
+                                 DEVICE_BLOCK_SIZE) >> 2));
+    MAP_uDMAChannelEnable(psInst->ucINDMA);
+}
+
+//*****************************************************************************
+//
+// This function starts the OUT DMA transfer into the buffer half selected by
+// ucBufferDMA.  Up to DEVICE_BUFFER_BLOCKS of the blocks still expected from
+// the host are received into the half.
+//
+//*****************************************************************************
+static void
+USBDSCSIStartOUT(tMSCInstance *psInst)
+{
+    unsigned long ulBlocks;
+
+    ulBlocks = psInst->ulBlocksToQueue;
+    if(ulBlocks > DEVICE_BUFFER_BLOCKS)
+    {
+        ulBlocks = DEVICE_BUFFER_BLOCKS;
+    }
+    psInst->pucBufferBlocks[psInst->ucBufferDMA] = (unsigned char)ulBlocks;
+    psInst->ulBlocksToQueue -= ulBlocks;
+
+    MAP_uDMAChannelTransferSet(psInst->ucOUTDMA,
+                               UDMA_MODE_BASIC,
+                               (void *)USBFIFOAddrGet(USB0_BASE,
+                                                      psInst->ucOUTEndpoint),
+                               psInst->pulBuffer[psInst->ucBufferDMA],
+                               ((ulBlocks * DEVICE_BLOCK_SIZE) >> 2));
+    MAP_uDMAChannelEnable(psInst->ucOUTDMA);
+}
+
 //*****************************************************************************
 //
 // This function is called to handle the interrupts on the Bulk endpoints for
@@ -505,6 +610,7 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
     tMSCCBW *pSCSICBW;
     unsigned long ulEPStatus;
     unsigned long ulSize;
+    unsigned long ulHalf;
 
     ASSERT(pvInstance != 0);
 
@@ -540,9 +646,12 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
             case STATE_SCSI_SEND_BLOCKS:
             {
                 //
-                // Decrement the number of bytes left to send.
+                // Decrement the number of bytes left to send by the size of
+                // the buffer half that has just been sent.
                 //
-                psInst->ulBytesToTransfer -= MAX_TRANSFER_SIZE;
+                psInst->ulBytesToTransfer -=
+                    (psInst->pucBufferBlocks[psInst->ucBufferDMA] *
+                     DEVICE_BLOCK_SIZE);
 
                 //
                 // If we are done then move on to the status phase.
@@ -585,30 +694,21 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
                 }
 
                 //
-                // Move on to the next Logical Block.
+                // The other half of the buffer was filled while this one was
+                // being sent, so switch to it and start sending it now.
                 //
-                psInst->ulCurrentLBA++;
+                psInst->ucBufferDMA ^= 1;
+                USBDSCSIStartIN(psInst);
 
                 //
-                // Read the new data and send it out.
+                // While that half is sent, refill the half that has just been
+                // freed with the next blocks, if any are left to read.
                 //
-                if(psDevice->sMediaFunctions.BlockRead(psInst->pvMedia,
-                        (unsigned char *)psInst->pulBuffer,
-                        psInst->ulCurrentLBA, 1) == 0)
+                if(psInst->ulBlocksToQueue)
                 {
+                    USBDSCSIReadBuffer(psDevice, psInst->ucBufferDMA ^ 1);
                 }
 
-                //
-                // Reset the DMA transfer and enable the DMA channel.
-                //
-                MAP_uDMAChannelTransferSet(psInst->ucINDMA,
-                                           UDMA_MODE_BASIC,
-                                           psInst->pulBuffer,
-                                           (void *)USBFIFOAddrGet(USB0_BASE,
-                                               psInst->ucINEndpoint),
-                                           (MAX_TRANSFER_SIZE >> 2));
-                MAP_uDMAChannelEnable(psInst->ucINDMA);
-
                 break;
             }
 
@@ -667,21 +767,35 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
             case STATE_SCSI_RECEIVE_BLOCKS:
             {
                 //
-                // Update the current status for the buffer.
+                // Remember which half of the buffer has just been filled.
                 //
-                psInst->ulBytesToTransfer -= MAX_TRANSFER_SIZE;
+                ulHalf = psInst->ucBufferDMA;
+
+                //
+                // If more blocks are expected then start receiving them into
+                // the other half of the buffer before writing this one, so
+                // that the host is not held off while the media is busy.
+                //
+                if(psInst->ulBlocksToQueue)
+                {
+                    psInst->ucBufferDMA ^= 1;
+                    USBDSCSIStartOUT(psInst);
+                }
 
                 //
                 // Write the new data.
                 //
                 psDevice->sMediaFunctions.BlockWrite(psInst->pvMedia,
-                    (unsigned char *)psInst->pulBuffer,
-                    psInst->ulCurrentLBA, 1);
+                    (unsigned char *)psInst->pulBuffer[ulHalf],
+                    psInst->ulCurrentLBA, psInst->pucBufferBlocks[ulHalf]);
 
                 //
-                // Move on to the next Logical Block.
+                // Move on to the next run of logical blocks and update the
+                // current status for the buffer.
                 //
-                psInst->ulCurrentLBA++;
+                psInst->ulCurrentLBA += psInst->pucBufferBlocks[ulHalf];
+                psInst->ulBytesToTransfer -=
+                    (psInst->pucBufferBlocks[ulHalf] * DEVICE_BLOCK_SIZE);
 
                 //
                 // Check if all bytes have been received.
@@ -696,9 +810,12 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
                     g_sSCSICSW.dCSWDataResidue = 0;
 
                     //
-                    // DMA has completed for the OUT endpoint.
+                    // DMA has completed for the OUT endpoint and the media
+                    // should be flushed if the host now goes idle.
                     //
                     psInst->ulFlags &= ~USBD_FLAG_DMA_OUT;
+                    psInst->ulFlags |= USBD_FLAG_FLUSH;
+                    psInst->ulIdleTime = 0;
 
                     //
                     // Indicate success and no extra data coming.
@@ -721,23 +838,6 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
                                                    0);
                     }
                 }
-                else
-                {
-                    //
-                    // Configure and enable DMA for the OUT transfer.
-                    //
-                    MAP_uDMAChannelTransferSet(psInst->ucOUTDMA,
-                                               UDMA_MODE_BASIC,
-                                               (void *)USBFIFOAddrGet(USB0_BASE,
-                                                   psInst->ucOUTEndpoint),
-                                               psInst->pulBuffer,
-                                               (MAX_TRANSFER_SIZE >> 2));
-
-                    //
-                    // Start the DMA transfer.
-                    //
-                    MAP_uDMAChannelEnable(psInst->ucOUTDMA);
-                }
 
                 break;
             }
@@ -777,6 +877,11 @@ HandleEndpoints(void *pvInstance, unsigned long ulStatus)
                     g_sSCSICSW.dCSWDataResidue = 0;
                     g_sSCSICSW.bCSWStatus = 0;
 
+                    //
+                    // The host is not idle so restart the flush timer.
+                    //
+                    psInst->ulIdleTime = 0;
+
                     USBDSCSICommand(psDevice, pSCSICBW);
                 }
                 else
@@ -900,6 +1005,63 @@ HandleDevice(void *pvInstance, unsigned long ulRequest, void *pvRequestData)
     }
 }
 
+//*****************************************************************************
+//
+// This function is called periodically and provides us with a time reference
+// and method of flushing the media once the host stops writing to it.
+//
+// \param pvInstance is the instance data for this request.
+// \param ulTimemS is the elapsed time in milliseconds since the last call
+// to this function.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+MSCTickHandler(void *pvInstance, unsigned long ulTimemS)
+{
+    const tUSBDMSCDevice *psDevice;
+    tMSCInstance *psInst;
+
+    ASSERT(pvInstance != 0);
+
+    //
+    // Create the instance pointer.
+    //
+    psDevice = (const tUSBDMSCDevice *)pvInstance;
+
+    //
+    // Get our instance data pointer.
+    //
+    psInst = psDevice->psPrivateData;
+
+    //
+    // Only count idle time if there is written data to flush and no command
+    // is in progress.
+    //
+    if(!(psInst->ulFlags & USBD_FLAG_FLUSH) ||
+       (psInst->ucSCSIState != STATE_SCSI_IDLE))
+    {
+        return;
+    }
+
+    psInst->ulIdleTime += ulTimemS;
+
+    //
+    // Once the host has been idle for long enough, have the media write out
+    // anything it is holding.
+    //
+    if(psInst->ulIdleTime >= USBDMSC_FLUSH_IDLE_MS)
+    {
+        psInst->ulFlags &= ~USBD_FLAG_FLUSH;
+
+        if(psInst->pvMedia != 0)
+        {
+            psDevice->sMediaFunctions.Flush(psInst->pvMedia);
+        }
+    }
+}
+
 //*****************************************************************************
 //
 // This function is called by the USB device stack whenever the device is
@@ -1121,6 +1283,8 @@ USBDMSCCompositeInit(unsigned long ulIndex, const tUSBDMSCDevice *psDevice)
     // Set the initial SCSI state to idle.
     //
     psInst->ucSCSIState = STATE_SCSI_IDLE;
+    psInst->ulFlags = 0;
+    psInst->ulIdleTime = 0;
 
     //
     // Fix up the device descriptor with the client-supplied values.
@@ -1183,6 +1347,21 @@ USBDMSCCompositeInit(unsigned long ulIndex, const tUSBDMSCDevice *psDevice)
     //
     MAP_SysCtlUSBPLLEnable();
 
+    //
+    // If the media holds back writes then register a tick handler so that
+    // they can be flushed once the host goes idle.
+    //
+    if(psDevice->sMediaFunctions.Flush)
+    {
+        //
+        // Initialize the USB tick module, this will prevent it from being
+        // initialized later in the call to USBDCDInit();
+        //
+        InternalUSBTickInit();
+
+        InternalUSBRegisterTickHandler(MSCTickHandler, (void *)psDevice);
+    }
+
     //
     // Return the pointer to the instance indicating that everything went well.
     //
@@ -1642,11 +1821,22 @@ USBDSCSIRead10(const tUSBDMSCDevice *psDevice, tMSCCBW *pSCSICBW)
         usNumBlocks = (pSCSICBW->CBWCB[7] << 8) | pSCSICBW->CBWCB[8];
 
         //
-        // Read the next logical block from the storage device.
+        // A transfer length of zero moves no data and the status is sent by
+        // USBDSCSICommand(), so there is nothing more to do.
+        //
+        if(usNumBlocks == 0)
+        {
+            return;
+        }
+
+        //
+        // Read the first run of logical blocks from the storage device into
+        // the first half of the buffer.
         //
-        if(psDevice->sMediaFunctions.BlockRead(psInst->pvMedia,
-               (unsigned char *)psInst->pulBuffer,
-               psInst->ulCurrentLBA, 1) == 0)
+        psInst->ulBlocksToQueue = usNumBlocks;
+        psInst->ucBufferDMA = 0;
+
+        if(USBDSCSIReadBuffer(psDevice, 0) == 0)
         {
             psInst->pvMedia = 0;
             psDevice->sMediaFunctions.Close(0);
@@ -1664,16 +1854,6 @@ USBDSCSIRead10(const tUSBDMSCDevice *psDevice, tMSCCBW *pSCSICBW)
         MAP_USBEndpointDMAEnable(USB0_BASE, psInst->ucINEndpoint,
                                  USB_EP_DEV_IN);
 
-        //
-        // Configure and DMA for the IN transfer.
-        //
-        MAP_uDMAChannelTransferSet(psInst->ucINDMA,
-                                   UDMA_MODE_BASIC,
-                                   psInst->pulBuffer,
-                                   (void *)USBFIFOAddrGet(USB0_BASE,
-                                                          psInst->ucINEndpoint),
-                                   (MAX_TRANSFER_SIZE >> 2));
-
         //
         // Remember that a DMA is in progress.
         //
@@ -1685,9 +1865,9 @@ USBDSCSIRead10(const tUSBDMSCDevice *psDevice, tMSCCBW *pSCSICBW)
         psInst->ulBytesToTransfer = (DEVICE_BLOCK_SIZE * usNumBlocks);
 
         //
-        // Start the DMA transfer.
+        // Start the DMA transfer of the first half of the buffer.
         //
-        MAP_uDMAChannelEnable(psInst->ucINDMA);
+        USBDSCSIStartIN(psInst);
 
         //
         // Move on and start sending blocks.
@@ -1698,6 +1878,15 @@ USBDSCSIRead10(const tUSBDMSCDevice *psDevice, tMSCCBW *pSCSICBW)
         {
             psDevice->pfnEventCallback(0, USBD_MSC_EVENT_READING, 0, 0);
         }
+
+        //
+        // Read ahead into the second half of the buffer while the first half
+        // is being sent.
+        //
+        if(psInst->ulBlocksToQueue)
+        {
+            USBDSCSIReadBuffer(psDevice, 1);
+        }
     }
     else
     {
@@ -1761,7 +1950,18 @@ USBDSCSIWrite10(const tUSBDMSCDevice *psDevice, tMSCCBW *pSCSICBW)
         //
         usNumBlocks = (pSCSICBW->CBWCB[7] << 8) | pSCSICBW->CBWCB[8];
 
+        //
+        // A transfer length of zero moves no data and the status is sent by
+        // USBDSCSICommand(), so there is nothing more to do.
+        //
+        if(usNumBlocks == 0)
+        {
+            return;
+        }
+
         psInst->ulBytesToTransfer = DEVICE_BLOCK_SIZE * usNumBlocks;
+        psInst->ulBlocksToQueue = usNumBlocks;
+        psInst->ucBufferDMA = 0;
 
         //
         // Start sending logical blocks, these are always multiples of
@@ -1775,25 +1975,16 @@ USBDSCSIWrite10(const tUSBDMSCDevice *psDevice, tMSCCBW *pSCSICBW)
         MAP_USBEndpointDMAEnable(USB0_BASE, psInst->ucOUTEndpoint,
                                  USB_EP_DEV_OUT);
 
-        //
-        // Configure the DMA for the OUT transfer.
-        //
-        MAP_uDMAChannelTransferSet(psInst->ucOUTDMA,
-                                   UDMA_MODE_BASIC,
-                                   (void *)USBFIFOAddrGet(USB0_BASE,
-                                                         psInst->ucOUTEndpoint),
-                                                         psInst->pulBuffer,
-                                   (MAX_TRANSFER_SIZE >> 2));
-
         //
         // Remember that a DMA is in progress.
         //
         psInst->ulFlags |= USBD_FLAG_DMA_OUT;
 
         //
-        // Enable the OUT DMA transfer.
+        // Start receiving the first run of blocks into the first half of the
+        // buffer.
         //
-        MAP_uDMAChannelEnable(psInst->ucOUTDMA);
+        USBDSCSIStartOUT(psInst);
 
         //
         // Notify the application of the write event.
@@ -2005,6 +2196,28 @@ USBDSCSICommand(const tUSBDMSCDevice *psDevice, tMSCCBW *pSCSICBW)
             break;
         }
 
+        //
+        // Handle the Synchronize Cache command.
+        //
+        case SCSI_SYNCHRONIZE_CACHE:
+        {
+            //
+            // Have the media write out anything that it is holding.  There
+            // is no data phase for this command.
+            //
+            g_sSCSICSW.dCSWDataResidue = 0;
+            g_sSCSICSW.bCSWStatus = 0;
+
+            psInst->ulFlags &= ~USBD_FLAG_FLUSH;
+
+            if((psInst->pvMedia != 0) && psDevice->sMediaFunctions.Flush)
+            {
+                psDevice->sMediaFunctions.Flush(psInst->pvMedia);
+            }
+
+            break;
+        }
+
         //
         // Handle the Read Capacities command.
         //
@@ -105,6 +105,9 @@ typedef struct
     // This function is use to read blocks from a physical device and return them
     // in the /e pucData buffer.  The data area pointed to by /e pucData should be
     // at least /e ulNumBlocks * Block Size bytes to prevent overwriting data.
+    // The class asks for up to DEVICE_BUFFER_BLOCKS blocks in one call, and a
+    // driver that can read several blocks with one media command should do
+    // so.
     //
     // /return Returns the number of bytes that were read from the device.
     //
@@ -126,7 +129,8 @@ typedef struct
     // This function is use to write blocks to a physical device from the buffer
     // pointed to by the /e pucData buffer.  If the number of blocks is greater than
     // one then the block address will increment and write to the next block until
-    // /e ulNumBlocks * Block Size bytes have been written.
+    // /e ulNumBlocks * Block Size bytes have been written.  The class passes
+    // up to DEVICE_BUFFER_BLOCKS blocks in one call.
     //
     // /return Returns the number of bytes that were written to the device.
     //
@@ -150,6 +154,23 @@ typedef struct
     //*****************************************************************************
     unsigned long (* NumBlocks)(void * pvDrive);
 
+    //*****************************************************************************
+    //
+    // This function will write any data that the media driver is holding back
+    // to the device.
+    //
+    // /param pvDrive is the pointer that was returned from a call to
+    // USBDMSCStorageOpen().
+    //
+    // This function is called when the host sends a SYNCHRONIZE CACHE command
+    // and when the host has not accessed the device for a short time after a
+    // write.  It is optional and may be left as 0 by drivers that write all
+    // data before returning from BlockWrite().
+    //
+    // /return None.
+    //
+    //*****************************************************************************
+    void (* Flush)(void * pvDrive);
 }
 tMSCDMedia;
 
@@ -160,6 +181,20 @@ tMSCDMedia;
 //*****************************************************************************
 #define DEVICE_BLOCK_SIZE       512
 
+//*****************************************************************************
+//
+// The number of blocks in each half of the double buffer used by READ(10) and
+// WRITE(10).  The media is read or written this many blocks at a time while
+// the other half of the buffer is transferred over USB.  The uDMA controller
+// moves at most 1024 words in one transfer, so this may not be more than 8.
+// The USB library and the application must be built with the same value
+// since it sets the size of tMSCInstance.
+//
+//*****************************************************************************
+#ifndef DEVICE_BUFFER_BLOCKS
+#define DEVICE_BUFFER_BLOCKS    1
+#endif
+
 //*****************************************************************************
 //
 // PRIVATE
@@ -199,9 +234,29 @@ typedef struct
 
     tUSBDMSCMediaStatus eMediaStatus;
 
-    unsigned long pulBuffer[DEVICE_BLOCK_SIZE>>2];
+    //
+    // The two halves of the block buffer, the number of blocks held in each
+    // and the half that is currently being moved by the uDMA controller.
+    //
+    unsigned long pulBuffer[2][(DEVICE_BLOCK_SIZE * DEVICE_BUFFER_BLOCKS)>>2];
+    unsigned char pucBufferBlocks[2];
+    unsigned char ucBufferDMA;
+
+    //
+    // The bytes of the current READ(10) or WRITE(10) that are still to be
+    // sent to the host or written to the media, the next block to be read
+    // from or written to the media, and the number of blocks that have not
+    // yet been read from the media or queued for reception.
+    //
     unsigned long ulBytesToTransfer;
     unsigned long ulCurrentLBA;
+    unsigned long ulBlocksToQueue;
+
+    //
+    // The time in milliseconds since the last write completed, used to flush
+    // the media once the host has gone idle.
+    //
+    unsigned long ulIdleTime;
 
     unsigned char ucINEndpoint;
     unsigned char ucINDMA;
@@ -310,7 +365,8 @@ typedef struct
     //
     //! This structure holds the access functions for the media used by this
     //! instance of the mass storage class device.  All of the functions in this
-    //! structure are required to be filled out with valid functions.
+    //! structure except Flush are required to be filled out with valid
+    //! functions.
     //
     tMSCDMedia sMediaFunctions;
 
@@ -357,6 +413,161 @@ tUSBDMSCDevice;
 //*****************************************************************************
 #define USBD_MSC_EVENT_WRITING  (USBD_MSC_EVENT_BASE + 2)
 
+//*****************************************************************************
+//
+// PRIVATE
+//
+// This structure describes one block held in the read cache of a
+// tUSBDMSCCache.  It is defined here only so that the application can
+// allocate the array of lines for the cache.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // The logical block held in this line or MSC_CACHE_INVALID.
+    //
+    unsigned long ulLBA;
+
+    //
+    // The value of the cache's use counter when the line was last used.
+    //
+    unsigned long ulStamp;
+}
+tMSCCacheLine;
+
+//*****************************************************************************
+//
+// PRIVATE
+//
+// This structure defines the private instance data for a tUSBDMSCCache.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    // The value returned by the underlying media Open() function.
+    //
+    void *pvMedia;
+
+    //
+    // The number of blocks on the media.
+    //
+    unsigned long ulNumBlocks;
+
+    //
+    // The block following the last one read by the host, used to detect
+    // sequential reads.
+    //
+    unsigned long ulNextLBA;
+
+    //
+    // The counter used to find the least recently used line.
+    //
+    unsigned long ulStamp;
+
+    //
+    // The first block and the number of blocks held in the read-ahead
+    // buffer.
+    //
+    unsigned long ulReadAheadLBA;
+    unsigned long ulReadAheadCount;
+
+    //
+    // The first block of the erase block held in the write buffer and bit
+    // masks of the blocks in it that hold valid data and that have not yet
+    // been written to the media.
+    //
+    unsigned long ulEraseLBA;
+    unsigned long ulValid;
+    unsigned long ulDirty;
+}
+tMSCCacheInstance;
+
+//*****************************************************************************
+//
+//! The structure used by the application to define a block cache that sits
+//! between the mass storage class device and the media access functions.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The access functions of the media that is being cached.  The Flush
+    //! function may be 0.
+    //
+    const tMSCDMedia *psMedia;
+
+    //
+    //! A pointer to ulNumLines * DEVICE_BLOCK_SIZE bytes used to keep
+    //! recently read blocks resident.  Only single block reads that are not
+    //! part of a sequential run are placed here, so that blocks such as the
+    //! FAT and directories are not pushed out by file data.
+    //
+    unsigned char *pucLines;
+
+    //
+    //! A pointer to an array of ulNumLines tMSCCacheLine structures.
+    //
+    tMSCCacheLine *psLines;
+
+    //
+    //! The number of blocks held by the read cache.  This may be 0.
+    //
+    unsigned long ulNumLines;
+
+    //
+    //! A pointer to ulReadAhead * DEVICE_BLOCK_SIZE bytes used to hold the
+    //! blocks read ahead of a sequential read.
+    //
+    unsigned char *pucReadAhead;
+
+    //
+    //! The number of blocks read from the media at once when a sequential or
+    //! multiple block read misses the cache.  This may be 0 to disable
+    //! read-ahead.
+    //
+    unsigned long ulReadAhead;
+
+    //
+    //! A pointer to ulEraseBlocks * DEVICE_BLOCK_SIZE bytes used to collect
+    //! writes.
+    //
+    unsigned char *pucEraseBuffer;
+
+    //
+    //! The number of blocks in one erase block of the media, up to 32.
+    //! Writes to the same erase block are collected and written with a single
+    //! call to the media BlockWrite() function when the host writes to
+    //! another erase block, sends SYNCHRONIZE CACHE or goes idle.  This may be
+    //! 0 to write blocks through to the media immediately.
+    //
+    unsigned long ulEraseBlocks;
+
+    //
+    //! A pointer to the private instance data for this cache.
+    //
+    tMSCCacheInstance *psPrivateData;
+}
+tUSBDMSCCache;
+
+//*****************************************************************************
+//
+//! This macro fills in the sMediaFunctions member of a tUSBDMSCDevice so that
+//! the mass storage class device accesses the media through the block cache
+//! passed to USBDMSCCacheInit().
+//
+//*****************************************************************************
+#define USBDMSC_CACHE_MEDIA_FUNCTIONS                                         \
+        {                                                                     \
+            USBDMSCCacheOpen,                                                 \
+            USBDMSCCacheClose,                                                \
+            USBDMSCCacheBlockRead,                                            \
+            USBDMSCCacheBlockWrite,                                           \
+            USBDMSCCacheNumBlocks,                                            \
+            USBDMSCCacheFlush                                                 \
+        }
+
 extern tDeviceInfo g_sMSCDeviceInfo;
 
 //*****************************************************************************
@@ -371,6 +582,19 @@ extern void *USBDMSCCompositeInit(unsigned long ulIndex,
 extern void USBDMSCTerm(void *pvInstance);
 extern void USBDMSCMediaChange(void *pvInstance,
                                tUSBDMSCMediaStatus eMediaStatus);
+extern void USBDMSCCacheInit(const tUSBDMSCCache *psCache);
+extern void *USBDMSCCacheOpen(unsigned long ulDrive);
+extern void USBDMSCCacheClose(void *pvDrive);
+extern unsigned long USBDMSCCacheBlockRead(void *pvDrive,
+                                           unsigned char *pucData,
+                                           unsigned long ulSector,
+                                           unsigned long ulNumBlocks);
+extern unsigned long USBDMSCCacheBlockWrite(void *pvDrive,
+                                            unsigned char *pucData,
+                                            unsigned long ulSector,
+                                            unsigned long ulNumBlocks);
+extern unsigned long USBDMSCCacheNumBlocks(void *pvDrive);
+extern void USBDMSCCacheFlush(void *pvDrive);
 
 //*****************************************************************************
 //
@@ -0,0 +1,715 @@
+//*****************************************************************************
+//
+// usbdmsccache.c - Block cache for the USB mass storage device class media.
+//
+// Copyright (c) 2009-2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+//
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+//
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+//
+// This is part of revision 9453 of the Stellaris USB Library.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "driverlib/debug.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+#include "usblib/device/usbdmsc.h"
+
+//*****************************************************************************
+//
+//! \addtogroup msc_device_class_api
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+// The value used to mark a cache line or buffer that holds no block.
+//
+//*****************************************************************************
+#define MSC_CACHE_INVALID       0xffffffff
+
+//*****************************************************************************
+//
+// The cache that is accessed through the media functions below.  The mass
+// storage class device passes 0 rather than the value returned by Open() to
+// Close(), so only one cache can be in use at a time.
+//
+//*****************************************************************************
+static const tUSBDMSCCache *g_psMSCCache;
+
+//*****************************************************************************
+//
+// Copies one block.  A byte loop is used so that the library does not depend
+// on the C library.
+//
+//*****************************************************************************
+static void
+CacheBlockCopy(unsigned char *pucDst, const unsigned char *pucSrc)
+{
+    unsigned long ulIdx;
+
+    for(ulIdx = 0; ulIdx < DEVICE_BLOCK_SIZE; ulIdx++)
+    {
+        pucDst[ulIdx] = pucSrc[ulIdx];
+    }
+}
+
+//*****************************************************************************
+//
+// Returns the bit mask covering ulCount blocks of the write buffer.
+//
+//*****************************************************************************
+static unsigned long
+CacheMask(unsigned long ulCount)
+{
+    return((ulCount >= 32) ? 0xffffffff : ((1UL << ulCount) - 1));
+}
+
+//*****************************************************************************
+//
+// Returns the number of blocks of the erase block held in the write buffer
+// that are on the media.  This is only less than ulEraseBlocks for the last
+// erase block of a media whose size is not a multiple of the erase block.
+//
+//*****************************************************************************
+static unsigned long
+CacheEraseCount(const tUSBDMSCCache *psCache)
+{
+    tMSCCacheInstance *psInst;
+
+    psInst = psCache->psPrivateData;
+
+    if((psInst->ulNumBlocks - psInst->ulEraseLBA) < psCache->ulEraseBlocks)
+    {
+        return(psInst->ulNumBlocks - psInst->ulEraseLBA);
+    }
+
+    return(psCache->ulEraseBlocks);
+}
+
+//*****************************************************************************
+//
+// Returns the index of ulLBA in the write buffer or -1 if the block is not
+// part of the erase block held there.
+//
+//*****************************************************************************
+static long
+CacheEraseSlot(const tUSBDMSCCache *psCache, unsigned long ulLBA)
+{
+    tMSCCacheInstance *psInst;
+
+    psInst = psCache->psPrivateData;
+
+    if((psInst->ulEraseLBA == MSC_CACHE_INVALID) ||
+       ((ulLBA - psInst->ulEraseLBA) >= psCache->ulEraseBlocks))
+    {
+        return(-1);
+    }
+
+    return((long)(ulLBA - psInst->ulEraseLBA));
+}
+
+//*****************************************************************************
+//
+// Copies any blocks in the range ulLBA to ulLBA + ulCount - 1 that are held
+// in the write buffer into pucData, since they are newer than the copies on
+// the media.
+//
+//*****************************************************************************
+static void
+CacheEraseOverlay(const tUSBDMSCCache *psCache, unsigned char *pucData,
+                  unsigned long ulLBA, unsigned long ulCount)
+{
+    unsigned long ulIdx;
+    long lSlot;
+
+    for(ulIdx = 0; ulIdx < ulCount; ulIdx++)
+    {
+        lSlot = CacheEraseSlot(psCache, ulLBA + ulIdx);
+
+        if((lSlot >= 0) && (psCache->psPrivateData->ulValid & (1UL << lSlot)))
+        {
+            CacheBlockCopy(pucData + (ulIdx * DEVICE_BLOCK_SIZE),
+                           psCache->pucEraseBuffer +
+                           (lSlot * DEVICE_BLOCK_SIZE));
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Returns the read cache line holding ulLBA or -1 if the block is not in the
+// read cache.
+//
+//*****************************************************************************
+static long
+CacheLineFind(const tUSBDMSCCache *psCache, unsigned long ulLBA)
+{
+    unsigned long ulIdx;
+
+    for(ulIdx = 0; ulIdx < psCache->ulNumLines; ulIdx++)
+    {
+        if(psCache->psLines[ulIdx].ulLBA == ulLBA)
+        {
+            return((long)ulIdx);
+        }
+    }
+
+    return(-1);
+}
+
+//*****************************************************************************
+//
+// Writes the dirty blocks held in the write buffer to the media.  If only
+// some of the blocks of the erase block have been written by the host, the
+// rest are read from the media first so that the whole erase block can be
+// written with a single call to BlockWrite().
+//
+//*****************************************************************************
+static void
+CacheWriteBack(const tUSBDMSCCache *psCache)
+{
+    tMSCCacheInstance *psInst;
+    unsigned long ulCount, ulMask, ulStart, ulEnd;
+
+    psInst = psCache->psPrivateData;
+
+    if(psInst->ulDirty == 0)
+    {
+        return;
+    }
+
+    ulCount = CacheEraseCount(psCache);
+    ulMask = CacheMask(ulCount);
+
+    //
+    // Fill in any blocks of the erase block that are not yet in the buffer.
+    //
+    for(ulStart = 0; (ulStart < ulCount) && (psInst->ulValid != ulMask);
+        ulStart = ulEnd)
+    {
+        //
+        // Skip blocks that are already valid.
+        //
+        if(psInst->ulValid & (1UL << ulStart))
+        {
+            ulEnd = ulStart + 1;
+            continue;
+        }
+
+        //
+        // Find the end of this run of missing blocks and read it.
+        //
+        for(ulEnd = ulStart + 1;
+            (ulEnd < ulCount) && !(psInst->ulValid & (1UL << ulEnd)); ulEnd++)
+        {
+        }
+
+        if(psCache->psMedia->BlockRead(psInst->pvMedia,
+                  psCache->pucEraseBuffer + (ulStart * DEVICE_BLOCK_SIZE),
+                  psInst->ulEraseLBA + ulStart, ulEnd - ulStart) == 0)
+        {
+            break;
+        }
+
+        psInst->ulValid |= CacheMask(ulEnd) & ~CacheMask(ulStart);
+    }
+
+    if(psInst->ulValid == ulMask)
+    {
+        //
+        // The whole erase block is present so write it in one go.
+        //
+        psCache->psMedia->BlockWrite(psInst->pvMedia, psCache->pucEraseBuffer,
+                                     psInst->ulEraseLBA, ulCount);
+    }
+    else
+    {
+        //
+        // The missing blocks could not be read, so write each run of dirty
+        // blocks on its own.
+        //
+        for(ulStart = 0; ulStart < ulCount; ulStart = ulEnd)
+        {
+            if(!(psInst->ulDirty & (1UL << ulStart)))
+            {
+                ulEnd = ulStart + 1;
+                continue;
+            }
+
+            for(ulEnd = ulStart + 1;
+                (ulEnd < ulCount) && (psInst->ulDirty & (1UL << ulEnd)); ulEnd++)
+            {
+            }
+
+            psCache->psMedia->BlockWrite(psInst->pvMedia,
+                    psCache->pucEraseBuffer + (ulStart * DEVICE_BLOCK_SIZE),
+                    psInst->ulEraseLBA + ulStart, ulEnd - ulStart);
+        }
+    }
+
+    psInst->ulDirty = 0;
+}
+
+//*****************************************************************************
+//
+// Discards everything held by the cache.  Any dirty blocks must already have
+// been written back.
+//
+//*****************************************************************************
+static void
+CacheInvalidate(const tUSBDMSCCache *psCache)
+{
+    tMSCCacheInstance *psInst;
+    unsigned long ulIdx;
+
+    psInst = psCache->psPrivateData;
+
+    for(ulIdx = 0; ulIdx < psCache->ulNumLines; ulIdx++)
+    {
+        psCache->psLines[ulIdx].ulLBA = MSC_CACHE_INVALID;
+        psCache->psLines[ulIdx].ulStamp = 0;
+    }
+
+    psInst->ulNextLBA = MSC_CACHE_INVALID;
+    psInst->ulStamp = 0;
+    psInst->ulReadAheadLBA = MSC_CACHE_INVALID;
+    psInst->ulReadAheadCount = 0;
+    psInst->ulEraseLBA = MSC_CACHE_INVALID;
+    psInst->ulValid = 0;
+    psInst->ulDirty = 0;
+}
+
+//*****************************************************************************
+//
+//! Initializes a block cache for the mass storage device class.
+//!
+//! \param psCache points to a structure describing the media to cache and the
+//! memory that the cache may use.
+//!
+//! This function prepares the cache described by \e psCache for use.  The
+//! application then accesses the media through the cache by filling in the
+//! sMediaFunctions member of its tUSBDMSCDevice structure with
+//! USBDMSC_CACHE_MEDIA_FUNCTIONS.  It must be called before USBDMSCInit() or
+//! USBDMSCCompositeInit(), since these open the media.
+//!
+//! Single block reads that do not continue the previous read are held in the
+//! read cache lines, which are replaced least recently used first.
+//! Sequential and multiple block reads that miss the cache are read
+//! \e ulReadAhead blocks at a time into a separate read-ahead buffer so that
+//! streaming file data does not push out blocks that the host reads often,
+//! such as the FAT and directories.  Writes are collected one erase block at a
+//! time and written back when the host writes to another erase block, sends a
+//! SYNCHRONIZE CACHE command, stops writing for a short time, or the media is
+//! closed.
+//!
+//! \note Since BlockWrite() returns before the data reaches the media, a media
+//! error during a write back cannot be reported to the host.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDMSCCacheInit(const tUSBDMSCCache *psCache)
+{
+    ASSERT(psCache);
+    ASSERT(psCache->psMedia);
+    ASSERT(psCache->psPrivateData);
+    ASSERT(psCache->ulEraseBlocks <= 32);
+    ASSERT((psCache->ulNumLines == 0) ||
+           (psCache->pucLines && psCache->psLines));
+    ASSERT((psCache->ulReadAhead == 0) || psCache->pucReadAhead);
+    ASSERT((psCache->ulEraseBlocks == 0) || psCache->pucEraseBuffer);
+
+    g_psMSCCache = psCache;
+
+    psCache->psPrivateData->pvMedia = 0;
+    psCache->psPrivateData->ulNumBlocks = 0;
+    CacheInvalidate(psCache);
+}
+
+//*****************************************************************************
+//
+//! Opens the media behind the block cache.
+//!
+//! \param ulDrive is the drive number to pass to the media Open() function.
+//!
+//! This function is the Open() member of USBDMSC_CACHE_MEDIA_FUNCTIONS.
+//!
+//! \return Returns a pointer to pass to the other cache media functions or 0
+//! if the media could not be opened.
+//
+//*****************************************************************************
+void *
+USBDMSCCacheOpen(unsigned long ulDrive)
+{
+    const tUSBDMSCCache *psCache;
+    tMSCCacheInstance *psInst;
+
+    psCache = g_psMSCCache;
+    ASSERT(psCache);
+    psInst = psCache->psPrivateData;
+
+    //
+    // Open the media and drop anything that was cached from any earlier
+    // media.
+    //
+    psInst->pvMedia = psCache->psMedia->Open(ulDrive);
+
+    if(psInst->pvMedia == 0)
+    {
+        return(0);
+    }
+
+    psInst->ulNumBlocks = psCache->psMedia->NumBlocks(psInst->pvMedia);
+    CacheInvalidate(psCache);
+
+    return((void *)psCache);
+}
+
+//*****************************************************************************
+//
+//! Writes back any data held by the block cache and closes the media.
+//!
+//! \param pvDrive is the pointer returned by USBDMSCCacheOpen().  The mass
+//! storage class device passes 0, which is also accepted.
+//!
+//! This function is the Close() member of USBDMSC_CACHE_MEDIA_FUNCTIONS.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDMSCCacheClose(void *pvDrive)
+{
+    const tUSBDMSCCache *psCache;
+    tMSCCacheInstance *psInst;
+
+    psCache = g_psMSCCache;
+    ASSERT(psCache);
+    psInst = psCache->psPrivateData;
+
+    if(psInst->pvMedia == 0)
+    {
+        return;
+    }
+
+    CacheWriteBack(psCache);
+    CacheInvalidate(psCache);
+
+    psCache->psMedia->Close(psInst->pvMedia);
+    psInst->pvMedia = 0;
+}
+
+//*****************************************************************************
+//
+//! Reads blocks through the block cache.
+//!
+//! \param pvDrive is the pointer returned by USBDMSCCacheOpen().
+//! \param pucData is the buffer that the data will be written into.
+//! \param ulSector is the first block to read.
+//! \param ulNumBlocks is the number of blocks to read.
+//!
+//! This function is the BlockRead() member of USBDMSC_CACHE_MEDIA_FUNCTIONS.
+//! Blocks are taken from the write buffer, the read-ahead buffer or the read
+//! cache when they are present there and are read from the media otherwise.
+//!
+//! \return Returns the number of bytes read or 0 if the media could not be
+//! read.
+//
+//*****************************************************************************
+unsigned long
+USBDMSCCacheBlockRead(void *pvDrive, unsigned char *pucData,
+                      unsigned long ulSector, unsigned long ulNumBlocks)
+{
+    const tUSBDMSCCache *psCache;
+    tMSCCacheInstance *psInst;
+    tBoolean bSequential;
+    unsigned long ulIdx, ulLBA, ulCount, ulOldest;
+    unsigned char *pucBlock;
+    long lLine, lSlot;
+
+    psCache = (const tUSBDMSCCache *)pvDrive;
+    ASSERT(psCache);
+    psInst = psCache->psPrivateData;
+
+    //
+    // Reads that continue the last one, or that ask for more than one block,
+    // are treated as streaming data and go through the read-ahead buffer.
+    //
+    bSequential = ((ulSector == psInst->ulNextLBA) || (ulNumBlocks > 1)) ?
+                  true : false;
+
+    for(ulIdx = 0; ulIdx < ulNumBlocks; ulIdx++)
+    {
+        ulLBA = ulSector + ulIdx;
+        pucBlock = 0;
+        lSlot = CacheEraseSlot(psCache, ulLBA);
+
+        //
+        // The write buffer holds the newest copy of any block it contains.
+        //
+        if((lSlot >= 0) && (psInst->ulValid & (1UL << lSlot)))
+        {
+            pucBlock = psCache->pucEraseBuffer + (lSlot * DEVICE_BLOCK_SIZE);
+        }
+
+        //
+        // Next try the read-ahead buffer.
+        //
+        else if((ulLBA - psInst->ulReadAheadLBA) < psInst->ulReadAheadCount)
+        {
+            pucBlock = psCache->pucReadAhead +
+                       ((ulLBA - psInst->ulReadAheadLBA) * DEVICE_BLOCK_SIZE);
+        }
+
+        //
+        // Then the read cache.
+        //
+        else if((lLine = CacheLineFind(psCache, ulLBA)) >= 0)
+        {
+            psCache->psLines[lLine].ulStamp = ++psInst->ulStamp;
+            pucBlock = psCache->pucLines + (lLine * DEVICE_BLOCK_SIZE);
+        }
+
+        //
+        // The block is not cached so read a run of blocks from here into the
+        // read-ahead buffer if this is streaming data.
+        //
+        else if(bSequential && psCache->ulReadAhead)
+        {
+            ulCount = psInst->ulNumBlocks - ulLBA;
+            if(ulCount > psCache->ulReadAhead)
+            {
+                ulCount = psCache->ulReadAhead;
+            }
+
+            psInst->ulReadAheadCount = 0;
+            if(psCache->psMedia->BlockRead(psInst->pvMedia,
+                                           psCache->pucReadAhead, ulLBA,
+                                           ulCount) == 0)
+            {
+                return(0);
+            }
+            CacheEraseOverlay(psCache, psCache->pucReadAhead, ulLBA, ulCount);
+            psInst->ulReadAheadLBA = ulLBA;
+            psInst->ulReadAheadCount = ulCount;
+
+            pucBlock = psCache->pucReadAhead;
+        }
+
+        //
+        // Otherwise read the block into the least recently used line of the
+        // read cache.
+        //
+        else if(psCache->ulNumLines)
+        {
+            lLine = 0;
+            ulOldest = psCache->psLines[0].ulStamp;
+            for(ulCount = 1; ulCount < psCache->ulNumLines; ulCount++)
+            {
+                if(psCache->psLines[ulCount].ulStamp < ulOldest)
+                {
+                    lLine = (long)ulCount;
+                    ulOldest = psCache->psLines[ulCount].ulStamp;
+                }
+            }
+
+            pucBlock = psCache->pucLines + (lLine * DEVICE_BLOCK_SIZE);
+            psCache->psLines[lLine].ulLBA = MSC_CACHE_INVALID;
+            if(psCache->psMedia->BlockRead(psInst->pvMedia, pucBlock, ulLBA,
+                                           1) == 0)
+            {
+                return(0);
+            }
+            psCache->psLines[lLine].ulLBA = ulLBA;
+            psCache->psLines[lLine].ulStamp = ++psInst->ulStamp;
+        }
+
+        //
+        // With no cache memory at all, read straight into the caller's
+        // buffer.
+        //
+        else
+        {
+            if(psCache->psMedia->BlockRead(psInst->pvMedia,
+                                           pucData + (ulIdx * DEVICE_BLOCK_SIZE),
+                                           ulLBA, 1) == 0)
+            {
+                return(0);
+            }
+        }
+
+        if(pucBlock)
+        {
+            CacheBlockCopy(pucData + (ulIdx * DEVICE_BLOCK_SIZE), pucBlock);
+        }
+    }
+
+    psInst->ulNextLBA = ulSector + ulNumBlocks;
+
+    return(ulNumBlocks * DEVICE_BLOCK_SIZE);
+}
+
+//*****************************************************************************
+//
+//! Writes blocks through the block cache.
+//!
+//! \param pvDrive is the pointer returned by USBDMSCCacheOpen().
+//! \param pucData is the buffer holding the data to write.
+//! \param ulSector is the first block to write.
+//! \param ulNumBlocks is the number of blocks to write.
+//!
+//! This function is the BlockWrite() member of USBDMSC_CACHE_MEDIA_FUNCTIONS.
+//! Any copies of the blocks in the read cache and the read-ahead buffer are
+//! updated.  If the cache has a write buffer then the blocks are collected
+//! there and only written to the media when the buffer is needed for another
+//! erase block or the cache is flushed.
+//!
+//! \return Returns the number of bytes written.
+//
+//*****************************************************************************
+unsigned long
+USBDMSCCacheBlockWrite(void *pvDrive, unsigned char *pucData,
+                       unsigned long ulSector, unsigned long ulNumBlocks)
+{
+    const tUSBDMSCCache *psCache;
+    tMSCCacheInstance *psInst;
+    unsigned long ulIdx, ulLBA, ulBit;
+    unsigned char *pucBlock;
+    long lLine;
+
+    psCache = (const tUSBDMSCCache *)pvDrive;
+    ASSERT(psCache);
+    psInst = psCache->psPrivateData;
+
+    for(ulIdx = 0; ulIdx < ulNumBlocks; ulIdx++)
+    {
+        ulLBA = ulSector + ulIdx;
+        pucBlock = pucData + (ulIdx * DEVICE_BLOCK_SIZE);
+
+        //
+        // Keep any cached copies of this block up to date.
+        //
+        if((ulLBA - psInst->ulReadAheadLBA) < psInst->ulReadAheadCount)
+        {
+            CacheBlockCopy(psCache->pucReadAhead +
+                           ((ulLBA - psInst->ulReadAheadLBA) *
+                            DEVICE_BLOCK_SIZE), pucBlock);
+        }
+
+        if((lLine = CacheLineFind(psCache, ulLBA)) >= 0)
+        {
+            CacheBlockCopy(psCache->pucLines + (lLine * DEVICE_BLOCK_SIZE),
+                           pucBlock);
+        }
+
+        if(psCache->ulEraseBlocks == 0)
+        {
+            continue;
+        }
+
+        //
+        // If this block is in another erase block than the one being
+        // collected then write that one back and start on this one.
+        //
+        if(CacheEraseSlot(psCache, ulLBA) < 0)
+        {
+            CacheWriteBack(psCache);
+            psInst->ulEraseLBA = ulLBA - (ulLBA % psCache->ulEraseBlocks);
+            psInst->ulValid = 0;
+        }
+
+        ulBit = 1UL << (ulLBA - psInst->ulEraseLBA);
+        CacheBlockCopy(psCache->pucEraseBuffer +
+                       ((ulLBA - psInst->ulEraseLBA) * DEVICE_BLOCK_SIZE),
+                       pucBlock);
+        psInst->ulValid |= ulBit;
+        psInst->ulDirty |= ulBit;
+    }
+
+    //
+    // Without a write buffer the data goes straight to the media.
+    //
+    if(psCache->ulEraseBlocks == 0)
+    {
+        return(psCache->psMedia->BlockWrite(psInst->pvMedia, pucData, ulSector,
+                                            ulNumBlocks));
+    }
+
+    return(ulNumBlocks * DEVICE_BLOCK_SIZE);
+}
+
+//*****************************************************************************
+//
+//! Returns the number of blocks on the media behind the block cache.
+//!
+//! \param pvDrive is the pointer returned by USBDMSCCacheOpen().
+//!
+//! This function is the NumBlocks() member of USBDMSC_CACHE_MEDIA_FUNCTIONS.
+//!
+//! \return Returns the number of blocks on the media.
+//
+//*****************************************************************************
+unsigned long
+USBDMSCCacheNumBlocks(void *pvDrive)
+{
+    const tUSBDMSCCache *psCache;
+
+    psCache = (const tUSBDMSCCache *)pvDrive;
+    ASSERT(psCache);
+
+    return(psCache->psPrivateData->ulNumBlocks);
+}
+
+//*****************************************************************************
+//
+//! Writes back any data held by the block cache.
+//!
+//! \param pvDrive is the pointer returned by USBDMSCCacheOpen().
+//!
+//! This function is the Flush() member of USBDMSC_CACHE_MEDIA_FUNCTIONS.  The
+//! mass storage class device calls it when the host sends SYNCHRONIZE CACHE
+//! and when the host stops writing for a short time.  The blocks stay in the
+//! cache after they are written, and the Flush() function of the media is
+//! called if it has one.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBDMSCCacheFlush(void *pvDrive)
+{
+    const tUSBDMSCCache *psCache;
+
+    psCache = (const tUSBDMSCCache *)pvDrive;
+    ASSERT(psCache);
+
+    CacheWriteBack(psCache);
+
+    if(psCache->psMedia->Flush)
+    {
+        psCache->psMedia->Flush(psCache->psPrivateData->pvMedia);
+    }
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
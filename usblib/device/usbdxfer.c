@@ -0,0 +1,593 @@
+//*****************************************************************************
+//
+// usbdxfer.c - Multi-packet uDMA transfers on device bulk endpoints.
+//
+// Copyright (c) 2008-2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+//
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+//
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+//
+// This is part of revision 9453 of the Stellaris USB Library.
+//
+//*****************************************************************************
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/debug.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+#include "driverlib/udma.h"
+#include "driverlib/usb.h"
+#include "usblib/usblib.h"
+#include "usblib/device/usbdevice.h"
+
+//*****************************************************************************
+//
+// The largest number of bytes moved by a single uDMA transfer.  The uDMA
+// controller moves at most 1024 items and transfers use 32-bit items.  This
+// is a multiple of the maximum packet size of any full speed bulk endpoint.
+//
+//*****************************************************************************
+#define USBD_XFER_DMA_MAX_BYTES 4096
+
+//*****************************************************************************
+//
+// Returns the uDMA channel that serves a given endpoint and direction.  Each
+// endpoint from 1 to 3 has a receive channel followed by a transmit channel.
+//
+//*****************************************************************************
+#define USBD_XFER_CHANNEL(ulEndpoint, bIn)                                    \
+        (UDMA_CHANNEL_USBEP1RX + ((USB_EP_TO_INDEX(ulEndpoint) - 1) * 2) +    \
+         ((bIn) ? 1 : 0))
+
+//*****************************************************************************
+//
+// Returns the uDMA arbitration size that matches the maximum packet size of
+// the endpoint.  The endpoint requests one packet at a time, so the uDMA
+// controller must not move more words than a packet holds in one burst.
+//
+//*****************************************************************************
+static unsigned long
+XferArbSize(unsigned long ulMaxPacket)
+{
+    switch(ulMaxPacket)
+    {
+        case 8:
+        {
+            return(UDMA_ARB_2);
+        }
+        case 16:
+        {
+            return(UDMA_ARB_4);
+        }
+        case 32:
+        {
+            return(UDMA_ARB_8);
+        }
+        default:
+        {
+            return(UDMA_ARB_16);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Returns the endpoint to normal packet operation once the uDMA controller
+// has finished with it.
+//
+//*****************************************************************************
+static void
+XferDMAOff(tUSBDXfer *psXfer)
+{
+    unsigned long ulFlags;
+
+    ulFlags = psXfer->bIn ? USB_EP_DEV_IN : USB_EP_DEV_OUT;
+
+    MAP_USBEndpointDMADisable(psXfer->ulUSBBase, psXfer->ucEndpoint, ulFlags);
+    MAP_USBEndpointDMAConfigSet(psXfer->ulUSBBase, psXfer->ucEndpoint,
+                                ulFlags);
+}
+
+//*****************************************************************************
+//
+// Fills in the parts of the transfer state that are common to both
+// directions and selects the endpoint's uDMA channel.
+//
+//*****************************************************************************
+static void
+XferSetup(tUSBDXfer *psXfer, unsigned long ulBase, unsigned long ulEndpoint,
+          unsigned long ulMaxPacket, unsigned char *pucData,
+          unsigned long ulLength, tBoolean bIn)
+{
+    ASSERT(((unsigned long)pucData & 3) == 0);
+    ASSERT((ulEndpoint >= USB_EP_1) && (ulEndpoint <= USB_EP_3));
+    ASSERT((ulMaxPacket == 8) || (ulMaxPacket == 16) || (ulMaxPacket == 32) ||
+           (ulMaxPacket == 64));
+
+    psXfer->ulUSBBase = ulBase;
+    psXfer->ucEndpoint = (unsigned char)ulEndpoint;
+    psXfer->ucDMAChannel = USBD_XFER_CHANNEL(ulEndpoint, bIn);
+    psXfer->usMaxPacket = (unsigned short)ulMaxPacket;
+    psXfer->bIn = bIn;
+    psXfer->pucData = pucData;
+    psXfer->ulSize = ulLength;
+    psXfer->ulCount = 0;
+    psXfer->ulChunk = 0;
+
+    MAP_uDMAChannelAttributeDisable(psXfer->ucDMAChannel, UDMA_ATTR_ALL);
+    MAP_USBEndpointDMAChannel(ulBase, ulEndpoint, psXfer->ucDMAChannel);
+}
+
+//*****************************************************************************
+//
+// Starts the uDMA transfer of the next run of whole packets of a transmit
+// transfer, or the final short or zero length packet once all whole packets
+// have been handed to the uDMA controller.
+//
+//*****************************************************************************
+static void
+XferTxNext(tUSBDXfer *psXfer)
+{
+    unsigned long ulCount;
+
+    //
+    // How many whole packets remain to be sent?
+    //
+    ulCount = psXfer->ulSize - psXfer->ulCount;
+    ulCount -= ulCount % psXfer->usMaxPacket;
+
+    if(ulCount)
+    {
+        if(ulCount > USBD_XFER_DMA_MAX_BYTES)
+        {
+            ulCount = USBD_XFER_DMA_MAX_BYTES;
+        }
+
+        //
+        // Hand the packets to the uDMA controller.  The endpoint is set to
+        // send each packet as soon as the uDMA controller has filled the
+        // FIFO.
+        //
+        psXfer->ulChunk = ulCount;
+        psXfer->eState = USBD_XFER_DMA;
+        MAP_uDMAChannelTransferSet(psXfer->ucDMAChannel, UDMA_MODE_BASIC,
+                                   psXfer->pucData + psXfer->ulCount,
+                                   (void *)USBFIFOAddrGet(psXfer->ulUSBBase,
+                                                          psXfer->ucEndpoint),
+                                   ulCount >> 2);
+        MAP_uDMAChannelEnable(psXfer->ucDMAChannel);
+    }
+    else
+    {
+        //
+        // Only a short packet remains, or nothing if the transfer was a
+        // multiple of the packet size, in which case a zero length packet
+        // tells the host that the transfer has ended.  Wait for the last
+        // packet sent by the uDMA controller to leave the FIFO first.
+        //
+        psXfer->eState = USBD_XFER_WAIT_TAIL;
+    }
+}
+
+//*****************************************************************************
+//
+// Starts a transmit transfer.
+//
+// \param psXfer is the transfer state to use.
+// \param ulBase is the USB controller base address.
+// \param ulEndpoint is the bulk IN endpoint, which must be USB_EP_1 to
+// USB_EP_3 since only these have uDMA channels.
+// \param ulMaxPacket is the maximum packet size of the endpoint, which must
+// be 8, 16, 32 or 64 bytes.
+// \param pucData points to the word aligned data to send.
+// \param ulLength is the number of bytes to send.
+//
+// Whole packets are moved to the endpoint FIFO by the uDMA controller in runs
+// of up to USBD_XFER_DMA_MAX_BYTES and sent as soon as each is complete.  The
+// transfer ends with a short packet holding the remaining bytes or, if the
+// length is a multiple of the packet size, a zero length packet.  The caller
+// must pass each interrupt from the endpoint, and the completion of the uDMA
+// transfer, to InternalUSBDXferTxProcess().
+//
+// \return None.
+//
+//*****************************************************************************
+void
+InternalUSBDXferTxStart(tUSBDXfer *psXfer, unsigned long ulBase,
+                        unsigned long ulEndpoint, unsigned long ulMaxPacket,
+                        unsigned char *pucData, unsigned long ulLength)
+{
+    XferSetup(psXfer, ulBase, ulEndpoint, ulMaxPacket, pucData, ulLength,
+              true);
+
+    //
+    // Move 32-bit words from memory to the FIFO, with the endpoint
+    // requesting a packet at a time from the uDMA controller and sending each
+    // one as soon as the FIFO is full.
+    //
+    MAP_uDMAChannelControlSet(psXfer->ucDMAChannel,
+                              (UDMA_SIZE_32 | UDMA_SRC_INC_32 |
+                               UDMA_DST_INC_NONE | XferArbSize(ulMaxPacket)));
+    MAP_USBEndpointDMAConfigSet(ulBase, ulEndpoint,
+                                (USB_EP_DEV_IN | USB_EP_DMA_MODE_1 |
+                                 USB_EP_AUTO_SET));
+    MAP_USBEndpointDMAEnable(ulBase, ulEndpoint, USB_EP_DEV_IN);
+
+    //
+    // Start on the first run of packets.  If the transfer is shorter than a
+    // packet, send it straight away.
+    //
+    XferTxNext(psXfer);
+
+    if(psXfer->eState == USBD_XFER_WAIT_TAIL)
+    {
+        XferDMAOff(psXfer);
+        InternalUSBDXferTxProcess(psXfer,
+                                  MAP_USBEndpointStatus(ulBase, ulEndpoint));
+    }
+}
+
+//*****************************************************************************
+//
+// Moves a transmit transfer on following an interrupt from its endpoint or
+// the completion of its uDMA transfer.
+//
+// \param psXfer is the transfer state.
+// \param ulEPStatus is the endpoint status read by the caller.
+//
+// \return Returns \b true once the final packet of the transfer has been
+// sent, or \b false if the transfer is still in progress.
+//
+//*****************************************************************************
+tBoolean
+InternalUSBDXferTxProcess(tUSBDXfer *psXfer, unsigned long ulEPStatus)
+{
+    //
+    // Has the uDMA controller finished the current run of packets?
+    //
+    if((psXfer->eState == USBD_XFER_DMA) &&
+       (MAP_uDMAChannelModeGet(psXfer->ucDMAChannel) == UDMA_MODE_STOP))
+    {
+        psXfer->ulCount += psXfer->ulChunk;
+        psXfer->ulChunk = 0;
+        XferTxNext(psXfer);
+
+        //
+        // Once all whole packets have been handed over, return the endpoint
+        // to normal operation for the final packet.
+        //
+        if(psXfer->eState == USBD_XFER_WAIT_TAIL)
+        {
+            XferDMAOff(psXfer);
+            ulEPStatus = MAP_USBEndpointStatus(psXfer->ulUSBBase,
+                                               psXfer->ucEndpoint);
+        }
+    }
+
+    //
+    // Nothing more can be done until the FIFO is empty.
+    //
+    if(ulEPStatus & USB_DEV_TX_TXPKTRDY)
+    {
+        return(false);
+    }
+
+    if(psXfer->eState == USBD_XFER_WAIT_TAIL)
+    {
+        //
+        // Send the remaining bytes, if any, as the final packet.
+        //
+        MAP_USBEndpointDataPut(psXfer->ulUSBBase, psXfer->ucEndpoint,
+                               psXfer->pucData + psXfer->ulCount,
+                               psXfer->ulSize - psXfer->ulCount);
+        psXfer->eState = USBD_XFER_TAIL;
+        MAP_USBEndpointDataSend(psXfer->ulUSBBase, psXfer->ucEndpoint,
+                                USB_TRANS_IN);
+    }
+    else if(psXfer->eState == USBD_XFER_TAIL)
+    {
+        //
+        // The final packet has been sent so the transfer is complete.
+        //
+        psXfer->ulCount = psXfer->ulSize;
+        psXfer->eState = USBD_XFER_IDLE;
+        return(true);
+    }
+
+    return(false);
+}
+
+//*****************************************************************************
+//
+// Starts the uDMA transfer of the next run of packets of a receive transfer.
+//
+//*****************************************************************************
+static void
+XferRxNext(tUSBDXfer *psXfer)
+{
+    unsigned long ulCount;
+
+    ulCount = psXfer->ulSize - psXfer->ulCount;
+    if(ulCount > USBD_XFER_DMA_MAX_BYTES)
+    {
+        ulCount = USBD_XFER_DMA_MAX_BYTES;
+    }
+
+    psXfer->ulChunk = ulCount;
+    MAP_uDMAChannelTransferSet(psXfer->ucDMAChannel, UDMA_MODE_BASIC,
+                               (void *)USBFIFOAddrGet(psXfer->ulUSBBase,
+                                                      psXfer->ucEndpoint),
+                               psXfer->pucData + psXfer->ulCount,
+                               ulCount >> 2);
+    MAP_uDMAChannelEnable(psXfer->ucDMAChannel);
+}
+
+//*****************************************************************************
+//
+// Stops the uDMA controller part way through a receive transfer and adds the
+// packets that it has already moved to the count.
+//
+//*****************************************************************************
+static void
+XferRxStop(tUSBDXfer *psXfer)
+{
+    MAP_uDMAChannelDisable(psXfer->ucDMAChannel);
+    psXfer->ulCount += psXfer->ulChunk -
+                       (MAP_uDMAChannelSizeGet(psXfer->ucDMAChannel) << 2);
+    psXfer->ulChunk = 0;
+}
+
+//*****************************************************************************
+//
+// Starts a receive transfer.
+//
+// \param psXfer is the transfer state to use.
+// \param ulBase is the USB controller base address.
+// \param ulEndpoint is the bulk OUT endpoint, which must be USB_EP_1 to
+// USB_EP_3 since only these have uDMA channels.
+// \param ulMaxPacket is the maximum packet size of the endpoint, which must
+// be 8, 16, 32 or 64 bytes.
+// \param pucData points to the word aligned buffer for the data.
+// \param ulLength is the size of the buffer, which must be a multiple of the
+// maximum packet size.
+//
+// Whole packets are moved from the endpoint FIFO by the uDMA controller.  The
+// transfer ends when the buffer is full, when the host sends a short or zero
+// length packet, which is read into the buffer after the others, or when the
+// idle timeout set in the ulIdleFrames member expires.  The caller must pass
+// each interrupt from the endpoint, and the completion of the uDMA transfer,
+// to InternalUSBDXferRxProcess() and, if it uses the idle timeout, call
+// InternalUSBDXferRxFrame() on every frame.
+//
+// \return Returns \b true if a short packet was already waiting and has
+// ended the transfer, or \b false if the transfer is in progress.
+//
+//*****************************************************************************
+tBoolean
+InternalUSBDXferRxStart(tUSBDXfer *psXfer, unsigned long ulBase,
+                        unsigned long ulEndpoint, unsigned long ulMaxPacket,
+                        unsigned char *pucData, unsigned long ulLength)
+{
+    ASSERT(ulLength && ((ulLength % ulMaxPacket) == 0));
+
+    XferSetup(psXfer, ulBase, ulEndpoint, ulMaxPacket, pucData, ulLength,
+              false);
+    psXfer->ulIdleCount = 0;
+    psXfer->ulIdleMark = 0;
+    psXfer->eState = USBD_XFER_DMA;
+
+    //
+    // Move 32-bit words from the FIFO to memory, with the endpoint
+    // requesting the uDMA controller for each full packet and acknowledging
+    // it once it has been read.  Short packets cause an endpoint interrupt
+    // instead.
+    //
+    MAP_uDMAChannelControlSet(psXfer->ucDMAChannel,
+                              (UDMA_SIZE_32 | UDMA_SRC_INC_NONE |
+                               UDMA_DST_INC_32 | XferArbSize(ulMaxPacket)));
+    MAP_USBEndpointDMAConfigSet(ulBase, ulEndpoint,
+                                (USB_EP_DEV_OUT | USB_EP_DMA_MODE_1 |
+                                 USB_EP_AUTO_CLEAR));
+    XferRxNext(psXfer);
+    MAP_USBEndpointDMAEnable(ulBase, ulEndpoint, USB_EP_DEV_OUT);
+
+    //
+    // A short packet may already be waiting, in which case it ends the
+    // transfer now.
+    //
+    return(InternalUSBDXferRxProcess(psXfer,
+                                     MAP_USBEndpointStatus(ulBase,
+                                                           ulEndpoint)));
+}
+
+//*****************************************************************************
+//
+// Moves a receive transfer on following an interrupt from its endpoint or
+// the completion of its uDMA transfer.  The uDMA controller only moves whole
+// packets, so a short packet from the host causes an endpoint interrupt
+// instead and ends the transfer.
+//
+// \param psXfer is the transfer state.
+// \param ulEPStatus is the endpoint status read by the caller.
+//
+// \return Returns \b true if the transfer has ended, in which case the
+// ulCount member holds the number of bytes received, or \b false if it is
+// still in progress.
+//
+//*****************************************************************************
+tBoolean
+InternalUSBDXferRxProcess(tUSBDXfer *psXfer, unsigned long ulEPStatus)
+{
+    unsigned long ulSize;
+
+    //
+    // Has the uDMA controller filled the current part of the buffer?
+    //
+    if(MAP_uDMAChannelModeGet(psXfer->ucDMAChannel) == UDMA_MODE_STOP)
+    {
+        psXfer->ulCount += psXfer->ulChunk;
+        psXfer->ulChunk = 0;
+
+        if(psXfer->ulCount == psXfer->ulSize)
+        {
+            XferDMAOff(psXfer);
+            psXfer->eState = USBD_XFER_IDLE;
+            return(true);
+        }
+
+        XferRxNext(psXfer);
+    }
+
+    //
+    // Is a short packet waiting in the FIFO?
+    //
+    if(ulEPStatus & USB_DEV_RX_PKT_RDY)
+    {
+        ulSize = MAP_USBEndpointDataAvail(psXfer->ulUSBBase,
+                                          psXfer->ucEndpoint);
+
+        if(ulSize < psXfer->usMaxPacket)
+        {
+            //
+            // Stop the uDMA transfer, then read the short packet after the
+            // packets that it has already moved and acknowledge it.
+            //
+            XferRxStop(psXfer);
+            MAP_USBEndpointDataGet(psXfer->ulUSBBase, psXfer->ucEndpoint,
+                                   psXfer->pucData + psXfer->ulCount,
+                                   &ulSize);
+            MAP_USBDevEndpointDataAck(psXfer->ulUSBBase, psXfer->ucEndpoint,
+                                      true);
+            psXfer->ulCount += ulSize;
+
+            XferDMAOff(psXfer);
+            psXfer->eState = USBD_XFER_IDLE;
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+//*****************************************************************************
+//
+// Checks a receive transfer for the idle timeout.  This is called on every
+// frame by device classes that offer the timeout.
+//
+// \param psXfer is the transfer state.
+//
+// Hosts do not end a transfer with a zero length packet when the data they
+// send happens to fill its last packet, so a receive transfer can be left
+// holding data until the host sends more.  When the ulIdleFrames member is
+// not 0, a transfer that has received some data and then received nothing
+// more for ulIdleFrames frames is ended with the data received so far.
+//
+// \return Returns \b true if the transfer has ended, in which case the
+// ulCount member holds the number of bytes received, or \b false if it is
+// still in progress.
+//
+//*****************************************************************************
+tBoolean
+InternalUSBDXferRxFrame(tUSBDXfer *psXfer)
+{
+    unsigned long ulMoved;
+
+    //
+    // Completion of the uDMA transfer is handled by the endpoint interrupt.
+    //
+    if((psXfer->eState != USBD_XFER_DMA) || !psXfer->ulIdleFrames ||
+       (MAP_uDMAChannelModeGet(psXfer->ucDMAChannel) == UDMA_MODE_STOP))
+    {
+        return(false);
+    }
+
+    //
+    // Restart the count whenever more data has arrived.
+    //
+    ulMoved = psXfer->ulCount + psXfer->ulChunk -
+              (MAP_uDMAChannelSizeGet(psXfer->ucDMAChannel) << 2);
+
+    if(ulMoved != psXfer->ulIdleMark)
+    {
+        psXfer->ulIdleMark = ulMoved;
+        psXfer->ulIdleCount = 0;
+        return(false);
+    }
+
+    if(!ulMoved || (++psXfer->ulIdleCount < psXfer->ulIdleFrames))
+    {
+        return(false);
+    }
+
+    //
+    // Stop the uDMA controller, which finishes any packet that it has
+    // started on.  If a packet arrived just now, carry on with the transfer.
+    //
+    MAP_uDMAChannelDisable(psXfer->ucDMAChannel);
+
+    if(MAP_USBEndpointStatus(psXfer->ulUSBBase, psXfer->ucEndpoint) &
+       USB_DEV_RX_PKT_RDY)
+    {
+        MAP_uDMAChannelEnable(psXfer->ucDMAChannel);
+        psXfer->ulIdleCount = 0;
+        return(false);
+    }
+
+    XferRxStop(psXfer);
+    XferDMAOff(psXfer);
+    psXfer->eState = USBD_XFER_IDLE;
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Determines whether the uDMA part of a transfer has finished.  The uDMA
+// completion raises the USB interrupt without setting any endpoint status, so
+// the endpoint interrupt handler of a class checks this for each transfer.
+//
+// \param psXfer is the transfer state.
+//
+// \return Returns \b true if the transfer's uDMA transfer has finished.
+//
+//*****************************************************************************
+tBoolean
+InternalUSBDXferDMADone(tUSBDXfer *psXfer)
+{
+    return(((psXfer->eState == USBD_XFER_DMA) &&
+            (MAP_uDMAChannelModeGet(psXfer->ucDMAChannel) ==
+             UDMA_MODE_STOP)) ? true : false);
+}
+
+//*****************************************************************************
+//
+// Abandons a transfer, as when the device is disconnected, and returns the
+// endpoint to normal packet operation.
+//
+// \param psXfer is the transfer state.
+//
+// \return None.
+//
+//*****************************************************************************
+void
+InternalUSBDXferAbort(tUSBDXfer *psXfer)
+{
+    if(psXfer->eState != USBD_XFER_IDLE)
+    {
+        MAP_uDMAChannelDisable(psXfer->ucDMAChannel);
+        XferDMAOff(psXfer);
+        psXfer->eState = USBD_XFER_IDLE;
+    }
+}
@@ -23,8 +23,10 @@
 //*****************************************************************************
 
 #include "inc/hw_types.h"
+#include "driverlib/interrupt.h"
 #include "driverlib/usb.h"
 #include "usblib/usblib.h"
+#include "usblib/usblibpriv.h"
 #include "usblib/usbmsc.h"
 #include "usblib/host/usbhost.h"
 #include "usblib/host/usbhmsc.h"
@@ -44,6 +46,39 @@
 //*****************************************************************************
 static void *USBHMSCOpen(tUSBHostDevice *pDevice);
 static void USBHMSCClose(void *pvInstance);
+static void USBHMSCMain(void *pvInstance);
+
+//*****************************************************************************
+//
+// The states of a request queued with USBHMSCRequestQueue().
+//
+//*****************************************************************************
+#define MSC_REQ_QUEUED          0   // Waiting for its CBW to be sent.
+#define MSC_REQ_CBW             1   // The CBW is being sent.
+#define MSC_REQ_CBW_SENT        2   // The CBW has been sent.
+#define MSC_REQ_DATA            3   // The data phase is in progress.
+#define MSC_REQ_CSW             4   // Waiting for the CSW.
+#define MSC_REQ_HALT            5   // The data phase stalled.
+#define MSC_REQ_CSW_HALT        6   // The first read of the CSW stalled.
+#define MSC_REQ_CSW_RETRY       7   // Reading the CSW for the second time.
+
+//*****************************************************************************
+//
+// The number of frames that MSCQueueIdle() waits for the request queue to
+// make progress before it fails the queued requests.
+//
+//*****************************************************************************
+#define MSC_QUEUE_TIMEOUT       20000
+
+//*****************************************************************************
+//
+// The pipe handle bit that indicates that the pipe was given a uDMA channel.
+// Queued requests clear it when they use the bulk IN pipe since the uDMA
+// channel always moves the full size asked for and so cannot report a short
+// packet.
+//
+//*****************************************************************************
+#define MSC_PIPE_UDMA           (USBHCD_PIPE_BULK_IN_DMA ^ USBHCD_PIPE_BULK_IN)
 
 //*****************************************************************************
 //
@@ -86,6 +121,70 @@ typedef struct
     // Bulk OUT pipe.
     //
     unsigned long ulBulkOutPipe;
+
+    //
+    // The maximum packet sizes of the bulk IN and bulk OUT endpoints.
+    //
+    unsigned long ulInMaxPacket;
+    unsigned long ulOutMaxPacket;
+
+    //
+    // The queue of requests made with USBHMSCRequestQueue().  The request at
+    // the head is the one in its data or status phase.
+    //
+    tUSBHMSCRequest * volatile psQueueHead;
+    tUSBHMSCRequest *psQueueTail;
+
+    //
+    // The request that has a packet scheduled on the bulk OUT pipe and the
+    // size of that packet.
+    //
+    tUSBHMSCRequest *psOutRequest;
+    unsigned long ulOutSize;
+
+    //
+    // The request that has a packet scheduled on the bulk IN pipe, the buffer
+    // that receives the packet and its size.
+    //
+    tUSBHMSCRequest *psInRequest;
+    unsigned char *pucInData;
+    unsigned long ulInSize;
+
+    //
+    // The tag given to the last queued command.
+    //
+    unsigned long ulTag;
+
+    //
+    // Set when a queued request failed and the device needs a reset before
+    // it can be used again.
+    //
+    tBoolean bRecover;
+
+    //
+    // Set while the callbacks of failed requests are being called.
+    //
+    tBoolean bFailing;
+
+    //
+    // Set by USBHMSCRequestOverlapSet() to send the next CBW while waiting
+    // for the current CSW, and set by the driver to stop doing so after a
+    // request fails while a CBW was sent early.
+    //
+    tBoolean bOverlap;
+    tBoolean bOverlapOff;
+
+    //
+    // The bulk pipe that stalled during a queued request and whose halt must
+    // be cleared from task context, or zero if there is none.
+    //
+    unsigned long ulHaltPipe;
+
+    //
+    // The CBW being sent and the CSW being received for queued requests.
+    //
+    tMSCCBW sCBW;
+    tMSCCSW sCSW;
 }
 tUSBHMSCInstance;
 
@@ -110,9 +209,527 @@ const tUSBHostClassDriver g_USBHostMSCClassDriver =
     USB_CLASS_MASS_STORAGE,
     USBHMSCOpen,
     USBHMSCClose,
-    0
+    0,
+    USBHMSCMain
 };
 
+//*****************************************************************************
+//
+// Schedules a single packet on the bulk IN pipe for a queued request.  The
+// packet is read from the FIFO in the pipe's callback, rather than by the
+// uDMA channel, so that the size of a short packet or a short CSW is known.
+//
+//*****************************************************************************
+static void
+MSCInSchedule(tUSBHMSCInstance *psInst, tUSBHMSCRequest *psRequest,
+              unsigned char *pucData, unsigned long ulSize)
+{
+    psInst->psInRequest = psRequest;
+    psInst->pucInData = pucData;
+    psInst->ulInSize = ulSize;
+
+    USBHCDPipeSchedule(psInst->ulBulkInPipe & ~MSC_PIPE_UDMA, 0, ulSize);
+}
+
+//*****************************************************************************
+//
+// Sends the CBW for a queued request.
+//
+//*****************************************************************************
+static void
+MSCCBWSend(tUSBHMSCInstance *psInst, tUSBHMSCRequest *psRequest)
+{
+    //
+    // Build the command in the instance's CBW, which is not in use since the
+    // OUT pipe is idle.
+    //
+    USBHSCSIRW10Build(&psInst->sCBW, psRequest->ulFlags & USBHMSC_REQ_WRITE,
+                      psRequest->ulLBA, psRequest->ulSize,
+                      psRequest->ulNumBlocks);
+    psRequest->ulTag = ++psInst->ulTag;
+    psInst->sCBW.dCBWTag = psRequest->ulTag;
+
+    psRequest->ulState = MSC_REQ_CBW;
+    psInst->psOutRequest = psRequest;
+    psInst->ulOutSize = sizeof(tMSCCBW);
+
+    USBHCDPipeSchedule(psInst->ulBulkOutPipe, (unsigned char *)&psInst->sCBW,
+                       sizeof(tMSCCBW));
+}
+
+//*****************************************************************************
+//
+// Sends the next CBW if the bulk OUT pipe is free.  This is either the CBW
+// for the request at the head of the queue or, if overlapped commands are
+// enabled and the head is waiting for its CSW, the CBW for the request behind
+// it.
+//
+//*****************************************************************************
+static void
+MSCQueueRun(tUSBHMSCInstance *psInst)
+{
+    tUSBHMSCRequest *psRequest;
+
+    psRequest = psInst->psQueueHead;
+
+    if((psRequest == 0) || psInst->psOutRequest)
+    {
+        return;
+    }
+
+    if(psRequest->ulState == MSC_REQ_QUEUED)
+    {
+        MSCCBWSend(psInst, psRequest);
+    }
+    else if(psInst->bOverlap && !psInst->bOverlapOff &&
+            (psRequest->ulState == MSC_REQ_CSW) && psRequest->psNext &&
+            (psRequest->psNext->ulState == MSC_REQ_QUEUED))
+    {
+        MSCCBWSend(psInst, psRequest->psNext);
+    }
+}
+
+//*****************************************************************************
+//
+// Moves the request at the head of the queue on to its next packet, or to
+// its status phase once all of its data has been transferred.
+//
+//*****************************************************************************
+static void
+MSCPhaseNext(tUSBHMSCInstance *psInst, tUSBHMSCRequest *psRequest)
+{
+    unsigned long ulSize;
+
+    ulSize = psRequest->ulSize - psRequest->ulCount;
+
+    if(ulSize)
+    {
+        if(psRequest->ulFlags & USBHMSC_REQ_WRITE)
+        {
+            if(ulSize > psInst->ulOutMaxPacket)
+            {
+                ulSize = psInst->ulOutMaxPacket;
+            }
+
+            psInst->psOutRequest = psRequest;
+            psInst->ulOutSize = ulSize;
+
+            USBHCDPipeSchedule(psInst->ulBulkOutPipe,
+                               psRequest->pucData + psRequest->ulCount,
+                               ulSize);
+        }
+        else
+        {
+            if(ulSize > psInst->ulInMaxPacket)
+            {
+                ulSize = psInst->ulInMaxPacket;
+            }
+
+            MSCInSchedule(psInst, psRequest,
+                          psRequest->pucData + psRequest->ulCount, ulSize);
+        }
+        return;
+    }
+
+    //
+    // Wait for the CSW and, since the OUT pipe is now free, send the CBW for
+    // the next request while it arrives if overlapped commands are enabled.
+    //
+    psRequest->ulState = MSC_REQ_CSW;
+    MSCInSchedule(psInst, psRequest, (unsigned char *)&psInst->sCSW,
+                  sizeof(tMSCCSW));
+    MSCQueueRun(psInst);
+}
+
+//*****************************************************************************
+//
+// Removes the request at the head of the queue, starts the data phase of the
+// next request if its CBW has already been sent and then calls the completed
+// request's callback.
+//
+//*****************************************************************************
+static void
+MSCRequestComplete(tUSBHMSCInstance *psInst, long lStatus)
+{
+    tUSBHMSCRequest *psRequest, *psNext;
+
+    psRequest = psInst->psQueueHead;
+    psNext = psRequest->psNext;
+    psInst->psQueueHead = psNext;
+    if(psNext == 0)
+    {
+        psInst->psQueueTail = 0;
+    }
+    psRequest->psNext = 0;
+
+    if(psNext && (psNext->ulState == MSC_REQ_CBW_SENT))
+    {
+        psNext->ulState = MSC_REQ_DATA;
+        MSCPhaseNext(psInst, psNext);
+    }
+    MSCQueueRun(psInst);
+
+    if(psRequest->pfnCallback)
+    {
+        psRequest->pfnCallback(psRequest, lStatus);
+    }
+}
+
+//*****************************************************************************
+//
+// Fails every queued request.  The device is left in an unknown state so it
+// is reset before the next command is sent.  If a CBW had been sent before
+// the previous CSW arrived, the device may not support overlapped commands so
+// they are turned off until USBHMSCRequestOverlapSet() is called again.
+//
+//*****************************************************************************
+static void
+MSCQueueFail(tUSBHMSCInstance *psInst)
+{
+    tUSBHMSCRequest *psRequest;
+
+    psInst->bRecover = true;
+    psInst->bFailing = true;
+    psInst->psOutRequest = 0;
+    psInst->psInRequest = 0;
+    psInst->ulHaltPipe = 0;
+
+    if(psInst->psQueueHead)
+    {
+        for(psRequest = psInst->psQueueHead->psNext; psRequest;
+            psRequest = psRequest->psNext)
+        {
+            if((psRequest->ulState == MSC_REQ_CBW) ||
+               (psRequest->ulState == MSC_REQ_CBW_SENT))
+            {
+                psInst->bOverlapOff = true;
+            }
+        }
+    }
+
+    while(psInst->psQueueHead)
+    {
+        psRequest = psInst->psQueueHead;
+        psInst->psQueueHead = psRequest->psNext;
+        psRequest->psNext = 0;
+
+        if(psRequest->pfnCallback)
+        {
+            psRequest->pfnCallback(psRequest, -1);
+        }
+    }
+    psInst->psQueueTail = 0;
+    psInst->bFailing = false;
+}
+
+//*****************************************************************************
+//
+// Handles a stall on one of the bulk pipes during the data or status phase
+// of the request at the head of the queue.  The queue stops until
+// MSCHaltClear() has cleared the halt from task context and then reads the
+// request's CSW.  A stall while reading the CSW for the second time fails the
+// queue.
+//
+//*****************************************************************************
+static void
+MSCHaltSet(tUSBHMSCInstance *psInst, tUSBHMSCRequest *psRequest,
+           unsigned long ulPipe)
+{
+    if(psRequest != psInst->psQueueHead)
+    {
+        MSCQueueFail(psInst);
+    }
+    else if(psRequest->ulState == MSC_REQ_DATA)
+    {
+        psRequest->ulState = MSC_REQ_HALT;
+        psInst->ulHaltPipe = ulPipe;
+    }
+    else if(psRequest->ulState == MSC_REQ_CSW)
+    {
+        psRequest->ulState = MSC_REQ_CSW_HALT;
+        psInst->ulHaltPipe = ulPipe;
+    }
+    else
+    {
+        MSCQueueFail(psInst);
+    }
+}
+
+//*****************************************************************************
+//
+// Clears the halt on a bulk pipe that stalled during a queued request and
+// then reads the request's CSW.  This makes a control transfer so it must be
+// called from task context.
+//
+//*****************************************************************************
+static void
+MSCHaltClear(tUSBHMSCInstance *psInst)
+{
+    tUSBHMSCRequest *psRequest;
+    unsigned long ulPipe;
+    tBoolean bIntsOff;
+
+    bIntsOff = IntMasterDisable();
+    ulPipe = psInst->ulHaltPipe;
+    psInst->ulHaltPipe = 0;
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    if(ulPipe == 0)
+    {
+        return;
+    }
+
+    USBHCDPipeReset(ulPipe);
+
+    //
+    // Read the CSW unless the queue failed, for example because the device
+    // was removed, while the halt was being cleared.
+    //
+    bIntsOff = IntMasterDisable();
+
+    psRequest = psInst->psQueueHead;
+    if(psRequest && (psRequest->ulState == MSC_REQ_HALT))
+    {
+        psRequest->ulState = MSC_REQ_CSW;
+        MSCInSchedule(psInst, psRequest, (unsigned char *)&psInst->sCSW,
+                      sizeof(tMSCCSW));
+        MSCQueueRun(psInst);
+    }
+    else if(psRequest && (psRequest->ulState == MSC_REQ_CSW_HALT))
+    {
+        psRequest->ulState = MSC_REQ_CSW_RETRY;
+        MSCInSchedule(psInst, psRequest, (unsigned char *)&psInst->sCSW,
+                      sizeof(tMSCCSW));
+    }
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+// The bulk OUT pipe callback, which handles the end of a CBW or of a data
+// packet for a queued write.
+//
+//*****************************************************************************
+static void
+MSCOutPipeCallback(unsigned long ulPipe, unsigned long ulEvent)
+{
+    tUSBHMSCInstance *psInst;
+    tUSBHMSCRequest *psRequest;
+
+    psInst = &g_USBHMSCDevice;
+
+    //
+    // Ignore events for the blocking commands, which poll the pipe.
+    //
+    psRequest = psInst->psOutRequest;
+    if(psRequest == 0)
+    {
+        return;
+    }
+    psInst->psOutRequest = 0;
+
+    //
+    // A stall during the data phase is cleared before the CSW is read.  A
+    // stalled CBW or any other error needs a reset to recover.
+    //
+    if((ulEvent == USB_EVENT_STALL) && (psRequest->ulState == MSC_REQ_DATA))
+    {
+        MSCHaltSet(psInst, psRequest, psInst->ulBulkOutPipe);
+        return;
+    }
+    if(ulEvent != USB_EVENT_TX_COMPLETE)
+    {
+        MSCQueueFail(psInst);
+        return;
+    }
+
+    if(psRequest->ulState == MSC_REQ_CBW)
+    {
+        //
+        // A CBW sent early for the next request waits for the current
+        // request's CSW before its data phase starts.
+        //
+        psRequest->ulState = MSC_REQ_CBW_SENT;
+        if(psRequest == psInst->psQueueHead)
+        {
+            psRequest->ulState = MSC_REQ_DATA;
+            MSCPhaseNext(psInst, psRequest);
+        }
+    }
+    else
+    {
+        psRequest->ulCount += psInst->ulOutSize;
+        MSCPhaseNext(psInst, psRequest);
+    }
+
+    MSCQueueRun(psInst);
+}
+
+//*****************************************************************************
+//
+// The bulk IN pipe callback, which handles a data packet for a queued read or
+// the CSW of any queued request.
+//
+//*****************************************************************************
+static void
+MSCInPipeCallback(unsigned long ulPipe, unsigned long ulEvent)
+{
+    tUSBHMSCInstance *psInst;
+    tUSBHMSCRequest *psRequest;
+    unsigned long ulSize;
+
+    psInst = &g_USBHMSCDevice;
+
+    //
+    // Ignore events for the blocking commands, which poll the pipe.
+    //
+    psRequest = psInst->psInRequest;
+    if(psRequest == 0)
+    {
+        return;
+    }
+    psInst->psInRequest = 0;
+
+    //
+    // A stall during the data phase, or the first stall of the CSW, is
+    // cleared before the CSW is read.
+    //
+    if(ulEvent == USB_EVENT_STALL)
+    {
+        MSCHaltSet(psInst, psRequest, psInst->ulBulkInPipe);
+        return;
+    }
+    if(ulEvent != USB_EVENT_RX_AVAILABLE)
+    {
+        MSCQueueFail(psInst);
+        return;
+    }
+
+    //
+    // Read the packet from the FIFO, which gives its actual size.
+    //
+    ulSize = USBHCDPipeReadNonBlocking(psInst->ulBulkInPipe & ~MSC_PIPE_UDMA,
+                                       psInst->pucInData, psInst->ulInSize);
+
+    if(psRequest->ulState == MSC_REQ_DATA)
+    {
+        //
+        // A short packet ends the data phase early.  The CSW residue reports
+        // the missing data.
+        //
+        psRequest->ulCount += ulSize;
+        if(ulSize < psInst->ulInSize)
+        {
+            psRequest->ulSize = psRequest->ulCount;
+        }
+        MSCPhaseNext(psInst, psRequest);
+        return;
+    }
+
+    //
+    // An invalid CSW or a phase error needs a reset to recover.
+    //
+    if((ulSize != sizeof(tMSCCSW)) ||
+       (psInst->sCSW.dCSWSignature != CSW_SIGNATURE) ||
+       (psInst->sCSW.dCSWTag != psRequest->ulTag) ||
+       (psInst->sCSW.bCSWStatus == CSWSTATUS_PHASE_ERROR))
+    {
+        MSCQueueFail(psInst);
+        return;
+    }
+
+    MSCRequestComplete(psInst,
+                       ((psInst->sCSW.bCSWStatus == CSWSTATUS_CMD_SUCCESS) &&
+                        (psInst->sCSW.dCSWDataResidue == 0)) ? 0 : -1);
+}
+
+//*****************************************************************************
+//
+// Waits for the request queue to drain and, if a queued request failed,
+// performs a bulk-only mass storage reset and clears the halt on both bulk
+// pipes.  This is called before any command is sent from task context and
+// must not be called from interrupt context.  It clears any halt that stops
+// the queue itself and fails the queue if it makes no progress for
+// MSC_QUEUE_TIMEOUT frames.
+//
+//*****************************************************************************
+static void
+MSCQueueIdle(tUSBHMSCInstance *psInst)
+{
+    tUSBRequest SetupPacket;
+    tUSBHMSCRequest *psRequest, *psLast;
+    unsigned long ulFrame, ulCount, ulState;
+    tBoolean bIntsOff;
+
+    psLast = 0;
+    ulCount = 0;
+    ulState = 0;
+    ulFrame = g_ulUSBSOFCount;
+
+    while(1)
+    {
+        MSCHaltClear(psInst);
+
+        bIntsOff = IntMasterDisable();
+
+        psRequest = psInst->psQueueHead;
+        if(psRequest == 0)
+        {
+            if(!bIntsOff)
+            {
+                IntMasterEnable();
+            }
+            break;
+        }
+
+        //
+        // Restart the timeout whenever the head of the queue moves on.
+        //
+        if((psRequest != psLast) || (psRequest->ulCount != ulCount) ||
+           (psRequest->ulState != ulState))
+        {
+            psLast = psRequest;
+            ulCount = psRequest->ulCount;
+            ulState = psRequest->ulState;
+            ulFrame = g_ulUSBSOFCount;
+        }
+        else if((g_ulUSBSOFCount - ulFrame) > MSC_QUEUE_TIMEOUT)
+        {
+            MSCQueueFail(psInst);
+        }
+
+        if(!bIntsOff)
+        {
+            IntMasterEnable();
+        }
+    }
+
+    if(psInst->bRecover)
+    {
+        SetupPacket.bmRequestType =
+            USB_RTYPE_DIR_OUT | USB_RTYPE_CLASS | USB_RTYPE_INTERFACE;
+        SetupPacket.bRequest = USBREQ_MSC_RESET;
+        SetupPacket.wValue = 0;
+        SetupPacket.wIndex = (unsigned short)psInst->pDevice->ulInterface;
+        SetupPacket.wLength = 0;
+
+        USBHCDControlTransfer(0, &SetupPacket, psInst->pDevice, 0, 0,
+                              MAX_PACKET_SIZE_EP0);
+
+        USBHCDPipeReset(psInst->ulBulkInPipe);
+        USBHCDPipeReset(psInst->ulBulkOutPipe);
+
+        psInst->bRecover = false;
+    }
+}
+
 //*****************************************************************************
 //
 //! This function is used to open an instance of the MSC driver.
@@ -148,6 +765,18 @@ USBHMSCOpen(tUSBHostDevice *pDevice)
     //
     g_USBHMSCDevice.pDevice = pDevice;
 
+    //
+    // Start with an empty request queue.
+    //
+    g_USBHMSCDevice.psQueueHead = 0;
+    g_USBHMSCDevice.psQueueTail = 0;
+    g_USBHMSCDevice.psOutRequest = 0;
+    g_USBHMSCDevice.psInRequest = 0;
+    g_USBHMSCDevice.bRecover = false;
+    g_USBHMSCDevice.bFailing = false;
+    g_USBHMSCDevice.bOverlapOff = false;
+    g_USBHMSCDevice.ulHaltPipe = 0;
+
     //
     // Get the interface descriptor.
     //
@@ -191,7 +820,10 @@ USBHMSCOpen(tUSBHostDevice *pDevice)
                     USBHCDPipeAllocSize(0, USBHCD_PIPE_BULK_IN_DMA,
                                         pDevice,
                                         pEndpointDescriptor->wMaxPacketSize,
-                                        0);
+                                        MSCInPipeCallback);
+                g_USBHMSCDevice.ulInMaxPacket =
+                    pEndpointDescriptor->wMaxPacketSize;
+
                 //
                 // Configure the USB pipe as a Bulk IN endpoint.
                 //
@@ -210,7 +842,10 @@ USBHMSCOpen(tUSBHostDevice *pDevice)
                     USBHCDPipeAllocSize(0, USBHCD_PIPE_BULK_OUT_DMA,
                                         pDevice,
                                         pEndpointDescriptor->wMaxPacketSize,
-                                        0);
+                                        MSCOutPipeCallback);
+                g_USBHMSCDevice.ulOutMaxPacket =
+                    pEndpointDescriptor->wMaxPacketSize;
+
                 //
                 // Configure the USB pipe as a Bulk OUT endpoint.
                 //
@@ -257,6 +892,8 @@ USBHMSCOpen(tUSBHostDevice *pDevice)
 static void
 USBHMSCClose(void *pvInstance)
 {
+    tBoolean bIntsOff;
+
     //
     // Do nothing if there is not a driver open.
     //
@@ -265,6 +902,17 @@ USBHMSCClose(void *pvInstance)
         return;
     }
 
+    //
+    // Fail any queued requests.  There is no device left to reset.
+    //
+    bIntsOff = IntMasterDisable();
+    MSCQueueFail(&g_USBHMSCDevice);
+    g_USBHMSCDevice.bRecover = false;
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
     //
     // Reset the device pointer.
     //
@@ -296,6 +944,32 @@ USBHMSCClose(void *pvInstance)
     }
 }
 
+//*****************************************************************************
+//
+//! This function is called by the host controller driver from USBHCDMain().
+//!
+//! \param pvInstance is the instance pointer returned by USBHMSCOpen().
+//!
+//! This function clears the halt on a bulk pipe that stalled during a request
+//! queued with USBHMSCRequestQueue(), which cannot be done from the pipe's
+//! callback, and then lets the request's status be read.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+USBHMSCMain(void *pvInstance)
+{
+    tUSBHMSCInstance *pMSCDevice;
+
+    pMSCDevice = (tUSBHMSCInstance *)pvInstance;
+
+    if(pMSCDevice->pDevice)
+    {
+        MSCHaltClear(pMSCDevice);
+    }
+}
+
 //*****************************************************************************
 //
 //! This function retrieves the maximum number of the logical units on a
@@ -388,6 +1062,11 @@ USBHMSCDriveReady(unsigned long ulInstance)
         return(-1);
     }
 
+    //
+    // Let queued requests finish first.
+    //
+    MSCQueueIdle(pMSCDevice);
+
     //
     // Only request the maximum number of LUNs once.
     //
@@ -622,6 +1301,11 @@ USBHMSCBlockRead(unsigned long ulInstance, unsigned long ulLBA,
         return(-1);
     }
 
+    //
+    // Let queued requests finish first.
+    //
+    MSCQueueIdle(pMSCDevice);
+
     //
     // Calculate the actual byte size of the read.
     //
@@ -684,6 +1368,11 @@ USBHMSCBlockWrite(unsigned long ulInstance, unsigned long ulLBA,
         return(-1);
     }
 
+    //
+    // Let queued requests finish first.
+    //
+    MSCQueueIdle(pMSCDevice);
+
     //
     // Calculate the actual byte size of the write.
     //
@@ -705,6 +1394,181 @@ USBHMSCBlockWrite(unsigned long ulInstance, unsigned long ulLBA,
     return(0);
 }
 
+//*****************************************************************************
+//
+//! This function queues a block read or write to an MSC device.
+//!
+//! \param ulInstance is the device instance to use for this request.
+//! \param psRequest is a pointer to the request to queue.
+//!
+//! This function adds the block read or write described by \e psRequest to
+//! the device's request queue and returns without waiting for it.  Queued
+//! requests are carried out in order from the USB interrupt, and each
+//! request's \e pfnCallback is called from interrupt context when it
+//! completes, with zero if the command succeeded or -1 if it failed.  The
+//! caller must not change or reuse \e psRequest until then.
+//!
+//! New requests may be queued from the callback.  If overlapped commands
+//! were enabled with USBHMSCRequestOverlapSet(), the command for the next
+//! request is sent while a request waits for its status from the device.
+//!
+//! If the device stalls a request's data or status phase, the halt is
+//! cleared from USBHCDMain() and the request's status is then read, so the
+//! application must keep calling USBHCDMain() while requests are queued.
+//! USBHMSCBlockRead(), USBHMSCBlockWrite() and USBHMSCDriveReady() wait for
+//! the queue to drain before sending their own command, clearing any halt
+//! themselves, and fail the queued requests if the queue makes no progress
+//! for 20 seconds.
+//!
+//! If a request fails, all queued requests fail with it and the next call to
+//! this function, USBHMSCBlockRead(), USBHMSCBlockWrite() or
+//! USBHMSCDriveReady() resets the device before continuing.  That call
+//! blocks and so must not be made from interrupt context.
+//!
+//! \return The function returns zero if the request was queued or -1 if no
+//! device is present or if it is called from the callback of a failed
+//! request.
+//
+//*****************************************************************************
+long
+USBHMSCRequestQueue(unsigned long ulInstance, tUSBHMSCRequest *psRequest)
+{
+    tUSBHMSCInstance *pMSCDevice;
+    tBoolean bIntsOff;
+
+    //
+    // Get the instance pointer in a more usable form.
+    //
+    pMSCDevice = (tUSBHMSCInstance *)ulInstance;
+
+    //
+    // If there is no device present then return an error.
+    //
+    if(pMSCDevice->pDevice == 0)
+    {
+        return(-1);
+    }
+
+    //
+    // Reset the device if an earlier request failed.  This cannot be done
+    // from the callbacks of the failed requests, which run in interrupt
+    // context.
+    //
+    if(pMSCDevice->bFailing)
+    {
+        return(-1);
+    }
+    if(pMSCDevice->bRecover)
+    {
+        MSCQueueIdle(pMSCDevice);
+    }
+
+    psRequest->psNext = 0;
+    psRequest->ulSize = pMSCDevice->ulBlockSize * psRequest->ulNumBlocks;
+    psRequest->ulCount = 0;
+    psRequest->ulState = MSC_REQ_QUEUED;
+
+    //
+    // Add the request to the end of the queue and start it if the bus is
+    // free.
+    //
+    bIntsOff = IntMasterDisable();
+
+    if(pMSCDevice->psQueueTail)
+    {
+        pMSCDevice->psQueueTail->psNext = psRequest;
+    }
+    else
+    {
+        pMSCDevice->psQueueHead = psRequest;
+    }
+    pMSCDevice->psQueueTail = psRequest;
+
+    MSCQueueRun(pMSCDevice);
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+//! This function returns the number of requests queued to an MSC device.
+//!
+//! \param ulInstance is the device instance to check.
+//!
+//! This function returns the number of requests queued with
+//! USBHMSCRequestQueue() whose callbacks have not yet been called, including
+//! the request currently being transferred.
+//!
+//! \return The number of requests pending.
+//
+//*****************************************************************************
+unsigned long
+USBHMSCRequestsPending(unsigned long ulInstance)
+{
+    tUSBHMSCInstance *pMSCDevice;
+    tUSBHMSCRequest *psRequest;
+    unsigned long ulCount;
+    tBoolean bIntsOff;
+
+    pMSCDevice = (tUSBHMSCInstance *)ulInstance;
+
+    ulCount = 0;
+
+    bIntsOff = IntMasterDisable();
+
+    for(psRequest = pMSCDevice->psQueueHead; psRequest;
+        psRequest = psRequest->psNext)
+    {
+        ulCount++;
+    }
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    return(ulCount);
+}
+
+//*****************************************************************************
+//
+//! This function enables or disables overlapped commands for queued requests.
+//!
+//! \param ulInstance is the device instance to configure.
+//! \param bOverlap is \b true to send the command for the next queued request
+//! while the current request waits for its status, or \b false to wait for
+//! the status first.
+//!
+//! Sending the next command block wrapper before the current command status
+//! wrapper has been read keeps the bus busy between requests, but the
+//! bulk-only transport specification requires the host to read the status
+//! first.  Devices that do not accept the early command may stall it, report
+//! a phase error or stop responding, so overlapped commands are disabled by
+//! default and should only be enabled for devices known to handle them.
+//!
+//! If a request fails while a command was sent early, the driver disables
+//! overlapped commands again after resetting the device.  Calling this
+//! function with \e bOverlap set to \b true enables them again.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBHMSCRequestOverlapSet(unsigned long ulInstance, tBoolean bOverlap)
+{
+    tUSBHMSCInstance *pMSCDevice;
+
+    pMSCDevice = (tUSBHMSCInstance *)ulInstance;
+
+    pMSCDevice->bOverlap = bOverlap;
+    pMSCDevice->bOverlapOff = false;
+}
+
 //*****************************************************************************
 //
 // Close the Doxygen group.
@@ -61,6 +61,76 @@ typedef void (*tUSBHMSCCallback)(unsigned long ulInstance,
                                  unsigned long ulEvent,
                                  void *pvEventData);
 
+//*****************************************************************************
+//
+// Values for the ulFlags member of tUSBHMSCRequest.
+//
+//*****************************************************************************
+#define USBHMSC_REQ_READ        0x00000000
+#define USBHMSC_REQ_WRITE       0x00000001
+
+typedef struct _tUSBHMSCRequest tUSBHMSCRequest;
+
+//*****************************************************************************
+//
+// The prototype for the function called when a queued request completes.
+// \e lStatus is zero if the command succeeded or -1 if it failed.
+//
+//*****************************************************************************
+typedef void (*tUSBHMSCRequestCallback)(tUSBHMSCRequest *psRequest,
+                                        long lStatus);
+
+//*****************************************************************************
+//
+//! This structure describes one block read or write queued with
+//! USBHMSCRequestQueue().  The application owns the structure and must not
+//! change it, or reuse it, until its callback has been called.
+//
+//*****************************************************************************
+struct _tUSBHMSCRequest
+{
+    //
+    //! The logical block address of the first block to transfer.
+    //
+    unsigned long ulLBA;
+
+    //
+    //! The number of blocks to transfer.
+    //
+    unsigned long ulNumBlocks;
+
+    //
+    //! The buffer holding the data to write or receiving the data read.  It
+    //! must hold \e ulNumBlocks blocks.
+    //
+    unsigned char *pucData;
+
+    //
+    //! USBHMSC_REQ_READ or USBHMSC_REQ_WRITE.
+    //
+    unsigned long ulFlags;
+
+    //
+    //! The function called from interrupt context when the request completes
+    //! or fails.
+    //
+    tUSBHMSCRequestCallback pfnCallback;
+
+    //
+    //! A value for the application's use, which is not used by the driver.
+    //
+    void *pvCBData;
+
+    //
+    // The following members are private to the driver.
+    //
+    tUSBHMSCRequest *psNext;
+    unsigned long ulTag;
+    unsigned long ulSize;
+    unsigned long ulCount;
+    unsigned long ulState;
+};
+
 //*****************************************************************************
 //
 // Prototypes for the USB MSC host driver APIs.
@@ -76,6 +146,11 @@ extern long USBHMSCBlockRead(unsigned long ulInstance, unsigned long ulLBA,
 extern long USBHMSCBlockWrite(unsigned long ulInstance, unsigned long ulLBA,
                               unsigned char *pucData,
                               unsigned long ulNumBlocks);
+extern long USBHMSCRequestQueue(unsigned long ulInstance,
+                                tUSBHMSCRequest *psRequest);
+extern unsigned long USBHMSCRequestsPending(unsigned long ulInstance);
+extern void USBHMSCRequestOverlapSet(unsigned long ulInstance,
+                                     tBoolean bOverlap);
 
 //*****************************************************************************
 //
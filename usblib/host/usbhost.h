@@ -129,6 +129,58 @@ const tUSBHostClassDriver VarName =                                         \
 typedef void (* tHCDPipeCallback)(unsigned long ulPipe,
                                   unsigned long ulEvent);
 
+//*****************************************************************************
+//
+//! This structure holds the FIFO memory allocation statistics returned by
+//! USBHCDFIFOStatsGet().  All sizes are in bytes.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The size of the controller's FIFO memory, including the 64 bytes used
+    //! by endpoint 0.
+    //
+    unsigned long ulTotal;
+
+    //
+    //! The FIFO memory that is not allocated.
+    //
+    unsigned long ulFree;
+
+    //
+    //! The largest FIFO that could be allocated now.
+    //
+    unsigned long ulLargestFree;
+
+    //
+    //! The lowest value that ulFree has reached.
+    //
+    unsigned long ulMinFree;
+
+    //
+    //! The number of FIFO allocations made.
+    //
+    unsigned long ulAllocs;
+
+    //
+    //! The number of FIFO allocations that failed for lack of space.
+    //
+    unsigned long ulFailures;
+
+    //
+    //! The number of bulk or isochronous pipes given a double buffered FIFO.
+    //
+    unsigned long ulDoubleBuffered;
+
+    //
+    //! The number of bulk or isochronous pipes given a single buffered FIFO
+    //! because there was no room for a double buffered one.
+    //
+    unsigned long ulSingleBuffered;
+}
+tUSBHCDFIFOStats;
+
 //*****************************************************************************
 //
 //! This is the structure that holds all of the information for devices
@@ -223,6 +275,14 @@ typedef struct
     //! endpoint associated with this device instance generates an interrupt.
     //
     void (*pfnIntHandler)(void *pvInstance);
+
+    //
+    //! This is the optional function that is called from USBHCDMain() for
+    //! each device instance that uses this class driver.  It lets the class
+    //! driver carry out work, such as control transfers, that blocks and so
+    //! cannot be done from its pipe callbacks.
+    //
+    void (*pfnMain)(void *pvInstance);
 }
 tUSBHostClassDriver;
 
@@ -281,6 +341,9 @@ extern void USBHCDSuspend(unsigned long ulIndex);
 extern void USBHCDResume(unsigned long ulIndex);
 extern void USBHCDReset(unsigned long ulIndex);
 extern void USBHCDPipeFree(unsigned long ulPipe);
+extern void USBHCDPipeReset(unsigned long ulPipe);
+extern void USBHCDFIFOStatsGet(unsigned long ulIndex,
+                               tUSBHCDFIFOStats *psStats);
 extern unsigned long USBHCDPipeAlloc(unsigned long ulIndex,
                                      unsigned long ulEndpointType,
                                      tUSBHostDevice *psDevice,
@@ -729,12 +729,131 @@ SendUnknownConnect(unsigned long ulIndex, unsigned long ulClass)
 
 //*****************************************************************************
 //
-// Internal memory allocation space is two unsigned long values where each
-// bit represents a 64 byte block in the FIFO.  This requires 64 bits for
-// the 4096 bytes of FIFO available.
+// The size of the USB controller's endpoint FIFO RAM.  Parts with 2 KB of
+// FIFO RAM, such as the LM4F120, should define this as 2048 when building the
+// library.
 //
 //*****************************************************************************
-static unsigned long g_ulAlloc[2];
+#ifndef USBHCD_FIFO_RAM_SIZE
+#define USBHCD_FIFO_RAM_SIZE    4096
+#endif
+
+//*****************************************************************************
+//
+// FIFO memory is handed out by a buddy allocator in 64 byte blocks.  Every
+// allocation is a power of two number of blocks aligned to its own size, so a
+// freed allocation merges back with its buddy as soon as both are free.  Each
+// bit of g_pulFIFOAlloc is set while the corresponding block is in use.
+//
+//*****************************************************************************
+#define FIFO_BLOCK_SIZE         64
+#define FIFO_NUM_BLOCKS         (USBHCD_FIFO_RAM_SIZE / FIFO_BLOCK_SIZE)
+
+static unsigned long g_pulFIFOAlloc[(FIFO_NUM_BLOCKS + 31) / 32];
+
+//*****************************************************************************
+//
+// The FIFO allocation statistics returned by USBHCDFIFOStatsGet().
+//
+//*****************************************************************************
+static tUSBHCDFIFOStats g_sFIFOStats;
+
+//*****************************************************************************
+//
+// Returns true if the ulCount FIFO blocks starting at ulBlock are all free.
+//
+//*****************************************************************************
+static tBoolean
+FIFOBlocksFree(unsigned long ulBlock, unsigned long ulCount)
+{
+    for(; ulCount; ulBlock++, ulCount--)
+    {
+        if(g_pulFIFOAlloc[ulBlock / 32] & (1 << (ulBlock % 32)))
+        {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Marks the ulCount FIFO blocks starting at ulBlock as used or free.
+//
+//*****************************************************************************
+static void
+FIFOBlocksMark(unsigned long ulBlock, unsigned long ulCount, tBoolean bUsed)
+{
+    for(; ulCount; ulBlock++, ulCount--)
+    {
+        if(bUsed)
+        {
+            g_pulFIFOAlloc[ulBlock / 32] |= (1 << (ulBlock % 32));
+        }
+        else
+        {
+            g_pulFIFOAlloc[ulBlock / 32] &= ~(1 << (ulBlock % 32));
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Finds room for an allocation of ulCount FIFO blocks, where ulCount is a
+// power of two.
+//
+// A buddy allocator satisfies a request by splitting the smallest free block
+// that is large enough, which keeps large blocks whole for later requests.
+// Each free, aligned run of ulCount blocks is checked for the size of the
+// largest free buddy block that contains it and the run inside the smallest
+// such block, lowest address first, is chosen.
+//
+// \return The first block of the allocation or FIFO_NUM_BLOCKS if there is
+// no room.
+//
+//*****************************************************************************
+static unsigned long
+FIFOBlockFind(unsigned long ulCount)
+{
+    unsigned long ulBlock, ulBest, ulBestSize, ulSize;
+
+    ulBest = FIFO_NUM_BLOCKS;
+    ulBestSize = FIFO_NUM_BLOCKS * 2;
+
+    for(ulBlock = 0; ulBlock < FIFO_NUM_BLOCKS; ulBlock += ulCount)
+    {
+        if(!FIFOBlocksFree(ulBlock, ulCount))
+        {
+            continue;
+        }
+
+        //
+        // Find the size of the largest free buddy block holding this run.
+        //
+        ulSize = ulCount;
+        while((ulSize < FIFO_NUM_BLOCKS) &&
+              FIFOBlocksFree(ulBlock & ~((ulSize * 2) - 1), ulSize * 2))
+        {
+            ulSize *= 2;
+        }
+
+        if(ulSize < ulBestSize)
+        {
+            ulBest = ulBlock;
+            ulBestSize = ulSize;
+
+            //
+            // Nothing can fit better than an exactly sized free block.
+            //
+            if(ulSize == ulCount)
+            {
+                break;
+            }
+        }
+    }
+
+    return(ulBest);
+}
 
 //*****************************************************************************
 //
@@ -745,33 +864,18 @@ static unsigned long g_ulAlloc[2];
 static void
 FIFOFree(tUSBHCDPipe *pUSBPipe)
 {
-    unsigned long ulMask;
+    unsigned long ulCount;
 
     //
-    // Calculate the mask value to use to clear off the allocated blocks used
-    // by the USB pipe specified by pUSBPipe.
+    // Release the blocks used by the pipe.  They merge with their buddies
+    // because the blocks' bits are all that records the allocation.
     //
-    ulMask = (1 << (pUSBPipe->ucFIFOSize - 2)) - 1;
-    ulMask = ulMask << pUSBPipe->ucFIFOBitOffset;
+    ulCount = USB_FIFO_SZ_TO_BYTES(pUSBPipe->ucFIFOSize) / FIFO_BLOCK_SIZE;
+    FIFOBlocksMark(pUSBPipe->ucFIFOBitOffset, ulCount, false);
 
-    //
-    // Determine which 32 bit word to access based on the size.
-    //
-    if(pUSBPipe->ucFIFOSize > USB_FIFO_SZ_64)
-    {
-        //
-        // If the FIFO size is greater than 64 then use the upper 32 bits.
-        //
-        g_ulAlloc[1] &= ~ulMask;
-    }
-    else
-    {
-        //
-        // If the FIFO size is less than or equal to 64 then use the lower
-        // 32 bits.
-        //
-        g_ulAlloc[0] &= ~ulMask;
-    }
+    g_sFIFOStats.ulFree += ulCount * FIFO_BLOCK_SIZE;
+
+    pUSBPipe->ucFIFOSize = 0;
 }
 
 //*****************************************************************************
@@ -781,158 +885,97 @@ FIFOFree(tUSBHCDPipe *pUSBPipe)
 // \param pUSBPipe is the USB pipe that needs FIFO memory allocated.
 // \param ulSize is the minimum size in bytes of the FIFO to allocate.
 //
-// This function will allocate \e ulSize bytes to the USB pipe in the
+// This function will allocate at least \e ulSize bytes to the USB pipe in the
 // \e pUSBPipe parameter.  The function will fill the pUSBPipe structure
-// members ucFIFOSize and ucFIFOAddr with values that can be used with the
-// USBFIFOConfigSet() API.  This allocation uses a first fit algorithm.
+// members ucFIFOSize and usFIFOAddr with values that can be used with the
+// USBFIFOConfigSet() API.  Bulk and isochronous pipes are given a double
+// buffered FIFO when there is room for one, so that the controller can move
+// one packet while the other is being handled, and fall back to a single
+// buffered FIFO otherwise.
 //
-// \return This function returns the size of the block allocated.
+// \return This function returns the number of bytes of FIFO memory allocated
+// or zero if there was no room.
 //
 //*****************************************************************************
 static unsigned long
 FIFOAlloc(tUSBHCDPipe *pUSBPipe, unsigned long ulSize)
 {
-    unsigned long ulBlocks, ulStart, ulBlockSize;
-    unsigned short usFIFOAddr;
-    unsigned long ulTemp, ulIndex;
+    unsigned long ulFIFOSize, ulBlock, ulCount;
 
     //
-    // Save which 32 bit value to access, the upper is for blocks greater
-    // than 64 and the lower is for block 64 or less.
+    // Find the FIFO size for one packet.  The smallest FIFO allocated is a
+    // single 64 byte block.
     //
-    if(ulSize > 64)
-    {
-        ulIndex = 1;
-    }
-    else
+    ulFIFOSize = USB_FIFO_SZ_64;
+    while((USB_FIFO_SZ_TO_BYTES(ulFIFOSize) < ulSize) &&
+          (ulFIFOSize < USB_FIFO_SZ_4096))
     {
-        ulIndex = 0;
+        ulFIFOSize++;
     }
+    ulCount = USB_FIFO_SZ_TO_BYTES(ulFIFOSize) / FIFO_BLOCK_SIZE;
+    ulBlock = FIFO_NUM_BLOCKS;
 
     //
-    // Initial FIFO address is 0.
-    //
-    usFIFOAddr = 0;
-
-    //
-    // Initialize the bit pattern and bit location.
+    // Try for a double buffered FIFO first on bulk and isochronous pipes.
     //
-    ulBlocks = 1;
-    ulStart = 0;
-
-    //
-    // The initial block size is always the minimum size of 64 bytes.
-    //
-    ulBlockSize = 64;
-
-    //
-    // The initial size and offset are 64 and 0.
-    //
-    pUSBPipe->ucFIFOBitOffset = 0;
-    pUSBPipe->ucFIFOSize = 3;
-
-    //
-    // Scan through 32 bits looking for a memory block large enough to fill
-    // the request.
-    //
-    while(usFIFOAddr <= 32)
+    if((pUSBPipe->ulType & (EP_PIPE_TYPE_BULK | EP_PIPE_TYPE_ISOC)) &&
+       (ulCount * 2 <= FIFO_NUM_BLOCKS))
     {
-        //
-        // If the pattern is zero then it is a possible match.
-        //
-        if((g_ulAlloc[ulIndex] & ulBlocks) == 0)
-        {
-            //
-            // If the size is large enough then save it and break out of the
-            // loop.
-            //
-            if(ulBlockSize >= ulSize)
-            {
-                //
-                // Mark the memory as allocated.
-                //
-                g_ulAlloc[ulIndex] |= ulBlocks;
-
-                break;
-            }
-
-            //
-            // Increment the size of the FIFO block.
-            //
-            pUSBPipe->ucFIFOSize++;
+        ulBlock = FIFOBlockFind(ulCount * 2);
 
-            //
-            // Add in a new bit to the size of the allocation.
-            //
-            ulBlocks = ulBlocks | (ulBlocks << 1) ;
-
-            //
-            // Double the current size.
-            //
-            ulBlockSize <<= 1;
-
-        }
-        else
+        if(ulBlock != FIFO_NUM_BLOCKS)
         {
-            //
-            // Need to start over looking because the last allocation match
-            // failed, so reset the bit offset to the current location and the
-            // size to 64 bytes.
-            //
-            pUSBPipe->ucFIFOBitOffset = usFIFOAddr;
-            pUSBPipe->ucFIFOSize = 3;
+            ulFIFOSize |= USB_FIFO_SIZE_DB_FLAG;
+            ulCount *= 2;
+            g_sFIFOStats.ulDoubleBuffered++;
+        }
+    }
 
-            //
-            // Reset the block size to the minimum (64 bytes).
-            //
-            ulBlockSize = 64;
+    if((ulBlock == FIFO_NUM_BLOCKS) && (ulCount <= FIFO_NUM_BLOCKS))
+    {
+        ulBlock = FIFOBlockFind(ulCount);
 
-            //
-            // Store the current starting bit location and set the block mask
-            // to this value.
-            //
-            ulStart = 1 << usFIFOAddr;
-            ulBlocks = ulStart;
+        if((ulBlock != FIFO_NUM_BLOCKS) &&
+           (pUSBPipe->ulType & (EP_PIPE_TYPE_BULK | EP_PIPE_TYPE_ISOC)))
+        {
+            g_sFIFOStats.ulSingleBuffered++;
         }
-
-        //
-        // Increase the address of the FIFO offset.
-        //
-        usFIFOAddr++;
     }
 
     //
     // If there was no block large enough then fail this call.
     //
-    if(usFIFOAddr > 32)
+    if(ulBlock == FIFO_NUM_BLOCKS)
     {
-        ulBlockSize = 0;
+        g_sFIFOStats.ulFailures++;
+
         pUSBPipe->usFIFOAddr = 0;
         pUSBPipe->ucFIFOBitOffset = 0;
         pUSBPipe->ucFIFOSize = 0;
+
+        return(0);
     }
-    else
-    {
-        //
-        // Calculate the offset in the FIFO.
-        //
-        ulTemp = pUSBPipe->ucFIFOBitOffset * 64;
 
-        //
-        // Sizes greater than 64 are allocated in the second half of the FIFO
-        // memory space.
-        //
-        if(ulSize > 64)
-        {
-            ulTemp += 2048;
-        }
+    //
+    // Mark the memory as allocated.
+    //
+    FIFOBlocksMark(ulBlock, ulCount, true);
 
-        //
-        // Convert this to the value that can be set in the USB controller.
-        //
-        pUSBPipe->usFIFOAddr = (unsigned short)ulTemp;
+    pUSBPipe->ucFIFOBitOffset = (unsigned char)ulBlock;
+    pUSBPipe->ucFIFOSize = (unsigned char)ulFIFOSize;
+    pUSBPipe->usFIFOAddr = (unsigned short)(ulBlock * FIFO_BLOCK_SIZE);
+
+    //
+    // Update the statistics.
+    //
+    g_sFIFOStats.ulAllocs++;
+    g_sFIFOStats.ulFree -= ulCount * FIFO_BLOCK_SIZE;
+    if(g_sFIFOStats.ulFree < g_sFIFOStats.ulMinFree)
+    {
+        g_sFIFOStats.ulMinFree = g_sFIFOStats.ulFree;
     }
-    return(ulBlockSize);
+
+    return(ulCount * FIFO_BLOCK_SIZE);
 }
 
 //*****************************************************************************
@@ -2279,6 +2322,127 @@ USBHCDPipeRead(unsigned long ulPipe, unsigned char *pucData,
     return(ulSize);
 }
 
+//*****************************************************************************
+//
+//! This function is used to return a USB pipe to its initial state.
+//!
+//! \param ulPipe is the USB pipe to reset.
+//!
+//! This function abandons any transaction that is in progress on the pipe by
+//! stopping its uDMA channel and flushing its FIFO, clears any halt condition
+//! on the device's endpoint with a CLEAR_FEATURE(ENDPOINT_HALT) request and
+//! resets the data toggle of both the endpoint and the pipe.  It is used by
+//! class drivers to recover a pipe after a stall or a transfer error that
+//! was reported to the pipe's callback, where the blocking transfer
+//! functions would have done this themselves.
+//!
+//! This function makes a control transfer and blocks until it completes so
+//! it must not be called from the pipe's callback or any other interrupt
+//! handler.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBHCDPipeReset(unsigned long ulPipe)
+{
+    unsigned long ulPipeIdx, ulEndpoint;
+
+    ulPipeIdx = ulPipe & EP_PIPE_IDX_M;
+    ulEndpoint = INDEX_TO_USB_EP(ulPipeIdx + 1);
+
+    if(ulPipe & EP_PIPE_TYPE_OUT)
+    {
+        //
+        // Stop any uDMA transfer and drop any packet waiting to be sent.
+        //
+        if(ulPipe & EP_PIPE_USE_UDMA)
+        {
+            MAP_uDMAChannelDisable(UDMA_CHANNEL_USBEP1TX + (ulPipeIdx * 2));
+            g_ulDMAPending &= ~(DMA_PEND_TRANSMIT_FLAG << ulPipeIdx);
+        }
+        MAP_USBFIFOFlush(USB0_BASE, ulEndpoint, USB_EP_HOST_OUT);
+
+        //
+        // A double buffered FIFO may hold a second packet.
+        //
+        if(g_sUSBHCD.USBOUTPipes[ulPipeIdx].ucFIFOSize & USB_FIFO_SIZE_DB_FLAG)
+        {
+            MAP_USBFIFOFlush(USB0_BASE, ulEndpoint, USB_EP_HOST_OUT);
+        }
+        g_sUSBHCD.USBOUTPipes[ulPipeIdx].eState = PIPE_IDLE;
+
+        USBHCDClearFeature(g_sUSBHCD.USBOUTPipes[ulPipeIdx].psDevice->ulAddress,
+                           ulPipe, USB_FEATURE_EP_HALT);
+    }
+    else
+    {
+        //
+        // Stop any uDMA transfer and drop any packet that was received.
+        //
+        if(ulPipe & EP_PIPE_USE_UDMA)
+        {
+            MAP_uDMAChannelDisable(UDMA_CHANNEL_USBEP1RX + (ulPipeIdx * 2));
+            g_ulDMAPending &= ~(DMA_PEND_RECEIVE_FLAG << ulPipeIdx);
+        }
+        MAP_USBFIFOFlush(USB0_BASE, ulEndpoint, USB_EP_HOST_IN);
+
+        //
+        // A double buffered FIFO may hold a second packet.
+        //
+        if(g_sUSBHCD.USBINPipes[ulPipeIdx].ucFIFOSize & USB_FIFO_SIZE_DB_FLAG)
+        {
+            MAP_USBFIFOFlush(USB0_BASE, ulEndpoint, USB_EP_HOST_IN);
+        }
+        g_sUSBHCD.USBINPipes[ulPipeIdx].eState = PIPE_IDLE;
+
+        USBHCDClearFeature(g_sUSBHCD.USBINPipes[ulPipeIdx].psDevice->ulAddress,
+                           ulPipe, USB_FEATURE_EP_HALT);
+    }
+}
+
+//*****************************************************************************
+//
+//! This function returns statistics on the use of the USB controller's FIFO
+//! memory.
+//!
+//! \param ulIndex specifies which USB controller to use.
+//! \param psStats is a pointer to the structure that is filled in.
+//!
+//! Each pipe allocated with USBHCDPipeAlloc() or USBHCDPipeAllocSize() is
+//! given part of the controller's FIFO memory.  Bulk and isochronous pipes are
+//! given a double buffered FIFO when there is room for one.  This function
+//! reports how much FIFO memory is in use, the largest FIFO that could still
+//! be allocated and how many allocations were made, failed or had to fall
+//! back to a single buffered FIFO since USBHCDInit() was called.  An
+//! application can use it to check that its combination of devices, hubs and
+//! class drivers fits in the FIFO memory.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBHCDFIFOStatsGet(unsigned long ulIndex, tUSBHCDFIFOStats *psStats)
+{
+    unsigned long ulCount;
+
+    ASSERT(ulIndex == 0);
+
+    *psStats = g_sFIFOStats;
+
+    //
+    // Find the largest block that could be allocated now.
+    //
+    for(ulCount = FIFO_NUM_BLOCKS; ulCount; ulCount /= 2)
+    {
+        if(FIFOBlockFind(ulCount) != FIFO_NUM_BLOCKS)
+        {
+            break;
+        }
+    }
+    psStats->ulLargestFree = ulCount * FIFO_BLOCK_SIZE;
+}
+
 //*****************************************************************************
 //
 //! This function is used to release a USB pipe.
@@ -2463,8 +2627,24 @@ USBHCDInitInternal(unsigned long ulIndex, void *pvPool,
     //
     // The first 64 Bytes are allocated to endpoint 0.
     //
-    g_ulAlloc[0] = 1;
-    g_ulAlloc[1] = 0;
+    for(lIdx = 0; lIdx < sizeof(g_pulFIFOAlloc) / sizeof(unsigned long);
+        lIdx++)
+    {
+        g_pulFIFOAlloc[lIdx] = 0;
+    }
+    FIFOBlocksMark(0, 1, true);
+
+    //
+    // Start the FIFO allocation statistics over.
+    //
+    g_sFIFOStats.ulTotal = USBHCD_FIFO_RAM_SIZE;
+    g_sFIFOStats.ulFree = USBHCD_FIFO_RAM_SIZE - FIFO_BLOCK_SIZE;
+    g_sFIFOStats.ulLargestFree = 0;
+    g_sFIFOStats.ulMinFree = g_sFIFOStats.ulFree;
+    g_sFIFOStats.ulAllocs = 0;
+    g_sFIFOStats.ulFailures = 0;
+    g_sFIFOStats.ulDoubleBuffered = 0;
+    g_sFIFOStats.ulSingleBuffered = 0;
 
     //
     // Save the base address for this controller.
@@ -3835,6 +4015,11 @@ USBHostIntHandlerInternal(unsigned long ulIndex, unsigned long ulStatus)
         //
         g_ulUSBSOFCount++;
 
+        //
+        // Call any handlers that need to run on every frame.
+        //
+        InternalUSBFrameTick();
+
         //
         // Increment our SOF divider.
         //
@@ -4423,7 +4608,9 @@ USBHCDDeviceDisconnected(unsigned long ulIndex, unsigned long ulDevIndex)
 //! host controller driver interface without the need for an RTOS.  All time
 //! critical operations are handled in interrupt context but all blocking
 //! operations are run from the this function to allow them to block and wait
-//! for completion without holding off other interrupts.
+//! for completion without holding off other interrupts.  This includes the
+//! work that class drivers defer to task context through the \e pfnMain
+//! member of their tUSBHostClassDriver structure.
 //!
 //! \return None.
 //
@@ -4546,6 +4733,17 @@ USBHCDMain(void)
         // Process the state machine for this device.
         //
         ProcessUSBDeviceStateMachine(eOldState, ulLoop);
+
+        //
+        // Let the device's class driver do any work that it has deferred to
+        // task context.
+        //
+        if((g_lUSBHActiveDriver[ulLoop] >= 0) && g_pvDriverInstance[ulLoop] &&
+           g_sUSBHCD.pClassDrivers[g_lUSBHActiveDriver[ulLoop]]->pfnMain)
+        {
+            g_sUSBHCD.pClassDrivers[g_lUSBHActiveDriver[ulLoop]]->pfnMain(
+                                                   g_pvDriverInstance[ulLoop]);
+        }
     }
 }
 
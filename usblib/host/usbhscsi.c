@@ -770,6 +770,60 @@ USBHSCSIWrite10(unsigned long ulInPipe, unsigned long ulOutPipe,
                                pulSize));
 }
 
+//*****************************************************************************
+//
+//! This function builds the CBW for a SCSI Read(10) or Write(10) command.
+//!
+//! \param pSCSICmd is the CBW to fill in.
+//! \param bWrite is \b true for a Write(10) command or \b false for a
+//! Read(10) command.
+//! \param ulLBA is the logical block address of the first block.
+//! \param ulSize is the number of bytes to transfer.
+//! \param ulNumBlocks is the number of contiguous blocks to transfer.
+//!
+//! This function fills in every field of the CBW except \e dCBWTag in the
+//! same way as USBHSCSIRead10() and USBHSCSIWrite10() do before they send the
+//! command.  It is used by drivers that send the CBW and run the data and
+//! status phases themselves rather than waiting for the command to complete,
+//! and which must choose a tag that matches the command to its status.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBHSCSIRW10Build(tMSCCBW *pSCSICmd, tBoolean bWrite, unsigned long ulLBA,
+                  unsigned long ulSize, unsigned long ulNumBlocks)
+{
+    unsigned long ulIdx;
+
+    pSCSICmd->dCBWSignature = CBW_SIGNATURE;
+    pSCSICmd->dCBWDataTransferLength = ulSize;
+    pSCSICmd->bmCBWFlags = bWrite ? CBWFLAGS_DIR_OUT : CBWFLAGS_DIR_IN;
+
+    //
+    // Only handle LUN 0.
+    //
+    pSCSICmd->bCBWLUN = 0;
+    pSCSICmd->bCBWCBLength = 10;
+
+    //
+    // Clear the whole command block, then fill in the opcode, the LBA at
+    // offset 2 and the transfer length in blocks at offset 7.
+    //
+    for(ulIdx = 0; ulIdx < sizeof(pSCSICmd->CBWCB); ulIdx++)
+    {
+        pSCSICmd->CBWCB[ulIdx] = 0;
+    }
+
+    pSCSICmd->CBWCB[0] = bWrite ? SCSI_WRITE_10 : SCSI_READ_10;
+    pSCSICmd->CBWCB[2] = (unsigned char)(ulLBA >> 24);
+    pSCSICmd->CBWCB[3] = (unsigned char)(ulLBA >> 16);
+    pSCSICmd->CBWCB[4] = (unsigned char)(ulLBA >> 8);
+    pSCSICmd->CBWCB[5] = (unsigned char)ulLBA;
+    pSCSICmd->CBWCB[7] = (unsigned char)(ulNumBlocks >> 8);
+    pSCSICmd->CBWCB[8] = (unsigned char)ulNumBlocks;
+}
+
 //*****************************************************************************
 //
 // Close the Doxygen group.
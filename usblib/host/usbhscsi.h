@@ -83,6 +83,9 @@ extern unsigned long USBHSCSIWrite10(unsigned long ulInPipe,
                                      unsigned char *pucData,
                                      unsigned long *pulSize,
                                      unsigned long ulNumBlocks);
+extern void USBHSCSIRW10Build(tMSCCBW *pSCSICmd, tBoolean bWrite,
+                              unsigned long ulLBA, unsigned long ulSize,
+                              unsigned long ulNumBlocks);
 
 //*****************************************************************************
 //
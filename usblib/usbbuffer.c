@@ -24,6 +24,7 @@
 
 #include "inc/hw_types.h"
 #include "driverlib/debug.h"
+#include "driverlib/interrupt.h"
 #include "usblib/usblib.h"
 #include "usblib/usblibpriv.h"
 
@@ -46,6 +47,11 @@ typedef struct
     tUSBRingBufObject sRingBuf;
     unsigned long ulLastSent;
     unsigned long ulFlags;
+    unsigned long ulCoalesceFrames;
+    unsigned long ulHoldStart;
+    tUSBBufferDesc *psDescHead;
+    tUSBBufferDesc *psDescTail;
+    unsigned long ulLastDesc;
 }
 tUSBBufferVars;
 
@@ -55,27 +61,195 @@ tUSBBufferVars;
 //
 //*****************************************************************************
 #define USB_BUFFER_FLAG_SEND_ZLP 0x00000001
+#define USB_BUFFER_FLAG_COALESCE 0x00000002
+#define USB_BUFFER_FLAG_HOLDING  0x00000004
 
 //*****************************************************************************
 //
-// Schedule the next packet transmission to the host if data remains to be
-// sent.
+// Determine whether a partial packet should be held back in coalescing mode.
+//
+// \param psVars points to the workspace of the transmit buffer.
+// \param ulPacket is the number of bytes the lower layer can accept.
+// \param ulTotal is the number of bytes waiting in the buffer.
+//
+// When coalescing is enabled, data is only passed to the lower layer once
+// a full packet is waiting or the data has been held for longer than the
+// configured number of frames.  The hold time is measured from the point at
+// which a partial packet was first held back.
+//
+// \return Returns \b true if transmission should be deferred or \b false if
+// the data should be sent now.
+//
+//*****************************************************************************
+static tBoolean
+CoalesceHold(tUSBBufferVars *psVars, unsigned long ulPacket,
+             unsigned long ulTotal)
+{
+    //
+    // Never hold data if coalescing is disabled or if there is either
+    // nothing to send or at least a full packet to send.
+    //
+    if(!(psVars->ulFlags & USB_BUFFER_FLAG_COALESCE) || !ulTotal ||
+       (ulTotal >= ulPacket))
+    {
+        psVars->ulFlags &= ~USB_BUFFER_FLAG_HOLDING;
+        return(false);
+    }
+
+    //
+    // Is this the first time this data has been held back?
+    //
+    if(!(psVars->ulFlags & USB_BUFFER_FLAG_HOLDING))
+    {
+        //
+        // Yes - start timing from the current frame.
+        //
+        psVars->ulHoldStart = g_ulUSBSOFCount;
+        psVars->ulFlags |= USB_BUFFER_FLAG_HOLDING;
+        return(true);
+    }
+
+    //
+    // Keep holding the data until the timeout has passed.
+    //
+    if((g_ulUSBSOFCount - psVars->ulHoldStart) <= psVars->ulCoalesceFrames)
+    {
+        return(true);
+    }
+
+    //
+    // The timeout has expired so the data must be sent now.
+    //
+    psVars->ulFlags &= ~USB_BUFFER_FLAG_HOLDING;
+    return(false);
+}
+
+//*****************************************************************************
+//
+// Determine how much data is waiting in the descriptor queue.
+//
+// \param psVars points to the workspace of the transmit buffer.
+// \param ulMax is the maximum number of bytes the caller is interested in.
+//
+// This function walks the descriptor queue adding up the number of bytes
+// that have not yet been sent.  It stops as soon as \e ulMax bytes have been
+// found so that a long queue does not need to be walked on every packet.
+//
+// \return Returns the number of bytes waiting, up to a maximum of \e ulMax.
+//
+//*****************************************************************************
+static unsigned long
+DescQueueUsed(tUSBBufferVars *psVars, unsigned long ulMax)
+{
+    tUSBBufferDesc *psDesc;
+    unsigned long ulCount;
+
+    ulCount = 0;
+    psDesc = psVars->psDescHead;
+
+    while(psDesc && (ulCount < ulMax))
+    {
+        ulCount += psDesc->ulLength - psDesc->ulOffset;
+        psDesc = psDesc->psNext;
+    }
+
+    return((ulCount < ulMax) ? ulCount : ulMax);
+}
+
+//*****************************************************************************
+//
+// Remove data that has been transmitted from the descriptor queue.
+//
+// \param psBuffer points to the transmit buffer.
+// \param ulLength is the number of bytes from the descriptor queue that the
+// lower layer has transmitted.
+//
+// This function advances the offset of the descriptor at the head of the
+// queue and, each time a descriptor has been completely transmitted, removes
+// it from the queue and sends \b USB_EVENT_BUFFER_DESC_COMPLETE to the client.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+DescQueueAdvance(const tUSBBuffer *psBuffer, unsigned long ulLength)
+{
+    tUSBBufferVars *psVars;
+    tUSBBufferDesc *psDesc;
+    unsigned long ulCount;
+    tBoolean bIntsOff;
+
+    psVars = psBuffer->pvWorkspace;
+
+    while(ulLength && psVars->psDescHead)
+    {
+        psDesc = psVars->psDescHead;
+
+        //
+        // How much of this descriptor has been sent?
+        //
+        ulCount = psDesc->ulLength - psDesc->ulOffset;
+        ulCount = (ulLength < ulCount) ? ulLength : ulCount;
+        psDesc->ulOffset += ulCount;
+        ulLength -= ulCount;
+
+        //
+        // Is this descriptor finished?
+        //
+        if(psDesc->ulOffset == psDesc->ulLength)
+        {
+            //
+            // Unlink it from the queue.  Interrupts are turned off since the
+            // tail pointer is also written by USBBufferDescQueue().
+            //
+            bIntsOff = IntMasterDisable();
+            psVars->psDescHead = psDesc->psNext;
+            if(!psVars->psDescHead)
+            {
+                psVars->psDescTail = (tUSBBufferDesc *)0;
+            }
+            if(!bIntsOff)
+            {
+                IntMasterEnable();
+            }
+
+            //
+            // Give the descriptor back to the client.
+            //
+            psBuffer->pfnCallback(psBuffer->pvCBData,
+                                  USB_EVENT_BUFFER_DESC_COMPLETE,
+                                  psDesc->ulLength, psDesc);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// Passes the next packet to the lower layer for transmission to the host if
+// data remains to be sent.
 //
 // \param psBuffer points to the buffer from which a packet transmission is
 // to be scheduled.
 //
 // This function checks to determine whether the lower layer is capable of
 // accepting a new packet for transmission and, if so, schedules the next
-// packet transmission if data remains in the buffer.
+// packet transmission if data remains in the buffer.  Data in the ring buffer
+// is sent first followed by data from the descriptor queue.  A single packet
+// may be built from several pieces, in which case the lower layer is told to
+// expect further calls before it transmits the packet.
+//
+// This function must be called with interrupts disabled.  It is called from
+// ScheduleNextTransmission().
 //
 // \return None.
 //
 //*****************************************************************************
 static void
-ScheduleNextTransmission(const tUSBBuffer *psBuffer)
+SendNextPacket(const tUSBBuffer *psBuffer)
 {
     tUSBBufferVars *psVars;
-    unsigned long ulPacket, ulSpace, ulTotal, ulSent;
+    tUSBBufferDesc *psDesc;
+    unsigned long ulPacket, ulSpace, ulRing, ulTotal, ulSent, ulOffset;
 
     //
     // Get a pointer to our workspace variables.
@@ -94,14 +268,16 @@ ScheduleNextTransmission(const tUSBBuffer *psBuffer)
     if(ulPacket)
     {
         //
-        // How much contiguous data do we have in the buffer?
+        // How much data do we have in the ring buffer?
         //
-        ulSpace = USBRingBufContigUsed(&psVars->sRingBuf);
+        ulRing = USBRingBufUsed(&psVars->sRingBuf);
+        ulRing = (ulRing < ulPacket) ? ulRing : ulPacket;
 
         //
-        // How much total data do we have in the buffer?
+        // How much total data do we have to send, including any queued
+        // descriptors?
         //
-        ulTotal = USBRingBufUsed(&psVars->sRingBuf);
+        ulTotal = ulRing + DescQueueUsed(psVars, ulPacket - ulRing);
 
         //
         // How much data will we be sending as a result of this call?
@@ -109,53 +285,76 @@ ScheduleNextTransmission(const tUSBBuffer *psBuffer)
         ulSent = (ulPacket < ulTotal) ? ulPacket : ulTotal;
 
         //
-        // Write the contiguous bytes to the lower layer assuming there is
-        // something to send.
+        // If coalescing is enabled and we only have a partial packet to
+        // send, hold the data back until more arrives or the timeout expires.
+        //
+        if(CoalesceHold(psVars, ulPacket, ulTotal))
+        {
+            return;
+        }
+
+        //
+        // Write the bytes to the lower layer assuming there is something to
+        // send.
         //
-        if(ulSpace)
+        if(ulSent)
         {
             //
             // There is data available to send.  Update our state to indicate
-            // the amount we will be sending in this packet.
+            // the amount we will be sending in this packet and how much of it
+            // comes from the descriptor queue.
             //
             psVars->ulLastSent = ulSent;
+            psVars->ulLastDesc = ulSent - ulRing;
 
             //
-            // Determine the maximum sized block we can send in this transfer.
-            //
-            ulSpace = (ulSpace < ulPacket) ? ulSpace : ulPacket;
-            //
-            // Call the lower layer to send the new packet.  If the current
-            // data spans the buffer wrap, tell the lower layer that it can
-            // expect a second call to fill the whole packet before it
-            // transmits it.
-            //
-            psBuffer->pfnTransfer(psBuffer->pvHandle,
-                                 (psVars->sRingBuf.pucBuf +
-                                  psVars->sRingBuf.ulReadIndex), ulSpace,
-                                  (((ulSpace < ulPacket) &&
-                                    (ulSpace < ulTotal)) ? false : true));
-
-            //
-            // Do we need to send a second part to fill out the packet?  This
-            // will occur if the current packet spans the buffer wrap.
+            // Send the contiguous bytes at the ring buffer read index.
             //
-            if((ulSpace < ulPacket) && (ulSpace < ulTotal))
+            if(ulRing)
             {
-                //
-                // The packet straddled the wrap.  How much space remains in
-                // the packet?
-                //
-                ulPacket -= ulSpace;
+                ulSpace = USBRingBufContigUsed(&psVars->sRingBuf);
+                ulSpace = (ulSpace < ulRing) ? ulSpace : ulRing;
+                ulSent -= ulSpace;
+                ulRing -= ulSpace;
+
+                psBuffer->pfnTransfer(psBuffer->pvHandle,
+                                      (psVars->sRingBuf.pucBuf +
+                                       psVars->sRingBuf.ulReadIndex), ulSpace,
+                                      ulSent ? false : true);
 
                 //
-                // How much data can we actually send?
+                // If the data spans the buffer wrap, send the second part
+                // from the start of the buffer.
                 //
-                ulSpace = ulTotal - ulSpace;
-                ulSpace = (ulSpace > ulPacket) ? ulPacket : ulSpace;
+                if(ulRing)
+                {
+                    ulSent -= ulRing;
+                    psBuffer->pfnTransfer(psBuffer->pvHandle,
+                                          psVars->sRingBuf.pucBuf, ulRing,
+                                          ulSent ? false : true);
+                }
+            }
+
+            //
+            // Fill the remainder of the packet straight from the memory
+            // described by the queued descriptors.
+            //
+            psDesc = psVars->psDescHead;
+            ulOffset = psDesc ? psDesc->ulOffset : 0;
+
+            while(ulSent && psDesc)
+            {
+                ulSpace = psDesc->ulLength - ulOffset;
+                ulSpace = (ulSpace < ulSent) ? ulSpace : ulSent;
+                ulSent -= ulSpace;
 
                 psBuffer->pfnTransfer(psBuffer->pvHandle,
-                                      psVars->sRingBuf.pucBuf, ulSpace, true);
+                                      (unsigned char *)(psDesc->pucData +
+                                                        ulOffset),
+                                      ulSpace, ulSent ? false : true);
+
+                psDesc = psDesc->psNext;
+                ulOffset = 0;
             }
         }
         else
@@ -172,6 +371,7 @@ ScheduleNextTransmission(const tUSBBuffer *psBuffer)
                 if(psVars->ulFlags & USB_BUFFER_FLAG_SEND_ZLP)
                 {
                     psVars->ulLastSent = 0;
+                    psVars->ulLastDesc = 0;
                     psBuffer->pfnTransfer(psBuffer->pvHandle,
                                           psVars->sRingBuf.pucBuf, 0, true);
                 }
@@ -179,12 +379,75 @@ ScheduleNextTransmission(const tUSBBuffer *psBuffer)
         }
 
         //
-        // Don't update the ring buffer read index yet.  We do this once we are
-        // sure the packet was correctly transmitted.
+        // Don't update the ring buffer read index or descriptor offsets yet.
+        // We do this once we are sure the packet was correctly transmitted.
         //
     }
 }
 
+//*****************************************************************************
+//
+// Schedule the next packet transmission to the host if data remains to be
+// sent.
+//
+// \param psBuffer points to the buffer from which a packet transmission is
+// to be scheduled.
+//
+// This function is called from both task context and the USB interrupt,
+// including the SOF handler used for coalescing.  Interrupts are disabled
+// while SendNextPacket() decides what to send and passes it to the lower
+// layer so that the same data cannot be sent twice.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+ScheduleNextTransmission(const tUSBBuffer *psBuffer)
+{
+    tBoolean bIntsOff;
+
+    bIntsOff = IntMasterDisable();
+
+    SendNextPacket(psBuffer);
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+// Frame handler for a transmit buffer operating in coalescing mode.
+//
+// \param pvInstance is the buffer whose data is to be checked.
+// \param ulTicksmS is the number of milliseconds since the last call.
+//
+// This function is called on every SOF and retries transmission of any
+// partial packet that is being held back so that it is sent once the
+// coalescing timeout expires.
+//
+// \return None.
+//
+//*****************************************************************************
+static void
+CoalesceFrameHandler(void *pvInstance, unsigned long ulTicksmS)
+{
+    const tUSBBuffer *psBuffer;
+    tUSBBufferVars *psVars;
+
+    psBuffer = (const tUSBBuffer *)pvInstance;
+    psVars = psBuffer->pvWorkspace;
+
+    //
+    // Only do anything if we are currently holding back data.
+    //
+    if(psVars->ulFlags & USB_BUFFER_FLAG_HOLDING)
+    {
+        ScheduleNextTransmission(psBuffer);
+    }
+}
+
 //*****************************************************************************
 //
 // Handles USB_EVENT_RX_AVAILABLE for a receive buffer.
@@ -404,6 +667,11 @@ HandleDataRemaining(tUSBBuffer *psBuffer)
     //
     ulBufData = USBRingBufUsed(&psVars->sRingBuf);
 
+    //
+    // Add any data still waiting in the descriptor queue.
+    //
+    ulBufData += DescQueueUsed(psVars, 0xFFFFFFFF);
+
     //
     // Return the total number of bytes of unprocessed data to the lower layer.
     //
@@ -430,17 +698,35 @@ static unsigned long
 HandleTxComplete(tUSBBuffer *psBuffer, unsigned long ulSize)
 {
     tUSBBufferVars *psVars;
+    unsigned long ulDesc;
 
     //
     // Get a pointer to our workspace variables.
     //
     psVars = psBuffer->pvWorkspace;
 
+    //
+    // Work out how much of the packet came from the descriptor queue.
+    //
+    ulDesc = (ulSize < psVars->ulLastDesc) ? ulSize : psVars->ulLastDesc;
+    psVars->ulLastDesc = 0;
+
     //
     // Update the transmit buffer read pointer to remove the data that has
     // now been transmitted.
     //
-    USBRingBufAdvanceRead(&psVars->sRingBuf, ulSize);
+    if(ulSize > ulDesc)
+    {
+        USBRingBufAdvanceRead(&psVars->sRingBuf, ulSize - ulDesc);
+    }
+
+    //
+    // Release any descriptors which have now been completely transmitted.
+    //
+    if(ulDesc)
+    {
+        DescQueueAdvance(psBuffer, ulDesc);
+    }
 
     //
     // Try to schedule the next packet transmission if data remains to be
@@ -559,6 +845,9 @@ USBBufferInit(const tUSBBuffer *psBuffer)
     //
     psVars = psBuffer->pvWorkspace;
     psVars->ulFlags = 0;
+    psVars->ulLastDesc = 0;
+    psVars->psDescHead = (tUSBBufferDesc *)0;
+    psVars->psDescTail = (tUSBBufferDesc *)0;
     USBRingBufInit(&psVars->sRingBuf, psBuffer->pcBuffer,
                    psBuffer->ulBufferSize);
 
@@ -623,6 +912,93 @@ USBBufferZeroLengthPacketInsert(const tUSBBuffer *psBuffer, tBoolean bSendZLP)
     }
 }
 
+//*****************************************************************************
+//
+//! Enables or disables transmit coalescing.
+//!
+//! \param psBuffer is the pointer to the transmit buffer instance whose
+//! coalescing mode is to be changed.
+//! \param bCoalesce is \b true to enable coalescing or \b false to disable it.
+//! \param ulFrames is the number of additional USB frames that a partial
+//! packet may be held back for before it is sent.
+//!
+//! By default, a transmit buffer starts sending as soon as any data is
+//! written to it so a producer making many small writes causes many short
+//! packets to be sent.  When coalescing is enabled, the buffer only passes
+//! data to the lower layer once a full packet is waiting or once a partial
+//! packet has been held back for longer than the timeout.  This reduces the
+//! number of packets and interrupts required to move a given amount of data.
+//!
+//! The timeout is checked on every start-of-frame so its granularity is one
+//! full speed frame (1 millisecond).  A value of 0 for \e ulFrames causes a
+//! partial packet to be sent at the next start-of-frame, which is never more
+//! than 1 millisecond away.  Each additional frame adds 1 millisecond to the
+//! maximum latency.
+//!
+//! Disabling coalescing immediately schedules any data being held back and
+//! releases the frame handler used for the timeout.  An application may do
+//! this, then re-enable coalescing, to push out a partial packet without
+//! waiting for the timeout.  Calling this function while coalescing is
+//! already enabled only changes the timeout.
+//!
+//! \note The start-of-frame interrupt must be enabled for the timeout to
+//! operate.  This is the case by default in both device and host mode.
+//!
+//! \return Returns \b true on success or \b false if no frame handler was
+//! available to service the timeout.
+//
+//*****************************************************************************
+tBoolean
+USBBufferCoalesceSet(const tUSBBuffer *psBuffer, tBoolean bCoalesce,
+                     unsigned long ulFrames)
+{
+    tUSBBufferVars *psVars;
+
+    //
+    // Check parameter validity.
+    //
+    ASSERT(psBuffer);
+    ASSERT(psBuffer->bTransmitBuffer == true);
+
+    //
+    // Get our workspace variables.
+    //
+    psVars = psBuffer->pvWorkspace;
+
+    if(bCoalesce)
+    {
+        //
+        // Make sure we get called on each frame to check the timeout, unless
+        // coalescing is already on and only the timeout is changing.
+        //
+        if(!(psVars->ulFlags & USB_BUFFER_FLAG_COALESCE) &&
+           InternalUSBRegisterFrameHandler(CoalesceFrameHandler,
+                                           (void *)psBuffer))
+        {
+            return(false);
+        }
+
+        //
+        // Enable coalescing with the new timeout.
+        //
+        psVars->ulCoalesceFrames = ulFrames;
+        psVars->ulFlags |= USB_BUFFER_FLAG_COALESCE;
+    }
+    else
+    {
+        //
+        // Disable coalescing and send anything that was being held back.
+        //
+        psVars->ulFlags &= ~(USB_BUFFER_FLAG_COALESCE |
+                             USB_BUFFER_FLAG_HOLDING);
+        InternalUSBUnregisterFrameHandler(CoalesceFrameHandler,
+                                          (void *)psBuffer);
+        ScheduleNextTransmission(psBuffer);
+    }
+
+    return(true);
+}
+
 //*****************************************************************************
 //
 //! Returns the current ring buffer indices for this USB buffer.
@@ -831,13 +1207,17 @@ USBBufferCallbackDataSet(tUSBBuffer *psBuffer, void *pvCBData)
 //! This function copies the supplied data into the transmit buffer.  The
 //! transmit buffer data will be packetized according to the constraints
 //! imposed by the lower layer in use and sent to the USB controller as soon as
-//! possible.  Once a packet is transmitted and acknowledged, a
-//! \b USB_EVENT_TX_COMPLETE event will be sent to the application callback
-//! indicating the number of bytes that have been sent from the buffer.
+//! possible, or held back until a full packet is available if coalescing has
+//! been enabled using USBBufferCoalesceSet().  Once a packet is transmitted
+//! and acknowledged, a \b USB_EVENT_TX_COMPLETE event will be sent to the
+//! application callback indicating the number of bytes that have been sent
+//! from the buffer.
 //!
 //! Attempts to send more data than there is space for in the transmit buffer
 //! will result in fewer bytes than expected being written.  The value returned
 //! by the function indicates the actual number of bytes copied to the buffer.
+//! No data is accepted while descriptors queued using USBBufferDescQueue()
+//! remain to be sent.
 //!
 //! \return Returns the number of bytes actually written.
 //
@@ -861,9 +1241,10 @@ USBBufferWrite(const tUSBBuffer *psBuffer, const unsigned char *pucData,
     psVars = psBuffer->pvWorkspace;
 
     //
-    // How much space is left in the buffer?
+    // How much space is left in the buffer?  No data is accepted while
+    // descriptors are queued since it would otherwise be sent ahead of them.
     //
-    ulSpace = USBRingBufFree(&psVars->sRingBuf);
+    ulSpace = psVars->psDescHead ? 0 : USBRingBufFree(&psVars->sRingBuf);
 
     //
     // How many bytes will we write?
@@ -889,6 +1270,89 @@ USBBufferWrite(const tUSBBuffer *psBuffer, const unsigned char *pucData,
     return(ulLength);
 }
 
+//*****************************************************************************
+//
+//! Queues a block of data to be transmitted directly from the caller's
+//! memory.
+//!
+//! \param psBuffer points to the transmit buffer instance on which the data
+//! is to be sent.
+//! \param psDesc points to a descriptor giving the address and size of the
+//! data to send.
+//!
+//! This function allows a client to send data without it first being copied
+//! into the buffer's ring buffer.  The \e pucData and \e ulLength fields of
+//! the descriptor must be set before this call and the data is then passed to
+//! the lower layer a packet at a time straight from \e pucData.  The data may
+//! reside in flash.  Several descriptors may be queued and their data is sent
+//! in order, with packets spanning descriptor boundaries as required so that
+//! small descriptors still produce full packets.
+//!
+//! Once all of the data for a descriptor has been transmitted and
+//! acknowledged, the descriptor is removed from the queue and the client
+//! callback is sent \b USB_EVENT_BUFFER_DESC_COMPLETE with \e ulMsgValue set
+//! to the number of bytes sent and \e pvMsgData pointing to the descriptor.
+//! Until this event is received, neither the descriptor nor the data it
+//! describes may be modified.  The descriptor itself must be in RAM since the
+//! buffer uses it to link the queue and track progress.
+//!
+//! Any data already in the ring buffer is sent before the queued descriptors
+//! and USBBufferWrite() accepts no further data until the descriptor queue is
+//! empty.  This ensures that data is always sent in the order it was given to
+//! the buffer.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+USBBufferDescQueue(const tUSBBuffer *psBuffer, tUSBBufferDesc *psDesc)
+{
+    tUSBBufferVars *psVars;
+    tBoolean bIntsOff;
+
+    //
+    // Check parameter validity.
+    //
+    ASSERT(psBuffer && psDesc && psDesc->pucData && psDesc->ulLength);
+    ASSERT(psBuffer->bTransmitBuffer == true);
+
+    //
+    // Get our workspace variables.
+    //
+    psVars = psBuffer->pvWorkspace;
+
+    //
+    // Initialize the private fields of the descriptor.
+    //
+    psDesc->psNext = (tUSBBufferDesc *)0;
+    psDesc->ulOffset = 0;
+
+    //
+    // Add the descriptor to the tail of the queue.  Interrupts are turned
+    // off since completed descriptors are removed from the queue in the
+    // context of the USB interrupt.
+    //
+    bIntsOff = IntMasterDisable();
+    if(psVars->psDescTail)
+    {
+        psVars->psDescTail->psNext = psDesc;
+    }
+    else
+    {
+        psVars->psDescHead = psDesc;
+    }
+    psVars->psDescTail = psDesc;
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    //
+    // Try to transmit the next packet to the host.
+    //
+    ScheduleNextTransmission(psBuffer);
+}
+
 //*****************************************************************************
 //
 //! Flushes a USB buffer, discarding any data that it contains.
@@ -898,7 +1362,10 @@ USBBufferWrite(const tUSBBuffer *psBuffer, const unsigned char *pucData,
 //!
 //! This function discards all data currently in the supplied buffer without
 //! processing (transmitting it via the USB controller or passing it to the
-//! client depending upon the buffer mode).
+//! client depending upon the buffer mode).  Any descriptors queued using
+//! USBBufferDescQueue() are removed from the queue and returned to the client
+//! via \b USB_EVENT_BUFFER_DESC_COMPLETE with \e ulMsgValue set to the number
+//! of bytes that were sent from each.
 //!
 //! \return None.
 //
@@ -907,6 +1374,8 @@ void
 USBBufferFlush(const tUSBBuffer *psBuffer)
 {
     tUSBBufferVars *psVars;
+    tUSBBufferDesc *psDesc, *psNext;
+    tBoolean bIntsOff;
 
     //
     // Check parameter validity.
@@ -922,6 +1391,28 @@ USBBufferFlush(const tUSBBuffer *psBuffer)
     // Flush the ring buffer.
     //
     USBRingBufFlush(&psVars->sRingBuf);
+
+    //
+    // Discard any queued descriptors, returning each to the client.
+    //
+    bIntsOff = IntMasterDisable();
+    psDesc = psVars->psDescHead;
+    psVars->psDescHead = (tUSBBufferDesc *)0;
+    psVars->psDescTail = (tUSBBufferDesc *)0;
+    psVars->ulLastDesc = 0;
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    while(psDesc)
+    {
+        psNext = psDesc->psNext;
+        psBuffer->pfnCallback(psBuffer->pvCBData,
+                              USB_EVENT_BUFFER_DESC_COMPLETE,
+                              psDesc->ulOffset, psDesc);
+        psDesc = psNext;
+    }
 }
 
 //*****************************************************************************
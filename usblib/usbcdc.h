@@ -736,9 +736,14 @@ extern "C"
 typedef struct
 {
     //
-    //! The data terminal rate in bits per second.
+    //! The data terminal rate in bits per second.  This field is 32 bits
+    //! wide on LP64 hosts too, so that the structure matches the request.
     //
+#ifdef __LP64__
+    unsigned int ulRate;
+#else
     unsigned long ulRate;
+#endif
 
     //
     //! The number of stop bits.  Valid values are USB_CDC_STOP_BITS_1,
@@ -1509,6 +1509,13 @@ tEventInfo;
 //
 #define USB_EVENT_SOF                (USB_EVENT_BASE + 19)
 
+//
+//! A USB buffer has finished transmitting the data described by a descriptor
+//! queued using USBBufferDescQueue().  The \e pvMsgData parameter points to
+//! the descriptor and \e ulMsgValue holds the number of bytes sent.
+//
+#define USB_EVENT_BUFFER_DESC_COMPLETE (USB_EVENT_BASE + 20)
+
 //*****************************************************************************
 //
 // Error sources reported via USB_EVENT_ERROR.
@@ -1640,7 +1647,40 @@ typedef unsigned long (* tUSBPacketAvailable)(void *pvHandle);
 //! the \e pvWorkspace field of the \e tUSBBuffer structure.
 //
 //*****************************************************************************
-#define USB_BUFFER_WORKSPACE_SIZE 24
+#define USB_BUFFER_WORKSPACE_SIZE 44
+
+//*****************************************************************************
+//
+//! The structure used to describe a block of data queued for transmission
+//! directly from application memory using USBBufferDescQueue().
+//
+//*****************************************************************************
+typedef struct _tUSBBufferDesc
+{
+    //
+    //! A pointer to the first byte of data to send.  This may point to data
+    //! in flash.
+    //
+    const unsigned char *pucData;
+
+    //
+    //! The number of bytes of data to send.
+    //
+    unsigned long ulLength;
+
+    //
+    //! The number of bytes that have been sent so far.  This field is
+    //! private to the USB buffer.
+    //
+    unsigned long ulOffset;
+
+    //
+    //! The next descriptor in the queue.  This field is private to the USB
+    //! buffer.
+    //
+    struct _tUSBBufferDesc *psNext;
+}
+tUSBBufferDesc;
 
 //*****************************************************************************
 //
@@ -1751,6 +1791,9 @@ tUSBRingBufObject;
 extern const tUSBBuffer *USBBufferInit(const tUSBBuffer *psBuffer);
 extern void USBBufferZeroLengthPacketInsert(const tUSBBuffer *psBuffer,
                                             tBoolean bSendZLP);
+extern tBoolean USBBufferCoalesceSet(const tUSBBuffer *psBuffer,
+                                     tBoolean bCoalesce,
+                                     unsigned long ulFrames);
 extern void USBBufferInfoGet(const tUSBBuffer *psBuffer,
                              tUSBRingBufObject *psRingBuf);
 extern void *USBBufferCallbackDataSet(tUSBBuffer *psBuffer, void *pvCBData);
@@ -1761,6 +1804,8 @@ extern void USBBufferDataWritten(const tUSBBuffer *psBuffer,
                                  unsigned long ulLength);
 extern void USBBufferDataRemoved(const tUSBBuffer *psBuffer,
                                  unsigned long ulLength);
+extern void USBBufferDescQueue(const tUSBBuffer *psBuffer,
+                               tUSBBufferDesc *psDesc);
 extern void USBBufferFlush(const tUSBBuffer *psBuffer);
 extern unsigned long USBBufferRead(const tUSBBuffer *psBuffer,
                                    unsigned char *pucData,
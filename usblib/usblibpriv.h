@@ -27,6 +27,10 @@
 #ifndef __USBLIBPRIV_H__
 #define __USBLIBPRIV_H__
 
+#ifdef USBLIB_NO_BITBAND
+#include "driverlib/interrupt.h"
+#endif
+
 //*****************************************************************************
 //
 // If building with a C++ compiler, make all of the definitions in this header
@@ -66,6 +70,17 @@ extern void USBHostIntHandlerInternal(unsigned long ulIndex,
 //*****************************************************************************
 #define USB_SOF_TICK_DIVIDE 5
 
+//*****************************************************************************
+//
+// The maximum number of frame handlers that can be registered.  Frame
+// handlers are called on every SOF rather than every USB_SOF_TICK_DIVIDE
+// SOFs and are used by code that needs finer timing than the tick provides.
+//
+//*****************************************************************************
+#ifndef MAX_USB_FRAME_HANDLERS
+#define MAX_USB_FRAME_HANDLERS      4
+#endif
+
 //*****************************************************************************
 //
 // Tick handler function pointer type.
@@ -84,6 +99,11 @@ extern void InternalUSBTickReset(void);
 extern long InternalUSBRegisterTickHandler(tUSBTickHandler pfHandler,
                                            void *pvInstance);
 extern void InternalUSBStartOfFrameTick(unsigned long ulTicksmS);
+extern long InternalUSBRegisterFrameHandler(tUSBTickHandler pfHandler,
+                                            void *pvInstance);
+extern void InternalUSBUnregisterFrameHandler(tUSBTickHandler pfHandler,
+                                              void *pvInstance);
+extern void InternalUSBFrameTick(void);
 extern void InternalUSBHCDSendEvent(unsigned long ulIndex,
                                     tEventInfo *psEvent,
                                     unsigned long ulEvFlag);
@@ -118,6 +138,39 @@ extern unsigned long g_ulUSBSOFCount;
 //*****************************************************************************
 #define InternalUSBGetTime() g_ulCurrentUSBTick
 
+//*****************************************************************************
+//
+// InternalUSBBitSetH sets or clears one bit of a halfword that may also be
+// written in the context of the USB interrupt.  On the target this is a
+// single, atomic bit-band write.  Builds for processors without a bit-band
+// region, such as the host build used by tools/usbsim, define
+// USBLIB_NO_BITBAND to use a read-modify-write with interrupts disabled.
+//
+//*****************************************************************************
+#ifdef USBLIB_NO_BITBAND
+#define InternalUSBBitSetH(pusValue, usBit, bSet)                             \
+    do                                                                        \
+    {                                                                         \
+        tBoolean bBitIntsOff = IntMasterDisable();                            \
+        if(bSet)                                                              \
+        {                                                                     \
+            *(pusValue) |= (unsigned short)(1 << (usBit));                    \
+        }                                                                     \
+        else                                                                  \
+        {                                                                     \
+            *(pusValue) &= (unsigned short)~(1 << (usBit));                   \
+        }                                                                     \
+        if(!bBitIntsOff)                                                      \
+        {                                                                     \
+            IntMasterEnable();                                                \
+        }                                                                     \
+    }                                                                         \
+    while(0)
+#else
+#define InternalUSBBitSetH(pusValue, usBit, bSet)                             \
+    HWREGBITH((pusValue), (usBit)) = (bSet) ? 1 : 0
+#endif
+
 //*****************************************************************************
 //
 // Mark the end of the C bindings section for C++ compilers.
@@ -44,6 +44,14 @@ extern "C"
 //*****************************************************************************
 #define USBREQ_GET_MAX_LUN      0xfe
 
+//*****************************************************************************
+//
+// The Bulk-Only Mass Storage Reset request, which returns a mass storage
+// device to the state where it is ready for the next CBW.
+//
+//*****************************************************************************
+#define USBREQ_MSC_RESET        0xff
+
 //*****************************************************************************
 //
 // The signatures defined by USB MSC class specification.
@@ -72,6 +80,19 @@ extern "C"
 #pragma pack(1)
 #endif
 
+//*****************************************************************************
+//
+// The type used for the 32-bit fields of the CBW and CSW.  An unsigned long is
+// 32 bits wide on the target but 64 bits wide on LP64 hosts such as the one
+// used to build the library for tools/usbsim.
+//
+//*****************************************************************************
+#ifdef __LP64__
+typedef unsigned int tMSCDWord;
+#else
+typedef unsigned long tMSCDWord;
+#endif
+
 //*****************************************************************************
 //
 // The following packed structure is used to access the Command Block Wrapper
@@ -86,7 +107,7 @@ typedef struct
     // field shall contain the value 0x43425355 (little endian), indicating a
     // CBW.
     //
-    unsigned long dCBWSignature;
+    tMSCDWord dCBWSignature;
 
     //
     // The Command Block Tag sent by the host controller.  The device shall
@@ -94,7 +115,7 @@ typedef struct
     // of the associated CSW.  The dCSWTag positively associates a CSW with the
     // corresponding CBW.
     //
-    unsigned long dCBWTag;
+    tMSCDWord dCBWTag;
 
     //
     // The number of bytes of data that the host expects to transfer on the
@@ -104,7 +125,7 @@ typedef struct
     // and the device will ignore the value of the Direction bit in
     // bmCBWFlags.
     //
-    unsigned long dCBWDataTransferLength;
+    tMSCDWord dCBWDataTransferLength;
 
     //
     // The device will ignore these bits if the dCBWDataTransferLength value
@@ -169,13 +190,13 @@ typedef struct
     // Signature that identifies this data packet as a CSW.  The signature
     // field must contain the value 53425355h (little endian) to indicate CSW.
     //
-    unsigned long dCSWSignature;
+    tMSCDWord dCSWSignature;
 
     //
     // The device will set this field to the value received in the dCBWTag of
     // the associated CBW.
     //
-    unsigned long dCSWTag;
+    tMSCDWord dCSWTag;
 
     //
     // For OUT transactions the device will fill the dCSWDataResidue field with
@@ -187,7 +208,7 @@ typedef struct
     // sent by the device.  The dCSWDataResidue will not exceed the value sent
     // in the dCBWDataTransferLength.
     //
-    unsigned long dCSWDataResidue;
+    tMSCDWord dCSWDataResidue;
 
     //
     // The bCSWStatus field indicates the success or failure of the command.
@@ -229,6 +250,7 @@ PACKED tMSCCSW;
 #define SCSI_READ_CAPACITY          0x25
 #define SCSI_READ_10                0x28
 #define SCSI_WRITE_10               0x2a
+#define SCSI_SYNCHRONIZE_CACHE      0x35
 
 //*****************************************************************************
 //
@@ -44,6 +44,18 @@
 tUSBTickHandler g_pfTickHandlers[MAX_USB_TICK_HANDLERS];
 void *g_pvTickInstance[MAX_USB_TICK_HANDLERS];
 
+//*****************************************************************************
+//
+// These are the internal frame handlers used by the USB stack.  Handlers in
+// g_pfFrameHandlers are called in the context of the USB SOF interrupt on
+// every SOF.  Unlike the tick handlers, these are not cleared by
+// InternalUSBTickInit() since they are registered by objects, such as USB
+// buffers, whose lifetime is independent of the device or host class driver.
+//
+//*****************************************************************************
+static tUSBTickHandler g_pfFrameHandlers[MAX_USB_FRAME_HANDLERS];
+static void *g_pvFrameInstance[MAX_USB_FRAME_HANDLERS];
+
 //*****************************************************************************
 //
 // Flag to indicate whether or not we have been initialized.
@@ -167,6 +179,122 @@ InternalUSBRegisterTickHandler(tUSBTickHandler pfHandler,
     return(0);
 }
 
+//*****************************************************************************
+//
+// This internal function registers a handler to be called on every SOF.
+//
+// \param pfHandler specifies the handler to call.
+// \param pvInstance is the instance pointer that will be passed to the
+// handler.
+//
+// Registering the same handler and instance pair more than once has no
+// effect, so callers may safely register each time they are configured.
+// Handlers registered via this function are called in the context of the SOF
+// interrupt with \e ulTicksmS set to 1.
+//
+// \return A value of zero means that the frame handler was registered and any
+// other value indicates an error.
+//
+//*****************************************************************************
+long
+InternalUSBRegisterFrameHandler(tUSBTickHandler pfHandler, void *pvInstance)
+{
+    long lIdx, lFree;
+
+    lFree = -1;
+
+    for(lIdx = 0; lIdx < MAX_USB_FRAME_HANDLERS; lIdx++)
+    {
+        //
+        // Is this handler already registered?
+        //
+        if((g_pfFrameHandlers[lIdx] == pfHandler) &&
+           (g_pvFrameInstance[lIdx] == pvInstance))
+        {
+            return(0);
+        }
+
+        //
+        // Remember the first free slot.
+        //
+        if((g_pfFrameHandlers[lIdx] == 0) && (lFree < 0))
+        {
+            lFree = lIdx;
+        }
+    }
+
+    if(lFree < 0)
+    {
+        return(-1);
+    }
+
+    //
+    // Save the instance data before the handler so that the SOF interrupt
+    // never sees a handler without its instance.
+    //
+    g_pvFrameInstance[lFree] = pvInstance;
+    g_pfFrameHandlers[lFree] = pfHandler;
+
+    return(0);
+}
+
+//*****************************************************************************
+//
+// This internal function removes a handler registered with
+// InternalUSBRegisterFrameHandler().
+//
+// \param pfHandler specifies the handler to remove.
+// \param pvInstance is the instance pointer that the handler was registered
+// with.
+//
+// Removing a handler and instance pair that is not registered has no effect.
+// The handler is cleared before its instance so that the SOF interrupt never
+// calls it with another handler's instance.
+//
+// \return None.
+//
+//*****************************************************************************
+void
+InternalUSBUnregisterFrameHandler(tUSBTickHandler pfHandler, void *pvInstance)
+{
+    long lIdx;
+
+    for(lIdx = 0; lIdx < MAX_USB_FRAME_HANDLERS; lIdx++)
+    {
+        if((g_pfFrameHandlers[lIdx] == pfHandler) &&
+           (g_pvFrameInstance[lIdx] == pvInstance))
+        {
+            g_pfFrameHandlers[lIdx] = 0;
+            g_pvFrameInstance[lIdx] = 0;
+            return;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// This internal function is called on every SOF by the low level device- or
+// host-mode interrupt handler to call any registered frame handlers.
+//
+// This function should only be called from within the USB library.
+//
+// \return None.
+//
+//*****************************************************************************
+void
+InternalUSBFrameTick(void)
+{
+    long lIdx;
+
+    for(lIdx = 0; lIdx < MAX_USB_FRAME_HANDLERS; lIdx++)
+    {
+        if(g_pfFrameHandlers[lIdx])
+        {
+            g_pfFrameHandlers[lIdx](g_pvFrameInstance[lIdx], 1);
+        }
+    }
+}
+
 //*****************************************************************************
 //
 //! \internal
@@ -0,0 +1,577 @@
+//*****************************************************************************
+//
+// tracerec.c - Low overhead RTOS trace recorder.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+// 
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+// 
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+// 
+// This is part of revision 9453 of the Stellaris Firmware Development Package.
+//
+//*****************************************************************************
+
+
+#include "inc/hw_nvic.h"
+#include "inc/hw_types.h"
+#include "driverlib/debug.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/uart.h"
+#include "utils/tracerec.h"
+
+//*****************************************************************************
+//
+//! \addtogroup tracerec_api
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+// The Cortex-M data watchpoint and trace (DWT) unit registers used to provide
+// a cycle accurate timestamp for each event.
+//
+//*****************************************************************************
+#define DWT_CTRL                0xE0001000  // DWT Control
+#define DWT_CYCCNT              0xE0001004  // DWT Cycle Count
+#define DWT_CTRL_CYCCNTENA      0x00000001  // Enable the cycle counter
+#define NVIC_DBG_INT_TRCENA     0x01000000  // Enable the DWT and ITM units
+
+//*****************************************************************************
+//
+// The in-memory (and on the wire) format of a single trace event.  The
+// structure is 8 bytes long and is sent exactly as it is stored, so the
+// stream is little endian.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulCycles;
+    unsigned char ucEvent;
+    unsigned char ucId;
+    unsigned short usData;
+}
+tTraceRecEvent;
+
+//*****************************************************************************
+//
+// The trace buffer and its indices.  The indices are free running counts of
+// events written and read; the buffer position is the count modulo the
+// buffer size.  Only the recording functions update the write index and only
+// the drain functions update the read index.
+//
+//*****************************************************************************
+static tTraceRecEvent g_psTraceRecBuffer[TRACEREC_BUFFER_EVENTS];
+static volatile unsigned long g_ulTraceRecWrite;
+static volatile unsigned long g_ulTraceRecRead;
+
+//*****************************************************************************
+//
+// The offset into the event at the read index that TraceRecUARTDrain() has
+// already sent.
+//
+//*****************************************************************************
+static unsigned long g_ulTraceRecDrainOffset;
+
+//*****************************************************************************
+//
+// The number of events dropped since tracing started, and the number that
+// have not yet been reported in the stream with a TRACEREC_EVENT_LOST event.
+//
+//*****************************************************************************
+static volatile unsigned long g_ulTraceRecLost;
+static volatile unsigned long g_ulTraceRecLostPending;
+
+//*****************************************************************************
+//
+// Whether events are currently being recorded.
+//
+//*****************************************************************************
+static volatile tBoolean g_bTraceRecEnabled;
+
+//*****************************************************************************
+//
+// The CPU clock rate, sent in the stream header so that the decoder can
+// convert cycle counts to time.
+//
+//*****************************************************************************
+static unsigned long g_ulTraceRecClock;
+
+//*****************************************************************************
+//
+// The names of the tasks created so far, indexed by task id, so they can be
+// resent each time tracing is started.  Id 0 is reserved for tasks that have
+// not been assigned an id.
+//
+//*****************************************************************************
+static const char *g_ppcTraceRecTaskNames[TRACEREC_MAX_TASKS];
+static unsigned long g_ulTraceRecNumTasks;
+static unsigned long g_ulTraceRecNumQueues;
+
+//*****************************************************************************
+//
+// Stores one event in the trace buffer.  This must be called with interrupts
+// disabled.  Returns false if the buffer was full.
+//
+//*****************************************************************************
+static tBoolean
+TraceRecPut(unsigned long ulCycles, unsigned long ulEvent, unsigned long ulId,
+            unsigned long ulData)
+{
+    tTraceRecEvent *psEvent;
+
+    //
+    // Is there space in the buffer?
+    //
+    if((g_ulTraceRecWrite - g_ulTraceRecRead) >= TRACEREC_BUFFER_EVENTS)
+    {
+        return(false);
+    }
+
+    //
+    // Fill in the event.
+    //
+    psEvent = &g_psTraceRecBuffer[g_ulTraceRecWrite &
+                                  (TRACEREC_BUFFER_EVENTS - 1)];
+    psEvent->ulCycles = ulCycles;
+    psEvent->ucEvent = (unsigned char)ulEvent;
+    psEvent->ucId = (unsigned char)ulId;
+    psEvent->usData = (unsigned short)ulData;
+
+    //
+    // Make the event visible to the drain functions.
+    //
+    g_ulTraceRecWrite++;
+
+    return(true);
+}
+
+//*****************************************************************************
+//
+// Stores the name of a task in the trace buffer as a run of
+// TRACEREC_EVENT_TASK_NAME events, six characters per event.  This must be
+// called with interrupts disabled so that the run is not split.
+//
+//*****************************************************************************
+static void
+TraceRecPutName(unsigned long ulId, const char *pcName)
+{
+    unsigned char pucChars[6];
+    unsigned long ulIdx;
+    tBoolean bDone;
+
+    bDone = false;
+
+    while(!bDone)
+    {
+        //
+        // Gather the next six characters, padding with zeros once the end of
+        // the string is found.
+        //
+        for(ulIdx = 0; ulIdx < 6; ulIdx++)
+        {
+            pucChars[ulIdx] = bDone ? 0 : (unsigned char)*pcName;
+            if(pucChars[ulIdx] == 0)
+            {
+                bDone = true;
+            }
+            else
+            {
+                pcName++;
+            }
+        }
+
+        if(!TraceRecPut(pucChars[0] | (pucChars[1] << 8) |
+                        (pucChars[2] << 16) | (pucChars[3] << 24),
+                        TRACEREC_EVENT_TASK_NAME, ulId,
+                        pucChars[4] | (pucChars[5] << 8)))
+        {
+            g_ulTraceRecLost++;
+            g_ulTraceRecLostPending++;
+            return;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Initializes the trace recorder.
+//!
+//! \param ulCPUClock is the rate of the processor clock in Hz.
+//!
+//! This function enables the DWT cycle counter that is used to timestamp each
+//! event.  It must be called before any tasks or queues are created so that
+//! they are all given trace ids.  Recording does not begin until
+//! TraceRecStart() is called.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TraceRecInit(unsigned long ulCPUClock)
+{
+    //
+    // The buffer indices rely on the size being a power of two.
+    //
+    ASSERT((TRACEREC_BUFFER_EVENTS & (TRACEREC_BUFFER_EVENTS - 1)) == 0);
+
+    g_ulTraceRecClock = ulCPUClock;
+    g_bTraceRecEnabled = false;
+
+    //
+    // Enable the trace unit and start the cycle counter.
+    //
+    HWREG(NVIC_DBG_INT) |= NVIC_DBG_INT_TRCENA;
+    HWREG(DWT_CYCCNT) = 0;
+    HWREG(DWT_CTRL) |= DWT_CTRL_CYCCNTENA;
+}
+
+//*****************************************************************************
+//
+//! Starts recording events.
+//!
+//! This function empties the trace buffer and then records a stream header
+//! followed by the names of all tasks that have been created so far, so that
+//! a decoder connecting part way through a session can still identify every
+//! task.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TraceRecStart(void)
+{
+    tBoolean bIntsOff;
+    unsigned long ulIdx;
+
+    bIntsOff = IntMasterDisable();
+
+    //
+    // Discard anything left from a previous session.
+    //
+    g_ulTraceRecRead = g_ulTraceRecWrite;
+    g_ulTraceRecDrainOffset = 0;
+    g_ulTraceRecLost = 0;
+    g_ulTraceRecLostPending = 0;
+
+    //
+    // Send the header and the known task names.
+    //
+    TraceRecPut(g_ulTraceRecClock, TRACEREC_EVENT_HEADER, TRACEREC_VERSION,
+                TRACEREC_MAGIC);
+
+    for(ulIdx = 1; (ulIdx <= g_ulTraceRecNumTasks) &&
+                   (ulIdx < TRACEREC_MAX_TASKS); ulIdx++)
+    {
+        TraceRecPutName(ulIdx, g_ppcTraceRecTaskNames[ulIdx]);
+    }
+
+    g_bTraceRecEnabled = true;
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+//! Stops recording events.
+//!
+//! Events already in the buffer may still be read after recording stops.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TraceRecStop(void)
+{
+    g_bTraceRecEnabled = false;
+}
+
+//*****************************************************************************
+//
+//! Records a single event.
+//!
+//! \param ulEvent is one of the \b TRACEREC_EVENT_* values.
+//! \param ulId is the task, queue or interrupt the event applies to.
+//! \param ulData is event specific data.  Only the low 16 bits are recorded.
+//!
+//! This function may be called from any context, including interrupt
+//! handlers of any priority.  Interrupts are disabled for a few cycles while
+//! the event is stored.  If the buffer is full the event is counted as lost
+//! and a TRACEREC_EVENT_LOST event is stored once space becomes available.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TraceRecEvent(unsigned long ulEvent, unsigned long ulId, unsigned long ulData)
+{
+    tBoolean bIntsOff;
+    unsigned long ulCycles;
+
+    if(!g_bTraceRecEnabled)
+    {
+        return;
+    }
+
+    bIntsOff = IntMasterDisable();
+
+    ulCycles = HWREG(DWT_CYCCNT);
+
+    //
+    // Report any events that were dropped before this one.
+    //
+    if(g_ulTraceRecLostPending)
+    {
+        if(TraceRecPut(ulCycles, TRACEREC_EVENT_LOST, 0,
+                       g_ulTraceRecLostPending))
+        {
+            g_ulTraceRecLostPending = 0;
+        }
+    }
+
+    if(g_ulTraceRecLostPending ||
+       !TraceRecPut(ulCycles, ulEvent, ulId, ulData))
+    {
+        g_ulTraceRecLost++;
+        g_ulTraceRecLostPending++;
+    }
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+//! Assigns a trace id to a newly created task.
+//!
+//! \param pcName is the name of the task.  The string must remain valid for
+//! the life of the task.
+//!
+//! This function is normally called by the traceTASK_CREATE() kernel hook.
+//!
+//! \return Returns the trace id of the task.
+//
+//*****************************************************************************
+unsigned long
+TraceRecTaskCreate(const char *pcName)
+{
+    tBoolean bIntsOff;
+    unsigned long ulId;
+
+    bIntsOff = IntMasterDisable();
+
+    ulId = ++g_ulTraceRecNumTasks;
+    if(ulId < TRACEREC_MAX_TASKS)
+    {
+        g_ppcTraceRecTaskNames[ulId] = pcName;
+    }
+
+    if(g_bTraceRecEnabled)
+    {
+        TraceRecPutName(ulId, pcName);
+    }
+
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    return(ulId);
+}
+
+//*****************************************************************************
+//
+//! Assigns a trace id to a newly created queue.
+//!
+//! \param ulType is the kernel's queue type, which is passed to the decoder.
+//!
+//! This function is normally called by the traceQUEUE_CREATE() and
+//! traceCREATE_MUTEX() kernel hooks.
+//!
+//! \return Returns the trace id of the queue.
+//
+//*****************************************************************************
+unsigned long
+TraceRecQueueCreate(unsigned long ulType)
+{
+    tBoolean bIntsOff;
+    unsigned long ulId;
+
+    bIntsOff = IntMasterDisable();
+    ulId = ++g_ulTraceRecNumQueues;
+    if(!bIntsOff)
+    {
+        IntMasterEnable();
+    }
+
+    TraceRecEvent(TRACEREC_EVENT_QUEUE_CREATE, ulId, ulType);
+
+    return(ulId);
+}
+
+//*****************************************************************************
+//
+//! Records entry to an interrupt handler.
+//!
+//! This function should be called at the start of each interrupt handler
+//! that is to appear in the trace.  The vector number is read from the NVIC
+//! so no parameter is required.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TraceRecISREnter(void)
+{
+    TraceRecEvent(TRACEREC_EVENT_ISR_ENTER,
+                  HWREG(NVIC_INT_CTRL) & NVIC_INT_CTRL_VEC_ACT_M, 0);
+}
+
+//*****************************************************************************
+//
+//! Records exit from an interrupt handler.
+//!
+//! This function should be called at the end of each interrupt handler that
+//! called TraceRecISREnter().
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TraceRecISRExit(void)
+{
+    TraceRecEvent(TRACEREC_EVENT_ISR_EXIT,
+                  HWREG(NVIC_INT_CTRL) & NVIC_INT_CTRL_VEC_ACT_M, 0);
+}
+
+//*****************************************************************************
+//
+//! Reads recorded events from the trace buffer.
+//!
+//! \param pucData points to the buffer to copy the events into.
+//! \param ulMaxBytes is the size of the buffer pointed to by \e pucData.
+//!
+//! This function copies as many whole events as will fit into \e pucData and
+//! removes them from the trace buffer.  It is intended for transports such as
+//! a USB bulk endpoint that move blocks of data; for example, an application
+//! can pass the result directly to USBBufferWrite().  It must not be mixed
+//! with TraceRecUARTDrain().
+//!
+//! \return Returns the number of bytes copied, which is always a multiple of
+//! 8.
+//
+//*****************************************************************************
+unsigned long
+TraceRecRead(unsigned char *pucData, unsigned long ulMaxBytes)
+{
+    unsigned long ulRead, ulCount, ulIdx;
+    unsigned char *pucEvent;
+
+    ASSERT(pucData);
+    ASSERT(g_ulTraceRecDrainOffset == 0);
+
+    ulRead = g_ulTraceRecRead;
+    ulCount = 0;
+
+    while((ulRead != g_ulTraceRecWrite) &&
+          ((ulCount + sizeof(tTraceRecEvent)) <= ulMaxBytes))
+    {
+        pucEvent = (unsigned char *)&g_psTraceRecBuffer[
+                       ulRead & (TRACEREC_BUFFER_EVENTS - 1)];
+
+        for(ulIdx = 0; ulIdx < sizeof(tTraceRecEvent); ulIdx++)
+        {
+            *pucData++ = pucEvent[ulIdx];
+        }
+
+        ulCount += sizeof(tTraceRecEvent);
+        ulRead++;
+    }
+
+    //
+    // Release the space back to the recorder.
+    //
+    g_ulTraceRecRead = ulRead;
+
+    return(ulCount);
+}
+
+//*****************************************************************************
+//
+//! Sends recorded events to a UART.
+//!
+//! \param ulBase is the base address of the UART to send the trace to.
+//!
+//! This function writes bytes from the trace buffer into the UART transmit
+//! FIFO until either the FIFO is full or the buffer is empty.  It never waits
+//! so it may be called from the idle task, a low priority task, or the UART
+//! transmit interrupt handler.  The UART must already be configured.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TraceRecUARTDrain(unsigned long ulBase)
+{
+    unsigned long ulRead;
+    unsigned char *pucEvent;
+
+    ulRead = g_ulTraceRecRead;
+
+    while((ulRead != g_ulTraceRecWrite) && UARTSpaceAvail(ulBase))
+    {
+        pucEvent = (unsigned char *)&g_psTraceRecBuffer[
+                       ulRead & (TRACEREC_BUFFER_EVENTS - 1)];
+
+        UARTCharPutNonBlocking(ulBase, pucEvent[g_ulTraceRecDrainOffset]);
+
+        //
+        // Move to the next event once every byte of this one is sent.
+        //
+        if(++g_ulTraceRecDrainOffset == sizeof(tTraceRecEvent))
+        {
+            g_ulTraceRecDrainOffset = 0;
+            ulRead++;
+            g_ulTraceRecRead = ulRead;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Returns the number of events lost since tracing started.
+//!
+//! Events are lost when they are recorded faster than the trace buffer is
+//! drained.
+//!
+//! \return Returns the number of lost events.
+//
+//*****************************************************************************
+unsigned long
+TraceRecLostEvents(void)
+{
+    return(g_ulTraceRecLost);
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
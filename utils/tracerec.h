@@ -0,0 +1,204 @@
+//*****************************************************************************
+//
+// tracerec.h - Prototypes and hooks for the RTOS trace recorder.
+//
+// Copyright (c) 2012 Texas Instruments Incorporated.  All rights reserved.
+// Software License Agreement
+// 
+// Texas Instruments (TI) is supplying this software for use solely and
+// exclusively on TI's microcontroller products. The software is owned by
+// TI and/or its suppliers, and is protected under applicable copyright
+// laws. You may not combine this software with "viral" open-source
+// software in order to form a larger program.
+// 
+// THIS SOFTWARE IS PROVIDED "AS IS" AND WITH ALL FAULTS.
+// NO WARRANTIES, WHETHER EXPRESS, IMPLIED OR STATUTORY, INCLUDING, BUT
+// NOT LIMITED TO, IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE APPLY TO THIS SOFTWARE. TI SHALL NOT, UNDER ANY
+// CIRCUMSTANCES, BE LIABLE FOR SPECIAL, INCIDENTAL, OR CONSEQUENTIAL
+// DAMAGES, FOR ANY REASON WHATSOEVER.
+// 
+// This is part of revision 9453 of the Stellaris Firmware Development Package.
+//
+//*****************************************************************************
+
+
+#ifndef __TRACEREC_H__
+#define __TRACEREC_H__
+
+//*****************************************************************************
+//
+// If building with a C++ compiler, make all of the definitions in this header
+// have a C binding.
+//
+//*****************************************************************************
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//*****************************************************************************
+//
+// The number of events held in the trace buffer.  Each event occupies 8 bytes
+// of RAM.  This must be a power of two.
+//
+//*****************************************************************************
+#ifndef TRACEREC_BUFFER_EVENTS
+#define TRACEREC_BUFFER_EVENTS  512
+#endif
+
+//*****************************************************************************
+//
+// The maximum number of tasks whose names are remembered so that they can be
+// resent each time tracing is started.
+//
+//*****************************************************************************
+#ifndef TRACEREC_MAX_TASKS
+#define TRACEREC_MAX_TASKS      32
+#endif
+
+//*****************************************************************************
+//
+// The event codes that appear in the trace stream.  Each event is 8 bytes,
+// transmitted little endian:
+//
+//     bytes 0-3: DWT cycle counter value when the event was recorded.
+//     byte  4:   event code (one of the TRACEREC_EVENT_* values).
+//     byte  5:   object identifier (task, queue or interrupt number).
+//     bytes 6-7: event specific data.
+//
+//*****************************************************************************
+#define TRACEREC_EVENT_HEADER   0x00    // Stream start.  Cycle field holds
+                                        // the CPU clock rate, id the format
+                                        // version, data TRACEREC_MAGIC.
+#define TRACEREC_EVENT_TASK_NAME \
+                                0x01    // Up to 6 characters of a task name.
+                                        // Bytes 0-3 and 6-7 hold characters.
+#define TRACEREC_EVENT_TASK_SWITCH \
+                                0x02    // Task id was switched in.
+#define TRACEREC_EVENT_ISR_ENTER \
+                                0x03    // Interrupt vector id was entered.
+#define TRACEREC_EVENT_ISR_EXIT 0x04    // Interrupt vector id was exited.
+#define TRACEREC_EVENT_QUEUE_CREATE \
+                                0x05    // Queue id was created, data holds
+                                        // the queue type.
+#define TRACEREC_EVENT_QUEUE_SEND \
+                                0x06    // Item sent to queue id, data holds
+                                        // the number of items waiting.
+#define TRACEREC_EVENT_QUEUE_RECEIVE \
+                                0x07    // Item received from queue id, data
+                                        // holds the number of items waiting.
+#define TRACEREC_EVENT_QUEUE_BLOCK_SEND \
+                                0x08    // Current task blocked sending to
+                                        // queue id.
+#define TRACEREC_EVENT_QUEUE_BLOCK_RECEIVE \
+                                0x09    // Current task blocked receiving from
+                                        // queue id.
+#define TRACEREC_EVENT_LOST     0x0A    // Data holds the number of events
+                                        // dropped because the buffer was full.
+#define TRACEREC_EVENT_USER     0x0B    // Application event, see
+                                        // TraceRecUserEvent().
+
+//*****************************************************************************
+//
+// The value carried in the data field of the TRACEREC_EVENT_HEADER event, and
+// the version of the stream format.
+//
+//*****************************************************************************
+#define TRACEREC_MAGIC          0x5452
+#define TRACEREC_VERSION        1
+
+//*****************************************************************************
+//
+// Prototypes for the trace recorder APIs.
+//
+//*****************************************************************************
+extern void TraceRecInit(unsigned long ulCPUClock);
+extern void TraceRecStart(void);
+extern void TraceRecStop(void);
+extern void TraceRecEvent(unsigned long ulEvent, unsigned long ulId,
+                          unsigned long ulData);
+extern unsigned long TraceRecTaskCreate(const char *pcName);
+extern unsigned long TraceRecQueueCreate(unsigned long ulType);
+extern void TraceRecISREnter(void);
+extern void TraceRecISRExit(void);
+extern unsigned long TraceRecRead(unsigned char *pucData,
+                                  unsigned long ulMaxBytes);
+extern void TraceRecUARTDrain(unsigned long ulBase);
+extern unsigned long TraceRecLostEvents(void);
+
+//*****************************************************************************
+//
+// Records an application defined event.  ucId and usData are passed through
+// to the decoder unchanged.
+//
+//*****************************************************************************
+#define TraceRecUserEvent(ucId, usData)                                       \
+        TraceRecEvent(TRACEREC_EVENT_USER, (ucId), (usData))
+
+//*****************************************************************************
+//
+// FreeRTOS kernel hooks.  To trace the kernel, include this header at the end
+// of FreeRTOSConfig.h and set configUSE_TRACE_FACILITY to 1.  The macros are
+// expanded inside tasks.c and queue.c so they may use the kernel's private
+// TCB and queue structures directly.
+//
+//*****************************************************************************
+#ifdef FREERTOS_CONFIG_H
+
+#if configUSE_TRACE_FACILITY != 1
+#error "The trace recorder requires configUSE_TRACE_FACILITY to be set to 1."
+#endif
+
+#define traceTASK_CREATE(pxNewTCB)                                            \
+        (pxNewTCB)->uxTaskNumber =                                            \
+            TraceRecTaskCreate((const char *)(pxNewTCB)->pcTaskName)
+
+#define traceTASK_SWITCHED_IN()                                               \
+        TraceRecEvent(TRACEREC_EVENT_TASK_SWITCH,                             \
+                      pxCurrentTCB->uxTaskNumber, 0)
+
+#define traceQUEUE_CREATE(pxNewQueue)                                         \
+        (pxNewQueue)->ucQueueNumber =                                         \
+            TraceRecQueueCreate((pxNewQueue)->ucQueueType)
+
+#define traceCREATE_MUTEX(pxNewQueue)                                         \
+        (pxNewQueue)->ucQueueNumber =                                         \
+            TraceRecQueueCreate((pxNewQueue)->ucQueueType)
+
+#define traceQUEUE_SEND(pxQueue)                                              \
+        TraceRecEvent(TRACEREC_EVENT_QUEUE_SEND, (pxQueue)->ucQueueNumber,    \
+                      (pxQueue)->uxMessagesWaiting + 1)
+
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)                                     \
+        TraceRecEvent(TRACEREC_EVENT_QUEUE_SEND, (pxQueue)->ucQueueNumber,    \
+                      (pxQueue)->uxMessagesWaiting + 1)
+
+#define traceQUEUE_RECEIVE(pxQueue)                                           \
+        TraceRecEvent(TRACEREC_EVENT_QUEUE_RECEIVE, (pxQueue)->ucQueueNumber, \
+                      (pxQueue)->uxMessagesWaiting - 1)
+
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)                                  \
+        TraceRecEvent(TRACEREC_EVENT_QUEUE_RECEIVE, (pxQueue)->ucQueueNumber, \
+                      (pxQueue)->uxMessagesWaiting - 1)
+
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue)                                  \
+        TraceRecEvent(TRACEREC_EVENT_QUEUE_BLOCK_SEND,                        \
+                      (pxQueue)->ucQueueNumber, 0)
+
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)                               \
+        TraceRecEvent(TRACEREC_EVENT_QUEUE_BLOCK_RECEIVE,                     \
+                      (pxQueue)->ucQueueNumber, 0)
+
+#endif // FREERTOS_CONFIG_H
+
+//*****************************************************************************
+//
+// Mark the end of the C bindings section for C++ compilers.
+//
+//*****************************************************************************
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TRACEREC_H__